@@ -5,6 +5,7 @@
  */
 
 #include <string.h>
+#include <algorithm>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
@@ -27,9 +28,15 @@
 #include "app_video.h"
 #include "app_pedestrian_detect.h"
 #include "app_humanface_detect.h"
+#include "app_model_manager.h"
 #include "app_camera_pipeline.hpp"
 #include "Camera.hpp"
 #include "ui/ui.h"
+#include "opdi_api_ws.h"
+#include "opdi_api_json.h"
+#include "opdi_recog.h"
+#include "opdi_clip.h"
+#include "opdi_cam.h"
 
 #define ALIGN_UP_BY(num, align) (((num) + ((align) - 1)) & ~((align) - 1))
 
@@ -55,8 +62,6 @@ static const char *TAG = "Camera";
 static vector<vector<int>> detect_bound;
 static vector<vector<int>> detect_keypoints;
 static std::list<dl::detect::result_t> detect_results;
-static PedestrianDetect *ped_detect = NULL;
-static HumanFaceDetect *hum_detect = NULL;
 static pipeline_handle_t feed_pipeline;
 static pipeline_handle_t detect_pipeline;
 
@@ -104,11 +109,15 @@ bool Camera::run(void)
         _camera_init_sem = NULL;
     }
 
-    ped_detect = get_pedestrian_detect();
-    assert(ped_detect != NULL);
-    
-    hum_detect = get_humanface_detect();
-    assert(hum_detect != NULL);
+    // Detectors load on the first frame of their mode; a warm one from the last open is reused
+    app_model_manager_init();
+
+#if CONFIG_OPDI_RECOG_ENABLE
+    // Face detection mode then also recognizes; without the model it only detects
+    if (opdi_recog_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Embedding model not loaded; faces are detected but not recognized");
+    }
+#endif
 
     xTaskCreatePinnedToCore((TaskFunction_t)camera_dectect_task, "Camera Detect", 1024 * 8, this, 5, &_detect_task_handle, 1);
 
@@ -400,6 +409,95 @@ static void perfmon_end(int ctr, int count)
 }
 #endif
 
+// Boxes of the latest detection to /ws "detect" subscribers; a no-op while nobody subscribed
+static void publish_detect(const std::list<dl::detect::result_t> &results, int w, int h, uint8_t model)
+{
+    opdi_ws_detect_hdr_t hdr = {};
+    opdi_ws_box_t boxes[OPDI_WS_DETECT_MAX_BOXES];
+    for (const auto& res : results) {
+        if (hdr.count == OPDI_WS_DETECT_MAX_BOXES) {
+            break;
+        }
+        if (res.box.size() < 4) {
+            continue;
+        }
+        opdi_ws_box_t &b = boxes[hdr.count++];
+        b.x = (int16_t)res.box[0];
+        b.y = (int16_t)res.box[1];
+        b.w = (uint16_t)std::max(0, res.box[2] - res.box[0]);
+        b.h = (uint16_t)std::max(0, res.box[3] - res.box[1]);
+        b.score = (uint8_t)std::min(100.0f, std::max(0.0f, res.score * 100.0f));
+        b.cls = (uint8_t)res.category;
+    }
+    hdr.t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    hdr.img_w = (uint16_t)w;
+    hdr.img_h = (uint16_t)h;
+    hdr.model = model;
+    opdi_api_ws_publish_bin(OPDI_WS_CH_DETECT, &hdr, sizeof(hdr), boxes, hdr.count * sizeof(boxes[0]));
+}
+
+#if CONFIG_OPDI_RECOG_ENABLE
+// Identify every face that has landmarks, through the per-track cache; one /ws "recognize" event
+// per frame so the per-topic coalescing never drops a face of the same frame
+static void recognize_faces(const std::list<dl::detect::result_t> &results, const uint16_t *frame, int w, int h)
+{
+    static char buf[1280];  // detect task only; kept off its stack
+    int64_t now = esp_timer_get_time();
+    opdi_json_t j;
+    opdi_json_init(&j, buf, sizeof(buf), NULL, NULL);
+    opdi_json_obj_begin(&j);
+    opdi_json_kv_str(&j, "type", "recognize");
+    opdi_json_kv_uint(&j, "t", (uint64_t)(now / 1000));
+    opdi_json_key(&j, "faces");
+    opdi_json_arr_begin(&j);
+    int n = 0;
+    opdi_recog_cache_begin_frame(now);
+    for (const auto& res : results) {
+        if (n == DETECT_NUM_MAX || res.box.size() < 4 || res.keypoint.size() < 10) {
+            continue;
+        }
+        const int box[4] = {res.box[0], res.box[1], res.box[2], res.box[3]};
+        uint16_t track;
+        opdi_recog_result_t r;
+        bool cached = opdi_recog_cache_get(box, res.keypoint.data(), now, &track, &r);
+        if (!cached) {
+            opdi_recog_result_t fresh;
+            esp_err_t err = opdi_recog_identify(frame, w, h, res.keypoint.data(), &fresh);
+            if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+                continue;
+            }
+            opdi_recog_cache_put(track, res.keypoint.data(), &fresh, now, &r);
+        }
+        n++;
+        opdi_json_obj_begin(&j);
+        opdi_json_kv_uint(&j, "track", track);
+        opdi_json_key(&j, "box");
+        opdi_json_arr_begin(&j);
+        opdi_json_int(&j, res.box[0]);
+        opdi_json_int(&j, res.box[1]);
+        opdi_json_int(&j, std::max(0, res.box[2] - res.box[0]));
+        opdi_json_int(&j, std::max(0, res.box[3] - res.box[1]));
+        opdi_json_arr_end(&j);
+        opdi_json_key(&j, "id");
+        if (r.matched) {
+            opdi_json_uint(&j, r.id);
+        } else {
+            opdi_json_null(&j);
+        }
+        opdi_json_kv_str(&j, "label", r.label);
+        opdi_json_kv_int(&j, "score", (int64_t)(r.score * 100.0f));
+        opdi_json_kv_uint(&j, "ms", r.lat.total_us / 1000);
+        opdi_json_kv_bool(&j, "cached", cached);
+        opdi_json_obj_end(&j);
+    }
+    opdi_json_arr_end(&j);
+    opdi_json_obj_end(&j);
+    if (n && opdi_json_finish(&j) == ESP_OK) {
+        opdi_api_ws_publish("recognize", j.buf, j.len);
+    }
+}
+#endif
+
 void Camera::camera_dectect_task(Camera *app)
 {
     int res = 0;
@@ -408,12 +506,29 @@ void Camera::camera_dectect_task(Camera *app)
         
         if (xEventGroupGetBits(camera_event_group) & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT)) {
             camera_pipeline_buffer_element *p = camera_pipeline_recv_element(feed_pipeline, portMAX_DELAY);
+            bool ped = xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_PED_DETECT;
+            if (p && !app_model_acquire(ped ? APP_MODEL_PEDESTRIAN : APP_MODEL_HUMANFACE)) {
+                // No model: hand the frame back undetected rather than stall the feed pipeline
+                camera_pipeline_queue_element_index(feed_pipeline, p->index);
+                p = NULL;
+            }
             if (p) {
-                if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_PED_DETECT) {
+                if (ped) {
                     detect_results = app_pedestrian_detect((uint16_t *)p->buffer, app->_hor_res, app->_ver_res);
                 }  else {
                     detect_results = app_humanface_detect((uint16_t *)p->buffer, app->_hor_res, app->_ver_res);
                 }
+                publish_detect(detect_results, app->_hor_res, app->_ver_res, ped ? 0 : 1);
+                // Starts an event clip, or extends the one being recorded (no-op without opdi_clip_start)
+                if (!detect_results.empty()) {
+                    opdi_clip_trigger(ped ? "pedestrian" : "face");
+                }
+#if CONFIG_OPDI_RECOG_ENABLE
+                // Before the frame goes back to the feed pipeline: the warp reads it
+                if (!ped && opdi_recog_ready()) {
+                    recognize_faces(detect_results, (uint16_t *)p->buffer, app->_hor_res, app->_ver_res);
+                }
+#endif
 
                 camera_pipeline_queue_element_index(feed_pipeline, p->index);
 
@@ -430,8 +545,11 @@ void Camera::camera_dectect_task(Camera *app)
         }
 
         if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_DELETE) {
-            delete_pedestrian_detect();
-            delete_humanface_detect();
+            // Keep-warm policy decides whether the detectors outlive the app
+            app_model_idle();
+#if CONFIG_OPDI_RECOG_ENABLE
+            opdi_recog_deinit();
+#endif
 
             ESP_LOGI(TAG, "Camera detect task exit");
             vTaskDelete(NULL);
@@ -449,6 +567,9 @@ static void camera_video_frame_operation(uint8_t *camera_buf, uint8_t camera_buf
     // Check if AI detection is needed
     EventBits_t current_bits = xEventGroupGetBits(camera_event_group);
     bool is_detect_mode = current_bits & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT);
+
+    // Stream/clip JPEG layers from the clean frame, before detection boxes are drawn into it
+    opdi_cam_encode_rgb565(camera_buf, camera_buf_hes, camera_buf_ves);
     
     if (is_detect_mode) {
         // Process input frame
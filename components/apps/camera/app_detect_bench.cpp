@@ -0,0 +1,119 @@
+// Detection benchmark on the device: recorded frames through the camera app's detectors (opdi_bench)
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "app_pedestrian_detect.h"
+#include "app_humanface_detect.h"
+#include "app_detect_bench.h"
+#include "opdi_bench.h"
+#include "opdi_recog.h"
+
+static const char *TAG = "app_detect_bench";
+
+static int bench_detect(void *ctx, const uint16_t *rgb565, int width, int height, uint32_t *recog_us)
+{
+    app_model_id_t id = (app_model_id_t)(intptr_t)ctx;
+    // The detectors take a mutable frame but only read it
+    uint16_t *frame = const_cast<uint16_t *>(rgb565);
+    std::list<dl::detect::result_t> results = id == APP_MODEL_PEDESTRIAN ?
+            app_pedestrian_detect(frame, width, height) : app_humanface_detect(frame, width, height);
+#if CONFIG_OPDI_RECOG_ENABLE
+    if (id == APP_MODEL_HUMANFACE && opdi_recog_ready()) {
+        // Every face, no track cache: the cost of a fresh embedding per face
+        int64_t t0 = esp_timer_get_time();
+        for (const auto &res : results) {
+            opdi_recog_result_t r;
+            if (res.keypoint.size() >= 10) {
+                opdi_recog_identify(rgb565, width, height, res.keypoint.data(), &r);
+            }
+        }
+        *recog_us = (uint32_t)(esp_timer_get_time() - t0);
+    }
+#endif
+    return (int)results.size();
+}
+
+esp_err_t app_detect_bench_run(app_model_id_t id, const char *dir, int width, int height, const char *out_path,
+                               opdi_bench_result_t *out)
+{
+    static const char *const names[APP_MODEL_MAX] = { "pedestrian", "humanface" };
+    if (id >= APP_MODEL_MAX || !dir) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Cold load, so the report carries the real load cost
+    app_model_manager_init();
+    app_model_unload_all();
+    if (!app_model_acquire(id)) {
+        return ESP_FAIL;
+    }
+    app_model_stats_t st;
+    app_model_get_stats(id, &st);
+#if CONFIG_OPDI_RECOG_ENABLE
+    bool recog = id == APP_MODEL_HUMANFACE && opdi_recog_init() == ESP_OK;
+#endif
+
+    opdi_bench_model_t model = {};
+    model.name = names[id];
+    model.detect = bench_detect;
+    model.ctx = (void *)(intptr_t)id;
+    model.load_ms = st.load_ms;
+    model.resident_bytes = st.resident_bytes;
+    opdi_bench_cfg_t cfg = {};
+    cfg.dir = dir;
+#if CONFIG_CAMERA_DETECT_BENCH
+    cfg.width = CONFIG_CAMERA_DETECT_BENCH_WIDTH;
+    cfg.height = CONFIG_CAMERA_DETECT_BENCH_HEIGHT;
+    cfg.repeat = CONFIG_CAMERA_DETECT_BENCH_REPEAT;
+    cfg.label = CONFIG_CAMERA_DETECT_BENCH_LABEL;
+#else
+    cfg.width = 1280;
+    cfg.height = 720;
+    cfg.repeat = 1;
+#endif
+    if (width > 0 && height > 0) {
+        cfg.width = width;
+        cfg.height = height;
+    }
+    cfg.warmup = -1;
+
+    opdi_bench_result_t r;
+    esp_err_t err = opdi_bench_run(&cfg, &model, NULL, NULL, &r);
+    if (err == ESP_OK) {
+        // One line on the console for copy-paste, and the file for tools/detect_bench_compare.py
+        err = opdi_bench_write_json(&cfg, &model, &r, opdi_bench_file_sink, stdout);
+        FILE *f = out_path ? fopen(out_path, "w") : NULL;
+        if (f) {
+            err = opdi_bench_write_json(&cfg, &model, &r, opdi_bench_file_sink, f);
+            fclose(f);
+            ESP_LOGI(TAG, "report written to %s", out_path);
+        } else if (out_path) {
+            ESP_LOGW(TAG, "cannot write %s", out_path);
+        }
+        if (out) {
+            *out = r;
+        }
+    }
+#if CONFIG_OPDI_RECOG_ENABLE
+    if (recog) {
+        opdi_recog_deinit();
+    }
+#endif
+    app_model_unload_all();
+    return err;
+}
+
+void app_detect_bench_boot(void)
+{
+#if CONFIG_CAMERA_DETECT_BENCH
+    char path[160];
+#if CONFIG_CAMERA_DETECT_BENCH_PEDESTRIAN
+    snprintf(path, sizeof(path), "%s/bench_pedestrian.json", CONFIG_CAMERA_DETECT_BENCH_DIR);
+    ESP_LOGI(TAG, "pedestrian: %s", esp_err_to_name(app_detect_bench_run(APP_MODEL_PEDESTRIAN, CONFIG_CAMERA_DETECT_BENCH_DIR, 0, 0, path, NULL)));
+#endif
+#if CONFIG_CAMERA_DETECT_BENCH_HUMANFACE
+    snprintf(path, sizeof(path), "%s/bench_humanface.json", CONFIG_CAMERA_DETECT_BENCH_DIR);
+    ESP_LOGI(TAG, "humanface: %s", esp_err_to_name(app_detect_bench_run(APP_MODEL_HUMANFACE, CONFIG_CAMERA_DETECT_BENCH_DIR, 0, 0, path, NULL)));
+#endif
+#endif
+}
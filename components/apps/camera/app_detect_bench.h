@@ -0,0 +1,30 @@
+// Detection benchmark on the device: recorded frames through the camera app's detectors (opdi_bench)
+#pragma once
+
+#include "esp_err.h"
+#include "app_model_manager.h"
+#include "opdi_bench.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Benchmark one detector over the *.rgb565 frames in dir.
+ *
+ * The model is loaded fresh, so the report carries its load time and resident bytes. In face mode
+ * with recognition enabled and the embedding model present, every face is also identified and
+ * timed as the "recog" stage. The JSON report is printed and, when out_path is set, written there.
+ * width/height 0 take the CONFIG_CAMERA_DETECT_BENCH frame size; out (optional) gets the result.
+ */
+esp_err_t app_detect_bench_run(app_model_id_t id, const char *dir, int width, int height, const char *out_path,
+                               opdi_bench_result_t *out);
+
+/**
+ * @brief The CONFIG_CAMERA_DETECT_BENCH run at boot: the selected detectors over CONFIG_CAMERA_DETECT_BENCH_DIR.
+ */
+void app_detect_bench_boot(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,177 @@
+// Detector model manager: lazy load on first use, keep-warm policy across mode switches and app opens
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "app_pedestrian_detect.h"
+#include "app_humanface_detect.h"
+#include "app_model_manager.h"
+
+static const char *TAG = "app_model";
+
+#if CONFIG_CAMERA_MODEL_KEEP_NONE
+#define KEEP_WARM_US 0
+#else
+#define KEEP_WARM_US ((int64_t)CONFIG_CAMERA_MODEL_KEEP_WARM_S * 1000000)
+#endif
+
+typedef struct {
+    const char *name;
+    bool (*load)(void);
+    void (*unload)(void);
+} model_ops_t;
+
+static bool load_pedestrian(void)
+{
+    return get_pedestrian_detect() != NULL;
+}
+
+static bool load_humanface(void)
+{
+    return get_humanface_detect() != NULL;
+}
+
+static const model_ops_t s_ops[APP_MODEL_MAX] = {
+    { "pedestrian", load_pedestrian, delete_pedestrian_detect },   // APP_MODEL_PEDESTRIAN
+    { "humanface", load_humanface, delete_humanface_detect },      // APP_MODEL_HUMANFACE
+};
+
+static app_model_stats_t s_stats[APP_MODEL_MAX];
+static size_t s_peak_bytes;
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_idle_timer;
+static bool s_idle;             // camera closed; the timer may release the warm models
+
+static void unload_locked(app_model_id_t id)
+{
+    if (!s_stats[id].loaded) {
+        return;
+    }
+    size_t before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    s_ops[id].unload();
+    s_stats[id].loaded = false;
+    size_t after = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    ESP_LOGI(TAG, "%s unloaded, %u KB PSRAM released", s_ops[id].name,
+             (unsigned)((after > before ? after - before : 0) / 1024));
+}
+
+static void unload_all_locked(void)
+{
+    for (int i = 0; i < APP_MODEL_MAX; i++) {
+        unload_locked((app_model_id_t)i);
+    }
+}
+
+static void idle_timer_cb(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // A reopen may have acquired a model while this callback waited for the lock
+    if (s_idle) {
+        ESP_LOGI(TAG, "camera closed for %d s, releasing warm models", (int)(KEEP_WARM_US / 1000000));
+        unload_all_locked();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void app_model_manager_init(void)
+{
+    if (s_lock) {
+        return;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    assert(s_lock != NULL);
+    const esp_timer_create_args_t args = {
+        .callback = idle_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "model_idle",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_idle_timer));
+}
+
+bool app_model_acquire(app_model_id_t id)
+{
+    if (id >= APP_MODEL_MAX || !s_lock) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_idle) {
+        s_idle = false;
+        esp_timer_stop(s_idle_timer);
+    }
+    if (!s_stats[id].loaded) {
+#if !CONFIG_CAMERA_MODEL_KEEP_ALL
+        // One working set at a time: free the other detector's tensors before this one allocates
+        unload_all_locked();
+#endif
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        int64_t t0 = esp_timer_get_time();
+        bool ok = s_ops[id].load();
+        int64_t t1 = esp_timer_get_time();
+        size_t free_after = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        app_model_stats_t *s = &s_stats[id];
+        s->loaded = ok;
+        if (ok) {
+            s->loads++;
+            s->load_ms = (uint32_t)((t1 - t0) / 1000);
+            s->resident_bytes = free_before > free_after ? free_before - free_after : 0;
+            if (s->resident_bytes > s_peak_bytes) {
+                s_peak_bytes = s->resident_bytes;
+            }
+            ESP_LOGI(TAG, "%s loaded in %u ms, %u KB resident (load #%u, peak %u KB)", s_ops[id].name,
+                     (unsigned)s->load_ms, (unsigned)(s->resident_bytes / 1024), (unsigned)s->loads,
+                     (unsigned)(s_peak_bytes / 1024));
+        } else {
+            ESP_LOGE(TAG, "%s failed to load", s_ops[id].name);
+        }
+    }
+    bool ready = s_stats[id].loaded;
+    xSemaphoreGive(s_lock);
+    return ready;
+}
+
+void app_model_idle(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+#if CONFIG_CAMERA_MODEL_KEEP_NONE
+    unload_all_locked();
+#else
+    if (KEEP_WARM_US > 0) {
+        s_idle = true;
+        esp_timer_stop(s_idle_timer);
+        esp_timer_start_once(s_idle_timer, KEEP_WARM_US);
+    }
+#endif
+    xSemaphoreGive(s_lock);
+}
+
+void app_model_unload_all(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_idle = false;
+    esp_timer_stop(s_idle_timer);
+    unload_all_locked();
+    xSemaphoreGive(s_lock);
+}
+
+void app_model_get_stats(app_model_id_t id, app_model_stats_t *out)
+{
+    if (id >= APP_MODEL_MAX || !out) {
+        return;
+    }
+    *out = s_stats[id];
+}
+
+size_t app_model_peak_bytes(void)
+{
+    return s_peak_bytes;
+}
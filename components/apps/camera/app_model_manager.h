@@ -0,0 +1,59 @@
+// Detector model manager: lazy load on first use, keep-warm policy across mode switches and app opens
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    APP_MODEL_PEDESTRIAN = 0,
+    APP_MODEL_HUMANFACE,
+    APP_MODEL_MAX,
+} app_model_id_t;
+
+typedef struct {
+    bool loaded;
+    uint32_t loads;          // times the model was parsed and its tensors allocated
+    uint32_t load_ms;        // duration of the last load
+    size_t resident_bytes;   // PSRAM taken by the last load (weights + working set)
+} app_model_stats_t;
+
+/**
+ * @brief Create the manager lock and timer. Idempotent; called from Camera::run().
+ */
+void app_model_manager_init(void);
+
+/**
+ * @brief Make a detector ready for the detect task, loading it if it is not resident.
+ *
+ * Under the "active" and "none" policies any other resident detector is unloaded first, so
+ * only one working set lives in PSRAM.
+ *
+ * @return true if the model can be run
+ */
+bool app_model_acquire(app_model_id_t id);
+
+/**
+ * @brief The camera app closed: apply the keep-warm policy (unload now, or after the keep-warm time).
+ */
+void app_model_idle(void);
+
+/**
+ * @brief Unload every detector now.
+ */
+void app_model_unload_all(void);
+
+void app_model_get_stats(app_model_id_t id, app_model_stats_t *out);
+
+/**
+ * @brief Largest PSRAM footprint seen for any one load: what the single-model policy keeps resident.
+ */
+size_t app_model_peak_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
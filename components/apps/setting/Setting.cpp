@@ -10,6 +10,7 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include "opdi_net.h"
 #include "esp_check.h"
 #include "esp_memory_utils.h"
 #include "esp_mac.h"
@@ -517,21 +518,21 @@ void AppSettings::stopWifiScan(void)
     deinitWifiListButton();
 }
 
-void AppSettings::scanWifiAndUpdateUi(void)
+bool AppSettings::scanWifiAndUpdateUi(void)
 {
     bool psk_flag = false;
 
-    uint16_t number = SCAN_LIST_SIZE;
-    wifi_ap_record_t ap_info[SCAN_LIST_SIZE];
-    uint16_t ap_count = 0;
-    memset(ap_info, 0, sizeof(ap_info));
+    static opdi_net_scan_ap_t ap_info[SCAN_LIST_SIZE];
 
     esp_wifi_start();
-    esp_wifi_scan_start(NULL, true);
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&number, ap_info));
+    // Shared scan service: reuses results younger than one refresh period and joins scans
+    // started by the web UI instead of running a second blocking scan on the radio
+    if (opdi_net_scan_request(WIFI_SCAN_TASK_PERIOD_MS) == ESP_ERR_NOT_FINISHED) {
+        return false;
+    }
+    size_t ap_count = opdi_net_scan_results(ap_info, SCAN_LIST_SIZE, NULL);
 #if ENABLE_DEBUG_LOG
-    ESP_LOGI(TAG, "Total APs scanned = %u", ap_count);
+    ESP_LOGI(TAG, "Total APs scanned = %u", (unsigned)ap_count);
 #endif
 
     bsp_display_lock(0);
@@ -540,14 +541,14 @@ void AppSettings::scanWifiAndUpdateUi(void)
     }
     bsp_display_unlock();
 
-    for (int i = 0; (i < SCAN_LIST_SIZE) && (i < ap_count); i++) {
+    for (int i = 0; i < (int)ap_count; i++) {
 #if ENABLE_DEBUG_LOG
         ESP_LOGI(TAG, "SSID \t\t%s", ap_info[i].ssid);
         ESP_LOGI(TAG, "RSSI \t\t%d", ap_info[i].rssi);
-        ESP_LOGI(TAG, "Channel \t\t%d", ap_info[i].primary);
+        ESP_LOGI(TAG, "Channel \t\t%d", ap_info[i].channel);
 #endif
 
-        if(ap_info[i].authmode != WIFI_AUTH_OPEN && ap_info[i].authmode != WIFI_AUTH_OWE) {
+        if(ap_info[i].auth != WIFI_AUTH_OPEN && ap_info[i].auth != WIFI_AUTH_OWE) {
             psk_flag = true;
         }
 #if ENABLE_DEBUG_LOG
@@ -570,10 +571,11 @@ void AppSettings::scanWifiAndUpdateUi(void)
         bsp_display_lock(0);
         if(xEventGroupGetBits(s_wifi_event_group) & WIFI_EVENT_SCANING) {
             initWifiListButton(label_wifi_ssid[i], img_img_wifi_lock[i], wifi_image[i], wifi_connect[i],
-                                ap_info[i].ssid, psk_flag, _wifi_signal_strength_level);     
+                                (uint8_t *)ap_info[i].ssid, psk_flag, _wifi_signal_strength_level);
         }
         bsp_display_unlock();
     }
+    return true;
 }
 
 void AppSettings::initWifiListButton(lv_obj_t* lv_label_ssid, lv_obj_t* lv_img_wifi_lock, lv_obj_t* lv_wifi_img,
@@ -715,8 +717,10 @@ void AppSettings::wifiScanTask(void *arg)
         }
 
         if(xEventGroupGetBits(s_wifi_event_group) & WIFI_EVENT_SCANING){
-            app->scanWifiAndUpdateUi();
-            vTaskDelay(pdMS_TO_TICKS(WIFI_SCAN_TASK_PERIOD_MS));
+            // While a scan is in flight, poll the cache every 100 ms below
+            if (app->scanWifiAndUpdateUi()) {
+                vTaskDelay(pdMS_TO_TICKS(WIFI_SCAN_TASK_PERIOD_MS));
+            }
         }
 
         vTaskDelay(pdMS_TO_TICKS(100));
@@ -924,9 +928,8 @@ void AppSettings::onButtonWifiListClickedEventCallback(lv_event_t * e)
     lv_scr_load(ui_ScreenSettingVerification);
     lv_label_set_text_fmt(ui_LabelScreenSettingVerificationSSID, "%s", lv_label_get_text(label_wifi_ssid));
 
+    // The radio scan is shared with other clients; just stop refreshing the list
     xEventGroupClearBits(s_wifi_event_group, WIFI_EVENT_SCANING);
-
-    esp_wifi_scan_stop();
 }
 
 void AppSettings::onSwitchPanelScreenSettingBLESwitchValueChangeEventCallback( lv_event_t * e) {
@@ -67,7 +67,7 @@ private:
     esp_err_t initWifi(void);
     void startWifiScan(void);
     void stopWifiScan(void);
-    void scanWifiAndUpdateUi(void);
+    bool scanWifiAndUpdateUi(void);
     // Smart Gadget
     // void updateGadgetTime(struct tm timeinfo);
 
@@ -144,6 +144,18 @@ esp_err_t bsp_extra_codec_init();
  */
 esp_err_t bsp_extra_player_init(void);
 
+/**
+ * @brief Route audio player output through custom write / clock functions.
+ *
+ * Must be called before bsp_extra_player_init(). By default the player writes straight to
+ * bsp_extra_i2s_write() and reconfigures the codec with bsp_extra_codec_set_fs(); a PCM mixer
+ * can take over both so other sounds share the I2S channel with the player.
+ *
+ * @param write_fn: PCM sink (NULL keeps bsp_extra_i2s_write)
+ * @param clk_fn: format change handler (NULL keeps bsp_extra_codec_set_fs)
+ */
+void bsp_extra_player_set_output(audio_player_write_fn write_fn, audio_reconfig_std_clock clk_fn);
+
 /**
  * @brief Delete audio player task.
  *
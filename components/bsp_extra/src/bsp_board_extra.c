@@ -43,6 +43,9 @@ static int _vloume_intensity = CODEC_DEFAULT_VOLUME;
 #define CONFIG_EXAMPLE_AUDIO_CODEC_GRACEFUL_FAIL 1
 #endif
 
+static audio_player_write_fn player_write_fn = bsp_extra_i2s_write;
+static audio_reconfig_std_clock player_clk_fn = bsp_extra_codec_set_fs;
+
 static audio_player_cb_t audio_idle_callback = NULL;
 static void *audio_idle_cb_user_data = NULL;
 static char audio_file_path[128];
@@ -290,8 +293,8 @@ esp_err_t bsp_extra_player_init(void)
     }
 
     audio_player_config_t config = { .mute_fn = audio_mute_function,
-                                     .write_fn = bsp_extra_i2s_write,
-                                     .clk_set_fn = bsp_extra_codec_set_fs,
+                                     .write_fn = player_write_fn,
+                                     .clk_set_fn = player_clk_fn,
                                      .priority = 5
                                    };
     ESP_RETURN_ON_ERROR(audio_player_new(config), TAG, "audio_player_init failed");
@@ -302,6 +305,12 @@ esp_err_t bsp_extra_player_init(void)
     return ESP_OK;
 }
 
+void bsp_extra_player_set_output(audio_player_write_fn write_fn, audio_reconfig_std_clock clk_fn)
+{
+    player_write_fn = write_fn ? write_fn : bsp_extra_i2s_write;
+    player_clk_fn = clk_fn ? clk_fn : bsp_extra_codec_set_fs;
+}
+
 esp_err_t bsp_extra_player_del(void)
 {
     _is_player_init = false;
@@ -0,0 +1,125 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming JSON writer. Output is escaped into a small caller-owned scratch buffer which is
+// flushed through a sink whenever it fills, so responses of any length go out without heap use
+// or truncation. Commas are inserted automatically; the first error latches and later calls
+// become no-ops, so call sites check only the result of opdi_json_finish().
+typedef esp_err_t (*opdi_json_sink_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    opdi_json_sink_t sink;  // NULL: fixed buffer, overflow -> ESP_ERR_INVALID_SIZE
+    void *ctx;
+    esp_err_t err;
+    uint32_t nonempty;      // bit d set: container at depth d already has a member
+    uint8_t depth;
+    bool after_key;
+} opdi_json_t;
+
+#define OPDI_JSON_MAX_DEPTH 32
+
+void opdi_json_init(opdi_json_t *w, char *scratch, size_t cap, opdi_json_sink_t sink, void *ctx);
+// Chunked HTTP response (sets Content-Type: application/json)
+void opdi_json_init_httpd(opdi_json_t *w, httpd_req_t *req, char *scratch, size_t cap);
+// Flush what is buffered; for HTTP also ends the chunked response. Returns the first error seen.
+// In fixed-buffer mode the document is w->buf[0..w->len) and is NUL-terminated when it fits.
+esp_err_t opdi_json_finish(opdi_json_t *w);
+
+void opdi_json_obj_begin(opdi_json_t *w);
+void opdi_json_obj_end(opdi_json_t *w);
+void opdi_json_arr_begin(opdi_json_t *w);
+void opdi_json_arr_end(opdi_json_t *w);
+void opdi_json_key(opdi_json_t *w, const char *key);
+
+void opdi_json_str(opdi_json_t *w, const char *s);              // NULL -> null
+void opdi_json_strn(opdi_json_t *w, const char *s, size_t n);   // stops early at NUL
+void opdi_json_int(opdi_json_t *w, int64_t v);
+void opdi_json_uint(opdi_json_t *w, uint64_t v);
+void opdi_json_bool(opdi_json_t *w, bool v);
+void opdi_json_null(opdi_json_t *w);
+// Pre-formatted JSON value written verbatim (caller guarantees validity)
+void opdi_json_raw(opdi_json_t *w, const char *json);
+
+// Object member shorthands
+static inline void opdi_json_kv_str(opdi_json_t *w, const char *k, const char *v){ opdi_json_key(w, k); opdi_json_str(w, v); }
+static inline void opdi_json_kv_int(opdi_json_t *w, const char *k, int64_t v){ opdi_json_key(w, k); opdi_json_int(w, v); }
+static inline void opdi_json_kv_uint(opdi_json_t *w, const char *k, uint64_t v){ opdi_json_key(w, k); opdi_json_uint(w, v); }
+static inline void opdi_json_kv_bool(opdi_json_t *w, const char *k, bool v){ opdi_json_key(w, k); opdi_json_bool(w, v); }
+
+// ---- Request bodies ----
+// In-place tokenizer plus a typed field-binding table. Tokens index into the caller's buffer and
+// live on the stack; values are converted straight into the bound struct members, so a config
+// update is parsed without any heap allocation.
+typedef enum { OPDI_JSON_OBJ = 1, OPDI_JSON_ARR, OPDI_JSON_STR, OPDI_JSON_PRIM } opdi_json_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t start;  // strings: first byte after the quote (text is still escaped)
+    uint16_t len;
+    uint16_t next;   // index of the first token after this value and its children
+} opdi_json_tok_t;
+
+#define OPDI_JSON_MAX_TOKENS 64   // per opdi_json_bind() call, 8 B each on the stack
+#define OPDI_JSON_MAX_NEST   8
+
+// Validates the whole document. ESP_ERR_INVALID_ARG: malformed, ESP_ERR_NO_MEM: more than max tokens.
+esp_err_t opdi_json_tokenize(const char *js, size_t len, opdi_json_tok_t *toks, size_t max, size_t *count);
+
+typedef enum {
+    OPDI_JSON_F_INT,    // signed integer member of 1/2/4/8 bytes, range-checked
+    OPDI_JSON_F_UINT,   // unsigned integer member, range-checked
+    OPDI_JSON_F_BOOL,   // bool member
+    OPDI_JSON_F_STR,    // char[] member; unescaped, rejected if it does not fit with its NUL
+    OPDI_JSON_F_ENUM,   // integer/enum member set to the index of the matching name
+    OPDI_JSON_F_OBJ,    // nested object bound with another table onto the same struct
+} opdi_json_ftype_t;
+
+typedef struct {
+    const char *key;
+    uint8_t type;
+    uint8_t size;       // sizeof the member
+    uint16_t offset;    // offsetof the member
+    const void *aux;    // F_ENUM: const char *const names[] (NULL holes allowed), F_OBJ: field table
+    uint8_t n;          // entries in aux
+} opdi_json_field_t;
+
+#define OPDI_JSON_BIND_(T, m, k, t) { .key = (k), .type = (t), .size = sizeof(((T *)0)->m), .offset = offsetof(T, m) }
+#define OPDI_JSON_INT(T, m, k)   OPDI_JSON_BIND_(T, m, k, OPDI_JSON_F_INT)
+#define OPDI_JSON_UINT(T, m, k)  OPDI_JSON_BIND_(T, m, k, OPDI_JSON_F_UINT)
+#define OPDI_JSON_BOOL(T, m, k)  OPDI_JSON_BIND_(T, m, k, OPDI_JSON_F_BOOL)
+#define OPDI_JSON_STR(T, m, k)   OPDI_JSON_BIND_(T, m, k, OPDI_JSON_F_STR)
+#define OPDI_JSON_ENUM(T, m, k, names) \
+    { .key = (k), .type = OPDI_JSON_F_ENUM, .size = sizeof(((T *)0)->m), .offset = offsetof(T, m), \
+      .aux = (names), .n = sizeof(names) / sizeof((names)[0]) }
+#define OPDI_JSON_OBJ(k, table) \
+    { .key = (k), .type = OPDI_JSON_F_OBJ, .aux = (table), .n = sizeof(table) / sizeof((table)[0]) }
+// Expands to the "fields, n" argument pair for a static table
+#define OPDI_JSON_FIELDS(table) (table), sizeof(table) / sizeof((table)[0])
+
+// Parse a top-level object and store the bound members into dst. Unknown keys are ignored and
+// null leaves a member untouched. seen (optional) gets bit i for each fields[i] present (n <= 32).
+// On error *bad (optional) names the offending key, NULL for a syntax error; dst may be partially
+// written, so bind into a copy. ESP_ERR_INVALID_ARG: malformed/wrong type/out of range,
+// ESP_ERR_INVALID_SIZE: string too long, ESP_ERR_NO_MEM: too many tokens.
+esp_err_t opdi_json_bind(const char *js, size_t len, const opdi_json_field_t *fields, size_t n,
+                         void *dst, uint32_t *seen, const char **bad);
+
+// Receive the request body into buf (NUL-terminated) and bind it. An empty body binds nothing.
+// On failure the error response (400 / 408 / 413 when the body is larger than cap-1) has already
+// been sent and the handler should just return ESP_OK.
+esp_err_t opdi_json_bind_req(httpd_req_t *req, char *buf, size_t cap, const opdi_json_field_t *fields,
+                             size_t n, void *dst, uint32_t *seen);
+
+#ifdef __cplusplus
+}
+#endif
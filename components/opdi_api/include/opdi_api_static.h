@@ -0,0 +1,31 @@
+#pragma once
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Web UI routes: / (index.html), /app.js, /style.css
+void opdi_api_static_register(httpd_handle_t server);
+
+typedef struct {
+    uint32_t sent;          // 200 responses
+    uint32_t not_modified;  // 304 responses (If-None-Match matched the ETag)
+    uint32_t gzip;          // bodies sent with Content-Encoding: gzip
+    uint32_t cache_hits;    // SPIFFS assets served from the RAM cache
+    uint32_t cache_misses;  // SPIFFS assets read from flash
+    uint32_t bytes;         // body bytes sent
+} opdi_api_static_stats_t;
+void opdi_api_static_get_stats(opdi_api_static_stats_t *out);
+
+// True when an If-None-Match header value covers etag (quoted, as sent in the ETag header)
+bool opdi_api_static_etag_match(const char *if_none_match, const char *etag);
+
+// Test hook: embedded asset by file name; returns its ETag, NULL if not embedded
+const char *opdi_api_static_test_asset(const char *name, const uint8_t **gz, size_t *gz_len, size_t *raw_len);
+
+#ifdef __cplusplus
+}
+#endif
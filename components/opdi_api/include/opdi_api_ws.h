@@ -1,14 +1,110 @@
 #pragma once
 #include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #ifdef __cplusplus
 extern "C" { 
 #endif
 
 void opdi_api_ws_register(httpd_handle_t server);
+// httpd_config_t.close_fn for the server hosting /ws: frees the client's event bus slot, then closes the socket
+void opdi_api_ws_close_fn(httpd_handle_t hd, int sockfd);
+// Two-way voice endpoint /audio/ws (binary PCM frames + JSON control)
+void opdi_api_audio_ws_register(httpd_handle_t server);
 
-// Broadcast helpers (JSON strings)
+// Event bus for /ws. Publishing copies the JSON into a bounded queue and returns at once (safe from
+// event handlers and esp_timer callbacks); one sender task batches queued events into frames, so a
+// client may receive a single object or an array of them. Events with the same non-NULL topic are
+// coalesced while queued (latest value wins), so pass a topic only for state/telemetry snapshots.
+// topic must be a string literal. ESP_ERR_NO_MEM: queue full, event dropped.
+esp_err_t opdi_api_ws_publish(const char *topic, const char *json, size_t len);
+// Uncoalesced publish (ordered events such as state transitions)
 void opdi_api_ws_broadcast(const char *json, size_t len);
 
+typedef struct {
+    uint32_t published;       // accepted by opdi_api_ws_publish()
+    uint32_t coalesced;       // replaced a queued event of the same topic
+    uint32_t dropped;         // queue full or out of memory
+    uint32_t frames;          // frames built (each shared by every client with the same subscription)
+    uint32_t batched;         // events that shared a frame with others
+    uint32_t bin_frames;      // binary frames (subset of frames)
+    uint32_t rendered;        // binary records rendered to JSON for text subscribers
+    uint32_t clients_dropped; // closed for exceeding CONFIG_OPDI_API_WS_CLIENT_DEPTH pending frames
+    uint16_t queue_hw;        // queue depth high-water mark
+    uint16_t queued;
+    uint16_t clients;
+} opdi_api_ws_stats_t;
+void opdi_api_ws_get_stats(opdi_api_ws_stats_t *out);
+
+// Channels a /ws client can subscribe to. JSON events are classified by their leading "type"
+// member; anything unrecognised is OPDI_WS_CH_OTHER. The high-rate channels (detect, audio.level)
+// are opt-in, everything else is sent to a client until it narrows its subscription with
+//   {"type":"sub","topics":["net","detect"],"binary":true}
+// ("*" = every channel). The device answers with {"type":"sub_ack","topics":[...],"binary":...}.
+typedef enum {
+    OPDI_WS_CH_NET = 0,
+    OPDI_WS_CH_CAM_STATE,
+    OPDI_WS_CH_CAM_TELEMETRY,
+    OPDI_WS_CH_CAM_IR,
+    OPDI_WS_CH_DETECT,
+    OPDI_WS_CH_AUDIO_LEVEL,
+    OPDI_WS_CH_RECOGNIZE,
+    OPDI_WS_CH_OTHER,
+    OPDI_WS_CH_COUNT
+} opdi_ws_channel_t;
+
+#define OPDI_WS_CH_BIT(ch)      (1u << (ch))
+#define OPDI_WS_CH_DEFAULT_MASK (((1u << OPDI_WS_CH_COUNT) - 1) & ~(OPDI_WS_CH_BIT(OPDI_WS_CH_DETECT) | OPDI_WS_CH_BIT(OPDI_WS_CH_AUDIO_LEVEL)))
+
+// Binary records for the high-rate channels. A client that subscribed with "binary":true gets them
+// in binary frames holding one or more records, each {u8 channel, u8 reserved, u16 payload_len}
+// followed by the payload; all fields little-endian. Text clients get the same data as JSON
+// ({"type":"detect",...}), rendered only when at least one of them subscribed to the channel.
+#define OPDI_WS_REC_HDR_LEN 4
+#define OPDI_WS_DETECT_MAX_BOXES 16
+
+typedef struct __attribute__((packed)) {
+    int16_t x, y;        // top-left, detector input pixels
+    uint16_t w, h;
+    uint8_t score;       // 0..100
+    uint8_t cls;
+} opdi_ws_box_t;         // 10 B ({"b":[x,y,w,h,score,cls]} in JSON: ~30 B)
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_ms;       // esp_timer time of the source frame
+    uint16_t img_w, img_h;
+    uint8_t model;       // 0 pedestrian, 1 face
+    uint8_t count;       // opdi_ws_box_t entries that follow
+} opdi_ws_detect_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_ms;
+    uint8_t source;      // 0 playback spectrum
+    uint8_t count;       // uint8_t levels that follow, lowest band first
+} opdi_ws_level_hdr_t;
+
+// Queue a fixed-layout record (hdr followed by body) on a binary-capable channel. Records of the
+// same channel coalesce while queued like topic events: the consumer only ever wants the newest
+// boxes or levels. Returns ESP_OK without queuing when no client subscribed to the channel.
+esp_err_t opdi_api_ws_publish_bin(opdi_ws_channel_t ch, const void *hdr, size_t hdr_len, const void *body, size_t body_len);
+
+// Event tap for other transports (the MQTT publisher): fn gets every event of the channels in mask,
+// subscribed to by a /ws client or not, in the publisher's context, so it must only copy. Binary
+// records arrive rendered as JSON. One tap at a time; fn NULL removes it.
+typedef void (*opdi_api_ws_tap_t)(opdi_ws_channel_t ch, const char *json, size_t len);
+void opdi_api_ws_set_tap(uint32_t mask, opdi_api_ws_tap_t fn);
+
+// Test hook: pop the next frame the sender would send to a text client with the default
+// subscription (NUL-terminated copy), returns its length, 0 if idle
+size_t opdi_api_ws_test_next_frame(char *out, size_t cap);
+// Test hooks: register a client (optionally applying a subscription message), then drain the queue
+// through the per-client framing with tx() standing in for httpd. Returns frames handed to tx().
+typedef void (*opdi_api_ws_test_tx_t)(int fd, bool binary, const uint8_t *data, size_t len);
+esp_err_t opdi_api_ws_test_client(int fd, const char *sub_json);
+void opdi_api_ws_test_client_remove(int fd);
+size_t opdi_api_ws_test_pump(opdi_api_ws_test_tx_t tx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,141 @@
+// Two-way voice WebSocket (SRD FR-16 / Appendix D): WS /audio/ws, single client.
+// Text frames carry control JSON, binary frames carry 20 ms PCM16 16 kHz mono audio.
+#include "opdi_api_ws.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "opdi_audio.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "opdi_audio_ws";
+
+#if CONFIG_HTTPD_WS_SUPPORT && CONFIG_OPDI_AUDIO_FULL_DUPLEX
+static httpd_handle_t s_server = NULL;
+static int s_fd = -1; // the one active audio client
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED; // s_fd: httpd, duplex sender and session tasks
+static esp_timer_handle_t s_stats_timer = NULL;
+static TaskHandle_t s_task = NULL;
+
+static int client_fd(void){
+    taskENTER_CRITICAL(&s_lock);
+    int fd = s_fd;
+    taskEXIT_CRITICAL(&s_lock);
+    return fd;
+}
+
+static esp_err_t send_text(int fd, const char *txt){
+    httpd_ws_frame_t f = { .type = HTTPD_WS_TYPE_TEXT, .payload = (uint8_t*)txt, .len = strlen(txt) };
+    return httpd_ws_send_frame_async(s_server, fd, &f);
+}
+
+// Uplink callback from the duplex sender task
+static esp_err_t uplink_send(const uint8_t *frame, size_t len, void *ctx){
+    int fd = (int)(intptr_t)ctx;
+    if (fd != client_fd()) return ESP_FAIL; // client replaced or gone
+    httpd_ws_frame_t f = { .type = HTTPD_WS_TYPE_BINARY, .payload = (uint8_t*)frame, .len = len };
+    return httpd_ws_send_frame_async(s_server, fd, &f);
+}
+
+// Ends the session of fd only: a client that has already replaced it keeps its own
+static void session_end(int fd, const char *why){
+    taskENTER_CRITICAL(&s_lock);
+    bool mine = fd >= 0 && s_fd == fd;
+    if (mine) s_fd = -1;
+    taskEXIT_CRITICAL(&s_lock);
+    if (!mine) return;
+    ESP_LOGI(TAG, "audio session end fd=%d (%s)", fd, why);
+    if (s_stats_timer) esp_timer_stop(s_stats_timer);
+    opdi_audio_duplex_stop();
+}
+
+// Runs in the esp_timer task, which must not block: stopping the engine waits for the mixer lock, so the
+// 1 s tick only wakes the session task
+static void stats_timer_cb(void *arg){
+    (void)arg;
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
+static void session_tick(void){
+    int fd = client_fd();
+    if (fd < 0) return;
+    if (!opdi_audio_duplex_active()){ session_end(fd, "engine stopped"); return; }
+    opdi_audio_duplex_stats_t st; opdi_audio_duplex_get_stats(&st);
+    uint32_t slots = st.rx_frames + st.glitches; // playout slots, real or concealed
+    uint32_t loss_x10 = slots ? (st.glitches * 1000U) / slots : 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"type\":\"stats\",\"rx_jitter_ms\":%u,\"tx_q_depth\":%u,\"pkt_loss\":%u.%u,\"late\":%u,\"glitches\":%u,\"tx_dropped\":%u,\"jb_depth_ms\":%u}",
+        (unsigned)st.rx_jitter_ms, (unsigned)st.tx_q_depth, (unsigned)(loss_x10 / 10), (unsigned)(loss_x10 % 10),
+        (unsigned)st.late_frames, (unsigned)st.glitches, (unsigned)st.tx_dropped, (unsigned)(st.jb_depth * OPDI_AUDIO_DUPLEX_FRAME_MS));
+    if (send_text(fd, buf) != ESP_OK) session_end(fd, "stats send failed");
+}
+
+static void session_task(void *arg){
+    (void)arg;
+    while (1){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        session_tick();
+    }
+}
+
+static esp_err_t audio_ws_handler(httpd_req_t *req){
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET){
+        int old = client_fd();
+        if (old >= 0 && old != fd) session_end(old, "replaced by new client");
+        esp_err_t r = opdi_audio_duplex_start(uplink_send, (void*)(intptr_t)fd);
+        if (r != ESP_OK){ ESP_LOGW(TAG, "duplex start failed: %s", esp_err_to_name(r)); return r; }
+        taskENTER_CRITICAL(&s_lock);
+        s_fd = fd;
+        taskEXIT_CRITICAL(&s_lock);
+        if (s_stats_timer) esp_timer_start_periodic(s_stats_timer, 1000 * 1000);
+        ESP_LOGI(TAG, "audio session start fd=%d", fd);
+        return ESP_OK;
+    }
+    // Frames are at most one 20 ms audio frame or a short control message; anything larger is dropped
+    static uint8_t buf[OPDI_AUDIO_WS_FRAME_BYTES + 1];
+    httpd_ws_frame_t f = { 0 };
+    if (httpd_ws_recv_frame(req, &f, 0) != ESP_OK) return ESP_FAIL;
+    if (f.len >= sizeof(buf)){
+        ESP_LOGW(TAG, "ws frame too large (%u bytes)", (unsigned)f.len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    f.payload = buf;
+    if (f.len && httpd_ws_recv_frame(req, &f, sizeof(buf)) != ESP_OK) return ESP_FAIL;
+    if (fd != client_fd()) return ESP_OK; // stale client
+    if (f.type == HTTPD_WS_TYPE_BINARY){
+        opdi_audio_duplex_rx(buf, f.len);
+    } else if (f.type == HTTPD_WS_TYPE_TEXT){
+        buf[f.len] = '\0';
+        if (strstr((char*)buf, "\"hello\"")){
+            send_text(fd, "{\"type\":\"hello\",\"codec\":\"pcm16_16k_mono\",\"role\":\"device\",\"frame_ms\":20}");
+        } else if (strstr((char*)buf, "\"bye\"")){
+            session_end(fd, "client bye");
+        }
+    }
+    // A closed socket surfaces as an uplink send failure; the next stats tick then ends the session
+    return ESP_OK;
+}
+#endif
+
+void opdi_api_audio_ws_register(httpd_handle_t server){
+#if CONFIG_HTTPD_WS_SUPPORT && CONFIG_OPDI_AUDIO_FULL_DUPLEX
+    s_server = server;
+    if (!s_task && xTaskCreate(session_task, "audio_ws", 3072, NULL, 5, &s_task) != pdPASS){
+        ESP_LOGE(TAG, "session task create failed; /audio/ws not registered");
+        return;
+    }
+    if (!s_stats_timer){
+        const esp_timer_create_args_t ta = { .callback = stats_timer_cb, .name = "audio_ws_stats" };
+        esp_timer_create(&ta, &s_stats_timer);
+    }
+    httpd_uri_t u = { .uri="/audio/ws", .method=HTTP_GET, .handler=audio_ws_handler, .is_websocket=true };
+    httpd_register_uri_handler(server, &u);
+    ESP_LOGI(TAG, "Audio WebSocket endpoint /audio/ws ready");
+#else
+    (void)server;
+    ESP_LOGW(TAG, "audio duplex disabled; /audio/ws not registered");
+#endif
+}
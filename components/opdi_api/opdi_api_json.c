@@ -0,0 +1,147 @@
+// Streaming JSON writer (see opdi_api_json.h)
+#include "opdi_api_json.h"
+#include <string.h>
+
+static esp_err_t httpd_sink(void *ctx, const char *data, size_t len){
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+void opdi_json_init(opdi_json_t *w, char *scratch, size_t cap, opdi_json_sink_t sink, void *ctx){
+    memset(w, 0, sizeof(*w));
+    w->buf = scratch; w->cap = cap; w->sink = sink; w->ctx = ctx;
+    if (!scratch || cap < 8) w->err = ESP_ERR_INVALID_ARG;
+}
+
+void opdi_json_init_httpd(opdi_json_t *w, httpd_req_t *req, char *scratch, size_t cap){
+    httpd_resp_set_type(req, "application/json");
+    opdi_json_init(w, scratch, cap, httpd_sink, req);
+}
+
+static void flush(opdi_json_t *w){
+    if (w->err || !w->len) return;
+    if (!w->sink) { w->err = ESP_ERR_INVALID_SIZE; return; }
+    w->err = w->sink(w->ctx, w->buf, w->len);
+    w->len = 0;
+}
+
+static void put(opdi_json_t *w, const char *s, size_t n){
+    while (n && !w->err) {
+        size_t room = w->cap - w->len;
+        if (!room) { flush(w); continue; }
+        size_t k = n < room ? n : room;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k; s += k; n -= k;
+    }
+}
+
+static inline void putc_(opdi_json_t *w, char c){
+    if (w->len == w->cap) flush(w);
+    if (!w->err) w->buf[w->len++] = c;
+}
+
+// Separator before a value or key at the current depth
+static void pre_value(opdi_json_t *w){
+    if (w->after_key) { w->after_key = false; return; }
+    uint32_t bit = 1u << w->depth;
+    if (w->nonempty & bit) putc_(w, ',');
+    w->nonempty |= bit;
+}
+
+static void open_(opdi_json_t *w, char c){
+    pre_value(w);
+    putc_(w, c);
+    if (w->depth + 1 >= OPDI_JSON_MAX_DEPTH) { if (!w->err) w->err = ESP_ERR_INVALID_STATE; return; }
+    w->depth++;
+    w->nonempty &= ~(1u << w->depth);
+}
+
+static void close_(opdi_json_t *w, char c){
+    if (!w->depth) { if (!w->err) w->err = ESP_ERR_INVALID_STATE; return; }
+    w->depth--;
+    putc_(w, c);
+}
+
+void opdi_json_obj_begin(opdi_json_t *w){ open_(w, '{'); }
+void opdi_json_obj_end(opdi_json_t *w){ close_(w, '}'); }
+void opdi_json_arr_begin(opdi_json_t *w){ open_(w, '['); }
+void opdi_json_arr_end(opdi_json_t *w){ close_(w, ']'); }
+
+static void escaped(opdi_json_t *w, const char *s, size_t n){
+    static const char hex[] = "0123456789abcdef";
+    putc_(w, '"');
+    size_t i = 0, run = 0; // run: plain bytes pending copy
+    for (; i < n && s[i]; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') { run++; continue; }
+        put(w, s + i - run, run); run = 0;
+        char e[6] = { '\\', 0 };
+        size_t el = 2;
+        switch (c) {
+            case '"':  e[1] = '"'; break;
+            case '\\': e[1] = '\\'; break;
+            case '\n': e[1] = 'n'; break;
+            case '\r': e[1] = 'r'; break;
+            case '\t': e[1] = 't'; break;
+            case '\b': e[1] = 'b'; break;
+            case '\f': e[1] = 'f'; break;
+            default:
+                e[1] = 'u'; e[2] = '0'; e[3] = '0'; e[4] = hex[c >> 4]; e[5] = hex[c & 15]; el = 6;
+                break;
+        }
+        put(w, e, el);
+    }
+    put(w, s + i - run, run); // tail; the common no-escape case is a single copy
+    putc_(w, '"');
+}
+
+void opdi_json_key(opdi_json_t *w, const char *key){
+    pre_value(w);
+    escaped(w, key, SIZE_MAX);
+    putc_(w, ':');
+    w->after_key = true;
+}
+
+void opdi_json_str(opdi_json_t *w, const char *s){
+    if (!s) { opdi_json_null(w); return; }
+    pre_value(w);
+    escaped(w, s, SIZE_MAX);
+}
+
+void opdi_json_strn(opdi_json_t *w, const char *s, size_t n){
+    if (!s) { opdi_json_null(w); return; }
+    pre_value(w);
+    escaped(w, s, n);
+}
+
+static void put_u64(opdi_json_t *w, uint64_t v){
+    char d[20]; size_t i = sizeof(d);
+    do { d[--i] = (char)('0' + v % 10); v /= 10; } while (v);
+    put(w, d + i, sizeof(d) - i);
+}
+
+void opdi_json_uint(opdi_json_t *w, uint64_t v){ pre_value(w); put_u64(w, v); }
+
+void opdi_json_int(opdi_json_t *w, int64_t v){
+    pre_value(w);
+    if (v < 0) { putc_(w, '-'); put_u64(w, (uint64_t)0 - (uint64_t)v); }
+    else put_u64(w, (uint64_t)v);
+}
+
+void opdi_json_bool(opdi_json_t *w, bool v){ pre_value(w); v ? put(w, "true", 4) : put(w, "false", 5); }
+void opdi_json_null(opdi_json_t *w){ pre_value(w); put(w, "null", 4); }
+void opdi_json_raw(opdi_json_t *w, const char *json){ pre_value(w); put(w, json, strlen(json)); }
+
+esp_err_t opdi_json_finish(opdi_json_t *w){
+    if (!w->err && w->depth) w->err = ESP_ERR_INVALID_STATE;
+    if (!w->sink) {
+        if (w->len < w->cap) w->buf[w->len] = '\0';
+        return w->err;
+    }
+    flush(w);
+    if (w->sink == httpd_sink) {
+        // Always terminate the chunked response so the client is not left waiting
+        esp_err_t e = httpd_resp_send_chunk((httpd_req_t *)w->ctx, NULL, 0);
+        if (!w->err) w->err = e;
+    }
+    return w->err;
+}
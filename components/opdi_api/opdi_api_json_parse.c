@@ -0,0 +1,317 @@
+// Zero-allocation request body parsing (see opdi_api_json.h)
+#include "opdi_api_json.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "opdi_json";
+
+typedef struct {
+    const char *js;
+    size_t len, pos;
+    opdi_json_tok_t *toks;
+    size_t max, n;
+} tz_t;
+
+static inline bool is_ws(char c){ return c==' ' || c=='\t' || c=='\n' || c=='\r'; }
+static inline bool is_digit(char c){ return c>='0' && c<='9'; }
+static inline int hex_val(char c){
+    if (is_digit(c)) return c - '0';
+    if (c>='a' && c<='f') return c - 'a' + 10;
+    if (c>='A' && c<='F') return c - 'A' + 10;
+    return -1;
+}
+static void skip_ws(tz_t *t){ while (t->pos < t->len && is_ws(t->js[t->pos])) t->pos++; }
+
+static opdi_json_tok_t *new_tok(tz_t *t, uint8_t type, size_t start){
+    if (t->n >= t->max) return NULL;
+    opdi_json_tok_t *k = &t->toks[t->n++];
+    k->type = type; k->start = (uint16_t)start; k->len = 0; k->next = (uint16_t)t->n;
+    return k;
+}
+
+static esp_err_t tok_string(tz_t *t){
+    size_t start = ++t->pos; // past the opening quote
+    while (t->pos < t->len) {
+        unsigned char c = (unsigned char)t->js[t->pos];
+        if (c == '"') {
+            opdi_json_tok_t *k = new_tok(t, OPDI_JSON_STR, start);
+            if (!k) return ESP_ERR_NO_MEM;
+            k->len = (uint16_t)(t->pos - start);
+            t->pos++;
+            return ESP_OK;
+        }
+        if (c < 0x20) return ESP_ERR_INVALID_ARG;
+        if (c == '\\') {
+            if (++t->pos >= t->len) return ESP_ERR_INVALID_ARG;
+            switch (t->js[t->pos]) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': break;
+                case 'u':
+                    if (t->pos + 4 >= t->len) return ESP_ERR_INVALID_ARG;
+                    for (int i=1; i<=4; i++) if (hex_val(t->js[t->pos + i]) < 0) return ESP_ERR_INVALID_ARG;
+                    t->pos += 4;
+                    break;
+                default: return ESP_ERR_INVALID_ARG;
+            }
+        }
+        t->pos++;
+    }
+    return ESP_ERR_INVALID_ARG; // unterminated
+}
+
+// true/false/null or a number per RFC 8259
+static bool valid_prim(const char *s, size_t n){
+    if ((n==4 && !memcmp(s, "true", 4)) || (n==5 && !memcmp(s, "false", 5)) || (n==4 && !memcmp(s, "null", 4))) return true;
+    size_t i = 0;
+    if (i<n && s[i]=='-') i++;
+    if (i>=n) return false;
+    if (s[i]=='0') i++;
+    else if (is_digit(s[i])) { while (i<n && is_digit(s[i])) i++; }
+    else return false;
+    if (i<n && s[i]=='.') { i++; if (i>=n || !is_digit(s[i])) return false; while (i<n && is_digit(s[i])) i++; }
+    if (i<n && (s[i]=='e' || s[i]=='E')) {
+        i++; if (i<n && (s[i]=='+' || s[i]=='-')) i++;
+        if (i>=n || !is_digit(s[i])) return false;
+        while (i<n && is_digit(s[i])) i++;
+    }
+    return i == n;
+}
+
+static esp_err_t tok_value(tz_t *t, unsigned depth){
+    skip_ws(t);
+    if (t->pos >= t->len) return ESP_ERR_INVALID_ARG;
+    char c = t->js[t->pos];
+    if (c == '"') return tok_string(t);
+    if (c == '{' || c == '[') {
+        if (depth >= OPDI_JSON_MAX_NEST) return ESP_ERR_INVALID_ARG;
+        bool obj = c == '{';
+        size_t idx = t->n, start = t->pos++;
+        if (!new_tok(t, obj ? OPDI_JSON_OBJ : OPDI_JSON_ARR, start)) return ESP_ERR_NO_MEM;
+        char close = obj ? '}' : ']';
+        skip_ws(t);
+        if (t->pos < t->len && t->js[t->pos] == close) t->pos++;
+        else for (;;) {
+            esp_err_t e;
+            if (obj) {
+                skip_ws(t);
+                if (t->pos >= t->len || t->js[t->pos] != '"') return ESP_ERR_INVALID_ARG;
+                if ((e = tok_string(t)) != ESP_OK) return e;
+                skip_ws(t);
+                if (t->pos >= t->len || t->js[t->pos] != ':') return ESP_ERR_INVALID_ARG;
+                t->pos++;
+            }
+            if ((e = tok_value(t, depth + 1)) != ESP_OK) return e;
+            skip_ws(t);
+            if (t->pos >= t->len) return ESP_ERR_INVALID_ARG;
+            c = t->js[t->pos++];
+            if (c == ',') continue;
+            if (c == close) break;
+            return ESP_ERR_INVALID_ARG;
+        }
+        t->toks[idx].len = (uint16_t)(t->pos - start);
+        t->toks[idx].next = (uint16_t)t->n;
+        return ESP_OK;
+    }
+    size_t start = t->pos;
+    while (t->pos < t->len) {
+        c = t->js[t->pos];
+        if (is_ws(c) || c==',' || c==':' || c=='}' || c==']') break;
+        t->pos++;
+    }
+    if (!valid_prim(t->js + start, t->pos - start)) return ESP_ERR_INVALID_ARG;
+    opdi_json_tok_t *k = new_tok(t, OPDI_JSON_PRIM, start);
+    if (!k) return ESP_ERR_NO_MEM;
+    k->len = (uint16_t)(t->pos - start);
+    return ESP_OK;
+}
+
+esp_err_t opdi_json_tokenize(const char *js, size_t len, opdi_json_tok_t *toks, size_t max, size_t *count){
+    if (!js || !toks || len > UINT16_MAX || max > UINT16_MAX) return ESP_ERR_INVALID_ARG;
+    tz_t t = { .js = js, .len = len, .toks = toks, .max = max };
+    esp_err_t e = tok_value(&t, 0);
+    if (e != ESP_OK) return e;
+    skip_ws(&t);
+    if (t.pos != len) return ESP_ERR_INVALID_ARG; // trailing garbage
+    if (count) *count = t.n;
+    return ESP_OK;
+}
+
+// ---- Binding ----
+
+static size_t put_utf8(char *o, uint32_t cp){
+    if (cp < 0x80) { o[0] = (char)cp; return 1; }
+    if (cp < 0x800) { o[0] = (char)(0xC0 | cp >> 6); o[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) { o[0] = (char)(0xE0 | cp >> 12); o[1] = (char)(0x80 | ((cp >> 6) & 0x3F)); o[2] = (char)(0x80 | (cp & 0x3F)); return 3; }
+    o[0] = (char)(0xF0 | cp >> 18); o[1] = (char)(0x80 | ((cp >> 12) & 0x3F)); o[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); o[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+static uint32_t hex4(const char *s){ return (uint32_t)(hex_val(s[0])<<12 | hex_val(s[1])<<8 | hex_val(s[2])<<4 | hex_val(s[3])); }
+
+// Unescape a validated string token into out[cap] (always NUL-terminated on success)
+static esp_err_t decode_str(const char *s, size_t n, char *out, size_t cap){
+    size_t o = 0;
+    for (size_t i=0; i<n; ) {
+        char tmp[4]; const char *src = tmp; size_t k;
+        if (s[i] != '\\') {
+            size_t run = i;
+            while (run < n && s[run] != '\\') run++;
+            src = s + i; k = run - i; i = run;
+        } else {
+            char e = s[i+1]; i += 2; k = 1;
+            switch (e) {
+                case 'b': tmp[0] = '\b'; break;
+                case 'f': tmp[0] = '\f'; break;
+                case 'n': tmp[0] = '\n'; break;
+                case 'r': tmp[0] = '\r'; break;
+                case 't': tmp[0] = '\t'; break;
+                case 'u': {
+                    uint32_t cp = hex4(s + i); i += 4;
+                    if (cp >= 0xD800 && cp < 0xDC00) { // surrogate pair
+                        if (i + 6 > n || s[i] != '\\' || s[i+1] != 'u') return ESP_ERR_INVALID_ARG;
+                        uint32_t lo = hex4(s + i + 2);
+                        if (lo < 0xDC00 || lo > 0xDFFF) return ESP_ERR_INVALID_ARG;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00); i += 6;
+                    } else if ((cp >= 0xDC00 && cp <= 0xDFFF) || cp == 0) return ESP_ERR_INVALID_ARG;
+                    k = put_utf8(tmp, cp);
+                    break;
+                }
+                default: tmp[0] = e; break; // " \ /
+            }
+        }
+        if (o + k >= cap) return ESP_ERR_INVALID_SIZE;
+        memcpy(out + o, src, k); o += k;
+    }
+    out[o] = '\0';
+    return ESP_OK;
+}
+
+// Integer literal (no fraction/exponent) as sign + magnitude
+static bool parse_int(const char *s, size_t n, bool *neg, uint64_t *mag){
+    size_t i = 0; uint64_t v = 0;
+    *neg = n && s[0]=='-'; if (*neg) i++;
+    if (i >= n) return false;
+    for (; i<n; i++) {
+        if (!is_digit(s[i])) return false;
+        unsigned d = (unsigned)(s[i] - '0');
+        if (v > (UINT64_MAX - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    *mag = v;
+    return true;
+}
+
+static void store_uint(uint8_t *p, uint8_t size, uint64_t v){
+    switch (size) {
+        case 1: *p = (uint8_t)v; break;
+        case 2: { uint16_t x = (uint16_t)v; memcpy(p, &x, 2); break; }
+        case 4: { uint32_t x = (uint32_t)v; memcpy(p, &x, 4); break; }
+        default: memcpy(p, &v, 8); break;
+    }
+}
+
+static esp_err_t bind_object(const char *js, const opdi_json_tok_t *toks, size_t obj,
+                             const opdi_json_field_t *fields, size_t n, uint8_t *dst, uint32_t *seen, const char **bad);
+
+static esp_err_t bind_value(const char *js, const opdi_json_tok_t *toks, size_t v, const opdi_json_field_t *f,
+                            uint8_t *dst, const char **bad){
+    const opdi_json_tok_t *k = &toks[v];
+    const char *s = js + k->start;
+    uint8_t *p = dst + f->offset;
+    switch (f->type) {
+        case OPDI_JSON_F_INT:
+        case OPDI_JSON_F_UINT: {
+            bool neg; uint64_t mag;
+            if (k->type != OPDI_JSON_PRIM || !parse_int(s, k->len, &neg, &mag)) return ESP_ERR_INVALID_ARG;
+            unsigned bits = f->size * 8u;
+            if (f->type == OPDI_JSON_F_UINT) {
+                if (neg && mag) return ESP_ERR_INVALID_ARG;
+                if (bits < 64 && mag >> bits) return ESP_ERR_INVALID_ARG;
+                store_uint(p, f->size, mag);
+            } else {
+                uint64_t lim = (uint64_t)1 << (bits - 1); // |min|; max is lim-1
+                if (neg ? mag > lim : mag >= lim) return ESP_ERR_INVALID_ARG;
+                store_uint(p, f->size, neg ? (uint64_t)0 - mag : mag); // two's complement, truncated to size
+            }
+            return ESP_OK;
+        }
+        case OPDI_JSON_F_BOOL:
+            if (k->type != OPDI_JSON_PRIM || (s[0] != 't' && s[0] != 'f')) return ESP_ERR_INVALID_ARG;
+            *(bool *)p = s[0] == 't';
+            return ESP_OK;
+        case OPDI_JSON_F_STR:
+            if (k->type != OPDI_JSON_STR) return ESP_ERR_INVALID_ARG;
+            return decode_str(s, k->len, (char *)p, f->size);
+        case OPDI_JSON_F_ENUM: {
+            char name[24];
+            if (k->type != OPDI_JSON_STR) return ESP_ERR_INVALID_ARG;
+            if (decode_str(s, k->len, name, sizeof(name)) != ESP_OK) return ESP_ERR_INVALID_ARG;
+            const char *const *names = (const char *const *)f->aux;
+            for (size_t i=0; i<f->n; i++) if (names[i] && !strcmp(names[i], name)) { store_uint(p, f->size, i); return ESP_OK; }
+            return ESP_ERR_INVALID_ARG;
+        }
+        case OPDI_JSON_F_OBJ:
+            if (k->type != OPDI_JSON_OBJ) return ESP_ERR_INVALID_ARG;
+            return bind_object(js, toks, v, (const opdi_json_field_t *)f->aux, f->n, dst, NULL, bad);
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t bind_object(const char *js, const opdi_json_tok_t *toks, size_t obj,
+                             const opdi_json_field_t *fields, size_t n, uint8_t *dst, uint32_t *seen, const char **bad){
+    for (size_t key = obj + 1; key < toks[obj].next; key = toks[key + 1].next) {
+        const opdi_json_tok_t *kt = &toks[key], *vt = &toks[key + 1];
+        for (size_t i=0; i<n; i++) {
+            const opdi_json_field_t *f = &fields[i];
+            if (strlen(f->key) != kt->len || memcmp(f->key, js + kt->start, kt->len)) continue;
+            if (vt->type == OPDI_JSON_PRIM && js[vt->start] == 'n') break; // null: leave as is
+            esp_err_t e = bind_value(js, toks, key + 1, f, dst, bad);
+            if (e != ESP_OK) { if (bad && !*bad) *bad = f->key; return e; }
+            if (seen) *seen |= 1u << i;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t opdi_json_bind(const char *js, size_t len, const opdi_json_field_t *fields, size_t n,
+                         void *dst, uint32_t *seen, const char **bad){
+    if (seen) *seen = 0;
+    if (bad) *bad = NULL;
+    if (n > 32) return ESP_ERR_INVALID_ARG;
+    opdi_json_tok_t toks[OPDI_JSON_MAX_TOKENS]; size_t count;
+    esp_err_t e = opdi_json_tokenize(js, len, toks, OPDI_JSON_MAX_TOKENS, &count);
+    if (e != ESP_OK) return e;
+    if (toks[0].type != OPDI_JSON_OBJ) return ESP_ERR_INVALID_ARG;
+    return bind_object(js, toks, 0, fields, n, (uint8_t *)dst, seen, bad);
+}
+
+esp_err_t opdi_json_bind_req(httpd_req_t *req, char *buf, size_t cap, const opdi_json_field_t *fields,
+                             size_t n, void *dst, uint32_t *seen){
+    if (seen) *seen = 0;
+    if (req->content_len >= cap) {
+        // Refuse up front rather than parse a truncated prefix
+        ESP_LOGW(TAG, "%s: body %u B > %u B", req->uri, (unsigned)req->content_len, (unsigned)(cap - 1));
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_sendstr(req, "body too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t got = 0;
+    while (got < req->content_len) {
+        int r = httpd_req_recv(req, buf + got, req->content_len - got);
+        if (r == HTTPD_SOCK_ERR_TIMEOUT) { httpd_resp_send_408(req); return ESP_ERR_TIMEOUT; }
+        if (r <= 0) return ESP_FAIL; // connection gone, nothing to answer
+        got += (size_t)r;
+    }
+    buf[got] = '\0';
+    if (!got) return ESP_OK;
+    const char *bad;
+    esp_err_t e = opdi_json_bind(buf, got, fields, n, dst, seen, &bad);
+    if (e != ESP_OK) {
+        char msg[64];
+        if (bad) snprintf(msg, sizeof(msg), "%s: %s", bad, e == ESP_ERR_INVALID_SIZE ? "too long" : "invalid");
+        else snprintf(msg, sizeof(msg), e == ESP_ERR_NO_MEM ? "json too complex" : "invalid json");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+    }
+    return e;
+}
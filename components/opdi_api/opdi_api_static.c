@@ -1,41 +1,221 @@
-// Simple static file serving for Web UI (Phase 1): reads from SPIFFS path /spiffs/web
-// Files expected: /spiffs/web/index.html, /spiffs/web/app.js, /spiffs/web/style.css
+// Web UI assets. With CONFIG_OPDI_API_WEB_EMBED the files in spiffs/web are gzipped at build time
+// (tools/gzip_web_assets.py) and served from flash in one send with Content-Encoding: gzip and a
+// strong ETag, so a reload over the provisioning AP costs a 304. A client that does not accept gzip
+// (or a build without embedding) gets the files from SPIFFS /spiffs/web, preferring a stored
+// <name>.gz, through a small RAM cache of hot assets.
 
+#include "opdi_api_static.h"
+#include "opdi_api_static_assets.h"
 #include "esp_http_server.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 #include <sys/stat.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
 
 static const char *TAG = "opdi_ui";
 
-static esp_err_t send_file(httpd_req_t *r, const char *rel, const char *ctype){
-    char path[128]; snprintf(path, sizeof(path), "/spiffs/web/%s", rel);
+#ifndef OPDI_API_WEB_DIR
+#define OPDI_API_WEB_DIR "/spiffs/web"
+#endif
+#define CACHE_SLOTS 4
+
+typedef struct {
+    const char *uri;
+    const char *name;
+    const char *ctype;
+} ui_route_t;
+
+static const ui_route_t s_routes[] = {
+    { "/", "index.html", "text/html; charset=utf-8" },
+    { "/app.js", "app.js", "application/javascript" },
+    { "/style.css", "style.css", "text/css; charset=utf-8" },
+};
+
+// Whole files held in RAM (PSRAM when available). Only touched from the httpd task.
+typedef struct {
+    char path[48];        // "": free
+    char etag[20];        // FNV-1a 64 of the content, quoted
+    uint8_t *data;
+    size_t len;
+    time_t mtime;
+    uint32_t used;        // LRU tick
+} cache_ent_t;
+
+static cache_ent_t s_cache[CACHE_SLOTS];
+static size_t s_cache_bytes;
+static uint32_t s_tick;
+static opdi_api_static_stats_t s_st;
+
+static bool hdr_get(httpd_req_t *r, const char *name, char *buf, size_t cap){
+    size_t n = httpd_req_get_hdr_value_len(r, name);
+    return n && n < cap && httpd_req_get_hdr_value_str(r, name, buf, cap) == ESP_OK;
+}
+
+static bool accepts_gzip(httpd_req_t *r){
+    char ae[96];
+    return hdr_get(r, "Accept-Encoding", ae, sizeof(ae)) && strstr(ae, "gzip");
+}
+
+// If-None-Match: "*", a single tag or a list; a weak W/"..." form of our tag also matches
+// (RFC 9110 uses weak comparison for it). etag includes its quotes, so a substring hit is exact.
+bool opdi_api_static_etag_match(const char *inm, const char *etag){
+    if (!inm || !etag) return false;
+    while (*inm == ' ') inm++;
+    return !strcmp(inm, "*") || strstr(inm, etag) != NULL;
+}
+
+static bool etag_matches(httpd_req_t *r, const char *etag){
+    char inm[128];
+    return hdr_get(r, "If-None-Match", inm, sizeof(inm)) && opdi_api_static_etag_match(inm, etag);
+}
+
+static esp_err_t send_body(httpd_req_t *r, const ui_route_t *rt, const char *etag, const uint8_t *data, size_t len, bool gz){
+    // URLs are not content-hashed: let the browser keep the file but revalidate on every load
+    httpd_resp_set_hdr(r, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(r, "Vary", "Accept-Encoding");
+    if (etag) {
+        httpd_resp_set_hdr(r, "ETag", etag);
+        if (etag_matches(r, etag)) {
+            s_st.not_modified++;
+            httpd_resp_set_status(r, "304 Not Modified");
+            return httpd_resp_send(r, NULL, 0);
+        }
+    }
+    httpd_resp_set_type(r, rt->ctype);
+    if (gz) { httpd_resp_set_hdr(r, "Content-Encoding", "gzip"); s_st.gzip++; }
+    s_st.sent++; s_st.bytes += len;
+    return httpd_resp_send(r, (const char *)data, len);
+}
+
+// Too large for the cache (or out of memory): stream in 1 KB chunks as before
+static esp_err_t stream_file(httpd_req_t *r, const ui_route_t *rt, const char *path, bool gz){
     FILE *f = fopen(path, "rb");
-    if(!f){ ESP_LOGW(TAG, "open %s fail: %s", path, strerror(errno)); return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "not found"); }
-    httpd_resp_set_type(r, ctype);
+    if (!f) { ESP_LOGW(TAG, "open %s fail: %s", path, strerror(errno)); return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "not found"); }
+    httpd_resp_set_hdr(r, "Cache-Control", "no-cache");
+    httpd_resp_set_type(r, rt->ctype);
+    if (gz) { httpd_resp_set_hdr(r, "Content-Encoding", "gzip"); s_st.gzip++; }
+    s_st.sent++;
     char buf[1024]; size_t n;
-    while((n=fread(buf,1,sizeof(buf),f))>0){ if (httpd_resp_send_chunk(r, buf, n)!=ESP_OK){ fclose(f); httpd_resp_send_chunk(r, NULL, 0); return ESP_FAIL; } }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        s_st.bytes += n;
+        if (httpd_resp_send_chunk(r, buf, n) != ESP_OK) { fclose(f); httpd_resp_send_chunk(r, NULL, 0); return ESP_FAIL; }
+    }
     fclose(f);
-    httpd_resp_send_chunk(r, NULL, 0);
-    return ESP_OK;
+    return httpd_resp_send_chunk(r, NULL, 0);
 }
 
-static esp_err_t ui_index(httpd_req_t *r){ return send_file(r, "index.html", "text/html; charset=utf-8"); }
-static esp_err_t ui_appjs(httpd_req_t *r){ return send_file(r, "app.js", "application/javascript"); }
-static esp_err_t ui_style(httpd_req_t *r){ return send_file(r, "style.css", "text/css; charset=utf-8"); }
+static cache_ent_t *cache_find(const char *path, const struct stat *st){
+    for (int i=0; i<CACHE_SLOTS; i++) {
+        cache_ent_t *c = &s_cache[i];
+        if (!c->data || strcmp(c->path, path)) continue;
+        if (c->len == (size_t)st->st_size && c->mtime == st->st_mtime) { c->used = ++s_tick; return c; }
+        // Replaced on SPIFFS (e.g. a UI upload): drop the stale copy
+        s_cache_bytes -= c->len; free(c->data); c->data = NULL; c->path[0] = '\0';
+        return NULL;
+    }
+    return NULL;
+}
+
+static void cache_evict_lru(void){
+    cache_ent_t *lru = NULL;
+    for (int i=0; i<CACHE_SLOTS; i++) if (s_cache[i].data && (!lru || s_cache[i].used < lru->used)) lru = &s_cache[i];
+    if (!lru) return;
+    s_cache_bytes -= lru->len; free(lru->data); lru->data = NULL; lru->path[0] = '\0';
+}
+
+static cache_ent_t *cache_load(const char *path, const struct stat *st){
+    size_t len = (size_t)st->st_size;
+    if (!len || len > CONFIG_OPDI_API_WEB_CACHE_BYTES || strlen(path) >= sizeof(s_cache[0].path)) return NULL;
+    cache_ent_t *slot = NULL;
+    for (;;) {
+        for (int i=0; i<CACHE_SLOTS && !slot; i++) if (!s_cache[i].data) slot = &s_cache[i];
+        if (slot && s_cache_bytes + len <= CONFIG_OPDI_API_WEB_CACHE_BYTES) break;
+        slot = NULL;
+        cache_evict_lru();
+    }
+    uint8_t *data = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!data) data = malloc(len);
+    if (!data) return NULL;
+    FILE *f = fopen(path, "rb");
+    size_t got = f ? fread(data, 1, len, f) : 0;
+    if (f) fclose(f);
+    if (got != len) { free(data); return NULL; }
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<len; i++) { h ^= data[i]; h *= 0x100000001b3ULL; }
+    snprintf(slot->etag, sizeof(slot->etag), "\"%016llx\"", (unsigned long long)h);
+    strcpy(slot->path, path);
+    slot->data = data; slot->len = len; slot->mtime = st->st_mtime; slot->used = ++s_tick;
+    s_cache_bytes += len;
+    return slot;
+}
+
+static esp_err_t send_spiffs(httpd_req_t *r, const ui_route_t *rt, bool gz_ok){
+    char path[48]; struct stat st; bool gz = false;
+    if (gz_ok) { snprintf(path, sizeof(path), OPDI_API_WEB_DIR "/%s.gz", rt->name); gz = stat(path, &st) == 0; }
+    if (!gz) {
+        snprintf(path, sizeof(path), OPDI_API_WEB_DIR "/%s", rt->name);
+        if (stat(path, &st) != 0) { ESP_LOGW(TAG, "%s missing", path); return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "not found"); }
+    }
+    cache_ent_t *c = cache_find(path, &st);
+    if (c) s_st.cache_hits++;
+    else { s_st.cache_misses++; c = cache_load(path, &st); }
+    if (c) return send_body(r, rt, c->etag, c->data, c->len, gz);
+    return stream_file(r, rt, path, gz);
+}
+
+static esp_err_t ui_get(httpd_req_t *r){
+    size_t ulen = strcspn(r->uri, "?");
+    const ui_route_t *rt = NULL;
+    for (size_t i=0; i<sizeof(s_routes)/sizeof(s_routes[0]) && !rt; i++) {
+        if (strlen(s_routes[i].uri) == ulen && !strncmp(s_routes[i].uri, r->uri, ulen)) rt = &s_routes[i];
+    }
+    if (!rt) return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "not found");
+    bool gz_ok = accepts_gzip(r);
+#if CONFIG_OPDI_API_WEB_EMBED
+    if (gz_ok) {
+        for (size_t i=0; i<opdi_web_asset_count; i++) {
+            const opdi_web_asset_t *a = &opdi_web_assets[i];
+            if (!strcmp(a->name, rt->name)) return send_body(r, rt, a->etag, a->gz, a->gz_len, true);
+        }
+    }
+#endif
+    return send_spiffs(r, rt, gz_ok);
+}
+
+void opdi_api_static_get_stats(opdi_api_static_stats_t *out){
+    if (out) *out = s_st;
+}
+
+const char *opdi_api_static_test_asset(const char *name, const uint8_t **gz, size_t *gz_len, size_t *raw_len){
+#if CONFIG_OPDI_API_WEB_EMBED
+    for (size_t i=0; i<opdi_web_asset_count; i++) {
+        const opdi_web_asset_t *a = &opdi_web_assets[i];
+        if (strcmp(a->name, name)) continue;
+        if (gz) *gz = a->gz;
+        if (gz_len) *gz_len = a->gz_len;
+        if (raw_len) *raw_len = a->raw_len;
+        return a->etag;
+    }
+#endif
+    return NULL;
+}
 
 // Register static handlers (called from app_main after httpd start)
 void opdi_api_static_register(httpd_handle_t h){
-    httpd_uri_t u_index = { .uri="/", .method=HTTP_GET, .handler=ui_index };
-    httpd_register_uri_handler(h, &u_index);
-    httpd_uri_t u_app = { .uri="/app.js", .method=HTTP_GET, .handler=ui_appjs };
-    httpd_register_uri_handler(h, &u_app);
-    httpd_uri_t u_css = { .uri="/style.css", .method=HTTP_GET, .handler=ui_style };
-    httpd_register_uri_handler(h, &u_css);
-    ESP_LOGI(TAG, "UI static routes mounted");
+    for (size_t i=0; i<sizeof(s_routes)/sizeof(s_routes[0]); i++) {
+        httpd_uri_t u = { .uri=s_routes[i].uri, .method=HTTP_GET, .handler=ui_get };
+        httpd_register_uri_handler(h, &u);
+    }
+#if CONFIG_OPDI_API_WEB_EMBED
+    uint32_t raw = 0, gz = 0;
+    for (size_t i=0; i<opdi_web_asset_count; i++) { raw += opdi_web_assets[i].raw_len; gz += opdi_web_assets[i].gz_len; }
+    ESP_LOGI(TAG, "UI static routes mounted (%u assets embedded, %u B -> %u B gzip)", (unsigned)opdi_web_asset_count, (unsigned)raw, (unsigned)gz);
+#else
+    ESP_LOGI(TAG, "UI static routes mounted (SPIFFS %s)", OPDI_API_WEB_DIR);
+#endif
 }
-
-// Provide weak symbol in case not linked
-__attribute__((weak)) void opdi_api_static_register(httpd_handle_t h);
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+// Internal to opdi_api: web UI assets gzipped and embedded at build time (tools/gzip_web_assets.py)
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *name;     // file name under spiffs/web, e.g. "app.js"
+    const char *etag;     // strong ETag of the gzip body, including the quotes
+    const uint8_t *gz;
+    uint32_t gz_len;
+    uint32_t raw_len;
+} opdi_web_asset_t;
+
+extern const opdi_web_asset_t opdi_web_assets[];
+extern const size_t opdi_web_asset_count;
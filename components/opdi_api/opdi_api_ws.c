@@ -1,9 +1,15 @@
 #include "opdi_api_ws.h"
+#include "opdi_api_json.h"
+#include "opdi_api_ws_bus.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_wifi_types.h" // for wifi_err_reason_t values (guarded cases below)
+#endif
 #include "opdi_net.h" // for opdi_net_metrics_t and accessors
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 static const char *TAG = "opdi_ws";
 
@@ -11,44 +17,31 @@ static const char *TAG = "opdi_ws";
 #warning "HTTPD WS support not enabled; websocket API disabled"
 #endif
 
-typedef struct ws_client_node {
-    int fd;
-    struct ws_client_node *next;
-} ws_client_node_t;
-static ws_client_node_t *s_clients = NULL;
-static httpd_handle_t s_server = NULL;
-static size_t s_client_count = 0;
-
-static void add_client(int fd){
-    ws_client_node_t *n = (ws_client_node_t*)calloc(1,sizeof(*n));
-    if(!n) return;
-    n->fd = fd;
-    n->next = s_clients;
-    s_clients = n;
-    s_client_count++;
+// Hooks overriding weak symbols from opdi_net (now we directly use public accessors).
+// Frames are built with the JSON writer in fixed-buffer mode: an event that does not fit is
+// dropped with a warning rather than broadcast truncated. topic: see opdi_api_ws_publish().
+static void broadcast_json(opdi_json_t *w, const char *what, const char *topic){
+    if (opdi_json_finish(w)!=ESP_OK){ ESP_LOGW(TAG, "%s event too large (%u B buffer), dropped", what, (unsigned)w->cap); return; }
+    if (opdi_api_ws_publish(topic, w->buf, w->len)!=ESP_OK) ESP_LOGW(TAG, "%s event dropped (queue full)", what);
+    else ESP_LOGD(TAG, "queued %s", what);
 }
-static void remove_client(int fd){
-    ws_client_node_t **pp=&s_clients; while(*pp){ if((*pp)->fd==fd){ ws_client_node_t *d=*pp; *pp=d->next; free(d); s_client_count--; return;} pp=&(*pp)->next; } }
-
-void opdi_api_ws_broadcast(const char *json, size_t len){
-#if CONFIG_HTTPD_WS_SUPPORT
-    if(!json||!s_server) return;
-    ws_client_node_t *n=s_clients; while(n){
-        httpd_ws_frame_t f={0}; f.payload=(uint8_t*)json; f.len=len; f.type=HTTPD_WS_TYPE_TEXT;
-        if (httpd_ws_send_frame_async(s_server, n->fd, &f)!=ESP_OK){ ESP_LOGW(TAG,"ws send fail fd=%d -> drop", n->fd); int bad=n->fd; n=n->next; remove_client(bad); continue; }
-        n=n->next;
-    }
-#else
-    (void)json; (void)len;
-#endif
+static void net_event_begin(opdi_json_t *w, char *buf, size_t cap, const char *sub){
+    opdi_json_init(w, buf, cap, NULL, NULL);
+    opdi_json_obj_begin(w);
+    opdi_json_kv_str(w, "type", "net");
+    opdi_json_kv_str(w, "sub", sub);
 }
 
-// Hooks overriding weak symbols from opdi_net (now we directly use public accessors)
 void opdi_net_emit_sta_connected(const char *ip, int rssi, const uint8_t bssid[6]){
+    (void)bssid;
+    char buf[192]; opdi_json_t w;
+    net_event_begin(&w, buf, sizeof(buf), "sta_connected");
+    opdi_json_kv_str(&w, "ip", ip?ip:"");
     const char *gw = opdi_net_gw_cached();
-    char buf[192]; snprintf(buf,sizeof(buf),"{\"type\":\"net\",\"sub\":\"sta_connected\",\"ip\":\"%s\",\"gw\":\"%s\",\"rssi\":%d}", ip?ip:"", gw?gw:"", rssi);
-    opdi_api_ws_broadcast(buf, strlen(buf));
-    ESP_LOGI(TAG, "broadcast sta_connected");
+    opdi_json_kv_str(&w, "gw", gw?gw:"");
+    opdi_json_kv_int(&w, "rssi", rssi);
+    opdi_json_obj_end(&w);
+    broadcast_json(&w, "sta_connected", NULL);
 }
 void opdi_net_emit_sta_disconnected(int reason){
     const char *reason_text="unknown";
@@ -70,50 +63,127 @@ void opdi_net_emit_sta_disconnected(int reason){
 #endif
     default: break;
     }
-    char buf[128]; snprintf(buf,sizeof(buf),"{\"type\":\"net\",\"sub\":\"sta_disconnected\",\"reason\":%d,\"reason_text\":\"%s\"}", reason, reason_text);
-    opdi_api_ws_broadcast(buf, strlen(buf));
-    ESP_LOGI(TAG, "broadcast sta_disconnected");
+    char buf[128]; opdi_json_t w;
+    net_event_begin(&w, buf, sizeof(buf), "sta_disconnected");
+    opdi_json_kv_int(&w, "reason", reason);
+    opdi_json_kv_str(&w, "reason_text", reason_text);
+    opdi_json_obj_end(&w);
+    broadcast_json(&w, "sta_disconnected", NULL);
 }
 void opdi_net_emit_ap_active(const char *ssid, uint8_t channel){
-    char buf[160]; snprintf(buf,sizeof(buf),"{\"type\":\"net\",\"sub\":\"ap_active\",\"ssid\":\"%s\",\"channel\":%u}", ssid?ssid:"", channel);
-    opdi_api_ws_broadcast(buf, strlen(buf));
-    ESP_LOGI(TAG, "broadcast ap_active");
+    char buf[160]; opdi_json_t w;
+    net_event_begin(&w, buf, sizeof(buf), "ap_active");
+    opdi_json_kv_str(&w, "ssid", ssid?ssid:"");
+    opdi_json_kv_uint(&w, "channel", channel);
+    opdi_json_obj_end(&w);
+    broadcast_json(&w, "ap_active", NULL);
 }
 
 // Metrics emission (overrides weak hook). Uses public metrics accessor.
 void opdi_net_emit_metrics(void){
     opdi_net_metrics_t m; opdi_net_get_metrics(&m);
-    char buf[256];
-    snprintf(buf,sizeof(buf),"{\"type\":\"net\",\"sub\":\"metrics\",\"attempts\":%lu,\"success\":%lu,\"avg_ms\":%lu,\"scans\":%lu,\"retries\":%lu}",
-        (unsigned long)m.connect_attempts,
-        (unsigned long)m.connects_success,
-        (unsigned long)m.avg_connect_time_ms,
-        (unsigned long)m.scan_count,
-        (unsigned long)m.current_retries);
-    opdi_api_ws_broadcast(buf, strlen(buf));
-    ESP_LOGI(TAG, "broadcast metrics");
+    char buf[320]; opdi_json_t w;
+    net_event_begin(&w, buf, sizeof(buf), "metrics");
+    opdi_json_kv_uint(&w, "attempts", m.connect_attempts);
+    opdi_json_kv_uint(&w, "success", m.connects_success);
+    opdi_json_kv_uint(&w, "avg_ms", m.avg_connect_time_ms);
+    opdi_json_kv_uint(&w, "scans", m.scan_count);
+    opdi_json_kv_uint(&w, "retries", m.current_retries);
+    opdi_json_kv_uint(&w, "ttip_ms", m.last_time_to_ip_ms);
+    opdi_json_kv_uint(&w, "boot_ip_ms", m.boot_to_ip_ms);
+    opdi_json_kv_uint(&w, "directed", m.directed_attempts);
+    opdi_json_kv_uint(&w, "fallbacks", m.directed_fallbacks);
+    opdi_json_obj_end(&w);
+    broadcast_json(&w, "metrics", "net.metrics");
+}
+
+// Shared scan completed: push the full result list so clients never poll /net/scan
+static void write_scan_event(opdi_json_t *w, const opdi_net_scan_ap_t *aps, size_t count){
+    opdi_json_obj_begin(w);
+    opdi_json_kv_str(w, "type", "net");
+    opdi_json_kv_str(w, "sub", "scan");
+    opdi_json_key(w, "aps"); opdi_json_arr_begin(w);
+    for (size_t i=0; i<count; i++){
+        const uint8_t *b = aps[i].bssid; char bssid[18];
+        snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x", b[0],b[1],b[2],b[3],b[4],b[5]);
+        opdi_json_obj_begin(w);
+        opdi_json_key(w, "ssid"); opdi_json_strn(w, aps[i].ssid, 32);
+        opdi_json_kv_str(w, "bssid", bssid);
+        opdi_json_kv_int(w, "rssi", aps[i].rssi);
+        opdi_json_kv_uint(w, "auth", aps[i].auth);
+        opdi_json_kv_uint(w, "ch", aps[i].channel);
+        opdi_json_obj_end(w);
+    }
+    opdi_json_arr_end(w);
+    opdi_json_obj_end(w);
+}
+static esp_err_t count_sink(void *ctx, const char *data, size_t len){ (void)data; *(size_t*)ctx += len; return ESP_OK; }
+
+void opdi_net_emit_scan(const opdi_net_scan_ap_t *aps, size_t count){
+    // Measure first (through a small scratch), then render once into an exact-size frame
+    char scratch[64]; size_t need = 0; opdi_json_t w;
+    opdi_json_init(&w, scratch, sizeof(scratch), count_sink, &need);
+    write_scan_event(&w, aps, count);
+    if (opdi_json_finish(&w)!=ESP_OK) return;
+    char *buf = malloc(need + 1); if (!buf) return;
+    opdi_json_init(&w, buf, need + 1, NULL, NULL);
+    write_scan_event(&w, aps, count);
+    broadcast_json(&w, "scan", "net.scan");
+    free(buf);
 }
 
 #if CONFIG_HTTPD_WS_SUPPORT
 static esp_err_t ws_handler(httpd_req_t *req){
     if (req->method == HTTP_GET) {
-        ESP_LOGI(TAG, "handshake established, fd=%d", httpd_req_to_sockfd(req));
-        add_client(httpd_req_to_sockfd(req));
+        int fd = httpd_req_to_sockfd(req);
+        if (opdi_api_ws_client_add(fd)!=ESP_OK){ ESP_LOGW(TAG, "fd=%d refused: %d clients connected", fd, CONFIG_OPDI_API_WS_MAX_CLIENTS); return ESP_FAIL; }
+        ESP_LOGI(TAG, "handshake established, fd=%d", fd);
         return ESP_OK;
     }
+    int fd = httpd_req_to_sockfd(req);
     httpd_ws_frame_t frame={0}; frame.type=HTTPD_WS_TYPE_TEXT;
-    if (httpd_ws_recv_frame(req, &frame, 0)!=ESP_OK) return ESP_FAIL;
-    if (frame.len){
-        frame.payload = malloc(frame.len+1); if(!frame.payload) return ESP_ERR_NO_MEM;
-        if (httpd_ws_recv_frame(req, &frame, frame.len+1)==ESP_OK){ frame.payload[frame.len]='\0'; ESP_LOGI(TAG, "ws rx (%u bytes)", (unsigned)frame.len); }
-        free(frame.payload);
+    if (httpd_ws_recv_frame(req, &frame, 0)!=ESP_OK){ opdi_api_ws_client_remove(fd); return ESP_FAIL; }
+    // Client messages are small control objects; anything larger is drained unread
+    char msg[256];
+    if (!frame.len || frame.type!=HTTPD_WS_TYPE_TEXT || frame.len>=sizeof(msg)){
+        if (frame.len) ESP_LOGW(TAG, "fd=%d: ignoring %u B frame (type %d)", fd, (unsigned)frame.len, (int)frame.type);
+        return ESP_OK;
+    }
+    frame.payload=(uint8_t*)msg;
+    if (httpd_ws_recv_frame(req, &frame, sizeof(msg))!=ESP_OK){ opdi_api_ws_client_remove(fd); return ESP_FAIL; }
+    uint32_t mask; bool binary;
+    esp_err_t r = opdi_api_ws_client_subscribe(fd, msg, frame.len, &mask, &binary);
+    if (r==ESP_ERR_NOT_SUPPORTED){ ESP_LOGI(TAG, "ws rx (%u bytes)", (unsigned)frame.len); return ESP_OK; }
+    char buf[192]; opdi_json_t w;
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "type", "sub_ack");
+    if (r==ESP_OK){
+        opdi_json_key(&w, "topics"); opdi_json_arr_begin(&w);
+        for (int ch=0; ch<OPDI_WS_CH_COUNT; ch++) if (mask & OPDI_WS_CH_BIT(ch)) opdi_json_str(&w, opdi_api_ws_channel_name(ch));
+        opdi_json_arr_end(&w);
+        opdi_json_kv_bool(&w, "binary", binary);
+        ESP_LOGI(TAG, "fd=%d subscribed mask=0x%02x binary=%d", fd, (unsigned)mask, binary);
+    } else {
+        opdi_json_kv_str(&w, "error", "bad subscription");
     }
-    return ESP_OK;
+    opdi_json_obj_end(&w);
+    if (opdi_json_finish(&w)!=ESP_OK) return ESP_OK;
+    httpd_ws_frame_t ack = { .type=HTTPD_WS_TYPE_TEXT, .payload=(uint8_t*)w.buf, .len=w.len };
+    return httpd_ws_send_frame(req, &ack);
 }
 #endif
 
+// httpd closes sessions on its own too (peer gone, LRU purge, keep-alive timeout): release the bus slot
+// of a /ws client with its socket. Replaces httpd's own close(), so the socket is closed here.
+void opdi_api_ws_close_fn(httpd_handle_t hd, int sockfd){
+    (void)hd;
+    opdi_api_ws_client_remove(sockfd);
+    close(sockfd);
+}
+
 void opdi_api_ws_register(httpd_handle_t server){
-    s_server = server;
+    opdi_api_ws_bus_start(server);
 #if CONFIG_HTTPD_WS_SUPPORT
     httpd_uri_t u_ws = { .uri="/ws", .method=HTTP_GET, .handler=ws_handler, .is_websocket=true };
     httpd_register_uri_handler(server, &u_ws);
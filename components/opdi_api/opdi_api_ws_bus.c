@@ -0,0 +1,579 @@
+// WebSocket event bus: producers (Wi-Fi event handlers, esp_timer callbacks, camera/IR modules)
+// only copy their JSON (or a fixed-layout binary record) into a bounded queue; one sender task
+// batches the queue into frames per subscription and hands them to httpd with
+// httpd_ws_send_data_async(). Nothing on the producer side touches a socket.
+#include "opdi_api_ws.h"
+#include "opdi_api_ws_bus.h"
+#include "opdi_api_json.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "opdi_ws_bus";
+
+#define QLEN        CONFIG_OPDI_API_WS_QUEUE_LEN
+#define MAX_CLIENTS CONFIG_OPDI_API_WS_MAX_CLIENTS
+
+// One allocation per event; a lone event is sent as-is, so the common case is never copied again.
+// A frame queued to several clients is freed by whichever completion callback drops the last ref.
+typedef struct {
+    uint32_t refs;
+    size_t len;
+    char data[];
+} ws_frame_t;
+
+typedef struct {
+    const char *topic; // NULL: never coalesced
+    ws_frame_t *f;     // JSON text, or a binary record including its OPDI_WS_REC_HDR_LEN header
+    uint8_t ch;
+    bool bin;
+} ws_event_t;
+
+typedef struct {
+    int fd;            // -1: free slot
+    uint8_t inflight;  // frames handed to httpd and not yet completed
+    bool binary;       // binary records as binary frames instead of rendered JSON
+    uint32_t mask;     // OPDI_WS_CH_BIT() of subscribed channels
+} ws_client_t;
+
+static const char *const s_ch_names[OPDI_WS_CH_COUNT] = {
+    [OPDI_WS_CH_NET] = "net",
+    [OPDI_WS_CH_CAM_STATE] = "cam.state",
+    [OPDI_WS_CH_CAM_TELEMETRY] = "cam.telemetry",
+    [OPDI_WS_CH_CAM_IR] = "cam.ir",
+    [OPDI_WS_CH_DETECT] = "detect",
+    [OPDI_WS_CH_AUDIO_LEVEL] = "audio.level",
+    [OPDI_WS_CH_RECOGNIZE] = "recognize",
+    [OPDI_WS_CH_OTHER] = "other",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ws_event_t s_q[QLEN];
+static size_t s_head, s_count, s_bytes;
+static ws_client_t s_clients[MAX_CLIENTS] = { [0 ... MAX_CLIENTS - 1] = { .fd = -1 } };
+static uint32_t s_sub_mask; // union of all client masks
+static opdi_api_ws_stats_t s_st;
+static TaskHandle_t s_task;
+static httpd_handle_t s_server;
+static opdi_api_ws_tap_t s_tap;
+static uint32_t s_tap_mask;
+
+const char *opdi_api_ws_channel_name(int ch){
+    return ch >= 0 && ch < OPDI_WS_CH_COUNT ? s_ch_names[ch] : NULL;
+}
+
+static ws_frame_t *frame_alloc(size_t len){
+    ws_frame_t *f = malloc(sizeof(*f) + len);
+    if (f) { f->refs = 1; f->len = len; }
+    return f;
+}
+
+static void frame_unref(ws_frame_t *f){
+    taskENTER_CRITICAL(&s_lock);
+    bool last = --f->refs == 0;
+    taskEXIT_CRITICAL(&s_lock);
+    if (last) free(f);
+}
+
+// Events are published as {"type":"<channel>",...}; only the leading member is looked at
+static uint8_t channel_of(const char *json, size_t len){
+    static const char pre[] = "{\"type\":\"";
+    const size_t pl = sizeof(pre) - 1;
+    if (len <= pl || memcmp(json, pre, pl)) return OPDI_WS_CH_OTHER;
+    for (uint8_t ch=0; ch<OPDI_WS_CH_OTHER; ch++) {
+        size_t n = strlen(s_ch_names[ch]);
+        if (len - pl > n && !memcmp(json + pl, s_ch_names[ch], n) && json[pl + n] == '"') return ch;
+    }
+    return OPDI_WS_CH_OTHER;
+}
+
+// Nobody subscribed: drop before copying. Before the sender starts (unit tests) events are always queued.
+static bool wanted(uint8_t ch){
+    return !s_task || (s_sub_mask & OPDI_WS_CH_BIT(ch));
+}
+
+static esp_err_t no_mem(void){
+    taskENTER_CRITICAL(&s_lock); s_st.dropped++; taskEXIT_CRITICAL(&s_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t enqueue(const char *topic, uint8_t ch, bool bin, ws_frame_t *f){
+    size_t len = f->len;
+    ws_frame_t *old = NULL;
+    esp_err_t r = ESP_OK;
+    taskENTER_CRITICAL(&s_lock);
+    s_st.published++;
+    ws_event_t *same = NULL;
+    for (size_t i=0; topic && i<s_count; i++) {
+        ws_event_t *e = &s_q[(s_head + i) % QLEN];
+        if (e->topic && !strcmp(e->topic, topic)) { same = e; break; }
+    }
+    if (same && s_bytes - same->f->len + len <= CONFIG_OPDI_API_WS_QUEUE_BYTES) {
+        // Latest value wins, keeping the queue position of the event it replaces
+        s_bytes = s_bytes - same->f->len + len;
+        old = same->f; same->f = f;
+        s_st.coalesced++;
+    } else if (s_count < QLEN && s_bytes + len <= CONFIG_OPDI_API_WS_QUEUE_BYTES) {
+        s_q[(s_head + s_count) % QLEN] = (ws_event_t){ .topic = topic, .f = f, .ch = ch, .bin = bin };
+        s_count++; s_bytes += len;
+        if (s_count > s_st.queue_hw) s_st.queue_hw = (uint16_t)s_count;
+    } else {
+        old = f; s_st.dropped++; r = ESP_ERR_NO_MEM; // full: drop the newest, never block
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (old) free(old);
+    if (r == ESP_OK && s_task) xTaskNotifyGive(s_task);
+    return r;
+}
+
+static opdi_api_ws_tap_t tap_for(uint8_t ch){
+    opdi_api_ws_tap_t fn = s_tap;
+    return fn && (s_tap_mask & OPDI_WS_CH_BIT(ch)) ? fn : NULL;
+}
+
+void opdi_api_ws_set_tap(uint32_t mask, opdi_api_ws_tap_t fn){
+    taskENTER_CRITICAL(&s_lock);
+    s_tap = fn; s_tap_mask = fn ? mask : 0;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static size_t render_rec(uint8_t ch, const uint8_t *rec, size_t plen, char *buf, size_t cap);
+
+esp_err_t opdi_api_ws_publish(const char *topic, const char *json, size_t len){
+    if (!json || !len) return ESP_ERR_INVALID_ARG;
+    uint8_t ch = channel_of(json, len);
+    // The tap sees every event, subscribed to or not
+    opdi_api_ws_tap_t tap = tap_for(ch);
+    if (tap) tap((opdi_ws_channel_t)ch, json, len);
+    if (!wanted(ch)) return ESP_OK;
+    ws_frame_t *f = frame_alloc(len);
+    if (!f) return no_mem();
+    memcpy(f->data, json, len);
+    return enqueue(topic, ch, false, f);
+}
+
+esp_err_t opdi_api_ws_publish_bin(opdi_ws_channel_t ch, const void *hdr, size_t hdr_len, const void *body, size_t body_len){
+    if ((unsigned)ch >= OPDI_WS_CH_OTHER || !hdr || (body_len && !body) || hdr_len + body_len > UINT16_MAX) return ESP_ERR_INVALID_ARG;
+    opdi_api_ws_tap_t tap = tap_for((uint8_t)ch);
+    if (!wanted(ch) && !tap) return ESP_OK;
+    size_t plen = hdr_len + body_len;
+    ws_frame_t *f = frame_alloc(OPDI_WS_REC_HDR_LEN + plen);
+    if (!f) return no_mem();
+    uint8_t *p = (uint8_t *)f->data;
+    p[0] = (uint8_t)ch; p[1] = 0; p[2] = (uint8_t)plen; p[3] = (uint8_t)(plen >> 8);
+    memcpy(p + OPDI_WS_REC_HDR_LEN, hdr, hdr_len);
+    if (body_len) memcpy(p + OPDI_WS_REC_HDR_LEN + hdr_len, body, body_len);
+    if (tap) {
+        char buf[96 + OPDI_WS_DETECT_MAX_BOXES * 40];
+        size_t n = render_rec((uint8_t)ch, p + OPDI_WS_REC_HDR_LEN, plen, buf, sizeof(buf));
+        if (n) tap(ch, buf, n);
+        if (!wanted(ch)) { free(f); return ESP_OK; }
+    }
+    // The channel name doubles as the coalescing topic: only the newest record per channel is kept
+    return enqueue(s_ch_names[ch], (uint8_t)ch, true, f);
+}
+
+void opdi_api_ws_broadcast(const char *json, size_t len){
+    if (opdi_api_ws_publish(NULL, json, len) == ESP_ERR_NO_MEM) ESP_LOGW(TAG, "event queue full, %u B event dropped", (unsigned)len);
+}
+
+// Single consumer. Pops queued events in order, at most CONFIG_OPDI_API_WS_BATCH_BYTES of them
+// (an oversize event goes alone).
+static size_t pop_batch(ws_event_t *evs){
+    size_t n = 0, total = 0;
+    taskENTER_CRITICAL(&s_lock);
+    while (s_count) {
+        ws_event_t *e = &s_q[s_head];
+        size_t add = e->f->len + (n ? 1 : 0);
+        if (n && total + add + 2 > CONFIG_OPDI_API_WS_BATCH_BYTES) break;
+        evs[n++] = *e; total += add; s_bytes -= e->f->len;
+        s_head = (s_head + 1) % QLEN; s_count--;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+// JSON view of a binary record payload into buf; 0 if the record is malformed
+static size_t render_rec(uint8_t ch, const uint8_t *rec, size_t plen, char *buf, size_t cap){
+    opdi_json_t w;
+    opdi_json_init(&w, buf, cap, NULL, NULL);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "type", s_ch_names[ch]);
+    if (ch == OPDI_WS_CH_DETECT) {
+        opdi_ws_detect_hdr_t h;
+        if (plen < sizeof(h)) return 0;
+        memcpy(&h, rec, sizeof(h));
+        if (plen != sizeof(h) + (size_t)h.count * sizeof(opdi_ws_box_t)) return 0;
+        opdi_json_kv_uint(&w, "t", h.t_ms);
+        opdi_json_kv_uint(&w, "w", h.img_w);
+        opdi_json_kv_uint(&w, "h", h.img_h);
+        opdi_json_kv_uint(&w, "model", h.model);
+        opdi_json_key(&w, "boxes"); opdi_json_arr_begin(&w);
+        for (size_t i=0; i<h.count; i++) {
+            opdi_ws_box_t b; memcpy(&b, rec + sizeof(h) + i * sizeof(b), sizeof(b));
+            opdi_json_arr_begin(&w);
+            opdi_json_int(&w, b.x); opdi_json_int(&w, b.y); opdi_json_uint(&w, b.w); opdi_json_uint(&w, b.h);
+            opdi_json_uint(&w, b.score); opdi_json_uint(&w, b.cls);
+            opdi_json_arr_end(&w);
+        }
+        opdi_json_arr_end(&w);
+    } else if (ch == OPDI_WS_CH_AUDIO_LEVEL) {
+        opdi_ws_level_hdr_t h;
+        if (plen < sizeof(h)) return 0;
+        memcpy(&h, rec, sizeof(h));
+        if (plen != sizeof(h) + h.count) return 0;
+        opdi_json_kv_uint(&w, "t", h.t_ms);
+        opdi_json_kv_uint(&w, "source", h.source);
+        opdi_json_key(&w, "levels"); opdi_json_arr_begin(&w);
+        for (size_t i=0; i<h.count; i++) opdi_json_uint(&w, rec[sizeof(h) + i]);
+        opdi_json_arr_end(&w);
+    } else {
+        return 0;
+    }
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w) == ESP_OK ? w.len : 0;
+}
+
+// JSON view of a queued binary record for text subscribers; NULL if the record is malformed
+static ws_frame_t *render_json(const ws_event_t *e){
+    char buf[96 + OPDI_WS_DETECT_MAX_BOXES * 40];
+    size_t n = render_rec(e->ch, (const uint8_t *)e->f->data + OPDI_WS_REC_HDR_LEN, e->f->len - OPDI_WS_REC_HDR_LEN, buf, sizeof(buf));
+    if (!n) return NULL;
+    ws_frame_t *f = frame_alloc(n);
+    if (f) memcpy(f->data, buf, n);
+    return f;
+}
+
+// Per-batch JSON view of each event: the event itself, or its rendering (done at most once, and
+// only if some text client subscribed to the channel)
+typedef struct {
+    ws_frame_t *json[QLEN];
+    bool tried[QLEN];
+} ws_batch_json_t;
+
+static void batch_json_init(ws_batch_json_t *bj, const ws_event_t *evs, size_t n){
+    for (size_t i=0; i<n; i++) { bj->json[i] = evs[i].bin ? NULL : evs[i].f; bj->tried[i] = !evs[i].bin; }
+}
+
+static void batch_release(ws_event_t *evs, size_t n, ws_batch_json_t *bj){
+    for (size_t i=0; i<n; i++) {
+        if (evs[i].bin && bj->json[i]) frame_unref(bj->json[i]);
+        frame_unref(evs[i].f);
+    }
+}
+
+static ws_frame_t *share(ws_frame_t *f, bool bin){
+    taskENTER_CRITICAL(&s_lock);
+    f->refs++; s_st.frames++;
+    if (bin) s_st.bin_frames++;
+    taskEXIT_CRITICAL(&s_lock);
+    return f;
+}
+
+static void count_frame(ws_frame_t *f, size_t k, bool bin){
+    taskENTER_CRITICAL(&s_lock);
+    if (f) { s_st.frames++; s_st.batched += k; if (bin) s_st.bin_frames++; }
+    else s_st.dropped += k;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// Text frame for one subscription: a lone match is shared unchanged, several are joined into a
+// JSON array [a,b,...]. Binary records are included (as JSON) only for text clients.
+static ws_frame_t *build_text(const ws_event_t *evs, size_t n, ws_batch_json_t *bj, uint32_t mask, bool binary){
+    size_t k = 0, total = 0, last = 0;
+    for (size_t i=0; i<n; i++) {
+        if (!(mask & OPDI_WS_CH_BIT(evs[i].ch)) || (evs[i].bin && binary)) continue;
+        if (!bj->tried[i]) {
+            bj->tried[i] = true;
+            bj->json[i] = render_json(&evs[i]);
+            taskENTER_CRITICAL(&s_lock); s_st.rendered++; taskEXIT_CRITICAL(&s_lock);
+        }
+        if (!bj->json[i]) continue;
+        total += bj->json[i]->len + (k ? 1 : 0); k++; last = i;
+    }
+    if (k <= 1) return k ? share(bj->json[last], false) : NULL;
+    ws_frame_t *f = frame_alloc(total + 2);
+    if (f) {
+        char *p = f->data; *p++ = '[';
+        for (size_t i=0, j=0; i<n; i++) {
+            if (!(mask & OPDI_WS_CH_BIT(evs[i].ch)) || (evs[i].bin && binary) || !bj->json[i]) continue;
+            if (j++) *p++ = ',';
+            memcpy(p, bj->json[i]->data, bj->json[i]->len); p += bj->json[i]->len;
+        }
+        *p = ']';
+    }
+    count_frame(f, k, false);
+    return f;
+}
+
+// Binary frame for one subscription: the subscribed records back to back
+static ws_frame_t *build_bin(const ws_event_t *evs, size_t n, uint32_t mask){
+    size_t k = 0, total = 0, last = 0;
+    for (size_t i=0; i<n; i++) {
+        if (!evs[i].bin || !(mask & OPDI_WS_CH_BIT(evs[i].ch))) continue;
+        total += evs[i].f->len; k++; last = i;
+    }
+    if (k <= 1) return k ? share(evs[last].f, true) : NULL;
+    ws_frame_t *f = frame_alloc(total);
+    if (f) {
+        char *p = f->data;
+        for (size_t i=0; i<n; i++) {
+            if (!evs[i].bin || !(mask & OPDI_WS_CH_BIT(evs[i].ch))) continue;
+            memcpy(p, evs[i].f->data, evs[i].f->len); p += evs[i].f->len;
+        }
+    }
+    count_frame(f, k, true);
+    return f;
+}
+
+static ws_frame_t *next_frame(void){
+    ws_event_t evs[QLEN]; ws_batch_json_t bj;
+    size_t n = pop_batch(evs);
+    if (!n) return NULL;
+    batch_json_init(&bj, evs, n);
+    ws_frame_t *f = build_text(evs, n, &bj, OPDI_WS_CH_DEFAULT_MASK, false);
+    batch_release(evs, n, &bj);
+    return f;
+}
+
+static int find_client_locked(int fd){
+    for (int i=0; i<MAX_CLIENTS; i++) if (s_clients[i].fd == fd) return i;
+    return -1;
+}
+
+static void update_sub_mask_locked(void){
+    uint32_t m = 0;
+    for (int i=0; i<MAX_CLIENTS; i++) if (s_clients[i].fd >= 0) m |= s_clients[i].mask;
+    s_sub_mask = m;
+}
+
+static void remove_client_locked(int i){
+    s_clients[i].fd = -1; s_clients[i].inflight = 0;
+    s_st.clients--;
+    update_sub_mask_locked();
+}
+
+esp_err_t opdi_api_ws_client_add(int fd){
+    esp_err_t r = ESP_OK;
+    taskENTER_CRITICAL(&s_lock);
+    int i = find_client_locked(fd); // a reused fd starts over
+    if (i < 0 && (i = find_client_locked(-1)) >= 0) s_st.clients++;
+    if (i >= 0) {
+        s_clients[i] = (ws_client_t){ .fd = fd, .mask = OPDI_WS_CH_DEFAULT_MASK };
+        update_sub_mask_locked();
+    } else {
+        r = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return r;
+}
+
+void opdi_api_ws_client_remove(int fd){
+    taskENTER_CRITICAL(&s_lock);
+    int i = find_client_locked(fd);
+    if (i >= 0) remove_client_locked(i);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static bool tok_is(const char *js, const opdi_json_tok_t *t, const char *s){
+    return t->type == OPDI_JSON_STR && strlen(s) == t->len && !memcmp(js + t->start, s, t->len);
+}
+
+esp_err_t opdi_api_ws_client_subscribe(int fd, const char *json, size_t len, uint32_t *mask, bool *binary){
+    opdi_json_tok_t toks[32]; size_t count;
+    if (opdi_json_tokenize(json, len, toks, sizeof(toks) / sizeof(toks[0]), &count) != ESP_OK || toks[0].type != OPDI_JSON_OBJ) return ESP_ERR_INVALID_ARG;
+    taskENTER_CRITICAL(&s_lock);
+    int i = find_client_locked(fd);
+    ws_client_t c = i >= 0 ? s_clients[i] : (ws_client_t){ .mask = OPDI_WS_CH_DEFAULT_MASK };
+    taskEXIT_CRITICAL(&s_lock);
+    if (i < 0) return ESP_ERR_NOT_FOUND;
+    bool is_sub = false;
+    for (size_t key = 1; key < toks[0].next; key = toks[key + 1].next) {
+        const opdi_json_tok_t *v = &toks[key + 1];
+        if (tok_is(json, &toks[key], "type")) {
+            is_sub = tok_is(json, v, "sub");
+        } else if (tok_is(json, &toks[key], "topics")) {
+            if (v->type != OPDI_JSON_ARR) return ESP_ERR_INVALID_ARG;
+            c.mask = 0;
+            for (size_t e = key + 2; e < v->next; e = toks[e].next) {
+                if (tok_is(json, &toks[e], "*")) { c.mask = (1u << OPDI_WS_CH_COUNT) - 1; continue; }
+                uint8_t ch = 0;
+                while (ch < OPDI_WS_CH_COUNT && !tok_is(json, &toks[e], s_ch_names[ch])) ch++;
+                if (ch == OPDI_WS_CH_COUNT) return ESP_ERR_INVALID_ARG;
+                c.mask |= OPDI_WS_CH_BIT(ch);
+            }
+        } else if (tok_is(json, &toks[key], "binary")) {
+            if (v->type != OPDI_JSON_PRIM || (json[v->start] != 't' && json[v->start] != 'f')) return ESP_ERR_INVALID_ARG;
+            c.binary = json[v->start] == 't';
+        }
+    }
+    if (!is_sub) return ESP_ERR_NOT_SUPPORTED;
+    taskENTER_CRITICAL(&s_lock);
+    i = find_client_locked(fd);
+    if (i >= 0) { s_clients[i].mask = c.mask; s_clients[i].binary = c.binary; update_sub_mask_locked(); }
+    taskEXIT_CRITICAL(&s_lock);
+    if (mask) *mask = c.mask;
+    if (binary) *binary = c.binary;
+    return i >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void opdi_api_ws_get_stats(opdi_api_ws_stats_t *out){
+    if (!out) return;
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    out->queued = (uint16_t)s_count;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// A client the bus gives up on: its session is closed too, or the socket would keep its httpd slot
+static void close_session(int fd){
+#if CONFIG_HTTPD_WS_SUPPORT
+    if (s_server) httpd_sess_trigger_close(s_server, fd);
+#endif
+}
+
+// Runs in the httpd task once the frame has been written (or failed) on one socket
+static void sent_cb(esp_err_t err, int fd, void *arg){
+    bool dropped = false;
+    taskENTER_CRITICAL(&s_lock);
+    int i = find_client_locked(fd);
+    if (i >= 0) {
+        if (s_clients[i].inflight) s_clients[i].inflight--;
+        if (err != ESP_OK) { remove_client_locked(i); dropped = true; }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (dropped) {
+        ESP_LOGW(TAG, "ws send fail fd=%d -> closing", fd);
+        close_session(fd);
+    }
+    frame_unref((ws_frame_t *)arg);
+}
+
+typedef esp_err_t (*ws_tx_t)(int fd, ws_frame_t *f, bool binary);
+
+#if CONFIG_HTTPD_WS_SUPPORT
+static esp_err_t httpd_tx(int fd, ws_frame_t *f, bool binary){
+    if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET) return ESP_FAIL;
+    httpd_ws_frame_t wf = { .type = binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT, .payload = (uint8_t *)f->data, .len = f->len };
+    return httpd_ws_send_data_async(s_server, fd, &wf, sent_cb, f);
+}
+static ws_tx_t s_tx = httpd_tx;
+#else
+static ws_tx_t s_tx;
+#endif
+
+static void deliver(int fd, ws_frame_t *f, bool binary){
+    taskENTER_CRITICAL(&s_lock);
+    int i = find_client_locked(fd);
+    if (i >= 0) { s_clients[i].inflight++; f->refs++; }
+    taskEXIT_CRITICAL(&s_lock);
+    if (i >= 0 && s_tx(fd, f, binary) != ESP_OK) sent_cb(ESP_FAIL, fd, f);
+}
+
+// Frames are built once per distinct subscription and shared by every client holding it
+static size_t send_batch(ws_event_t *evs, size_t n){
+    ws_client_t cl[MAX_CLIENTS];
+    int slow[MAX_CLIENTS];
+    size_t nc = 0, n_slow = 0, frames = 0;
+    taskENTER_CRITICAL(&s_lock);
+    for (int i=0; i<MAX_CLIENTS; i++) {
+        if (s_clients[i].fd < 0) continue;
+        if (s_clients[i].inflight >= CONFIG_OPDI_API_WS_CLIENT_DEPTH) {
+            // Still has a full backlog in httpd: this client cannot keep up, cut it loose
+            slow[n_slow++] = s_clients[i].fd;
+            remove_client_locked(i);
+            s_st.clients_dropped++;
+            continue;
+        }
+        cl[nc++] = s_clients[i];
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    for (size_t i=0; i<n_slow; i++) {
+        ESP_LOGW(TAG, "fd=%d has %d frames pending -> closing slow client", slow[i], CONFIG_OPDI_API_WS_CLIENT_DEPTH);
+        close_session(slow[i]);
+    }
+    ws_batch_json_t bj;
+    batch_json_init(&bj, evs, n);
+    bool done[MAX_CLIENTS] = { 0 };
+    for (size_t i=0; i<nc; i++) {
+        if (done[i]) continue;
+        ws_frame_t *t = build_text(evs, n, &bj, cl[i].mask, cl[i].binary);
+        ws_frame_t *b = cl[i].binary ? build_bin(evs, n, cl[i].mask) : NULL;
+        for (size_t j=i; j<nc; j++) {
+            if (done[j] || cl[j].mask != cl[i].mask || cl[j].binary != cl[i].binary) continue;
+            done[j] = true;
+            if (t) deliver(cl[j].fd, t, false);
+            if (b) deliver(cl[j].fd, b, true);
+        }
+        if (t) { frame_unref(t); frames++; }
+        if (b) { frame_unref(b); frames++; }
+    }
+    batch_release(evs, n, &bj);
+    return frames;
+}
+
+size_t opdi_api_ws_test_next_frame(char *out, size_t cap){
+    ws_frame_t *f = next_frame();
+    if (!f) return 0;
+    size_t len = f->len;
+    if (out && cap) { size_t k = len < cap - 1 ? len : cap - 1; memcpy(out, f->data, k); out[k] = '\0'; }
+    frame_unref(f);
+    return len;
+}
+
+esp_err_t opdi_api_ws_test_client(int fd, const char *sub_json){
+    esp_err_t r = opdi_api_ws_client_add(fd);
+    if (r == ESP_OK && sub_json) r = opdi_api_ws_client_subscribe(fd, sub_json, strlen(sub_json), NULL, NULL);
+    return r;
+}
+
+void opdi_api_ws_test_client_remove(int fd){
+    opdi_api_ws_client_remove(fd);
+}
+
+static opdi_api_ws_test_tx_t s_test_tx;
+static esp_err_t test_tx(int fd, ws_frame_t *f, bool binary){
+    s_test_tx(fd, binary, (const uint8_t *)f->data, f->len);
+    sent_cb(ESP_OK, fd, f);
+    return ESP_OK;
+}
+
+size_t opdi_api_ws_test_pump(opdi_api_ws_test_tx_t tx){
+    ws_tx_t prev = s_tx;
+    s_test_tx = tx; s_tx = test_tx;
+    ws_event_t evs[QLEN];
+    size_t n, frames = 0;
+    while ((n = pop_batch(evs)) != 0) frames += send_batch(evs, n);
+    s_tx = prev;
+    return frames;
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+static void sender_task(void *arg){
+    (void)arg;
+    ws_event_t evs[QLEN];
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Gather window: a burst (state change + metrics + telemetry) goes out as one frame
+        if (CONFIG_OPDI_API_WS_BATCH_MS) vTaskDelay(pdMS_TO_TICKS(CONFIG_OPDI_API_WS_BATCH_MS));
+        size_t n;
+        while ((n = pop_batch(evs)) != 0) send_batch(evs, n);
+    }
+}
+#endif
+
+esp_err_t opdi_api_ws_bus_start(httpd_handle_t server){
+    s_server = server;
+#if CONFIG_HTTPD_WS_SUPPORT
+    // Stack: batch + per-batch JSON views + one rendered detection record
+    if (!s_task && xTaskCreate(sender_task, "ws_tx", 4096, NULL, CONFIG_OPDI_API_WS_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "sender task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,12 @@
+#pragma once
+// Internal to opdi_api: glue between the /ws handler and the event bus
+#include "esp_http_server.h"
+#include <stdbool.h>
+
+esp_err_t opdi_api_ws_bus_start(httpd_handle_t server);
+esp_err_t opdi_api_ws_client_add(int fd);   // ESP_ERR_NO_MEM when CONFIG_OPDI_API_WS_MAX_CLIENTS are connected
+void opdi_api_ws_client_remove(int fd);
+// Applies a {"type":"sub",...} message to fd; reports the resulting subscription.
+// ESP_ERR_INVALID_ARG: malformed or unknown channel name, subscription unchanged.
+esp_err_t opdi_api_ws_client_subscribe(int fd, const char *json, size_t len, uint32_t *mask, bool *binary);
+const char *opdi_api_ws_channel_name(int ch);
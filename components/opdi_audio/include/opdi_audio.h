@@ -0,0 +1,238 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#if CONFIG_IDF_TARGET_LINUX
+// Host build: no I2S driver; the player clock adapter only needs the slot mode
+typedef enum { I2S_SLOT_MODE_MONO = 1, I2S_SLOT_MODE_STEREO = 2 } i2s_slot_mode_t;
+#else
+#include "driver/i2s_std.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output format of the mixer (everything handed to bsp_extra_i2s_write is 16-bit stereo)
+#define OPDI_AUDIO_CHANNELS        2
+#define OPDI_AUDIO_FRAME_BYTES     (OPDI_AUDIO_CHANNELS * sizeof(int16_t))
+#define OPDI_AUDIO_GAIN_UNITY      256  // Q8 gain used by the mixing core
+
+// Stream priorities: a stream is ducked while any higher priority stream is active
+typedef enum {
+    OPDI_AUDIO_PRIO_MUSIC = 0,
+    OPDI_AUDIO_PRIO_EVENT,
+    OPDI_AUDIO_PRIO_VOICE,
+    OPDI_AUDIO_PRIO_ALERT,
+} opdi_audio_prio_t;
+
+typedef int opdi_audio_stream_t; // index into the mixer stream table, -1 = invalid
+
+typedef struct {
+    uint32_t sample_rate;     // current device rate
+    uint32_t blocks;          // blocks written to I2S since init
+    uint32_t clipped_samples; // samples saturated by the mixing core
+    uint32_t underruns;       // active stream ran dry mid-block
+    uint32_t active_streams;  // streams that contributed to the last block
+    uint32_t latency_ms;      // worst-case queueing latency (one ring + one block)
+} opdi_audio_mixer_stats_t;
+
+// Start the mixer task; the codec must already be initialized (bsp_extra_codec_init)
+esp_err_t opdi_audio_mixer_init(void);
+bool opdi_audio_mixer_ready(void);
+// Current device rate; producers must write PCM at this rate
+uint32_t opdi_audio_mixer_rate(void);
+
+// Play a one-shot clip (16-bit stereo) without copying it into a ring. pcm must stay valid
+// until played or opdi_audio_mixer_cancel_clips() returns. Non-blocking.
+esp_err_t opdi_audio_mixer_play_clip(const int16_t *pcm, size_t frames, opdi_audio_prio_t prio);
+// Stop every clip in flight (call before freeing clip memory)
+void opdi_audio_mixer_cancel_clips(void);
+
+// Open an input stream. Each stream has exactly one producer task.
+esp_err_t opdi_audio_stream_open(opdi_audio_prio_t prio, opdi_audio_stream_t *out);
+// Release a stream; audio already queued still plays out before the slot is reused
+esp_err_t opdi_audio_stream_close(opdi_audio_stream_t s);
+// Queue interleaved 16-bit stereo PCM; blocks up to timeout_ms for ring space.
+// Returns bytes accepted (may be short on timeout).
+size_t opdi_audio_stream_write(opdi_audio_stream_t s, const void *pcm, size_t len, uint32_t timeout_ms);
+// Per-stream gain 0..100 %
+void opdi_audio_stream_set_gain(opdi_audio_stream_t s, uint8_t gain_pct);
+// Drop anything still queued on the stream
+void opdi_audio_stream_flush(opdi_audio_stream_t s);
+
+void opdi_audio_mixer_get_stats(opdi_audio_mixer_stats_t *out);
+
+#if CONFIG_IDF_TARGET_LINUX
+// Host build: opdi_audio_linux.c stands in for the codec. The speaker takes one block at a time in real time
+// at the mixer rate and hands it to spk as it starts playing; the mic delivers frames in real time from mic
+// (silence when NULL), called when the frames are complete. Both get 16-bit stereo.
+typedef void (*opdi_audio_host_pcm_fn)(int16_t *pcm, size_t frames, void *ctx);
+void opdi_audio_host_set_io(opdi_audio_host_pcm_fn mic, opdi_audio_host_pcm_fn spk, void *ctx);
+#endif
+
+// audio_player adapters (match audio_player_write_fn / audio_reconfig_std_clock); the
+// player output becomes an OPDI_AUDIO_PRIO_MUSIC stream instead of owning the I2S channel.
+esp_err_t opdi_audio_player_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+esp_err_t opdi_audio_player_clk_set(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
+
+// --- Tone / earcon cache ---
+typedef enum {
+    OPDI_AUDIO_TONE_STARTUP = 0, // boot fallback beep
+    OPDI_AUDIO_TONE_NOTIFY,
+    OPDI_AUDIO_TONE_OK,
+    OPDI_AUDIO_TONE_ERROR,
+    OPDI_AUDIO_TONE_COUNT,
+} opdi_audio_tone_id_t;
+
+#define OPDI_AUDIO_TONE_MAX_SEGS 4
+
+typedef struct {
+    uint16_t freq_hz;  // 0 = rest
+    uint16_t dur_ms;
+    uint8_t level_pct; // of full scale
+} opdi_audio_tone_seg_t;
+
+// Requires the mixer. Tones are rendered into PSRAM at init (or loaded from
+// CONFIG_OPDI_AUDIO_TONE_DIR/<name>_<rate>.pcm) and re-rendered only by opdi_audio_tone_define().
+esp_err_t opdi_audio_tone_cache_init(void);
+// Replace a tone definition (n <= OPDI_AUDIO_TONE_MAX_SEGS; n == 0 = silent, segs may be NULL)
+esp_err_t opdi_audio_tone_define(opdi_audio_tone_id_t id, const opdi_audio_tone_seg_t *segs, size_t n);
+// Non-blocking: hands the cached samples to the mixer as a clip and returns (ESP_ERR_NOT_FOUND: silent tone)
+esp_err_t opdi_audio_tone_play(opdi_audio_tone_id_t id, opdi_audio_prio_t prio);
+// Fallback without a mixer: renders the tone and writes it to I2S in the caller's task, blocking for its
+// length. ESP_ERR_INVALID_STATE while the mixer runs (it owns I2S), ESP_ERR_NOT_FOUND: silent tone.
+esp_err_t opdi_audio_tone_play_direct(opdi_audio_tone_id_t id);
+
+// Synthesis core (used by the cache and host tests). out == NULL returns the required frame count.
+size_t opdi_audio_tone_render(const opdi_audio_tone_seg_t *segs, size_t n, uint32_t rate, int16_t *out, size_t max_frames);
+
+// --- Full-duplex voice over WebSocket (SRD FR-16, Appendix D) ---
+// Wire format: 16 kHz mono PCM16 in 20 ms frames behind a 6 byte header (seq u16, ts_ms u32, LE)
+#define OPDI_AUDIO_DUPLEX_RATE          16000
+#define OPDI_AUDIO_DUPLEX_FRAME_MS      20
+#define OPDI_AUDIO_DUPLEX_FRAME_SAMPLES (OPDI_AUDIO_DUPLEX_RATE * OPDI_AUDIO_DUPLEX_FRAME_MS / 1000)
+#define OPDI_AUDIO_WS_HDR_BYTES         6
+#define OPDI_AUDIO_WS_FRAME_BYTES       (OPDI_AUDIO_WS_HDR_BYTES + OPDI_AUDIO_DUPLEX_FRAME_SAMPLES * 2)
+#define OPDI_AUDIO_JB_SLOTS             16 // power of two, 320 ms
+
+typedef struct {
+    uint32_t tx_frames;     // mic frames handed to the WS sender
+    uint32_t tx_dropped;    // mic frames dropped because the uplink ring was full
+    uint32_t tx_q_depth;    // frames waiting in the uplink ring
+    uint32_t rx_frames;     // downlink frames received
+    uint32_t rx_bad;        // malformed downlink frames
+    uint32_t late_frames;   // arrived after their playout slot
+    uint32_t glitches;      // playout slots concealed (loss, lateness or underrun)
+    uint32_t underruns;     // jitter buffer drained and rebuffered
+    uint32_t rx_jitter_ms;  // interarrival jitter estimate
+    uint32_t jb_depth;      // frames currently buffered for playout
+    uint32_t capture_errors;// failed bsp_extra_i2s_read calls
+} opdi_audio_duplex_stats_t;
+
+// Uplink sink (e.g. httpd_ws_send_frame_async); called from the sender task, never from the capture loop
+typedef esp_err_t (*opdi_audio_duplex_send_fn)(const uint8_t *frame, size_t len, void *ctx);
+
+// Start capture (bsp_extra_i2s_read -> uplink) and playout (jitter buffer -> mixer VOICE stream)
+esp_err_t opdi_audio_duplex_start(opdi_audio_duplex_send_fn send, void *ctx);
+// Tasks exit on their own; safe to call from the send callback
+void opdi_audio_duplex_stop(void);
+bool opdi_audio_duplex_active(void);
+// Feed one binary downlink frame
+void opdi_audio_duplex_rx(const uint8_t *buf, size_t len);
+void opdi_audio_duplex_get_stats(opdi_audio_duplex_stats_t *out);
+
+typedef struct { uint16_t seq; uint32_t ts_ms; } opdi_audio_ws_hdr_t;
+// Returns bytes written to out (0 if cap is too small)
+size_t opdi_audio_ws_frame_pack(uint16_t seq, uint32_t ts_ms, const int16_t *pcm, size_t samples, uint8_t *out, size_t cap);
+// pcm may be NULL to only read the header
+bool opdi_audio_ws_frame_parse(const uint8_t *buf, size_t len, opdi_audio_ws_hdr_t *hdr, int16_t *pcm, size_t max_samples, size_t *samples);
+
+// Lock-free single-producer/single-consumer ring of fixed-size records
+typedef struct {
+    uint8_t *buf;
+    uint32_t rec_size, rec_count;
+    uint32_t head, tail; // free-running counters, accessed atomically
+} opdi_audio_spsc_t;
+void opdi_audio_spsc_init(opdi_audio_spsc_t *r, uint8_t *buf, uint32_t rec_size, uint32_t rec_count);
+bool opdi_audio_spsc_push(opdi_audio_spsc_t *r, const void *rec);
+bool opdi_audio_spsc_pop(opdi_audio_spsc_t *r, void *rec);
+uint32_t opdi_audio_spsc_depth(const opdi_audio_spsc_t *r);
+
+typedef struct {
+    uint32_t received, played, late, duplicate, glitches, underruns, overflow;
+} opdi_audio_jb_stats_t;
+
+// Jitter buffer of 20 ms frames indexed by sequence number; not thread safe
+typedef struct {
+    int16_t pcm[OPDI_AUDIO_JB_SLOTS][OPDI_AUDIO_DUPLEX_FRAME_SAMPLES];
+    uint16_t seq[OPDI_AUDIO_JB_SLOTS];
+    bool filled[OPDI_AUDIO_JB_SLOTS];
+    int16_t last[OPDI_AUDIO_DUPLEX_FRAME_SAMPLES]; // concealment source
+    uint16_t play_seq;
+    uint8_t target, depth, conceal_run;
+    bool synced, playing, have_transit;
+    int32_t last_transit, jitter_x16;
+    opdi_audio_jb_stats_t stats;
+} opdi_audio_jb_t;
+void opdi_audio_jb_init(opdi_audio_jb_t *jb, uint8_t target_frames);
+void opdi_audio_jb_push(opdi_audio_jb_t *jb, uint16_t seq, uint32_t ts_ms, uint32_t arrival_ms, const int16_t *pcm);
+// Always fills out with one frame; returns false when the frame was concealed or silence
+bool opdi_audio_jb_pop(opdi_audio_jb_t *jb, int16_t *out);
+uint32_t opdi_audio_jb_jitter_ms(const opdi_audio_jb_t *jb);
+
+// --- Polyphase sample-rate converter (player file rate -> fixed device rate) ---
+#define OPDI_AUDIO_RESAMPLE_TAPS  16  // taps per polyphase branch
+#define OPDI_AUDIO_RESAMPLE_MAX_L 640 // largest reduced upsampling factor (11.025 -> 48 kHz)
+
+typedef struct {
+    uint32_t in_rate, out_rate;
+    uint16_t L, M;      // reduced ratio out/in = L/M
+    uint16_t phase, pos;
+    int16_t *coef;      // L x TAPS, Q15; NULL when L == M (pass-through)
+    int16_t hist[2][2 * OPDI_AUDIO_RESAMPLE_TAPS];
+} opdi_audio_resampler_t;
+
+// r must be zeroed before the first init; re-init with a new ratio redesigns the filter
+esp_err_t opdi_audio_resampler_init(opdi_audio_resampler_t *r, uint32_t in_rate, uint32_t out_rate);
+void opdi_audio_resampler_deinit(opdi_audio_resampler_t *r);
+void opdi_audio_resampler_reset(opdi_audio_resampler_t *r);
+// Upper bound of output frames for in_frames of input
+size_t opdi_audio_resampler_max_out(const opdi_audio_resampler_t *r, size_t in_frames);
+// Stereo 16-bit in/out. out_cap must be >= max_out(in_frames) or the excess is lost.
+size_t opdi_audio_resampler_process(opdi_audio_resampler_t *r, const int16_t *in, size_t in_frames, int16_t *out, size_t out_cap);
+
+// --- Spectrum (player output tap -> radix-4 fixed-point FFT -> display bands) ---
+#define OPDI_AUDIO_SPECTRUM_FFT_N    1024 // power of 4; ~21 ms at 48 kHz
+#define OPDI_AUDIO_SPECTRUM_BANDS    4    // bass, low-mid, high-mid, treble
+#define OPDI_AUDIO_SPECTRUM_FLOOR_Q2 24   // log2(power) * 4 mapped to level 0 (~-60 dBFS)
+
+// In-place complex FFT of n = 4^k (<= FFT_N) points in Q0 int32; output is X[k] / n, natural order
+void opdi_audio_fft_r4(int32_t *re, int32_t *im, size_t n);
+// Hann-windowed FFT of FFT_N mono samples -> band levels 0..80 (~0.75 dB per step)
+void opdi_audio_spectrum_compute(const int16_t *mono, uint32_t rate, uint16_t bands[OPDI_AUDIO_SPECTRUM_BANDS]);
+// Called by the player path with the stereo frames it hands to the mixer (single writer)
+void opdi_audio_spectrum_feed(const int16_t *stereo, size_t frames);
+// UI-rate poll (~30 Hz, single reader): latest levels with peak-hold decay; falls to 0 when idle
+void opdi_audio_spectrum_poll(uint16_t bands[OPDI_AUDIO_SPECTRUM_BANDS]);
+
+// --- Mixing core (no RTOS dependencies; used by the mixer task and host tests) ---
+typedef struct {
+    const int16_t *pcm; // interleaved stereo, NULL = silent
+    size_t frames;      // valid frames in pcm; the remainder of the block is silence
+    uint16_t gain_from; // Q8 gain at block start
+    uint16_t gain_to;   // Q8 gain at block end (linear ramp avoids zipper noise)
+} opdi_audio_mix_input_t;
+
+// Mix n_in inputs into out (frames stereo frames). Returns number of clipped samples.
+uint32_t opdi_audio_mix_block(const opdi_audio_mix_input_t *in, size_t n_in, int16_t *out, size_t frames);
+
+// Compute Q8 target gains for n streams from their priority, activity and user gain.
+void opdi_audio_mix_target_gains(const uint8_t *prio, const bool *active, const uint8_t *gain_pct,
+                                 size_t n, uint8_t duck_pct, uint16_t *out_q8);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,193 @@
+// Full-duplex voice engine: mic capture -> uplink frames, downlink frames -> jitter buffer -> mixer
+#include "opdi_audio.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "opdi_audio_linux.h"
+#else
+#include "bsp_board_extra.h"
+#endif
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "opdi_duplex";
+
+#ifndef CONFIG_OPDI_AUDIO_JITTER_TARGET_MS
+#define CONFIG_OPDI_AUDIO_JITTER_TARGET_MS 80
+#endif
+#ifndef CONFIG_OPDI_AUDIO_DUPLEX_TX_FRAMES
+#define CONFIG_OPDI_AUDIO_DUPLEX_TX_FRAMES 8
+#endif
+
+#define FRAME_SAMPLES OPDI_AUDIO_DUPLEX_FRAME_SAMPLES
+#define MAX_RATIO     3 // device rate may be 16/32/48 kHz (integer multiples of the wire rate)
+
+typedef struct {
+    opdi_audio_duplex_send_fn send;
+    void *ctx;
+    volatile bool run;
+    TaskHandle_t cap_task, tx_task, play_task;
+    SemaphoreHandle_t jb_lock;       // rx (httpd task) vs playout task
+    opdi_audio_jb_t *jb;             // PSRAM
+    opdi_audio_spsc_t tx;            // capture -> sender, lock-free
+    uint8_t *tx_buf;
+    opdi_audio_stream_t voice;
+    uint16_t tx_seq;
+    opdi_audio_duplex_stats_t st;
+} duplex_t;
+
+static duplex_t s_dx = { .voice = -1 };
+
+static uint32_t now_ms(void){ return (uint32_t)(esp_timer_get_time() / 1000); }
+
+// Device PCM is stereo at the mixer rate; the wire is 16 kHz mono
+static uint32_t rate_ratio(void){
+    uint32_t rate = opdi_audio_mixer_rate();
+    if (rate % OPDI_AUDIO_DUPLEX_RATE) return 0;
+    uint32_t k = rate / OPDI_AUDIO_DUPLEX_RATE;
+    return (k >= 1 && k <= MAX_RATIO) ? k : 0;
+}
+
+static void capture_task(void *arg){
+    (void)arg;
+    static int16_t dev[FRAME_SAMPLES * MAX_RATIO * 2];
+    static int16_t mono[FRAME_SAMPLES];
+    static uint8_t frame[OPDI_AUDIO_WS_FRAME_BYTES];
+    bool warned = false;
+    while (s_dx.run){
+        uint32_t k = rate_ratio();
+        if (!k){
+            if (!warned){ ESP_LOGW(TAG, "device rate %u Hz not a multiple of %d; uplink paused", (unsigned)opdi_audio_mixer_rate(), OPDI_AUDIO_DUPLEX_RATE); warned = true; }
+            vTaskDelay(pdMS_TO_TICKS(OPDI_AUDIO_DUPLEX_FRAME_MS));
+            continue;
+        }
+        warned = false;
+        size_t want = FRAME_SAMPLES * k * OPDI_AUDIO_FRAME_BYTES, got = 0;
+        if (bsp_extra_i2s_read(dev, want, &got, OPDI_AUDIO_DUPLEX_FRAME_MS * 2) != ESP_OK || got < want){
+            s_dx.st.capture_errors++;
+            vTaskDelay(1);
+            continue;
+        }
+        uint32_t ts = now_ms();
+        // Average L/R and decimate by k (box filter; the codec's own anti-alias filter does the rest)
+        for (int i=0;i<FRAME_SAMPLES;i++){
+            int32_t acc = 0;
+            for (uint32_t j=0;j<k;j++){ const int16_t *p = &dev[2*(i*k + j)]; acc += p[0] + p[1]; }
+            mono[i] = (int16_t)(acc / (int32_t)(2*k));
+        }
+        opdi_audio_ws_frame_pack(s_dx.tx_seq++, ts, mono, FRAME_SAMPLES, frame, sizeof(frame));
+        // The sender clears its handle as it exits at stop: read it once
+        TaskHandle_t tx = s_dx.tx_task;
+        if (opdi_audio_spsc_push(&s_dx.tx, frame)) { s_dx.st.tx_frames++; if (tx) xTaskNotifyGive(tx); }
+        else s_dx.st.tx_dropped++;
+    }
+    s_dx.cap_task = NULL;
+    vTaskDelete(NULL);
+}
+
+// Sender is decoupled from capture so a slow socket never stalls the I2S read loop
+static void sender_task(void *arg){
+    (void)arg;
+    static uint8_t frame[OPDI_AUDIO_WS_FRAME_BYTES];
+    while (s_dx.run){
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OPDI_AUDIO_DUPLEX_FRAME_MS * 2));
+        while (s_dx.run && opdi_audio_spsc_pop(&s_dx.tx, frame)){
+            if (s_dx.send(frame, sizeof(frame), s_dx.ctx) != ESP_OK){
+                ESP_LOGW(TAG, "uplink send failed; stopping duplex");
+                s_dx.run = false;
+            }
+        }
+    }
+    s_dx.tx_task = NULL;
+    vTaskDelete(NULL);
+}
+
+static void playout_task(void *arg){
+    (void)arg;
+    static int16_t mono[FRAME_SAMPLES];
+    static int16_t dev[FRAME_SAMPLES * MAX_RATIO * 2];
+    TickType_t last = xTaskGetTickCount();
+    const TickType_t period = pdMS_TO_TICKS(OPDI_AUDIO_DUPLEX_FRAME_MS);
+    while (s_dx.run){
+        xTaskDelayUntil(&last, period ? period : 1);
+        xSemaphoreTake(s_dx.jb_lock, portMAX_DELAY);
+        bool buffering = !s_dx.jb->playing;
+        opdi_audio_jb_pop(s_dx.jb, mono);
+        buffering = buffering && !s_dx.jb->playing;
+        xSemaphoreGive(s_dx.jb_lock);
+        if (buffering) continue; // nothing to play yet: keep the mixer stream idle
+        uint32_t k = rate_ratio();
+        if (!k) continue;
+        // Upsample by sample repetition into stereo at the device rate
+        for (int i=0;i<FRAME_SAMPLES;i++) for (uint32_t j=0;j<k;j++){ dev[2*(i*k + j)] = mono[i]; dev[2*(i*k + j) + 1] = mono[i]; }
+        opdi_audio_stream_write(s_dx.voice, dev, FRAME_SAMPLES * k * OPDI_AUDIO_FRAME_BYTES, OPDI_AUDIO_DUPLEX_FRAME_MS);
+    }
+    s_dx.play_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t opdi_audio_duplex_start(opdi_audio_duplex_send_fn send, void *ctx){
+    if (!send) return ESP_ERR_INVALID_ARG;
+    if (!opdi_audio_mixer_ready()) return ESP_ERR_INVALID_STATE;
+    // A previous session's tasks exit within one frame period of stop
+    for (int i=0; i<5 && !s_dx.run && (s_dx.cap_task || s_dx.tx_task || s_dx.play_task); i++) vTaskDelay(pdMS_TO_TICKS(OPDI_AUDIO_DUPLEX_FRAME_MS));
+    if (s_dx.run || s_dx.cap_task || s_dx.tx_task || s_dx.play_task) return ESP_ERR_INVALID_STATE;
+    if (!s_dx.jb_lock) s_dx.jb_lock = xSemaphoreCreateMutex();
+    if (!s_dx.jb) s_dx.jb = heap_caps_malloc(sizeof(opdi_audio_jb_t), MALLOC_CAP_SPIRAM);
+    if (!s_dx.tx_buf) s_dx.tx_buf = heap_caps_malloc((size_t)CONFIG_OPDI_AUDIO_DUPLEX_TX_FRAMES * OPDI_AUDIO_WS_FRAME_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_dx.jb_lock || !s_dx.jb || !s_dx.tx_buf) return ESP_ERR_NO_MEM;
+    esp_err_t r = opdi_audio_stream_open(OPDI_AUDIO_PRIO_VOICE, &s_dx.voice);
+    if (r != ESP_OK) return r;
+    opdi_audio_jb_init(s_dx.jb, (CONFIG_OPDI_AUDIO_JITTER_TARGET_MS + OPDI_AUDIO_DUPLEX_FRAME_MS - 1) / OPDI_AUDIO_DUPLEX_FRAME_MS);
+    opdi_audio_spsc_init(&s_dx.tx, s_dx.tx_buf, OPDI_AUDIO_WS_FRAME_BYTES, CONFIG_OPDI_AUDIO_DUPLEX_TX_FRAMES);
+    memset(&s_dx.st, 0, sizeof(s_dx.st));
+    s_dx.send = send; s_dx.ctx = ctx; s_dx.tx_seq = 0;
+    s_dx.run = true;
+    bool ok = xTaskCreate(sender_task, "dx_tx", 4096, NULL, 5, &s_dx.tx_task) == pdPASS;
+    ok = ok && xTaskCreate(capture_task, "dx_cap", 4096, NULL, 6, &s_dx.cap_task) == pdPASS;
+    ok = ok && xTaskCreate(playout_task, "dx_play", 4096, NULL, 6, &s_dx.play_task) == pdPASS;
+    if (!ok){ ESP_LOGE(TAG, "task create failed"); opdi_audio_duplex_stop(); return ESP_ERR_NO_MEM; }
+    ESP_LOGI(TAG, "duplex started (jitter target %d ms, uplink ring %d frames)", CONFIG_OPDI_AUDIO_JITTER_TARGET_MS, CONFIG_OPDI_AUDIO_DUPLEX_TX_FRAMES);
+    return ESP_OK;
+}
+
+void opdi_audio_duplex_stop(void){
+    if (!s_dx.run && s_dx.voice < 0) return;
+    s_dx.run = false;
+    TaskHandle_t tx = s_dx.tx_task;
+    if (tx) xTaskNotifyGive(tx);
+    if (s_dx.voice >= 0){ opdi_audio_stream_close(s_dx.voice); s_dx.voice = -1; }
+    ESP_LOGI(TAG, "duplex stopped (tx=%u drop=%u rx=%u late=%u glitch=%u)", (unsigned)s_dx.st.tx_frames,
+             (unsigned)s_dx.st.tx_dropped, (unsigned)s_dx.st.rx_frames, (unsigned)s_dx.jb->stats.late, (unsigned)s_dx.jb->stats.glitches);
+}
+
+bool opdi_audio_duplex_active(void){ return s_dx.run; }
+
+void opdi_audio_duplex_rx(const uint8_t *buf, size_t len){
+    if (!s_dx.run) return;
+    static int16_t pcm[FRAME_SAMPLES];
+    opdi_audio_ws_hdr_t h; size_t n = 0;
+    if (!opdi_audio_ws_frame_parse(buf, len, &h, pcm, FRAME_SAMPLES, &n) || n != FRAME_SAMPLES){ s_dx.st.rx_bad++; return; }
+    s_dx.st.rx_frames++;
+    xSemaphoreTake(s_dx.jb_lock, portMAX_DELAY);
+    opdi_audio_jb_push(s_dx.jb, h.seq, h.ts_ms, now_ms(), pcm);
+    xSemaphoreGive(s_dx.jb_lock);
+}
+
+void opdi_audio_duplex_get_stats(opdi_audio_duplex_stats_t *out){
+    if (!out) return;
+    *out = s_dx.st;
+    out->tx_q_depth = s_dx.tx_buf ? opdi_audio_spsc_depth(&s_dx.tx) : 0;
+    if (s_dx.jb && s_dx.jb_lock){
+        xSemaphoreTake(s_dx.jb_lock, portMAX_DELAY);
+        out->late_frames = s_dx.jb->stats.late;
+        out->glitches = s_dx.jb->stats.glitches;
+        out->underruns = s_dx.jb->stats.underruns;
+        out->jb_depth = s_dx.jb->depth;
+        out->rx_jitter_ms = opdi_audio_jb_jitter_ms(s_dx.jb);
+        xSemaphoreGive(s_dx.jb_lock);
+    }
+}
@@ -0,0 +1,128 @@
+// Duplex voice core: WS frame codec, SPSC frame ring and jitter buffer (no RTOS dependencies)
+#include "opdi_audio.h"
+#include <string.h>
+
+// --- Binary WS frame (SRD Appendix D): seq u16 | ts_ms u32 | PCM16 mono, little-endian ---
+size_t opdi_audio_ws_frame_pack(uint16_t seq, uint32_t ts_ms, const int16_t *pcm, size_t samples, uint8_t *out, size_t cap){
+    size_t len = OPDI_AUDIO_WS_HDR_BYTES + samples * sizeof(int16_t);
+    if (!out || (samples && !pcm) || cap < len) return 0;
+    out[0] = (uint8_t)seq; out[1] = (uint8_t)(seq >> 8);
+    out[2] = (uint8_t)ts_ms; out[3] = (uint8_t)(ts_ms >> 8); out[4] = (uint8_t)(ts_ms >> 16); out[5] = (uint8_t)(ts_ms >> 24);
+    uint8_t *p = out + OPDI_AUDIO_WS_HDR_BYTES;
+    for (size_t i=0;i<samples;i++){ p[2*i] = (uint8_t)pcm[i]; p[2*i + 1] = (uint8_t)((uint16_t)pcm[i] >> 8); }
+    return len;
+}
+
+bool opdi_audio_ws_frame_parse(const uint8_t *buf, size_t len, opdi_audio_ws_hdr_t *hdr, int16_t *pcm, size_t max_samples, size_t *samples){
+    if (!buf || !hdr || len < OPDI_AUDIO_WS_HDR_BYTES || ((len - OPDI_AUDIO_WS_HDR_BYTES) & 1)) return false;
+    size_t n = (len - OPDI_AUDIO_WS_HDR_BYTES) / sizeof(int16_t);
+    if (n > max_samples) return false;
+    hdr->seq = (uint16_t)(buf[0] | (buf[1] << 8));
+    hdr->ts_ms = (uint32_t)buf[2] | ((uint32_t)buf[3] << 8) | ((uint32_t)buf[4] << 16) | ((uint32_t)buf[5] << 24);
+    const uint8_t *p = buf + OPDI_AUDIO_WS_HDR_BYTES;
+    if (pcm) for (size_t i=0;i<n;i++) pcm[i] = (int16_t)(p[2*i] | (p[2*i + 1] << 8));
+    if (samples) *samples = n;
+    return true;
+}
+
+// --- Single-producer / single-consumer ring of fixed-size records ---
+// head is only written by the producer, tail only by the consumer; acquire/release ordering
+// publishes the record bytes before the index that makes them visible.
+void opdi_audio_spsc_init(opdi_audio_spsc_t *r, uint8_t *buf, uint32_t rec_size, uint32_t rec_count){
+    r->buf = buf; r->rec_size = rec_size; r->rec_count = rec_count; r->head = 0; r->tail = 0;
+}
+
+bool opdi_audio_spsc_push(opdi_audio_spsc_t *r, const void *rec){
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= r->rec_count) return false; // full
+    memcpy(r->buf + (size_t)(head % r->rec_count) * r->rec_size, rec, r->rec_size);
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool opdi_audio_spsc_pop(opdi_audio_spsc_t *r, void *rec){
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if (head == tail) return false; // empty
+    memcpy(rec, r->buf + (size_t)(tail % r->rec_count) * r->rec_size, r->rec_size);
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t opdi_audio_spsc_depth(const opdi_audio_spsc_t *r){
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+// --- Jitter buffer ---
+#define JB_MASK (OPDI_AUDIO_JB_SLOTS - 1)
+#define CONCEAL_REPEAT 2 // frames of faded repetition before falling back to silence
+
+void opdi_audio_jb_init(opdi_audio_jb_t *jb, uint8_t target_frames){
+    memset(jb, 0, sizeof(*jb));
+    if (target_frames < 1) target_frames = 1;
+    if (target_frames > OPDI_AUDIO_JB_SLOTS - 2) target_frames = OPDI_AUDIO_JB_SLOTS - 2;
+    jb->target = target_frames;
+}
+
+static void jb_clear_slots(opdi_audio_jb_t *jb){ memset(jb->filled, 0, sizeof(jb->filled)); jb->depth = 0; }
+
+void opdi_audio_jb_push(opdi_audio_jb_t *jb, uint16_t seq, uint32_t ts_ms, uint32_t arrival_ms, const int16_t *pcm){
+    jb->stats.received++;
+    // Interarrival jitter estimate (RFC 3550 6.4.1), kept in ms * 16 to stay in integers
+    if (jb->have_transit){
+        int32_t transit = (int32_t)(arrival_ms - ts_ms);
+        int32_t d = transit - jb->last_transit; if (d < 0) d = -d;
+        jb->jitter_x16 += d - ((jb->jitter_x16 + 8) >> 4);
+        jb->last_transit = transit;
+    } else {
+        jb->last_transit = (int32_t)(arrival_ms - ts_ms); jb->have_transit = true;
+    }
+    if (!jb->synced){ jb->play_seq = seq; jb->synced = true; }
+    int16_t ahead = (int16_t)(seq - jb->play_seq);
+    // Before playout starts a reordered earlier frame simply moves the start back
+    if (ahead < 0 && !jb->playing && jb->stats.played == 0 && -ahead <= jb->target){ jb->play_seq = seq; ahead = 0; }
+    if (ahead < 0){ jb->stats.late++; return; } // its playout slot has already been concealed
+    if (ahead >= OPDI_AUDIO_JB_SLOTS){
+        // Sender jumped far ahead (stall or restart): resync around the new frame
+        jb->stats.overflow++;
+        jb_clear_slots(jb);
+        jb->play_seq = seq; jb->playing = false;
+    }
+    uint32_t slot = seq & JB_MASK;
+    if (jb->filled[slot] && jb->seq[slot] == seq){ jb->stats.duplicate++; return; }
+    if (!jb->filled[slot]) jb->depth++;
+    jb->filled[slot] = true; jb->seq[slot] = seq;
+    memcpy(jb->pcm[slot], pcm, sizeof(jb->pcm[slot]));
+}
+
+bool opdi_audio_jb_pop(opdi_audio_jb_t *jb, int16_t *out){
+    if (!jb->playing){
+        // (Re)buffering: hold playout until target frames are queued
+        if (jb->depth < jb->target){ memset(out, 0, OPDI_AUDIO_DUPLEX_FRAME_SAMPLES * sizeof(int16_t)); return false; }
+        jb->playing = true;
+    }
+    uint32_t slot = jb->play_seq & JB_MASK;
+    bool have = jb->filled[slot] && jb->seq[slot] == jb->play_seq;
+    if (have){
+        memcpy(out, jb->pcm[slot], OPDI_AUDIO_DUPLEX_FRAME_SAMPLES * sizeof(int16_t));
+        memcpy(jb->last, out, sizeof(jb->last));
+        jb->filled[slot] = false; jb->depth--;
+        jb->conceal_run = 0;
+        jb->stats.played++;
+    } else {
+        // Missing frame: repeat the last one at half level, then silence
+        jb->stats.glitches++;
+        if (jb->conceal_run < CONCEAL_REPEAT){
+            for (int i=0;i<OPDI_AUDIO_DUPLEX_FRAME_SAMPLES;i++){ jb->last[i] /= 2; out[i] = jb->last[i]; }
+        } else {
+            memset(out, 0, OPDI_AUDIO_DUPLEX_FRAME_SAMPLES * sizeof(int16_t));
+        }
+        jb->conceal_run++;
+        if (jb->depth == 0){ jb->playing = false; jb->stats.underruns++; } // drained: rebuffer to target
+    }
+    jb->play_seq++;
+    return have;
+}
+
+uint32_t opdi_audio_jb_jitter_ms(const opdi_audio_jb_t *jb){ return (uint32_t)(jb->jitter_x16 >> 4); }
@@ -0,0 +1,58 @@
+// Host build (linux target): a real-time stand-in for the ES8311 codec behind bsp_extra. The speaker clock
+// plays one block at a time (a write returns when its block starts, like a single DMA descriptor); the mic
+// clock completes one read's worth of frames per read period. Both restart after an idle gap.
+#include "opdi_audio_linux.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static uint32_t s_fs = 48000;
+static int64_t s_spk_end_us, s_mic_end_us;
+static opdi_audio_host_pcm_fn s_mic, s_spk;
+static void *s_ctx;
+
+void opdi_audio_host_set_io(opdi_audio_host_pcm_fn mic, opdi_audio_host_pcm_fn spk, void *ctx){
+    s_mic = mic; s_spk = spk; s_ctx = ctx;
+}
+
+static void sleep_until(int64_t t_us){
+    int64_t wait = t_us - esp_timer_get_time();
+    if (wait <= 0) return;
+    TickType_t ticks = pdMS_TO_TICKS((uint32_t)((wait + 999) / 1000));
+    vTaskDelay(ticks ? ticks : 1);
+}
+
+static int64_t period_us(size_t frames){ return (int64_t)frames * 1000000 / s_fs; }
+
+esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch){
+    if (!rate || bits_cfg != 16 || ch != I2S_SLOT_MODE_STEREO) return ESP_ERR_INVALID_ARG;
+    s_fs = rate;
+    s_spk_end_us = s_mic_end_us = 0;
+    return ESP_OK;
+}
+
+esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms){
+    (void)timeout_ms;
+    size_t frames = len / OPDI_AUDIO_FRAME_BYTES;
+    int64_t now = esp_timer_get_time();
+    int64_t start = s_spk_end_us > now ? s_spk_end_us : now;
+    s_spk_end_us = start + period_us(frames);
+    sleep_until(start);
+    if (s_spk) s_spk((int16_t*)audio_buffer, frames, s_ctx);
+    if (bytes_written) *bytes_written = len;
+    return ESP_OK;
+}
+
+esp_err_t bsp_extra_i2s_read(void *audio_buffer, size_t len, size_t *bytes_read, uint32_t timeout_ms){
+    (void)timeout_ms;
+    size_t frames = len / OPDI_AUDIO_FRAME_BYTES;
+    int64_t now = esp_timer_get_time();
+    if (s_mic_end_us < now - period_us(frames)) s_mic_end_us = now; // reader fell behind or was idle: drop the gap
+    s_mic_end_us += period_us(frames);
+    sleep_until(s_mic_end_us);
+    if (s_mic) s_mic((int16_t*)audio_buffer, frames, s_ctx);
+    else memset(audio_buffer, 0, frames * OPDI_AUDIO_FRAME_BYTES);
+    if (bytes_read) *bytes_read = frames * OPDI_AUDIO_FRAME_BYTES;
+    return ESP_OK;
+}
@@ -0,0 +1,8 @@
+// Host build (linux target): the bsp_extra codec calls the mixer and the duplex engine use, implemented
+// by opdi_audio_linux.c with the same signatures as bsp_board_extra.h
+#pragma once
+#include "opdi_audio.h"
+
+esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
+esp_err_t bsp_extra_i2s_read(void *audio_buffer, size_t len, size_t *bytes_read, uint32_t timeout_ms);
+esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
@@ -0,0 +1,41 @@
+// Mixing core: integer gain ramp + saturating sum (no RTOS dependencies)
+#include "opdi_audio.h"
+#include <string.h>
+
+static inline int16_t sat16(int32_t v, uint32_t *clipped){
+    if (v > INT16_MAX){ (*clipped)++; return INT16_MAX; }
+    if (v < INT16_MIN){ (*clipped)++; return INT16_MIN; }
+    return (int16_t)v;
+}
+
+uint32_t opdi_audio_mix_block(const opdi_audio_mix_input_t *in, size_t n_in, int16_t *out, size_t frames){
+    if (!out || !frames) return 0;
+    uint32_t clipped = 0;
+    for (size_t f=0; f<frames; f++){
+        int32_t acc_l = 0, acc_r = 0;
+        for (size_t i=0; i<n_in; i++){
+            const opdi_audio_mix_input_t *s = &in[i];
+            if (!s->pcm || f >= s->frames) continue;
+            // Linear ramp from gain_from to gain_to across the block (Q8)
+            int32_t g = (int32_t)s->gain_from + (((int32_t)s->gain_to - (int32_t)s->gain_from) * (int32_t)f) / (int32_t)frames;
+            if (g == 0) continue;
+            acc_l += ((int32_t)s->pcm[2*f]     * g) >> 8;
+            acc_r += ((int32_t)s->pcm[2*f + 1] * g) >> 8;
+        }
+        out[2*f]     = sat16(acc_l, &clipped);
+        out[2*f + 1] = sat16(acc_r, &clipped);
+    }
+    return clipped;
+}
+
+void opdi_audio_mix_target_gains(const uint8_t *prio, const bool *active, const uint8_t *gain_pct,
+                                 size_t n, uint8_t duck_pct, uint16_t *out_q8){
+    if (!prio || !active || !gain_pct || !out_q8) return;
+    int top = -1; // highest priority that currently produces audio
+    for (size_t i=0; i<n; i++){ if (active[i] && (int)prio[i] > top) top = prio[i]; }
+    for (size_t i=0; i<n; i++){
+        uint32_t g = ((uint32_t)gain_pct[i] * OPDI_AUDIO_GAIN_UNITY) / 100U;
+        if (top >= 0 && (int)prio[i] < top) g = (g * duck_pct) / 100U;
+        out_q8[i] = (uint16_t)g;
+    }
+}
@@ -0,0 +1,331 @@
+// PCM mixer service: N prioritized input rings -> single bsp_extra_i2s_write consumer
+#include "opdi_audio.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "opdi_audio_linux.h"
+#else
+#include "bsp_board_extra.h"
+#endif
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include <string.h>
+
+static const char *TAG = "opdi_audio";
+
+#ifndef CONFIG_OPDI_AUDIO_MIXER_STREAMS
+#define CONFIG_OPDI_AUDIO_MIXER_STREAMS 4
+#endif
+#ifndef CONFIG_OPDI_AUDIO_MIXER_BLOCK_FRAMES
+#define CONFIG_OPDI_AUDIO_MIXER_BLOCK_FRAMES 240
+#endif
+#ifndef CONFIG_OPDI_AUDIO_STREAM_BUF_MS
+#define CONFIG_OPDI_AUDIO_STREAM_BUF_MS 120
+#endif
+#ifndef CONFIG_OPDI_AUDIO_DUCK_PCT
+#define CONFIG_OPDI_AUDIO_DUCK_PCT 30
+#endif
+#ifndef CONFIG_OPDI_AUDIO_DEVICE_RATE
+#define CONFIG_OPDI_AUDIO_DEVICE_RATE 48000
+#endif
+#ifndef CONFIG_OPDI_AUDIO_MIXER_TASK_PRIO
+#define CONFIG_OPDI_AUDIO_MIXER_TASK_PRIO 6
+#endif
+
+#define MAX_STREAMS   CONFIG_OPDI_AUDIO_MIXER_STREAMS
+#define BLOCK_FRAMES  CONFIG_OPDI_AUDIO_MIXER_BLOCK_FRAMES
+#define BLOCK_BYTES   (BLOCK_FRAMES * OPDI_AUDIO_FRAME_BYTES)
+#define RING_BYTES    ((CONFIG_OPDI_AUDIO_DEVICE_RATE * CONFIG_OPDI_AUDIO_STREAM_BUF_MS / 1000) * OPDI_AUDIO_FRAME_BYTES)
+// Player input is converted in chunks; the output scratch covers the largest upsampling ratio (8 kHz files)
+#define PLAYER_CHUNK_FRAMES 256
+#define PLAYER_OUT_FRAMES   (PLAYER_CHUNK_FRAMES * (CONFIG_OPDI_AUDIO_DEVICE_RATE / 8000 + 1) + 2)
+
+typedef struct {
+    bool used;
+    uint8_t prio;
+    uint8_t gain_pct;
+    uint16_t gain_q8;     // gain reached at the end of the previous block (ramp start)
+    bool short_last;      // previous block was only partially filled
+    bool closing;         // released by the producer; slot freed once the ring drains
+    StreamBufferHandle_t rb;
+    const int16_t *clip;  // one-shot clip played straight from caller memory instead of the ring
+    size_t clip_frames, clip_pos;
+} mixer_stream_t;
+
+static mixer_stream_t s_streams[MAX_STREAMS];
+static SemaphoreHandle_t s_lock; // protects stream table open/close
+static TaskHandle_t s_task = NULL;
+static uint32_t s_rate = CONFIG_OPDI_AUDIO_DEVICE_RATE;
+static opdi_audio_mixer_stats_t s_stats;
+static opdi_audio_stream_t s_player_stream = -1;
+static opdi_audio_resampler_t s_player_rs;  // player task only (write + clk_set run on it)
+static int16_t s_player_out[PLAYER_OUT_FRAMES * OPDI_AUDIO_CHANNELS];
+static size_t s_player_pend_off, s_player_pend_len; // bytes of s_player_out not yet in the stream
+
+// Scratch buffers live in internal RAM: they are touched every block
+static int16_t s_scratch[MAX_STREAMS][BLOCK_FRAMES * OPDI_AUDIO_CHANNELS];
+static int16_t s_out[BLOCK_FRAMES * OPDI_AUDIO_CHANNELS];
+
+static bool stream_valid(opdi_audio_stream_t s){ return s >= 0 && s < MAX_STREAMS && s_streams[s].used && !s_streams[s].closing; }
+
+static void mix_one_block(void){
+    opdi_audio_mix_input_t in[MAX_STREAMS];
+    uint8_t prio[MAX_STREAMS], gain_pct[MAX_STREAMS]; bool active[MAX_STREAMS]; uint16_t target[MAX_STREAMS];
+    size_t n = 0; int idx[MAX_STREAMS];
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i=0;i<MAX_STREAMS;i++){
+        mixer_stream_t *st = &s_streams[i];
+        if (!st->used) continue;
+        size_t frames;
+        if (st->clip){
+            // Copy under the lock so a clip cancelled right after this block can be freed safely
+            frames = st->clip_frames - st->clip_pos; if (frames > BLOCK_FRAMES) frames = BLOCK_FRAMES;
+            memcpy(s_scratch[n], st->clip + st->clip_pos * OPDI_AUDIO_CHANNELS, frames * OPDI_AUDIO_FRAME_BYTES);
+            st->clip_pos += frames;
+            if (st->clip_pos >= st->clip_frames){ st->clip = NULL; st->used = false; st->closing = false; }
+            in[n].pcm = s_scratch[n]; in[n].frames = frames;
+            prio[n] = st->prio; gain_pct[n] = st->gain_pct; active[n] = frames > 0;
+            idx[n] = i; n++;
+            continue;
+        }
+        size_t got = xStreamBufferReceive(st->rb, s_scratch[n], BLOCK_BYTES, 0);
+        frames = got / OPDI_AUDIO_FRAME_BYTES;
+        // A gap in the middle of a sound (short block followed by more data) is an underrun;
+        // the short tail at the end of a sound is not.
+        if (frames && st->short_last) s_stats.underruns++;
+        st->short_last = frames > 0 && frames < BLOCK_FRAMES;
+        if (st->closing && xStreamBufferIsEmpty(st->rb)) { st->used = false; st->closing = false; }
+        in[n].pcm = s_scratch[n]; in[n].frames = frames;
+        prio[n] = st->prio; gain_pct[n] = st->gain_pct; active[n] = frames > 0;
+        idx[n] = i; n++;
+    }
+    opdi_audio_mix_target_gains(prio, active, gain_pct, n, CONFIG_OPDI_AUDIO_DUCK_PCT, target);
+    uint32_t act = 0;
+    for (size_t k=0;k<n;k++){
+        mixer_stream_t *st = &s_streams[idx[k]];
+        in[k].gain_from = active[k] ? st->gain_q8 : target[k];
+        in[k].gain_to = target[k];
+        st->gain_q8 = target[k];
+        if (active[k]) act++;
+    }
+    xSemaphoreGive(s_lock);
+    s_stats.clipped_samples += opdi_audio_mix_block(in, n, s_out, BLOCK_FRAMES);
+    s_stats.active_streams = act;
+    size_t written = 0;
+    if (bsp_extra_i2s_write(s_out, BLOCK_BYTES, &written, portMAX_DELAY) == ESP_OK) s_stats.blocks++;
+}
+
+static bool any_stream_data(bool *full_block){
+    bool any = false; *full_block = false;
+    for (int i=0;i<MAX_STREAMS;i++){
+        if (!s_streams[i].used) continue;
+        size_t avail = s_streams[i].clip ? (s_streams[i].clip_frames - s_streams[i].clip_pos) * OPDI_AUDIO_FRAME_BYTES
+                                         : xStreamBufferBytesAvailable(s_streams[i].rb);
+        if (avail) any = true;
+        if (avail >= BLOCK_BYTES) *full_block = true;
+    }
+    return any;
+}
+
+static void mixer_task(void *arg){
+    (void)arg;
+    while (1){
+        bool full = false;
+        if (!any_stream_data(&full)){
+            // Idle: nothing queued, I2S is left alone until a producer wakes us
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (!full){
+            // Only partial data: give producers one block period to top up before flushing the tail
+            TickType_t block_ticks = pdMS_TO_TICKS((BLOCK_FRAMES * 1000U) / s_rate);
+            if (block_ticks == 0) block_ticks = 1;
+            if (ulTaskNotifyTake(pdTRUE, block_ticks) > 0 && any_stream_data(&full) && !full) {
+                continue;
+            }
+        }
+        mix_one_block();
+    }
+}
+
+esp_err_t opdi_audio_mixer_init(void){
+    if (s_task) return ESP_OK;
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    memset(s_streams, 0, sizeof(s_streams));
+    memset(&s_stats, 0, sizeof(s_stats));
+    // The codec is set to one fixed rate for the lifetime of the mixer; sources are converted to it
+    s_rate = CONFIG_OPDI_AUDIO_DEVICE_RATE;
+    esp_err_t fs = bsp_extra_codec_set_fs(s_rate, 16, I2S_SLOT_MODE_STEREO);
+    if (fs != ESP_OK){ ESP_LOGE(TAG, "codec set %u Hz failed: %s", (unsigned)s_rate, esp_err_to_name(fs)); return fs; }
+    if (opdi_audio_resampler_init(&s_player_rs, s_rate, s_rate) != ESP_OK) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(mixer_task, "audio_mix", 4096, NULL, CONFIG_OPDI_AUDIO_MIXER_TASK_PRIO, &s_task) != pdPASS){
+        ESP_LOGE(TAG, "mixer task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "mixer ready (%d streams, block=%d frames, ring=%u bytes)", MAX_STREAMS, BLOCK_FRAMES, (unsigned)RING_BYTES);
+    return ESP_OK;
+}
+
+bool opdi_audio_mixer_ready(void){ return s_task != NULL; }
+
+uint32_t opdi_audio_mixer_rate(void){ return s_rate; }
+
+esp_err_t opdi_audio_mixer_play_clip(const int16_t *pcm, size_t frames, opdi_audio_prio_t prio){
+    if (!pcm || !frames) return ESP_ERR_INVALID_ARG;
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    esp_err_t r = ESP_ERR_NO_MEM;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i=0;i<MAX_STREAMS;i++){
+        mixer_stream_t *st = &s_streams[i];
+        if (st->used) continue;
+        // Owned by the mixer from the start (closing): no producer handle is handed out
+        st->used = true; st->closing = true; st->prio = (uint8_t)prio; st->gain_pct = 100;
+        st->gain_q8 = OPDI_AUDIO_GAIN_UNITY; st->short_last = false;
+        st->clip = pcm; st->clip_frames = frames; st->clip_pos = 0;
+        r = ESP_OK;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    if (r == ESP_OK) xTaskNotifyGive(s_task);
+    else ESP_LOGW(TAG, "no free mixer stream for clip (prio=%d)", (int)prio);
+    return r;
+}
+
+void opdi_audio_mixer_cancel_clips(void){
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i=0;i<MAX_STREAMS;i++){
+        mixer_stream_t *st = &s_streams[i];
+        if (st->used && st->clip){ st->clip = NULL; st->used = false; st->closing = false; }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t opdi_audio_stream_open(opdi_audio_prio_t prio, opdi_audio_stream_t *out){
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    *out = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i=0;i<MAX_STREAMS;i++){
+        mixer_stream_t *st = &s_streams[i];
+        if (st->used) continue;
+        st->clip = NULL;
+        if (!st->rb){
+#if CONFIG_OPDI_AUDIO_BUFFERS_IN_PSRAM
+            st->rb = xStreamBufferCreateWithCaps(RING_BYTES, OPDI_AUDIO_FRAME_BYTES, MALLOC_CAP_SPIRAM);
+#else
+            st->rb = xStreamBufferCreate(RING_BYTES, OPDI_AUDIO_FRAME_BYTES);
+#endif
+            if (!st->rb){ xSemaphoreGive(s_lock); return ESP_ERR_NO_MEM; }
+        } else {
+            xStreamBufferReset(st->rb);
+        }
+        st->used = true; st->closing = false; st->prio = (uint8_t)prio; st->gain_pct = 100;
+        st->gain_q8 = OPDI_AUDIO_GAIN_UNITY; st->short_last = false;
+        *out = i;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    if (*out < 0){ ESP_LOGW(TAG, "no free mixer stream (prio=%d)", (int)prio); return ESP_ERR_NO_MEM; }
+    ESP_LOGD(TAG, "stream %d open prio=%d", *out, (int)prio);
+    return ESP_OK;
+}
+
+esp_err_t opdi_audio_stream_close(opdi_audio_stream_t s){
+    if (!stream_valid(s)) return ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Queued audio still plays out; the mixer frees the slot (ring kept for reuse) once drained
+    if (xStreamBufferIsEmpty(s_streams[s].rb)) s_streams[s].used = false;
+    else s_streams[s].closing = true;
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+size_t opdi_audio_stream_write(opdi_audio_stream_t s, const void *pcm, size_t len, uint32_t timeout_ms){
+    if (!stream_valid(s) || !pcm) return 0;
+    len -= len % OPDI_AUDIO_FRAME_BYTES; // keep the ring frame aligned
+    const uint8_t *p = (const uint8_t*)pcm; size_t done = 0;
+    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    while (done < len){
+        size_t chunk = len - done; if (chunk > BLOCK_BYTES) chunk = BLOCK_BYTES;
+        size_t n = xStreamBufferSend(s_streams[s].rb, p + done, chunk, ticks);
+        done += n;
+        xTaskNotifyGive(s_task);
+        if (n < chunk) break; // timed out
+    }
+    return done;
+}
+
+void opdi_audio_stream_set_gain(opdi_audio_stream_t s, uint8_t gain_pct){
+    if (!stream_valid(s)) return;
+    // Under the table lock: mix_one_block reads gain_pct while it computes the block's ramp
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_streams[s].gain_pct = gain_pct > 100 ? 100 : gain_pct;
+    xSemaphoreGive(s_lock);
+}
+
+void opdi_audio_stream_flush(opdi_audio_stream_t s){
+    if (!stream_valid(s)) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    xStreamBufferReset(s_streams[s].rb);
+    s_streams[s].short_last = false;
+    xSemaphoreGive(s_lock);
+}
+
+void opdi_audio_mixer_get_stats(opdi_audio_mixer_stats_t *out){
+    if (!out) return;
+    *out = s_stats;
+    out->sample_rate = s_rate;
+    out->latency_ms = (uint32_t)(((uint64_t)(RING_BYTES / OPDI_AUDIO_FRAME_BYTES) + BLOCK_FRAMES) * 1000ULL / s_rate);
+}
+
+// --- audio_player adapters ---
+// Send what is left of the last resampled block; true once all of it is in the stream
+static bool player_flush(uint32_t timeout_ms){
+    if (!s_player_pend_len) return true;
+    size_t w = opdi_audio_stream_write(s_player_stream, (const uint8_t*)s_player_out + s_player_pend_off, s_player_pend_len, timeout_ms);
+    s_player_pend_off += w; s_player_pend_len -= w;
+    return s_player_pend_len == 0;
+}
+
+// The resampler keeps state, so input it has consumed cannot be handed back: when the stream is full,
+// the unsent output of that block waits in s_player_out and goes first on the next call, and the
+// input is reported consumed. bytes_written thus always matches what reached (or is held for) the mixer.
+esp_err_t opdi_audio_player_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms){
+    if (bytes_written) *bytes_written = 0;
+    if (s_player_stream < 0 && opdi_audio_stream_open(OPDI_AUDIO_PRIO_MUSIC, &s_player_stream) != ESP_OK){
+        return ESP_FAIL;
+    }
+    if (!player_flush(timeout_ms)) return ESP_ERR_TIMEOUT; // still backed up: nothing consumed
+    const int16_t *in = (const int16_t*)audio_buffer;
+    size_t frames = len / OPDI_AUDIO_FRAME_BYTES, done = 0;
+    bool sent = true;
+    while (sent && done < frames){
+        size_t n = frames - done; if (n > PLAYER_CHUNK_FRAMES) n = PLAYER_CHUNK_FRAMES;
+        size_t out = opdi_audio_resampler_process(&s_player_rs, in + done * OPDI_AUDIO_CHANNELS, n, s_player_out, PLAYER_OUT_FRAMES);
+        opdi_audio_spectrum_feed(s_player_out, out);
+        done += n;
+        s_player_pend_off = 0; s_player_pend_len = out * OPDI_AUDIO_FRAME_BYTES;
+        sent = player_flush(timeout_ms);
+    }
+    if (bytes_written) *bytes_written = (done == frames) ? len : done * OPDI_AUDIO_FRAME_BYTES;
+    return (done == frames) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t opdi_audio_player_clk_set(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch){
+    if (bits_cfg != 16){
+        ESP_LOGW(TAG, "player format %u-bit not supported by mixer", (unsigned)bits_cfg);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    (void)ch; // audio_player expands mono to stereo before writing
+    // The codec stays at the device rate: only the player's converter changes, so track
+    // changes no longer stop I2S or reprogram the ES8311.
+    esp_err_t r = opdi_audio_resampler_init(&s_player_rs, rate, s_rate);
+    if (r == ESP_OK) ESP_LOGI(TAG, "player %u Hz -> device %u Hz (L/M=%u/%u)", (unsigned)rate, (unsigned)s_rate, s_player_rs.L, s_player_rs.M);
+    else ESP_LOGW(TAG, "no converter for %u Hz: %s", (unsigned)rate, esp_err_to_name(r));
+    return r;
+}
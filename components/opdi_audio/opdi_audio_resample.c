@@ -0,0 +1,95 @@
+// Polyphase rational resampler (L/M) for 16-bit stereo; Q15 coefficients, int32 accumulate
+#include "opdi_audio.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAPS OPDI_AUDIO_RESAMPLE_TAPS
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b){ while (b){ uint32_t t = a % b; a = b; b = t; } return a; }
+
+static inline int16_t sat16(int32_t v){ return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v); }
+
+// Windowed-sinc prototype of L*TAPS taps, split into L phases of TAPS taps each.
+// Every phase is normalized to unity DC gain so a constant input stays exactly constant.
+static void design(int16_t *coef, uint32_t L, uint32_t M){
+    const uint32_t n = L * TAPS;
+    const double fc = 0.5 * 0.92 / (double)(L > M ? L : M); // cutoff relative to the upsampled rate
+    const double mid = (double)(n - 1) / 2.0;
+    for (uint32_t p=0; p<L; p++){
+        double h[TAPS], sum = 0;
+        for (uint32_t k=0; k<TAPS; k++){
+            double i = (double)(p + k * L), x = i - mid;
+            double sinc = (fabs(x) < 1e-9) ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+            double w = 0.35875 - 0.48829 * cos(2.0 * M_PI * i / (n - 1)) + 0.14128 * cos(4.0 * M_PI * i / (n - 1))
+                     - 0.01168 * cos(6.0 * M_PI * i / (n - 1)); // Blackman-Harris
+            h[k] = sinc * w; sum += h[k];
+        }
+        for (uint32_t k=0; k<TAPS; k++) coef[p * TAPS + k] = (int16_t)lrint(h[k] / sum * 32767.0);
+    }
+}
+
+esp_err_t opdi_audio_resampler_init(opdi_audio_resampler_t *r, uint32_t in_rate, uint32_t out_rate){
+    if (!r || !in_rate || !out_rate) return ESP_ERR_INVALID_ARG;
+    uint32_t g = gcd_u32(in_rate, out_rate);
+    uint32_t L = out_rate / g, M = in_rate / g;
+    if (L > OPDI_AUDIO_RESAMPLE_MAX_L || M > 0xFFFF) return ESP_ERR_NOT_SUPPORTED;
+    if (r->coef && r->L == L && r->M == M){ opdi_audio_resampler_reset(r); return ESP_OK; } // same ratio: keep filter
+    opdi_audio_resampler_deinit(r);
+    r->in_rate = in_rate; r->out_rate = out_rate; r->L = (uint16_t)L; r->M = (uint16_t)M;
+    if (L != M){
+        r->coef = malloc((size_t)L * TAPS * sizeof(int16_t));
+        if (!r->coef) return ESP_ERR_NO_MEM;
+        design(r->coef, L, M);
+    }
+    opdi_audio_resampler_reset(r);
+    return ESP_OK;
+}
+
+void opdi_audio_resampler_deinit(opdi_audio_resampler_t *r){
+    if (!r) return;
+    free(r->coef);
+    memset(r, 0, sizeof(*r));
+}
+
+void opdi_audio_resampler_reset(opdi_audio_resampler_t *r){
+    memset(r->hist, 0, sizeof(r->hist));
+    r->pos = 0; r->phase = 0;
+}
+
+size_t opdi_audio_resampler_max_out(const opdi_audio_resampler_t *r, size_t in_frames){
+    if (!r->L || r->L == r->M) return in_frames;
+    return (in_frames * r->L + r->M - 1) / r->M + 1;
+}
+
+size_t opdi_audio_resampler_process(opdi_audio_resampler_t *r, const int16_t *in, size_t in_frames, int16_t *out, size_t out_cap){
+    if (!r->L) return 0;
+    if (r->L == r->M){ // same rate
+        size_t n = in_frames < out_cap ? in_frames : out_cap;
+        memcpy(out, in, n * OPDI_AUDIO_FRAME_BYTES);
+        return n;
+    }
+    const uint32_t L = r->L, M = r->M;
+    uint32_t phase = r->phase, pos = r->pos;
+    size_t o = 0;
+    for (size_t i=0; i<in_frames; i++){
+        // History is mirrored (pos and pos+TAPS) so the newest TAPS samples are always contiguous
+        pos = (pos + 1) % TAPS;
+        r->hist[0][pos] = r->hist[0][pos + TAPS] = in[2*i];
+        r->hist[1][pos] = r->hist[1][pos + TAPS] = in[2*i + 1];
+        const int16_t *xl = &r->hist[0][pos + TAPS], *xr = &r->hist[1][pos + TAPS]; // newest sample
+        while (phase < L){
+            if (o >= out_cap) goto done;
+            const int16_t *h = &r->coef[phase * TAPS];
+            int32_t al = 1 << 14, ar = 1 << 14; // rounding
+            for (int k=0; k<TAPS; k++){ al += (int32_t)h[k] * xl[-k]; ar += (int32_t)h[k] * xr[-k]; }
+            out[2*o] = sat16(al >> 15); out[2*o + 1] = sat16(ar >> 15);
+            o++;
+            phase += M;
+        }
+        phase -= L;
+    }
+done:
+    r->phase = phase; r->pos = pos;
+    return o;
+}
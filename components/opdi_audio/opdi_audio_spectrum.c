@@ -0,0 +1,127 @@
+// Real-time spectrum: tap of the player output + radix-4 fixed-point FFT -> 4 display bands
+#include "opdi_audio.h"
+#include <math.h>
+#include <string.h>
+
+#define N OPDI_AUDIO_SPECTRUM_FFT_N
+
+// Twiddles exp(-2*pi*i*k/N), Q15, and a Hann window; built once on first use
+static int16_t s_cos[N], s_sin[N], s_win[N];
+static bool s_tables;
+
+static void build_tables(void){
+    for (int k=0; k<N; k++){
+        double a = 2.0 * M_PI * k / N;
+        s_cos[k] = (int16_t)lrint(cos(a) * 32767.0);
+        s_sin[k] = (int16_t)lrint(-sin(a) * 32767.0);
+        s_win[k] = (int16_t)lrint((0.5 - 0.5 * cos(a)) * 32767.0);
+    }
+    s_tables = true;
+}
+
+static inline void cmul(int32_t *re, int32_t *im, int16_t c, int16_t s){
+    int64_t r = (int64_t)*re * c - (int64_t)*im * s;
+    int64_t i = (int64_t)*re * s + (int64_t)*im * c;
+    *re = (int32_t)(r >> 15); *im = (int32_t)(i >> 15);
+}
+
+// In-place radix-4 decimation-in-frequency FFT, n = 4^k <= N. Each stage scales by 1/4 so the
+// result is X[k]/n and never overflows for 16-bit input. Output is returned in natural order.
+void opdi_audio_fft_r4(int32_t *re, int32_t *im, size_t n){
+    if (!s_tables) build_tables();
+    const size_t tw_step0 = N / n;
+    for (size_t len = n; len >= 4; len >>= 2){
+        size_t q = len >> 2, step = (n / len) * tw_step0;
+        for (size_t base = 0; base < n; base += len){
+            for (size_t j = 0; j < q; j++){
+                size_t i0 = base + j, i1 = i0 + q, i2 = i1 + q, i3 = i2 + q;
+                int32_t b0r = re[i0] + re[i2], b0i = im[i0] + im[i2];
+                int32_t b1r = re[i0] - re[i2], b1i = im[i0] - im[i2];
+                int32_t b2r = re[i1] + re[i3], b2i = im[i1] + im[i3];
+                int32_t b3r = re[i1] - re[i3], b3i = im[i1] - im[i3];
+                re[i0] = (b0r + b2r) >> 2;  im[i0] = (b0i + b2i) >> 2;
+                int32_t y2r = (b0r - b2r) >> 2, y2i = (b0i - b2i) >> 2;
+                int32_t y1r = (b1r + b3i) >> 2, y1i = (b1i - b3r) >> 2; // b1 - j*b3
+                int32_t y3r = (b1r - b3i) >> 2, y3i = (b1i + b3r) >> 2; // b1 + j*b3
+                size_t t = j * step;
+                if (t){
+                    cmul(&y1r, &y1i, s_cos[t], s_sin[t]);
+                    cmul(&y2r, &y2i, s_cos[2*t], s_sin[2*t]);
+                    cmul(&y3r, &y3i, s_cos[3*t], s_sin[3*t]);
+                }
+                re[i1] = y1r; im[i1] = y1i;
+                re[i2] = y2r; im[i2] = y2i;
+                re[i3] = y3r; im[i3] = y3i;
+            }
+        }
+    }
+    // Base-4 digit reversal
+    int digits = 0; for (size_t m = n; m > 1; m >>= 2) digits++;
+    for (size_t i=0; i<n; i++){
+        size_t r = 0, v = i;
+        for (int d=0; d<digits; d++){ r = (r << 2) | (v & 3); v >>= 2; }
+        if (r > i){
+            int32_t t = re[i]; re[i] = re[r]; re[r] = t;
+            t = im[i]; im[i] = im[r]; im[r] = t;
+        }
+    }
+}
+
+// log2 with 2 fractional bits (0 for x < 1)
+static int32_t log2_q2(uint64_t x){
+    if (!x) return 0;
+    int msb = 63 - __builtin_clzll(x);
+    uint32_t frac = msb >= 2 ? (uint32_t)((x >> (msb - 2)) & 3) : (uint32_t)((x << (2 - msb)) & 3);
+    return msb * 4 + (int32_t)frac;
+}
+
+// Band edges (Hz) matching the music demo's four lanes: bass, low-mid, high-mid, treble
+static const uint16_t s_edges[OPDI_AUDIO_SPECTRUM_BANDS + 1] = { 40, 250, 2000, 6000, 16000 };
+
+void opdi_audio_spectrum_compute(const int16_t *mono, uint32_t rate, uint16_t bands[OPDI_AUDIO_SPECTRUM_BANDS]){
+    static int32_t re[N], im[N];
+    if (!s_tables) build_tables();
+    for (int i=0; i<N; i++){ re[i] = ((int32_t)mono[i] * s_win[i]) >> 15; im[i] = 0; }
+    opdi_audio_fft_r4(re, im, N);
+    for (int b=0; b<OPDI_AUDIO_SPECTRUM_BANDS; b++){
+        uint32_t k0 = (uint32_t)s_edges[b] * N / rate, k1 = (uint32_t)s_edges[b+1] * N / rate;
+        if (k0 < 1) k0 = 1;
+        if (k1 > N / 2) k1 = N / 2;
+        if (k1 <= k0) k1 = k0 + 1;
+        uint64_t p = 0;
+        for (uint32_t k=k0; k<k1; k++) p += (uint64_t)((int64_t)re[k] * re[k] + (int64_t)im[k] * im[k]);
+        // Log scale, 0.75 dB per step: a full-scale tone lands near 80, the range of the old demo tables
+        int32_t lvl = (log2_q2(p) - OPDI_AUDIO_SPECTRUM_FLOOR_Q2);
+        bands[b] = (uint16_t)(lvl < 0 ? 0 : (lvl > 80 ? 80 : lvl));
+    }
+}
+
+// --- Tap: single writer (player task), single reader (UI timer) ---
+static int16_t s_tap[N];
+static volatile uint32_t s_tap_w;     // frames written since start
+static uint32_t s_tap_seen;           // reader: s_tap_w at last poll
+static uint16_t s_levels[OPDI_AUDIO_SPECTRUM_BANDS];
+
+void opdi_audio_spectrum_feed(const int16_t *stereo, size_t frames){
+    uint32_t w = s_tap_w;
+    for (size_t f=0; f<frames; f++) s_tap[(w + f) % N] = (int16_t)(((int32_t)stereo[2*f] + stereo[2*f + 1]) >> 1);
+    s_tap_w = w + (uint32_t)frames;
+}
+
+void opdi_audio_spectrum_poll(uint16_t bands[OPDI_AUDIO_SPECTRUM_BANDS]){
+    static int16_t win[N];
+    uint16_t now[OPDI_AUDIO_SPECTRUM_BANDS] = { 0 };
+    uint32_t w = s_tap_w;
+    if (w != s_tap_seen){
+        // Latest N samples, oldest first (a concurrent write may tear a few samples; harmless for display)
+        for (int i=0; i<N; i++) win[i] = s_tap[(w + i) % N];
+        opdi_audio_spectrum_compute(win, opdi_audio_mixer_rate(), now);
+        s_tap_seen = w;
+    }
+    // Instant attack, gradual release so bars fall smoothly (and to zero when playback stops)
+    for (int b=0; b<OPDI_AUDIO_SPECTRUM_BANDS; b++){
+        uint16_t fall = s_levels[b] > 4 ? s_levels[b] - 4 : 0;
+        s_levels[b] = now[b] > fall ? now[b] : fall;
+        bands[b] = s_levels[b];
+    }
+}
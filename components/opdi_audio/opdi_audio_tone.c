@@ -0,0 +1,59 @@
+// Tone synthesis core: integer table oscillator (no RTOS or libm dependencies)
+#include "opdi_audio.h"
+
+#define RAMP_MS 4 // attack/release per segment, avoids clicks at segment edges
+
+// One full sine period, Q15 (256 entries; generated offline so boot never touches libm)
+static const int16_t s_sine[256] = {
+         0,    804,   1608,   2410,   3212,   4011,   4808,   5602,   6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+     12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,  18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+     23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,  27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+     30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,  32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+     32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,  32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+     30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,  27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+     23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,  18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+     12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,   6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+         0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,  -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+    -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790, -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+    -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+    -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683, -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+    -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,  -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+};
+
+size_t opdi_audio_tone_render(const opdi_audio_tone_seg_t *segs, size_t n, uint32_t rate, int16_t *out, size_t max_frames){
+    if (!segs || !rate) return 0;
+    size_t total = 0;
+    for (size_t i=0;i<n;i++) total += (size_t)segs[i].dur_ms * rate / 1000U;
+    if (!out) return total;
+    if (total > max_frames) total = max_frames;
+    size_t pos = 0;
+    for (size_t i=0;i<n && pos<total;i++){
+        const opdi_audio_tone_seg_t *sg = &segs[i];
+        size_t len = (size_t)sg->dur_ms * rate / 1000U; if (len > total - pos) len = total - pos;
+        size_t ramp = (size_t)RAMP_MS * rate / 1000U; if (ramp * 2 > len) ramp = len / 2;
+        int32_t amp = (int32_t)(sg->level_pct > 100 ? 100 : sg->level_pct) * 32767 / 100;
+        // 32-bit phase accumulator: top 8 bits index the table, next 8 bits interpolate
+        uint32_t phase = 0, inc = (uint32_t)(((uint64_t)sg->freq_hz << 32) / rate);
+        for (size_t f=0; f<len; f++){
+            int32_t v = 0;
+            if (sg->freq_hz){
+                uint32_t idx = phase >> 24, frac = (phase >> 16) & 0xFF;
+                int32_t a = s_sine[idx], b = s_sine[(idx + 1) & 0xFF];
+                v = a + (((b - a) * (int32_t)frac) >> 8);
+                int32_t env = amp;
+                if (ramp){
+                    if (f < ramp) env = (int32_t)((int64_t)amp * (int64_t)f / (int64_t)ramp);
+                    else if (f >= len - ramp) env = (int32_t)((int64_t)amp * (int64_t)(len - 1 - f) / (int64_t)ramp);
+                }
+                v = (v * env) >> 15;
+                phase += inc;
+            }
+            out[2*(pos+f)] = (int16_t)v; out[2*(pos+f) + 1] = (int16_t)v;
+        }
+        pos += len;
+    }
+    return total;
+}
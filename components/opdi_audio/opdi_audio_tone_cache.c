@@ -0,0 +1,143 @@
+// Tone / earcon cache: tones rendered once into PSRAM, played as zero-copy mixer clips
+#include "opdi_audio.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "opdi_audio_linux.h"
+#else
+#include "bsp_board_extra.h"
+#endif
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "opdi_tone";
+
+#ifndef CONFIG_OPDI_AUDIO_TONE_DIR
+#define CONFIG_OPDI_AUDIO_TONE_DIR "/spiffs/tones"
+#endif
+// The boot earcon is the app's startup beep (main/Kconfig.projbuild), so it is rendered once, as configured
+#ifndef CONFIG_OPDI_AUDIO_DEVICE_RATE
+#define CONFIG_OPDI_AUDIO_DEVICE_RATE 48000
+#endif
+#ifndef CONFIG_EXAMPLE_STARTUP_BEEP_FREQ
+#define CONFIG_EXAMPLE_STARTUP_BEEP_FREQ 440
+#endif
+#ifndef CONFIG_EXAMPLE_STARTUP_BEEP_DURATION_MS
+#define CONFIG_EXAMPLE_STARTUP_BEEP_DURATION_MS 120
+#endif
+
+typedef struct {
+    opdi_audio_tone_seg_t segs[OPDI_AUDIO_TONE_MAX_SEGS];
+    uint8_t nseg;
+    int16_t *pcm;    // PSRAM, rendered at s_cache_rate
+    size_t frames;
+} tone_slot_t;
+
+static const char *s_names[OPDI_AUDIO_TONE_COUNT] = { "startup", "notify", "ok", "error" };
+static tone_slot_t s_tones[OPDI_AUDIO_TONE_COUNT] = {
+    [OPDI_AUDIO_TONE_STARTUP] = { .segs = { { CONFIG_EXAMPLE_STARTUP_BEEP_FREQ, CONFIG_EXAMPLE_STARTUP_BEEP_DURATION_MS, 25 } }, .nseg = 1 },
+    [OPDI_AUDIO_TONE_NOTIFY]  = { .segs = { { 880, 60, 25 }, { 0, 30, 0 }, { 880, 60, 25 } }, .nseg = 3 },
+    [OPDI_AUDIO_TONE_OK]      = { .segs = { { 660, 70, 25 }, { 990, 90, 25 } }, .nseg = 2 },
+    [OPDI_AUDIO_TONE_ERROR]   = { .segs = { { 330, 120, 30 }, { 220, 180, 30 } }, .nseg = 2 },
+};
+static uint32_t s_cache_rate = 0;
+static SemaphoreHandle_t s_tone_lock;
+
+// Pre-rendered PCM override: <dir>/<name>_<rate>.pcm, raw 16-bit stereo at the device rate
+static bool load_from_fs(opdi_audio_tone_id_t id, uint32_t rate){
+    char path[96];
+    snprintf(path, sizeof(path), "%s/%s_%u.pcm", CONFIG_OPDI_AUDIO_TONE_DIR, s_names[id], (unsigned)rate);
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END); long sz = ftell(f); fseek(f, 0, SEEK_SET);
+    size_t frames = sz > 0 ? (size_t)sz / OPDI_AUDIO_FRAME_BYTES : 0;
+    int16_t *pcm = frames ? heap_caps_malloc(frames * OPDI_AUDIO_FRAME_BYTES, MALLOC_CAP_SPIRAM) : NULL;
+    bool ok = pcm && fread(pcm, OPDI_AUDIO_FRAME_BYTES, frames, f) == frames;
+    fclose(f);
+    if (!ok){ free(pcm); return false; }
+    s_tones[id].pcm = pcm; s_tones[id].frames = frames;
+    ESP_LOGI(TAG, "tone %s loaded from %s (%u frames)", s_names[id], path, (unsigned)frames);
+    return true;
+}
+
+static esp_err_t render_one(opdi_audio_tone_id_t id, uint32_t rate){
+    tone_slot_t *t = &s_tones[id];
+    free(t->pcm); t->pcm = NULL; t->frames = 0;
+    if (load_from_fs(id, rate)) return ESP_OK;
+    size_t frames = opdi_audio_tone_render(t->segs, t->nseg, rate, NULL, 0);
+    if (!frames) return ESP_OK; // empty definition = silent tone
+    t->pcm = heap_caps_malloc(frames * OPDI_AUDIO_FRAME_BYTES, MALLOC_CAP_SPIRAM);
+    if (!t->pcm) return ESP_ERR_NO_MEM;
+    t->frames = opdi_audio_tone_render(t->segs, t->nseg, rate, t->pcm, frames);
+    return ESP_OK;
+}
+
+// Caller holds s_tone_lock. Clips in flight reference the old buffers, so stop them first.
+static esp_err_t render_all(uint32_t rate){
+    opdi_audio_mixer_cancel_clips();
+    esp_err_t r = ESP_OK;
+    for (int i=0;i<OPDI_AUDIO_TONE_COUNT;i++){ esp_err_t e = render_one((opdi_audio_tone_id_t)i, rate); if (e != ESP_OK) r = e; }
+    s_cache_rate = rate;
+    return r;
+}
+
+// Renders every tone at the mixer rate, which is fixed once the mixer runs: a play never synthesizes, so the
+// first earcon after boot costs the same as any other
+esp_err_t opdi_audio_tone_cache_init(void){
+    if (!opdi_audio_mixer_ready()) return ESP_ERR_INVALID_STATE;
+    if (!s_tone_lock) s_tone_lock = xSemaphoreCreateMutex();
+    if (!s_tone_lock) return ESP_ERR_NO_MEM;
+    xSemaphoreTake(s_tone_lock, portMAX_DELAY);
+    esp_err_t r = ESP_OK;
+    if (s_cache_rate != opdi_audio_mixer_rate()){
+        r = render_all(opdi_audio_mixer_rate());
+        size_t bytes = 0; for (int i=0;i<OPDI_AUDIO_TONE_COUNT;i++) bytes += s_tones[i].frames * OPDI_AUDIO_FRAME_BYTES;
+        ESP_LOGI(TAG, "tone cache rendered (%d tones, %u bytes PSRAM, %u Hz)", OPDI_AUDIO_TONE_COUNT, (unsigned)bytes, (unsigned)s_cache_rate);
+    }
+    xSemaphoreGive(s_tone_lock);
+    return r;
+}
+
+esp_err_t opdi_audio_tone_define(opdi_audio_tone_id_t id, const opdi_audio_tone_seg_t *segs, size_t n){
+    if (id >= OPDI_AUDIO_TONE_COUNT || (n && !segs) || n > OPDI_AUDIO_TONE_MAX_SEGS) return ESP_ERR_INVALID_ARG;
+    if (!s_tone_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_tone_lock, portMAX_DELAY);
+    opdi_audio_mixer_cancel_clips();
+    if (n) memcpy(s_tones[id].segs, segs, n * sizeof(*segs)); // n == 0: silent tone, segs may be NULL
+    s_tones[id].nseg = (uint8_t)n;
+    esp_err_t r = s_cache_rate ? render_one(id, s_cache_rate) : ESP_OK;
+    xSemaphoreGive(s_tone_lock);
+    return r;
+}
+
+esp_err_t opdi_audio_tone_play(opdi_audio_tone_id_t id, opdi_audio_prio_t prio){
+    if (id >= OPDI_AUDIO_TONE_COUNT) return ESP_ERR_INVALID_ARG;
+    if (!s_tone_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_tone_lock, portMAX_DELAY);
+    // Pointer hand-off only; a tone missing here failed to render at init/define or is defined empty
+    esp_err_t r = s_tones[id].pcm ? opdi_audio_mixer_play_clip(s_tones[id].pcm, s_tones[id].frames, prio) : ESP_ERR_NOT_FOUND;
+    xSemaphoreGive(s_tone_lock);
+    return r;
+}
+
+// No mixer (its init failed): render into a scratch buffer at the device rate and write it to I2S here.
+// The caller's task blocks for the tone's length; nothing else may write to I2S meanwhile.
+esp_err_t opdi_audio_tone_play_direct(opdi_audio_tone_id_t id){
+    if (id >= OPDI_AUDIO_TONE_COUNT) return ESP_ERR_INVALID_ARG;
+    if (opdi_audio_mixer_ready()) return ESP_ERR_INVALID_STATE; // the mixer owns I2S: opdi_audio_tone_play()
+    const tone_slot_t *t = &s_tones[id];
+    const uint32_t rate = CONFIG_OPDI_AUDIO_DEVICE_RATE;
+    size_t frames = opdi_audio_tone_render(t->segs, t->nseg, rate, NULL, 0);
+    if (!frames) return ESP_ERR_NOT_FOUND;
+    int16_t *pcm = heap_caps_malloc(frames * OPDI_AUDIO_FRAME_BYTES, MALLOC_CAP_SPIRAM);
+    if (!pcm) return ESP_ERR_NO_MEM;
+    frames = opdi_audio_tone_render(t->segs, t->nseg, rate, pcm, frames);
+    esp_err_t r = bsp_extra_codec_set_fs(rate, 16, I2S_SLOT_MODE_STEREO);
+    size_t written = 0;
+    if (r == ESP_OK) r = bsp_extra_i2s_write(pcm, frames * OPDI_AUDIO_FRAME_BYTES, &written, portMAX_DELAY);
+    free(pcm);
+    return r;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "opdi_api_json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Detection benchmark: replays a directory of raw RGB565 frames (*.rgb565, width*height*2 bytes,
+// little-endian, name order) through a detector and reports FPS, per-stage latency percentiles,
+// peak heap/PSRAM and detection counts as one JSON document, so runs can be diffed.
+
+typedef enum {
+    OPDI_BENCH_STAGE_READ = 0,   // file -> PSRAM frame buffer
+    OPDI_BENCH_STAGE_DETECT,     // detector run: pre-process, inference, post-process
+    OPDI_BENCH_STAGE_RECOG,      // optional per-frame follow-up (face recognition), reported by the callback
+    OPDI_BENCH_STAGE_TOTAL,      // read + detector callback
+    OPDI_BENCH_STAGE_MAX,
+} opdi_bench_stage_t;
+
+// Run one frame. Returns the number of detections, or < 0 on failure (the run stops).
+// The callback may put the time of its follow-up work in recog_us; the rest of its wall time is
+// counted as DETECT.
+typedef int (*opdi_bench_detect_fn)(void *ctx, const uint16_t *rgb565, int width, int height, uint32_t *recog_us);
+
+typedef struct {
+    const char *name;           // "humanface", "pedestrian", ...
+    opdi_bench_detect_fn detect;
+    void *ctx;
+    uint32_t load_ms;           // model load time, reported as is (0: unknown)
+    size_t resident_bytes;      // model PSRAM footprint, reported as is (0: unknown)
+} opdi_bench_model_t;
+
+typedef struct {
+    const char *dir;            // directory with the *.rgb565 frames
+    int width, height;          // every frame; files of another size are skipped
+    int repeat;                 // passes over the directory (>= 1)
+    int max_frames;             // timed frames, 0: CONFIG_OPDI_BENCH_MAX_FRAMES
+    int warmup;                 // < 0: CONFIG_OPDI_BENCH_WARMUP
+    const char *label;          // free text copied into the report ("p4 240MHz, conf 0.5"), may be NULL
+} opdi_bench_cfg_t;
+
+typedef struct {
+    uint32_t p50, p90, p99, max, mean;   // microseconds
+} opdi_bench_pct_t;
+
+typedef struct {
+    uint32_t frames;            // timed frames
+    uint32_t skipped;           // files of the wrong size
+    float fps;                  // frames / detector time (read excluded)
+    float wall_fps;             // frames / whole run
+    opdi_bench_pct_t stage[OPDI_BENCH_STAGE_MAX];
+    bool has_recog;             // the callback reported RECOG time
+    size_t heap_peak;           // internal RAM above the level at start, bytes
+    size_t psram_peak;          // PSRAM above the level at start, bytes
+    uint32_t detections;        // sum over timed frames
+    uint32_t frames_with;       // timed frames with at least one detection
+    uint32_t max_per_frame;
+} opdi_bench_result_t;
+
+// Run the benchmark. The report is written through sink (may be NULL) with opdi_json_* and is also
+// returned in out (may be NULL). ESP_ERR_NOT_FOUND: no frame in dir; ESP_ERR_NO_MEM; ESP_FAIL: the
+// detector failed; the sink's error.
+esp_err_t opdi_bench_run(const opdi_bench_cfg_t *cfg, const opdi_bench_model_t *model,
+                         opdi_json_sink_t sink, void *sink_ctx, opdi_bench_result_t *out);
+
+// Nearest-rank percentiles of n samples; sorts v in place. Exposed for the unit test.
+void opdi_bench_percentiles(uint32_t *v, size_t n, opdi_bench_pct_t *out);
+
+// Write the report of a finished run (what opdi_bench_run() sends to its sink)
+esp_err_t opdi_bench_write_json(const opdi_bench_cfg_t *cfg, const opdi_bench_model_t *model,
+                                const opdi_bench_result_t *r, opdi_json_sink_t sink, void *sink_ctx);
+
+// Sink writing to a stdio FILE * (ctx)
+esp_err_t opdi_bench_file_sink(void *ctx, const char *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,265 @@
+// Detection benchmark harness: recorded RGB565 frames -> detector callback -> JSON report
+#include "opdi_bench.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <malloc.h>
+#endif
+
+static const char *TAG = "opdi_bench";
+
+#define FRAME_EXT ".rgb565"
+#define MAX_FILES 1024
+#define JSON_SCRATCH 256
+
+static const char *const s_stage_names[OPDI_BENCH_STAGE_MAX] = { "read", "detect", "recog", "total" };
+
+esp_err_t opdi_bench_file_sink(void *ctx, const char *data, size_t len){
+    return fwrite(data, 1, len, (FILE *)ctx) == len ? ESP_OK : ESP_FAIL;
+}
+
+// ---- memory high-water marks ----
+// The device has per-interval minimum-free monitoring in the heap; the linux build samples the
+// allocator after every stage, which misses allocations freed within one detector call.
+typedef struct { size_t heap0, psram0, heap_peak, psram_peak; } mem_watch_t;
+
+#if CONFIG_IDF_TARGET_LINUX
+static size_t heap_used(void){ return mallinfo2().uordblks; }
+static void mem_begin(mem_watch_t *m){ memset(m, 0, sizeof(*m)); m->heap0 = heap_used(); }
+static void mem_sample(mem_watch_t *m){
+    size_t u = heap_used();
+    if (u > m->heap0 && u - m->heap0 > m->heap_peak) m->heap_peak = u - m->heap0;
+}
+static void mem_end(mem_watch_t *m){ mem_sample(m); }
+#else
+static void mem_begin(mem_watch_t *m){
+    memset(m, 0, sizeof(*m));
+    m->heap0 = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    m->psram0 = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    heap_caps_monitor_local_minimum_free_size_start();
+}
+static void mem_sample(mem_watch_t *m){ (void)m; }
+static void mem_end(mem_watch_t *m){
+    size_t h = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    size_t p = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    heap_caps_monitor_local_minimum_free_size_stop();
+    m->heap_peak = m->heap0 > h ? m->heap0 - h : 0;
+    m->psram_peak = m->psram0 > p ? m->psram0 - p : 0;
+}
+#endif
+
+// ---- frame list ----
+static int name_cmp(const void *a, const void *b){
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void free_names(char **names, size_t n){
+    for (size_t i=0; i<n; i++) free(names[i]);
+    free(names);
+}
+
+static esp_err_t list_frames(const char *dir, char ***out, size_t *count){
+    DIR *d = opendir(dir);
+    if (!d) return ESP_ERR_NOT_FOUND;
+    char **names = calloc(MAX_FILES, sizeof(char *));
+    size_t n = 0;
+    struct dirent *e;
+    while (names && n < MAX_FILES && (e = readdir(d)) != NULL){
+        size_t len = strlen(e->d_name), ext = strlen(FRAME_EXT);
+        if (len <= ext || strcmp(e->d_name + len - ext, FRAME_EXT)) continue;
+        if (!(names[n] = strdup(e->d_name))) break;
+        n++;
+    }
+    closedir(d);
+    if (!names) return ESP_ERR_NO_MEM;
+    if (!n){ free(names); return ESP_ERR_NOT_FOUND; }
+    qsort(names, n, sizeof(char *), name_cmp);
+    *out = names; *count = n;
+    return ESP_OK;
+}
+
+static bool read_frame(const char *dir, const char *name, uint16_t *buf, size_t bytes){
+    char path[300];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    bool ok = fread(buf, 1, bytes, f) == bytes && fgetc(f) == EOF;
+    fclose(f);
+    return ok;
+}
+
+static int u32_cmp(const void *a, const void *b){
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void opdi_bench_percentiles(uint32_t *v, size_t n, opdi_bench_pct_t *out){
+    memset(out, 0, sizeof(*out));
+    if (!n) return;
+    qsort(v, n, sizeof(uint32_t), u32_cmp);
+    uint64_t sum = 0;
+    for (size_t i=0; i<n; i++) sum += v[i];
+    // Nearest rank: the smallest sample with at least p% of the samples at or below it
+    out->p50 = v[(n * 50 + 99) / 100 - 1];
+    out->p90 = v[(n * 90 + 99) / 100 - 1];
+    out->p99 = v[(n * 99 + 99) / 100 - 1];
+    out->max = v[n - 1];
+    out->mean = (uint32_t)(sum / n);
+}
+
+static void kv_float(opdi_json_t *w, const char *k, float v){
+    char num[24];
+    snprintf(num, sizeof(num), "%.2f", (double)v);
+    opdi_json_key(w, k);
+    opdi_json_raw(w, num);
+}
+
+esp_err_t opdi_bench_write_json(const opdi_bench_cfg_t *cfg, const opdi_bench_model_t *model,
+                                const opdi_bench_result_t *r, opdi_json_sink_t sink, void *sink_ctx){
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init(&w, scratch, sizeof(scratch), sink, sink_ctx);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "bench", "detect");
+    opdi_json_kv_uint(&w, "version", 1);
+    time_t now = time(NULL);
+    opdi_json_kv_uint(&w, "t", now > 1600000000 ? (uint64_t)now : 0);   // 0 before SNTP
+    opdi_json_kv_str(&w, "label", cfg->label ? cfg->label : "");
+    opdi_json_kv_str(&w, "model", model->name);
+    opdi_json_kv_uint(&w, "load_ms", model->load_ms);
+    opdi_json_kv_uint(&w, "resident_bytes", model->resident_bytes);
+    opdi_json_kv_str(&w, "dir", cfg->dir);
+    opdi_json_kv_int(&w, "width", cfg->width);
+    opdi_json_kv_int(&w, "height", cfg->height);
+    opdi_json_kv_uint(&w, "frames", r->frames);
+    opdi_json_kv_uint(&w, "skipped", r->skipped);
+    kv_float(&w, "fps", r->fps);
+    kv_float(&w, "wall_fps", r->wall_fps);
+    opdi_json_key(&w, "stages_us"); opdi_json_obj_begin(&w);
+    for (int s=0; s<OPDI_BENCH_STAGE_MAX; s++){
+        if (s == OPDI_BENCH_STAGE_RECOG && !r->has_recog) continue;
+        const opdi_bench_pct_t *p = &r->stage[s];
+        opdi_json_key(&w, s_stage_names[s]); opdi_json_obj_begin(&w);
+        opdi_json_kv_uint(&w, "p50", p->p50);
+        opdi_json_kv_uint(&w, "p90", p->p90);
+        opdi_json_kv_uint(&w, "p99", p->p99);
+        opdi_json_kv_uint(&w, "max", p->max);
+        opdi_json_kv_uint(&w, "mean", p->mean);
+        opdi_json_obj_end(&w);
+    }
+    opdi_json_obj_end(&w);
+    opdi_json_key(&w, "mem"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "heap_peak", r->heap_peak);
+    opdi_json_kv_uint(&w, "psram_peak", r->psram_peak);
+    opdi_json_obj_end(&w);
+    opdi_json_key(&w, "detections"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "total", r->detections);
+    opdi_json_kv_uint(&w, "frames_with", r->frames_with);
+    opdi_json_kv_uint(&w, "max_per_frame", r->max_per_frame);
+    kv_float(&w, "mean_per_frame", r->frames ? (float)r->detections / (float)r->frames : 0.0f);
+    opdi_json_obj_end(&w);
+    opdi_json_obj_end(&w);
+    esp_err_t err = opdi_json_finish(&w);
+    if (err == ESP_OK) err = sink(sink_ctx, "\n", 1);
+    return err;
+}
+
+esp_err_t opdi_bench_run(const opdi_bench_cfg_t *cfg, const opdi_bench_model_t *model,
+                         opdi_json_sink_t sink, void *sink_ctx, opdi_bench_result_t *out){
+    if (!cfg || !cfg->dir || cfg->width <= 0 || cfg->height <= 0 || !model || !model->detect) return ESP_ERR_INVALID_ARG;
+    int repeat = cfg->repeat > 0 ? cfg->repeat : 1;
+    int max_frames = cfg->max_frames > 0 ? cfg->max_frames : CONFIG_OPDI_BENCH_MAX_FRAMES;
+    int warmup = cfg->warmup >= 0 ? cfg->warmup : CONFIG_OPDI_BENCH_WARMUP;
+    size_t bytes = (size_t)cfg->width * (size_t)cfg->height * 2;
+
+    char **names = NULL; size_t n_files = 0;
+    esp_err_t err = list_frames(cfg->dir, &names, &n_files);
+    if (err != ESP_OK){ ESP_LOGE(TAG, "no %s frames in %s", FRAME_EXT, cfg->dir); return err; }
+
+    opdi_bench_result_t *r = calloc(1, sizeof(*r));
+    uint16_t *frame = heap_caps_aligned_alloc(64, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint32_t *samples = heap_caps_malloc((size_t)max_frames * OPDI_BENCH_STAGE_MAX * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    bool *bad = calloc(n_files, sizeof(bool));
+    if (!r || !frame || !samples || !bad){ err = ESP_ERR_NO_MEM; goto done; }
+    uint32_t *stage_us[OPDI_BENCH_STAGE_MAX];
+    for (int s=0; s<OPDI_BENCH_STAGE_MAX; s++) stage_us[s] = samples + (size_t)s * max_frames;
+
+    ESP_LOGI(TAG, "%s: %u files in %s, %dx%d, %d warm-up, %d pass(es)", model->name, (unsigned)n_files, cfg->dir,
+             cfg->width, cfg->height, warmup, repeat);
+    // Warm-up on the first readable frame
+    for (size_t i=0; i<n_files && warmup > 0; i++){
+        if (!read_frame(cfg->dir, names[i], frame, bytes)) continue;
+        uint32_t rec = 0;
+        for (int k=0; k<warmup && err == ESP_OK; k++){
+            if (model->detect(model->ctx, frame, cfg->width, cfg->height, &rec) < 0) err = ESP_FAIL;
+        }
+        break;
+    }
+    if (err != ESP_OK) goto done;
+
+    mem_watch_t mem;
+    mem_begin(&mem);
+    int64_t t_start = esp_timer_get_time();
+    uint64_t detect_total_us = 0;
+    for (int pass=0; pass<repeat && err == ESP_OK && r->frames < (uint32_t)max_frames; pass++){
+        for (size_t i=0; i<n_files && r->frames < (uint32_t)max_frames; i++){
+            if (bad[i]) continue;
+            int64_t t0 = esp_timer_get_time();
+            if (!read_frame(cfg->dir, names[i], frame, bytes)){
+                ESP_LOGW(TAG, "%s: not a %dx%d RGB565 frame, skipped", names[i], cfg->width, cfg->height);
+                bad[i] = true;
+                r->skipped++;
+                continue;
+            }
+            int64_t t1 = esp_timer_get_time();
+            mem_sample(&mem);
+            uint32_t rec = 0;
+            int det = model->detect(model->ctx, frame, cfg->width, cfg->height, &rec);
+            int64_t t2 = esp_timer_get_time();
+            mem_sample(&mem);
+            if (det < 0){ ESP_LOGE(TAG, "%s: detector failed", names[i]); err = ESP_FAIL; break; }
+            uint32_t call = (uint32_t)(t2 - t1);
+            if (rec > call) rec = call;
+            uint32_t f = r->frames++;
+            stage_us[OPDI_BENCH_STAGE_READ][f] = (uint32_t)(t1 - t0);
+            stage_us[OPDI_BENCH_STAGE_DETECT][f] = call - rec;
+            stage_us[OPDI_BENCH_STAGE_RECOG][f] = rec;
+            stage_us[OPDI_BENCH_STAGE_TOTAL][f] = (uint32_t)(t2 - t0);
+            if (rec) r->has_recog = true;
+            detect_total_us += call;
+            r->detections += (uint32_t)det;
+            if (det) r->frames_with++;
+            if ((uint32_t)det > r->max_per_frame) r->max_per_frame = (uint32_t)det;
+        }
+    }
+    int64_t wall_us = esp_timer_get_time() - t_start;
+    mem_end(&mem);
+    if (err != ESP_OK) goto done;
+    if (!r->frames){ err = ESP_ERR_NOT_FOUND; goto done; }
+
+    r->heap_peak = mem.heap_peak;
+    r->psram_peak = mem.psram_peak;
+    r->fps = detect_total_us ? (float)r->frames * 1e6f / (float)detect_total_us : 0.0f;
+    r->wall_fps = wall_us > 0 ? (float)r->frames * 1e6f / (float)wall_us : 0.0f;
+    for (int s=0; s<OPDI_BENCH_STAGE_MAX; s++) opdi_bench_percentiles(stage_us[s], r->frames, &r->stage[s]);
+    ESP_LOGI(TAG, "%s: %u frames, %.1f fps (%.1f with reads), detect p50 %u us p99 %u us, %u detections",
+             model->name, (unsigned)r->frames, (double)r->fps, (double)r->wall_fps,
+             (unsigned)r->stage[OPDI_BENCH_STAGE_DETECT].p50, (unsigned)r->stage[OPDI_BENCH_STAGE_DETECT].p99,
+             (unsigned)r->detections);
+    if (sink) err = opdi_bench_write_json(cfg, model, r, sink, sink_ctx);
+    if (out) *out = *r;
+
+done:
+    free(bad);
+    heap_caps_free(samples);
+    heap_caps_free(frame);
+    free(r);
+    free_names(names, n_files);
+    return err;
+}
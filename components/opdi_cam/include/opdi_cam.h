@@ -1,6 +1,7 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -28,6 +29,141 @@ esp_err_t opdi_cam_set_config(const opdi_cam_config_t *cfg);
 // For Phase1 returns a tiny static JPEG test pattern.
 int opdi_cam_snapshot(unsigned char *buf, size_t buf_cap);
 
+// ---- Logic layer (manager, stream ring, telemetry, IR policy, governor) ----
+// Hardware independent; built on the device and on the linux host target alike (opdi_cam_jpeg.c is device only).
+
+typedef enum { OPDI_CAM_PROFILE_240P, OPDI_CAM_PROFILE_480P, OPDI_CAM_PROFILE_720P } opdi_cam_profile_t;
+typedef enum { OPDI_CAM_STATE_INIT, OPDI_CAM_STATE_IDLE, OPDI_CAM_STATE_PREVIEW, OPDI_CAM_STATE_RUN, OPDI_CAM_STATE_FAULT } opdi_cam_state_t;
+typedef enum { OPDI_IR_MODE_AUTO, OPDI_IR_MODE_ON, OPDI_IR_MODE_OFF } opdi_ir_mode_t;
+// Simulcast layers: MAIN at profile/jpeg_q, SUB (low resolution, from the same capture) at sub_profile/sub_jpeg_q
+typedef enum { OPDI_CAM_LAYER_MAIN, OPDI_CAM_LAYER_SUB } opdi_cam_layer_t;
+#define OPDI_CAM_LAYERS 2
+
+#define OPDI_CAM_WB_AUTO 0
+#define OPDI_CAM_EXT_CONFIG_VERSION 2
+
+// Extended config, persisted as one NVS blob (version mismatch -> defaults)
+typedef struct {
+    uint8_t version;
+    opdi_cam_profile_t profile;
+    uint8_t fps_target;         // 10..30
+    uint8_t jpeg_q;             // 50..90
+    bool ae_lock;
+    uint32_t exposure_us;
+    uint16_t agc_gain;
+    uint8_t wb_mode;            // OPDI_CAM_WB_*
+    bool flip;
+    bool mirror;
+    int8_t bcsh_brightness;     // -2..2
+    int8_t bcsh_contrast;
+    int8_t bcsh_saturation;
+    int8_t bcsh_sharpness;
+    opdi_ir_mode_t ir_mode;
+    uint16_t ir_y_low;          // luma thresholds (swapped if inverted)
+    uint16_t ir_y_high;
+    uint16_t ir_hyst_on_ms;
+    uint16_t ir_hyst_off_ms;
+    bool simulcast;                   // also produce the SUB layer while it has viewers
+    opdi_cam_profile_t sub_profile;   // never above profile
+    uint8_t sub_jpeg_q;               // 50..90
+} opdi_cam_ext_config_t;
+
+typedef struct {
+    opdi_cam_profile_t active_profile;
+    uint8_t fps_target;
+    uint8_t fps_capture;
+    uint8_t fps_stream;
+    uint8_t jpeg_q_current;
+    uint8_t drop_pct;
+    uint16_t luma_avg;
+    opdi_ir_mode_t ir_mode_cfg;
+    bool ir_active;
+    uint8_t recog_hit_pct;      // faces answered by the recognition track cache, last second
+    uint16_t recog_embed_ps;    // face embeddings computed per second
+    opdi_cam_profile_t sub_profile;   // SUB layer, when simulcast is on
+    uint8_t sub_jpeg_q;
+    uint8_t fps_sub;
+} opdi_cam_telemetry_t;
+
+esp_err_t opdi_cam_manager_init(void);
+esp_err_t opdi_cam_manager_start(void);
+esp_err_t opdi_cam_manager_stop(void);
+esp_err_t opdi_cam_manager_set_detection(bool enable);
+opdi_cam_state_t opdi_cam_manager_get_state(void);
+esp_err_t opdi_cam_ext_config_get(opdi_cam_ext_config_t *out);
+esp_err_t opdi_cam_ext_config_set(const opdi_cam_ext_config_t *in);   // clamps, persists
+
+// Telemetry: per-frame hook, 1 s tick (fps, governor, cam.telemetry WS event)
+void opdi_cam_get_telemetry(opdi_cam_telemetry_t *out);
+void opdi_cam_on_frame(uint16_t luma_avg);
+void opdi_cam_periodic_1s(void);
+void opdi_cam_governor_notify_cpu_load(uint8_t pct);
+
+// Stream ring (CONFIG_OPDI_CAM_STREAM_DEPTH newest JPEG frames), one per layer; the *_jpeg/_latest/_stats
+// forms are the MAIN layer
+esp_err_t opdi_cam_stream_push_jpeg(const uint8_t *data, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q);
+esp_err_t opdi_cam_stream_push_layer(opdi_cam_layer_t layer, const uint8_t *data, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q);
+// Copy the newest frame; out==NULL returns its size, a short buffer returns -size, 0 = no frame yet
+int opdi_cam_stream_copy_latest(uint8_t *out, size_t cap, uint8_t *out_q, opdi_cam_profile_t *out_profile, uint32_t *out_ts_ms);
+int opdi_cam_stream_copy_layer(opdi_cam_layer_t layer, uint8_t *out, size_t cap, uint8_t *out_q, opdi_cam_profile_t *out_profile, uint32_t *out_ts_ms);
+size_t opdi_cam_stream_current_frame_size(void);
+void opdi_cam_stream_stats(uint32_t *accepted, uint32_t *served, uint32_t *dropped);
+void opdi_cam_stream_layer_stats(opdi_cam_layer_t layer, uint32_t *accepted, uint32_t *served, uint32_t *dropped);
+// Viewers per layer: stream handlers count themselves in and out; nobody watching SUB = it is not encoded
+void opdi_cam_stream_client(opdi_cam_layer_t layer, bool join);
+uint32_t opdi_cam_stream_clients(opdi_cam_layer_t layer);
+
+// Simulcast encoder: JPEG of the frame just captured (as opdi_cam_snapshot returned it) at another profile
+// and quality. Returns bytes written, -size when cap is short, 0 when this build cannot produce the layer.
+int opdi_cam_encode_layer(const uint8_t *frame, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q, uint8_t *out, size_t cap);
+
+// Stream ring slot written in place (hardware encoder output): reserve the next slot with at least cap bytes,
+// fill it, then commit the bytes used. Reserving again before the commit grows the same slot; len 0 cancels
+// (counted as dropped). The reserved slot is never the newest one nor one a reader is still copying; NULL (a
+// drop) when there is none. Single writer per layer; copies may run from any task.
+uint8_t *opdi_cam_stream_reserve(opdi_cam_layer_t layer, size_t cap);
+esp_err_t opdi_cam_stream_commit(opdi_cam_layer_t layer, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q);
+
+// Byte order of the camera's RGB565 frames (the P4 ISP via esp_video): 0 = low byte first in memory, as
+// ffmpeg's rgb565le. The LCD, the PPA and the JPEG engine read that order without a swap. esp-dl calls the
+// same frames DL_IMAGE_CAP_RGB565_BIG_ENDIAN: its flag describes the uint16 bit layout, not the bytes.
+// Every consumer of raw frames (encode stage, recognition warp, bench recordings) goes by this one macro.
+#define OPDI_CAM_RGB565_BIG_ENDIAN 0
+
+// RGB565 encode stage, for sensors without a JPEG mode: the capture callback hands over each raw frame, and
+// every layer that is wanted (viewers, clip pre-roll) gets it scaled to its profile and JPEG-encoded at its
+// quality straight into a ring slot. Frames faster than fps_target are skipped.
+typedef struct {
+    uint16_t crop_x, crop_y;    // source window, centred
+    uint16_t crop_w, crop_h;
+    uint8_t scale_16;           // scaler step in 1/16 (16 = 1:1, no scaler pass)
+    uint16_t out_w, out_h;      // encoded size, multiples of 16
+} opdi_cam_scale_plan_t;
+typedef struct {
+    uint32_t frames;
+    uint32_t encode_us_avg;     // scale + encode, per frame
+    uint32_t encode_us_max;
+    uint32_t bytes_avg;
+    uint32_t bytes_max;
+    uint16_t width, height;     // last encoded size
+} opdi_cam_encode_stats_t;
+esp_err_t opdi_cam_encode_plan(uint16_t src_w, uint16_t src_h, opdi_cam_profile_t profile, opdi_cam_scale_plan_t *out);
+esp_err_t opdi_cam_encode_rgb565(const uint8_t *frame, uint16_t w, uint16_t h);
+void opdi_cam_encode_get_stats(opdi_cam_profile_t profile, opdi_cam_encode_stats_t *out);
+void opdi_cam_encode_reset_stats(void);
+// A raw frame arrived in the last 2 s: the stage feeds the rings and the snapshot task stands aside
+bool opdi_cam_encode_active(void);
+// Encoder backend (opdi_cam_jpeg.c on the device: PPA scale, then the JPEG engine). out and cap in whole 128 B
+// cache lines (ESP_ERR_INVALID_ARG otherwise). ESP_ERR_INVALID_SIZE when cap is too small for the result,
+// ESP_ERR_NOT_SUPPORTED in builds without one.
+esp_err_t opdi_cam_hw_encode(const uint8_t *rgb565, uint16_t w, uint16_t h, const opdi_cam_scale_plan_t *plan,
+                             uint8_t jpeg_q, uint8_t *out, size_t cap, size_t *out_len);
+
+// IR illumination policy (AUTO: luma thresholds with hysteresis)
+esp_err_t opdi_cam_ir_set_mode(opdi_ir_mode_t mode);
+opdi_ir_mode_t opdi_cam_ir_get_mode(void);
+bool opdi_cam_ir_is_active(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -236,7 +236,8 @@ esp_err_t opdi_cam_init(void){
                     ESP_LOGW(TAG, "failed set format; continuing with sensor but snapshot disabled");
                 }
             } else {
-                ESP_LOGW(TAG, "no JPEG format available; using stub");
+                // Raw/ISP sensors (SC2336, OV5647): the capture callback feeds opdi_cam_encode_rgb565()
+                ESP_LOGI(TAG, "no JPEG format; stream frames come from the RGB565 hardware encode stage");
             }
         } else {
             ESP_LOGW(TAG, "query format failed; using stub");
@@ -0,0 +1,154 @@
+// RGB565 encode stage (logic layer): raw frames from the capture callback -> per-layer JPEG in the stream rings
+#include "opdi_cam.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "opdi_cam_enc";
+
+#define ACTIVE_US (2ULL * 1000000ULL) // no raw frame for this long: the snapshot task takes over again
+#define SLOT_ALIGN 128U // the JPEG engine writes whole cache lines; the ring allocates slots in the same unit
+
+static const uint16_t k_profile_h[] = { 240, 480, 720 }; // by opdi_cam_profile_t
+
+typedef struct {
+	uint64_t us_sum, bytes_sum;
+	uint32_t frames, us_max, bytes_max;
+	uint16_t w, h;
+} enc_acc_t;
+
+static enc_acc_t s_acc[OPDI_CAM_PROFILE_720P + 1];
+static uint64_t s_last_seen_us; // last raw frame offered
+static uint64_t s_last_enc_us; // last frame taken (fps_target pacing)
+static bool s_warned;
+static bool s_over_warned; // encode outlasted a capture interval
+
+// Which layers want this frame: MAIN for its viewers and the clip pre-roll, SUB only for its own viewers
+extern bool opdi_cam_clip_wants_frames(void);
+
+esp_err_t opdi_cam_encode_plan(uint16_t src_w, uint16_t src_h, opdi_cam_profile_t profile, opdi_cam_scale_plan_t *out){
+	if (!out || src_w < 16 || src_h < 16 || profile > OPDI_CAM_PROFILE_720P) return ESP_ERR_INVALID_ARG;
+	// The scaler steps in 1/16: take the step nearest the profile height, keep the frame's aspect and
+	// crop the few source pixels that do not fill a whole 16x16 block at the output
+	uint32_t k = (16U * k_profile_h[profile] + src_h / 2U) / src_h;
+	if (k < 1) k = 1; else if (k > 16) k = 16;
+	uint32_t ow = (src_w * k / 16U) & ~15U, oh = (src_h * k / 16U) & ~15U;
+	if (!ow || !oh) return ESP_ERR_INVALID_SIZE;
+	uint32_t cw = ow * 16U / k, ch = oh * 16U / k;
+	out->crop_w = (uint16_t)cw; out->crop_h = (uint16_t)ch;
+	out->crop_x = (uint16_t)((src_w - cw) / 2U); out->crop_y = (uint16_t)((src_h - ch) / 2U);
+	out->scale_16 = (uint8_t)k;
+	out->out_w = (uint16_t)ow; out->out_h = (uint16_t)oh;
+	return ESP_OK;
+}
+
+// Average luma (0..255) of an 8x8 grid of pixels: enough for the IR policy, negligible per frame
+static uint16_t luma_estimate(const uint8_t *frame, uint16_t w, uint16_t h){
+	const uint16_t *px = (const uint16_t*)frame;
+	uint32_t sum = 0;
+	for (uint32_t gy = 0; gy < 8; gy++){
+		for (uint32_t gx = 0; gx < 8; gx++){
+			uint16_t v = px[(h * (2U * gy + 1U) / 16U) * w + w * (2U * gx + 1U) / 16U];
+#if OPDI_CAM_RGB565_BIG_ENDIAN
+			v = (uint16_t)((v >> 8) | (v << 8));
+#endif
+			uint32_t r = (v >> 11) << 3, g = ((v >> 5) & 0x3F) << 2, b = (v & 0x1F) << 3;
+			sum += (77U * r + 150U * g + 29U * b) >> 8;
+		}
+	}
+	return (uint16_t)(sum / 64U);
+}
+
+static void account(opdi_cam_profile_t p, const opdi_cam_scale_plan_t *plan, uint32_t us, size_t bytes){
+	enc_acc_t *a = &s_acc[p];
+	a->frames++;
+	a->us_sum += us; if (us > a->us_max) a->us_max = us;
+	a->bytes_sum += bytes; if (bytes > a->bytes_max) a->bytes_max = (uint32_t)bytes;
+	a->w = plan->out_w; a->h = plan->out_h;
+}
+
+static esp_err_t encode_into_ring(opdi_cam_layer_t layer, const uint8_t *frame, uint16_t w, uint16_t h, opdi_cam_profile_t p, uint8_t q){
+	opdi_cam_scale_plan_t plan;
+	esp_err_t err = opdi_cam_encode_plan(w, h, p, &plan);
+	if (err != ESP_OK) return err;
+	// Slot size: a quarter above the largest frame seen at this profile; the raw size when that was short.
+	// Whole cache lines, as the engine is given the size as is (raw, at 16x16 blocks, always is).
+	size_t raw = (size_t)plan.out_w * plan.out_h * 2U;
+	size_t cap = s_acc[p].bytes_max ? s_acc[p].bytes_max + s_acc[p].bytes_max / 4U + 4096U : raw / 4U;
+	cap = (cap + SLOT_ALIGN - 1U) & ~(size_t)(SLOT_ALIGN - 1U);
+	if (cap > raw) cap = raw;
+	size_t len = 0;
+	uint32_t us = 0;
+	for (int attempt = 0; attempt < 2; attempt++){
+		uint8_t *dst = opdi_cam_stream_reserve(layer, cap);
+		if (!dst) return ESP_ERR_NO_MEM;
+		int64_t t0 = esp_timer_get_time();
+		err = opdi_cam_hw_encode(frame, w, h, &plan, q, dst, cap, &len);
+		us = (uint32_t)(esp_timer_get_time() - t0);
+		if (err != ESP_ERR_INVALID_SIZE || cap == raw) break;
+		cap = raw;
+	}
+	if (err != ESP_OK){
+		opdi_cam_stream_commit(layer, 0, p, q);
+		if (!s_warned){ s_warned = true; ESP_LOGW(TAG, "encode %ux%u failed: %s", plan.out_w, plan.out_h, esp_err_to_name(err)); }
+		return err;
+	}
+	account(p, &plan, us, len);
+	return opdi_cam_stream_commit(layer, len, p, q);
+}
+
+// Runs in the capture callback, which holds the frame for the LCD and detection: scale and encode of both
+// layers have to fit in one capture interval, or the next frame waits. Warned once when they do not.
+esp_err_t opdi_cam_encode_rgb565(const uint8_t *frame, uint16_t w, uint16_t h){
+	if (!frame || !w || !h) return ESP_ERR_INVALID_ARG;
+	uint64_t now = (uint64_t)esp_timer_get_time();
+	uint64_t gap = s_last_seen_us ? now - s_last_seen_us : 0;
+	s_last_seen_us = now;
+	opdi_cam_on_frame(luma_estimate(frame, w, h));
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	bool want_main = opdi_cam_stream_clients(OPDI_CAM_LAYER_MAIN) || opdi_cam_clip_wants_frames();
+	bool want_sub = c.simulcast && opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB);
+	if (!want_main && !want_sub) return ESP_OK;
+	// Pace to fps_target; a quarter interval of slack so 30 fps capture halves to 15 rather than thirds
+	uint64_t interval = 1000000ULL / (c.fps_target ? c.fps_target : 10);
+	if (s_last_enc_us && now - s_last_enc_us + interval / 4U < interval) return ESP_OK;
+	s_last_enc_us = now;
+	esp_err_t err = ESP_OK;
+	if (want_main) err = encode_into_ring(OPDI_CAM_LAYER_MAIN, frame, w, h, c.profile, c.jpeg_q);
+	if (want_sub){
+		esp_err_t e = encode_into_ring(OPDI_CAM_LAYER_SUB, frame, w, h, c.sub_profile, c.sub_jpeg_q);
+		if (err == ESP_OK) err = e;
+	}
+	uint64_t spent = (uint64_t)esp_timer_get_time() - now;
+	if (gap && spent > gap && !s_over_warned){
+		s_over_warned = true;
+		ESP_LOGW(TAG, "encode took %lu us, over the %lu us capture interval", (unsigned long)spent, (unsigned long)gap);
+	}
+	return err;
+}
+
+bool opdi_cam_encode_active(void){
+	return s_last_seen_us && (uint64_t)esp_timer_get_time() - s_last_seen_us < ACTIVE_US;
+}
+
+void opdi_cam_encode_get_stats(opdi_cam_profile_t profile, opdi_cam_encode_stats_t *out){
+	if (!out) return;
+	memset(out, 0, sizeof(*out));
+	if (profile > OPDI_CAM_PROFILE_720P) return;
+	const enc_acc_t *a = &s_acc[profile];
+	out->frames = a->frames;
+	if (a->frames){
+		out->encode_us_avg = (uint32_t)(a->us_sum / a->frames);
+		out->bytes_avg = (uint32_t)(a->bytes_sum / a->frames);
+	}
+	out->encode_us_max = a->us_max;
+	out->bytes_max = a->bytes_max;
+	out->width = a->w; out->height = a->h;
+}
+
+void opdi_cam_encode_reset_stats(void){
+	memset(s_acc, 0, sizeof(s_acc));
+	s_last_enc_us = 0;
+	s_warned = false;
+	s_over_warned = false;
+}
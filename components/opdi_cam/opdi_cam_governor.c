@@ -6,8 +6,10 @@
 static const char *TAG = "cam_gov";
 
 static uint8_t s_cpu_load_pct = 0;
-static uint64_t s_last_downshift_us = 0;
-static uint64_t s_last_upshift_us = 0;
+// Per simulcast layer: a slow viewer of one layer does not downshift the other
+static uint64_t s_last_downshift_us[OPDI_CAM_LAYERS];
+static uint64_t s_last_upshift_us[OPDI_CAM_LAYERS];
+static uint32_t s_last_acc[OPDI_CAM_LAYERS], s_last_served[OPDI_CAM_LAYERS];
 static const uint64_t UPSHIFT_GUARD_US = 10ULL * 1000000ULL; // 10s
 
 extern esp_err_t opdi_cam_ext_config_get(opdi_cam_ext_config_t *out);
@@ -15,48 +17,75 @@ extern esp_err_t opdi_cam_ext_config_set(const opdi_cam_ext_config_t *in);
 extern void opdi_cam_get_telemetry(opdi_cam_telemetry_t *out);
 extern void opdi_cam_on_frame(uint16_t luma_avg);
 extern void opdi_cam_adjust_stream_metrics(uint8_t fps_stream, uint8_t drop_pct);
-extern void opdi_cam_stream_stats(uint32_t *accepted, uint32_t *served, uint32_t *dropped);
 
 void opdi_cam_governor_notify_cpu_load(uint8_t pct){ s_cpu_load_pct = pct; }
 
-static void apply_profile(opdi_cam_profile_t newp){
+static opdi_cam_profile_t *layer_profile(opdi_cam_ext_config_t *c, opdi_cam_layer_t layer){
+	return layer == OPDI_CAM_LAYER_SUB ? &c->sub_profile : &c->profile;
+}
+
+static uint8_t *layer_jpeg_q(opdi_cam_ext_config_t *c, opdi_cam_layer_t layer){
+	return layer == OPDI_CAM_LAYER_SUB ? &c->sub_jpeg_q : &c->jpeg_q;
+}
+
+static void apply_profile(opdi_cam_layer_t layer, opdi_cam_profile_t newp){
 	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
-	if (c.profile == newp) return;
-	c.profile = newp; opdi_cam_ext_config_set(&c);
-	ESP_LOGI(TAG, "profile change -> %d", (int)newp);
+	if (*layer_profile(&c, layer) == newp) return;
+	*layer_profile(&c, layer) = newp; opdi_cam_ext_config_set(&c);
+	ESP_LOGI(TAG, "layer %d profile change -> %d", (int)layer, (int)newp);
 }
 
-static void adjust_jpeg_q(int delta){
+static void adjust_jpeg_q(opdi_cam_layer_t layer, int delta){
 	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
-	int q = (int)c.jpeg_q + delta;
+	uint8_t *cur = layer_jpeg_q(&c, layer);
+	int q = (int)*cur + delta;
 	if (q < 50) q=50; else if (q>90) q=90;
-	if (q == c.jpeg_q) return;
-	c.jpeg_q = (uint8_t)q; opdi_cam_ext_config_set(&c);
-	ESP_LOGI(TAG, "jpeg_q -> %d", q);
+	if (q == *cur) return;
+	*cur = (uint8_t)q; opdi_cam_ext_config_set(&c);
+	ESP_LOGI(TAG, "layer %d jpeg_q -> %d", (int)layer, q);
 }
 
-// Called each second from periodic tick (after telemetry update) to evaluate scaling
-void opdi_cam_governor_periodic(void){
 #ifdef CONFIG_OPDI_CAM_GOVERNOR
+static void govern_layer(opdi_cam_layer_t layer, uint64_t now){
 	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
-	uint64_t now = esp_timer_get_time();
-	uint32_t acc=0, served=0, drop=0; opdi_cam_stream_stats(&acc,&served,&drop);
-	uint32_t backlog = (acc > served) ? (acc - served) : 0;
-	bool high_load = (s_cpu_load_pct > 85) || (backlog > 3);
+	opdi_cam_profile_t p = *layer_profile(&c, layer);
+	// Backlog: frames of the last second the average viewer of this layer did not get (none unwatched)
+	uint32_t acc=0, served=0, drop=0; opdi_cam_stream_layer_stats(layer, &acc, &served, &drop);
+	uint32_t acc_d = acc - s_last_acc[layer], served_d = served - s_last_served[layer];
+	s_last_acc[layer] = acc; s_last_served[layer] = served;
+	uint32_t viewers = opdi_cam_stream_clients(layer);
+	uint32_t per_viewer = viewers ? served_d / viewers : acc_d;
+	uint32_t backlog = (acc_d > per_viewer) ? (acc_d - per_viewer) : 0;
+	// CPU load is charged to MAIN, the expensive layer; SUB follows its own viewers' backlog
+	bool cpu_high = layer == OPDI_CAM_LAYER_MAIN && s_cpu_load_pct > 85;
+	bool high_load = cpu_high || (backlog > 3);
 	bool low_load = (s_cpu_load_pct < 55) && (backlog < 2);
+	// SUB stays below MAIN (or at 240p with it): otherwise it would be a second copy of MAIN
+	opdi_cam_profile_t ceiling = OPDI_CAM_PROFILE_720P;
+	if (layer == OPDI_CAM_LAYER_SUB) ceiling = c.profile > OPDI_CAM_PROFILE_240P ? c.profile - 1 : OPDI_CAM_PROFILE_240P;
 
 	// Downshift conditions
 	if (high_load){
-		if (c.profile == OPDI_CAM_PROFILE_720P){ apply_profile(OPDI_CAM_PROFILE_480P); s_last_downshift_us = now; }
-		else if (c.profile == OPDI_CAM_PROFILE_480P){ apply_profile(OPDI_CAM_PROFILE_240P); s_last_downshift_us = now; }
-		else { adjust_jpeg_q(-5); }
+		if (p > OPDI_CAM_PROFILE_240P){ apply_profile(layer, p - 1); s_last_downshift_us[layer] = now; }
+		else { adjust_jpeg_q(layer, -5); }
 		return; // only one action per cycle
 	}
 	// Upshift conditions (guard time)
-	if (low_load && (now - s_last_downshift_us) > UPSHIFT_GUARD_US && (now - s_last_upshift_us) > UPSHIFT_GUARD_US){
-		if (c.profile == OPDI_CAM_PROFILE_240P){ apply_profile(OPDI_CAM_PROFILE_480P); s_last_upshift_us = now; }
-		else if (c.profile == OPDI_CAM_PROFILE_480P){ apply_profile(OPDI_CAM_PROFILE_720P); s_last_upshift_us = now; }
-		else { adjust_jpeg_q(+5); }
+	if (low_load && (now - s_last_downshift_us[layer]) > UPSHIFT_GUARD_US && (now - s_last_upshift_us[layer]) > UPSHIFT_GUARD_US){
+		if (p < ceiling){ apply_profile(layer, p + 1); s_last_upshift_us[layer] = now; }
+		else { adjust_jpeg_q(layer, +5); }
 	}
+}
+#endif
+
+// Called each second from periodic tick (after telemetry update) to evaluate scaling
+void opdi_cam_governor_periodic(void){
+#ifdef CONFIG_OPDI_CAM_GOVERNOR
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	uint64_t now = esp_timer_get_time();
+	govern_layer(OPDI_CAM_LAYER_MAIN, now);
+	// SUB is only encoded while someone watches it, so its backlog means nothing otherwise
+	if (c.simulcast && opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB)) govern_layer(OPDI_CAM_LAYER_SUB, now);
+	else opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_SUB, &s_last_acc[OPDI_CAM_LAYER_SUB], &s_last_served[OPDI_CAM_LAYER_SUB], NULL);
 #endif
 }
@@ -1,8 +1,14 @@
 // IR policy scaffolding - purely logic layer (no hardware toggling yet)
 #include "opdi_cam.h"
-#include "driver/gpio.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "opdi_api_ws.h"
+#include <stdio.h>
+#include <string.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/gpio.h"
+#endif
 
 static const char *TAG = "opdi_cam_ir";
 static opdi_ir_mode_t s_mode = OPDI_IR_MODE_AUTO;
@@ -14,6 +20,10 @@ static bool s_waiting_on = false; // hysteresis direction flags
 static bool s_waiting_off = false;
 static bool s_gpio_inited = false;
 
+#if CONFIG_IDF_TARGET_LINUX
+// Host build: no IR transistor, s_active is the only output
+static void apply_gpio(void){ s_gpio_inited = true; }
+#else
 static void apply_gpio(void){
     if (!s_gpio_inited){
         gpio_config_t io = {0};
@@ -25,6 +35,7 @@ static void apply_gpio(void){
     // Active-low drive
     gpio_set_level(CONFIG_OPDI_IR_GPIO, s_active ? 0 : 1);
 }
+#endif
 
 esp_err_t opdi_cam_ir_set_mode(opdi_ir_mode_t mode){
     s_mode = mode;
@@ -33,7 +44,7 @@ esp_err_t opdi_cam_ir_set_mode(opdi_ir_mode_t mode){
     else if (mode == OPDI_IR_MODE_OFF){ s_active = false; }
     ESP_LOGI(TAG, "ir mode set %d active=%d", (int)mode, (int)s_active);
     char buf[96]; snprintf(buf,sizeof(buf),"{\"type\":\"cam.ir\",\"mode\":%d,\"active\":%s}",(int)s_mode, s_active?"true":"false");
-    opdi_api_ws_broadcast(buf, strlen(buf));
+    opdi_api_ws_publish("cam.ir", buf, strlen(buf));
     apply_gpio();
     return ESP_OK;
 }
@@ -49,14 +60,14 @@ static void evaluate_auto(uint16_t y_avg){
     if (!s_active){
         if (y_avg < s_y_low){
             if (!s_waiting_on){ s_waiting_on = true; s_state_change_deadline = now_us + (uint64_t)s_on_ms * 1000ULL; }
-            else if (now_us >= s_state_change_deadline){ s_active = true; s_waiting_on = false; apply_gpio(); ESP_LOGI(TAG, "IR -> ON (y=%u)", y_avg); char jb[96]; snprintf(jb,sizeof(jb),"{\"type\":\"cam.ir\",\"mode\":%d,\"active\":true}",(int)s_mode); opdi_api_ws_broadcast(jb, strlen(jb)); }
+            else if (now_us >= s_state_change_deadline){ s_active = true; s_waiting_on = false; apply_gpio(); ESP_LOGI(TAG, "IR -> ON (y=%u)", y_avg); char jb[96]; snprintf(jb,sizeof(jb),"{\"type\":\"cam.ir\",\"mode\":%d,\"active\":true}",(int)s_mode); opdi_api_ws_publish("cam.ir", jb, strlen(jb)); }
         } else {
             s_waiting_on = false;
         }
     } else { // currently active
         if (y_avg > s_y_high){
             if (!s_waiting_off){ s_waiting_off = true; s_state_change_deadline = now_us + (uint64_t)s_off_ms * 1000ULL; }
-            else if (now_us >= s_state_change_deadline){ s_active = false; s_waiting_off = false; apply_gpio(); ESP_LOGI(TAG, "IR -> OFF (y=%u)", y_avg); char jb[96]; snprintf(jb,sizeof(jb),"{\"type\":\"cam.ir\",\"mode\":%d,\"active\":false}",(int)s_mode); opdi_api_ws_broadcast(jb, strlen(jb)); }
+            else if (now_us >= s_state_change_deadline){ s_active = false; s_waiting_off = false; apply_gpio(); ESP_LOGI(TAG, "IR -> OFF (y=%u)", y_avg); char jb[96]; snprintf(jb,sizeof(jb),"{\"type\":\"cam.ir\",\"mode\":%d,\"active\":false}",(int)s_mode); opdi_api_ws_publish("cam.ir", jb, strlen(jb)); }
         } else {
             s_waiting_off = false;
         }
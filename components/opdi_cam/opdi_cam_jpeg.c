@@ -0,0 +1,104 @@
+// Hardware encode backend for the RGB565 stage (device only): PPA scale/crop, then the JPEG engine.
+// Called from the capture callback only, so the engines and the scaler buffer need no lock.
+#include "opdi_cam.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "driver/jpeg_encode.h"
+#include "driver/ppa.h"
+
+static const char *TAG = "opdi_cam_jpeg";
+
+static jpeg_encoder_handle_t s_enc;
+static ppa_client_handle_t s_srm;
+static uint8_t *s_scaled;     // PPA output, JPEG engine input
+static size_t s_scaled_cap;
+
+static esp_err_t ensure_engines(void){
+    if (!s_enc){
+        jpeg_encode_engine_cfg_t ecfg = {
+            .intr_priority = 0,
+            .timeout_ms = 100,
+        };
+        esp_err_t err = jpeg_new_encoder_engine(&ecfg, &s_enc);
+        if (err != ESP_OK){ ESP_LOGE(TAG, "jpeg encoder engine: %s", esp_err_to_name(err)); return err; }
+    }
+    if (!s_srm){
+        ppa_client_config_t pcfg = {
+            .oper_type = PPA_OPERATION_SRM,
+            .max_pending_trans_num = 1,
+        };
+        esp_err_t err = ppa_register_client(&pcfg, &s_srm);
+        if (err != ESP_OK){ ESP_LOGE(TAG, "ppa srm client: %s", esp_err_to_name(err)); return err; }
+    }
+    return ESP_OK;
+}
+
+// Scaled frame: the scale is quantized to 1/16, so the last output column/row may be left unwritten. The
+// buffer is zeroed when (re)allocated, so those pixels are black rather than garbage.
+static esp_err_t scale(const uint8_t *rgb565, uint16_t w, uint16_t h, const opdi_cam_scale_plan_t *plan){
+    size_t need = ((size_t)plan->out_w * plan->out_h * 2U + 127U) & ~(size_t)127U;
+    if (s_scaled_cap < need){
+        heap_caps_free(s_scaled);
+        s_scaled = (uint8_t*)heap_caps_aligned_calloc(128, 1, need, MALLOC_CAP_SPIRAM);
+        s_scaled_cap = s_scaled ? need : 0;
+        if (!s_scaled) return ESP_ERR_NO_MEM;
+    }
+    float k = plan->scale_16 / 16.0f;
+    ppa_srm_oper_config_t srm = {
+        .in = {
+            .buffer = rgb565,
+            .pic_w = w, .pic_h = h,
+            .block_w = plan->crop_w, .block_h = plan->crop_h,
+            .block_offset_x = plan->crop_x, .block_offset_y = plan->crop_y,
+            .srm_cm = PPA_SRM_COLOR_MODE_RGB565,
+        },
+        .out = {
+            .buffer = s_scaled,
+            .buffer_size = s_scaled_cap,
+            .pic_w = plan->out_w, .pic_h = plan->out_h,
+            .block_offset_x = 0, .block_offset_y = 0,
+            .srm_cm = PPA_SRM_COLOR_MODE_RGB565,
+        },
+        .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
+        .byte_swap = OPDI_CAM_RGB565_BIG_ENDIAN,    // the JPEG engine reads RGB565 low byte first
+        .scale_x = k, .scale_y = k,
+        .mode = PPA_TRANS_MODE_BLOCKING,
+    };
+    return ppa_do_scale_rotate_mirror(s_srm, &srm);
+}
+
+// Replaces the weak ESP_ERR_NOT_SUPPORTED default in opdi_cam_manager.c
+esp_err_t opdi_cam_hw_encode(const uint8_t *rgb565, uint16_t w, uint16_t h, const opdi_cam_scale_plan_t *plan,
+                             uint8_t jpeg_q, uint8_t *out, size_t cap, size_t *out_len){
+    if (!rgb565 || !plan || !out || !out_len) return ESP_ERR_INVALID_ARG;
+    *out_len = 0;
+    // The driver syncs the output from the cache line by line: an unaligned buffer or size is a caller
+    // bug, not a short buffer
+    if (((uintptr_t)out & 127U) || (cap & 127U)) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ensure_engines();
+    if (err != ESP_OK) return err;
+    // 1:1 with nothing to crop (or swap): the engine reads the captured frame directly
+    const uint8_t *src = rgb565;
+    size_t raw = (size_t)plan->out_w * plan->out_h * 2U;
+    if (OPDI_CAM_RGB565_BIG_ENDIAN || plan->scale_16 != 16 || plan->out_w != w || plan->out_h != h){
+        err = scale(rgb565, w, h, plan);
+        if (err != ESP_OK) return err;
+        src = s_scaled;
+    }
+    jpeg_encode_cfg_t cfg = {
+        .src_type = JPEG_ENCODE_IN_FORMAT_RGB565,
+        .sub_sample = JPEG_DOWN_SAMPLING_YUV420,
+        .image_quality = jpeg_q,
+        .width = plan->out_w,
+        .height = plan->out_h,
+    };
+    uint32_t n = 0;
+    err = jpeg_encoder_process(s_enc, &cfg, src, (uint32_t)raw, out, (uint32_t)cap, &n);
+    // Out of space: the DMA stops at the end of the output buffer, the engine never reports the end of
+    // the frame and the driver times out; an output that fills the buffer to the last byte is cut off too.
+    // Anything else (cache sync, engine errors) goes back as it is, so the caller does not retry it.
+    if (err == ESP_ERR_TIMEOUT || (err == ESP_OK && n >= cap)) return ESP_ERR_INVALID_SIZE;
+    if (err != ESP_OK) return err;
+    *out_len = n;
+    return ESP_OK;
+}
@@ -0,0 +1,95 @@
+// Linux host target: stands in for opdi_cam.c (no sensor, SCCB or esp_video).
+// Config persistence is the same NVS blob; snapshots are the stub JPEG, or the file named by
+// OPDI_HOST_JPEG so stream benchmarks can run with realistic frame sizes. Simulcast SUB frames are
+// copies of the MAIN frame.
+#include "opdi_cam.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "opdi_cam_host";
+#define CAM_NVS_NS "cam"
+#define CAM_NVS_KEY "cfg"
+#define HOST_JPEG_MAX (512 * 1024)
+
+static opdi_cam_config_t s_cfg = {0,0,0,true};
+static bool s_loaded = false;
+static unsigned char *s_frame = NULL;   // OPDI_HOST_JPEG contents, loaded once
+static size_t s_frame_len = 0;
+
+static const unsigned char s_jpeg_stub[] = {
+    0xFF,0xD8,
+    0xFF,0xE0, 0x00,0x10,
+    'J','F','I','F',0x00,
+    0x01,0x01,
+    0x00,
+    0x00,0x01, 0x00,0x01,
+    0x00,0x00,
+    0xFF,0xD9
+};
+
+static void cam_cfg_clamp(opdi_cam_config_t *c){
+    if (c->brightness < -10) c->brightness=-10; else if (c->brightness>10) c->brightness=10;
+    if (c->contrast < -10) c->contrast=-10; else if (c->contrast>10) c->contrast=10;
+    if (c->saturation < -10) c->saturation=-10; else if (c->saturation>10) c->saturation=10;
+}
+
+static void load_host_frame(void){
+    const char *path = getenv("OPDI_HOST_JPEG");
+    if (!path || !path[0]) return;
+    FILE *f = fopen(path, "rb");
+    if (!f){ ESP_LOGW(TAG, "OPDI_HOST_JPEG %s: cannot open, using stub", path); return; }
+    unsigned char *buf = malloc(HOST_JPEG_MAX);
+    size_t n = buf ? fread(buf, 1, HOST_JPEG_MAX, f) : 0;
+    fclose(f);
+    if (n < 4 || buf[0] != 0xFF || buf[1] != 0xD8){ ESP_LOGW(TAG, "OPDI_HOST_JPEG %s: not a JPEG, using stub", path); free(buf); return; }
+    s_frame = buf; s_frame_len = n;
+    ESP_LOGI(TAG, "snapshots from %s (%u bytes)", path, (unsigned)n);
+}
+
+esp_err_t opdi_cam_init(void){
+    if (s_loaded) return ESP_OK;
+    nvs_handle_t h;
+    if (nvs_open(CAM_NVS_NS, NVS_READWRITE, &h) == ESP_OK){
+        opdi_cam_config_t tmp; size_t req = sizeof(tmp);
+        if (nvs_get_blob(h, CAM_NVS_KEY, &tmp, &req)==ESP_OK && req==sizeof(tmp)){ s_cfg = tmp; cam_cfg_clamp(&s_cfg); }
+        nvs_close(h);
+    }
+    s_loaded = true;
+    load_host_frame();
+    ESP_LOGI(TAG, "host camera stub ready");
+    return ESP_OK;
+}
+
+void opdi_cam_get_config(opdi_cam_config_t *out){ if(out) *out = s_cfg; }
+
+esp_err_t opdi_cam_set_config(const opdi_cam_config_t *cfg){
+    if(!cfg) return ESP_ERR_INVALID_ARG;
+    opdi_cam_config_t c = *cfg; cam_cfg_clamp(&c); s_cfg = c;
+    nvs_handle_t h; esp_err_t err = nvs_open(CAM_NVS_NS, NVS_READWRITE, &h);
+    if (err!=ESP_OK) return err;
+    err = nvs_set_blob(h, CAM_NVS_KEY, &s_cfg, sizeof(s_cfg));
+    if (err==ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+int opdi_cam_snapshot(unsigned char *buf, size_t buf_cap){
+    const unsigned char *src = s_frame ? s_frame : s_jpeg_stub;
+    int need = s_frame ? (int)s_frame_len : (int)sizeof(s_jpeg_stub);
+    if (!buf) return need;
+    if ((size_t)need > buf_cap) return -need;
+    memcpy(buf, src, need);
+    return need;
+}
+
+// No scaler on the host: the SUB layer is the captured frame itself, tagged with the SUB profile/quality
+int opdi_cam_encode_layer(const uint8_t *frame, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q, uint8_t *out, size_t cap){
+    (void)profile; (void)jpeg_q;
+    if (cap < len) return -(int)len;
+    memcpy(out, frame, len);
+    return (int)len;
+}
@@ -4,6 +4,8 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "opdi_api_ws.h"
@@ -42,6 +44,12 @@ static void cam_ext_config_load_defaults(opdi_cam_ext_config_t *c){
     c->ir_y_high = CONFIG_OPDI_IR_Y_HIGH;
     c->ir_hyst_on_ms = CONFIG_OPDI_IR_HYST_ON_MS;
     c->ir_hyst_off_ms = CONFIG_OPDI_IR_HYST_OFF_MS;
+#if CONFIG_OPDI_CAM_SIMULCAST
+    c->simulcast = true;
+#endif
+    const char *sp = CONFIG_OPDI_CAM_SUB_PROFILE;
+    c->sub_profile = strcmp(sp, "480p") == 0 ? OPDI_CAM_PROFILE_480P : OPDI_CAM_PROFILE_240P;
+    c->sub_jpeg_q = CONFIG_OPDI_CAM_SUB_JPEG_Q;
 }
 
 static void clamp_ext_config(opdi_cam_ext_config_t *c){
@@ -52,6 +60,8 @@ static void clamp_ext_config(opdi_cam_ext_config_t *c){
     if (c->bcsh_contrast   < -2) c->bcsh_contrast=-2;   else if (c->bcsh_contrast>2) c->bcsh_contrast=2;
     if (c->bcsh_saturation < -2) c->bcsh_saturation=-2; else if (c->bcsh_saturation>2) c->bcsh_saturation=2;
     if (c->bcsh_sharpness  < -2) c->bcsh_sharpness=-2;  else if (c->bcsh_sharpness>2) c->bcsh_sharpness=2;
+    if (c->sub_jpeg_q < 50) c->sub_jpeg_q = 50; else if (c->sub_jpeg_q > 90) c->sub_jpeg_q = 90;
+    if (c->sub_profile > c->profile) c->sub_profile = c->profile;
     if (c->ir_y_low > c->ir_y_high) { uint16_t t = c->ir_y_low; c->ir_y_low = c->ir_y_high; c->ir_y_high = t; }
 }
 
@@ -81,13 +91,32 @@ static void cam_ws_emit_ir(bool active, opdi_ir_mode_t mode){
 
 // --------------- Capture / streaming task ---------------
 static TaskHandle_t s_stream_task = NULL;
+
+// SUB layer from the frame just pushed to MAIN: same capture, scaled and encoded at its own profile/quality
+static void cam_push_sub(const opdi_cam_ext_config_t *c, const uint8_t *frame, size_t len){
+    size_t cap = len;
+    uint8_t *out = (uint8_t*)malloc(cap);
+    int n = out ? opdi_cam_encode_layer(frame, len, c->sub_profile, c->sub_jpeg_q, out, cap) : 0;
+    if (n < 0){
+        cap = (size_t)-n; free(out);
+        out = (uint8_t*)malloc(cap);
+        n = out ? opdi_cam_encode_layer(frame, len, c->sub_profile, c->sub_jpeg_q, out, cap) : 0;
+    }
+    if (n > 0) opdi_cam_stream_push_layer(OPDI_CAM_LAYER_SUB, out, (size_t)n, c->sub_profile, c->sub_jpeg_q);
+    free(out);
+}
 static void cam_stream_task(void *arg){
     (void)arg;
     // Simple loop: use snapshot API as provisional frame source until direct pipeline integration.
     // Obtains target FPS from current config each cycle.
     const TickType_t min_delay = pdMS_TO_TICKS(5);
+    TickType_t last_tick = xTaskGetTickCount();
     while(1){
+        // 1 s telemetry/governor tick (the telemetry ignores a second call within the same second)
+        if (xTaskGetTickCount() - last_tick >= pdMS_TO_TICKS(1000)){ last_tick = xTaskGetTickCount(); opdi_cam_periodic_1s(); }
         if (s_state != OPDI_CAM_STATE_PREVIEW && s_state != OPDI_CAM_STATE_RUN){ vTaskDelay(pdMS_TO_TICKS(200)); continue; }
+        // Raw frames arriving: the RGB565 encode stage feeds the rings from the capture callback
+        if (opdi_cam_encode_active()){ vTaskDelay(pdMS_TO_TICKS(200)); continue; }
         opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
         uint32_t interval_ms = c.fps_target ? (1000U / c.fps_target) : 100;
         int need = opdi_cam_snapshot(NULL, 0);
@@ -101,6 +130,7 @@ static void cam_stream_task(void *arg){
                     if (need > 20){ y = (uint16_t)(buf[20]); }
                     opdi_cam_on_frame(y);
                     opdi_cam_stream_push_jpeg(buf, (size_t)got, c.profile, c.jpeg_q);
+                    if (c.simulcast && opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB)) cam_push_sub(&c, buf, (size_t)got);
                 }
                 free(buf);
             }
@@ -113,7 +143,7 @@ static void cam_stream_task(void *arg){
 
 static void ensure_stream_task_started(void){
     if (!s_stream_task){
-        xTaskCreate(cam_stream_task, "cam_stream", 4096, NULL, 5, &s_stream_task);
+        xTaskCreate(cam_stream_task, "cam_stream", 6144, NULL, 5, &s_stream_task); // room for the 1 s tick (NVS writes)
     }
 }
 
@@ -187,8 +217,31 @@ esp_err_t opdi_cam_ext_config_set(const opdi_cam_ext_config_t *in){
     return ESP_OK;
 }
 
-// Periodic tick placeholder
-void opdi_cam_periodic_1s(void){ /* upcoming: fps counters, governor, telemetry emit */ }
+// Periodic tick placeholder (opdi_cam_telemetry.c provides the real one)
+__attribute__((weak)) void opdi_cam_periodic_1s(void){ /* upcoming: fps counters, governor, telemetry emit */ }
+
+// Governor hint placeholder (opdi_cam_governor.c provides the real one)
+__attribute__((weak)) void opdi_cam_governor_notify_cpu_load(uint8_t pct){ (void)pct; }
+
+// Recognition cache metrics placeholder (opdi_recog_cache.c provides the real one when linked)
+__attribute__((weak)) void opdi_cam_recog_periodic_1s(void){ }
+
+// Event clip placeholder (opdi_clip.c provides the real one when linked)
+__attribute__((weak)) void opdi_cam_clip_frame(const uint8_t *jpeg, size_t len, uint32_t ts_ms){ (void)jpeg; (void)len; (void)ts_ms; }
+
+// Simulcast encoder placeholder: no SUB layer unless the build can scale (opdi_cam_linux.c, HW encoder)
+__attribute__((weak)) int opdi_cam_encode_layer(const uint8_t *frame, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q, uint8_t *out, size_t cap){
+    (void)frame; (void)len; (void)profile; (void)jpeg_q; (void)out; (void)cap;
+    return 0;
+}
+
+// Event clip placeholder: without the recorder, nothing but viewers needs MAIN frames
+__attribute__((weak)) bool opdi_cam_clip_wants_frames(void){ return false; }
 
-// Governor hint placeholder
-void opdi_cam_governor_notify_cpu_load(uint8_t pct){ (void)pct; }
+// RGB565 encoder placeholder: builds without a hardware encoder (host) produce no frames on that path
+__attribute__((weak)) esp_err_t opdi_cam_hw_encode(const uint8_t *rgb565, uint16_t w, uint16_t h, const opdi_cam_scale_plan_t *plan,
+                                                   uint8_t jpeg_q, uint8_t *out, size_t cap, size_t *out_len){
+    (void)rgb565; (void)w; (void)h; (void)plan; (void)jpeg_q; (void)out; (void)cap;
+    if (out_len) *out_len = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+}
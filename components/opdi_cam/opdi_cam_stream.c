@@ -1,6 +1,14 @@
-// Streaming ring buffer implementation (logic layer only)
+// Streaming ring buffer implementation (logic layer only), one ring per simulcast layer.
+// One writer per layer (capture callback; the JPEG engine's DMA fills reserved slots) and any number of
+// readers (stream/snapshot handlers). Indexes and counters are under s_lock; the frame bytes are copied
+// outside it. A reader pins the slot it copies, and reserve() never hands out the newest or a pinned slot,
+// so the writer neither waits for a slow reader nor frees/overwrites a buffer that is being read.
 #include "opdi_cam.h"
+#include "sdkconfig.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
 #include <string.h>
 
 #ifndef CONFIG_OPDI_CAM_STREAM_DEPTH
@@ -13,72 +21,179 @@ typedef struct {
 	uint8_t jpeg_q;
 	opdi_cam_profile_t profile;
 	uint8_t *buf; // allocated block
+	size_t cap; // its size
+	uint8_t readers; // copies in progress (pinned: not reserved, not freed)
 } cam_stream_slot_t;
 
-static cam_stream_slot_t s_slots[CONFIG_OPDI_CAM_STREAM_DEPTH];
-static size_t s_slot_cap = 0; // capacity per slot (largest seen so far)
-static int s_latest = -1; // index of newest frame
-static uint32_t s_dropped = 0;
-static uint32_t s_accepted = 0;
-static uint32_t s_served = 0; // number of frames handed to clients via copy
+typedef struct {
+	cam_stream_slot_t slots[CONFIG_OPDI_CAM_STREAM_DEPTH];
+	int latest; // index of newest frame
+	int reserved; // slot handed out by opdi_cam_stream_reserve(), -1 = none
+	uint32_t dropped;
+	uint32_t accepted;
+	uint32_t served; // number of frames handed to clients via copy
+	uint32_t clients; // stream handlers currently on this layer
+} cam_stream_ring_t;
+
+static cam_stream_ring_t s_rings[OPDI_CAM_LAYERS] = { { .latest = -1, .reserved = -1 }, { .latest = -1, .reserved = -1 } };
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static cam_stream_ring_t *ring_of(opdi_cam_layer_t layer){
+	return &s_rings[layer == OPDI_CAM_LAYER_SUB ? OPDI_CAM_LAYER_SUB : OPDI_CAM_LAYER_MAIN];
+}
+
+// Slot buffers are written by the JPEG engine's DMA on the device: cache line aligned PSRAM, whole lines
+static uint8_t *slot_alloc(size_t *cap){
+	*cap = (*cap + 127) & ~(size_t)127;
+#if CONFIG_IDF_TARGET_LINUX
+	return (uint8_t*)calloc(1, *cap);
+#else
+	return (uint8_t*)heap_caps_aligned_calloc(128, 1, *cap, MALLOC_CAP_SPIRAM);
+#endif
+}
 
 size_t opdi_cam_stream_current_frame_size(void){
-	if (s_latest < 0) {
-		return 0;
+	cam_stream_ring_t *r = ring_of(OPDI_CAM_LAYER_MAIN);
+	taskENTER_CRITICAL(&s_lock);
+	size_t len = r->latest < 0 ? 0 : r->slots[r->latest].len;
+	taskEXIT_CRITICAL(&s_lock);
+	return len;
+}
+
+uint8_t *opdi_cam_stream_reserve(opdi_cam_layer_t layer, size_t cap){
+	if (!cap) return NULL;
+	cam_stream_ring_t *r = ring_of(layer);
+	// Reserved again before the commit: same slot. Otherwise the oldest one after the newest that no
+	// reader holds (advance circularly).
+	taskENTER_CRITICAL(&s_lock);
+	int next = r->reserved;
+	for (int k = 1; next < 0 && k <= CONFIG_OPDI_CAM_STREAM_DEPTH; k++){
+		int i = (r->latest + k) % CONFIG_OPDI_CAM_STREAM_DEPTH;
+		if (i != r->latest && !r->slots[i].readers) next = i;
 	}
-	return s_slots[s_latest].len;
+	r->reserved = next;
+	if (next < 0) r->dropped++; // every older slot is being read
+	taskEXIT_CRITICAL(&s_lock);
+	if (next < 0) return NULL;
+	cam_stream_slot_t *slot = &r->slots[next];
+	if (!slot->buf || slot->cap < cap){
+		// Grow the slot buffer (no lock needed: readers only pin the newest slot); the old content is not needed
+		free(slot->buf);
+		slot->cap = cap;
+		slot->buf = slot_alloc(&slot->cap);
+		if (!slot->buf){
+			slot->cap = 0;
+			taskENTER_CRITICAL(&s_lock);
+			r->reserved = -1; r->dropped++;
+			taskEXIT_CRITICAL(&s_lock);
+			return NULL;
+		}
+	}
+	return slot->buf;
 }
 
-esp_err_t opdi_cam_stream_push_jpeg(const uint8_t *data, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q){
-	if (!data || !len) return ESP_ERR_INVALID_ARG;
-	// Choose next slot (overwrite oldest if full). Strategy: advance circularly.
-	int next = (s_latest + 1) % CONFIG_OPDI_CAM_STREAM_DEPTH;
-	cam_stream_slot_t *slot = &s_slots[next];
-	if (!slot->buf || s_slot_cap < len){
-		// Reallocate slot buffer
-		uint8_t *nb = (uint8_t*)realloc(slot->buf, len);
-		if (!nb){ s_dropped++; return ESP_FAIL; }
-		slot->buf = nb; s_slot_cap = len > s_slot_cap ? len : s_slot_cap;
+esp_err_t opdi_cam_stream_commit(opdi_cam_layer_t layer, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q){
+	cam_stream_ring_t *r = ring_of(layer);
+	taskENTER_CRITICAL(&s_lock);
+	int idx = r->reserved;
+	r->reserved = -1;
+	cam_stream_slot_t *slot = idx < 0 ? NULL : &r->slots[idx];
+	esp_err_t err = !slot ? ESP_ERR_INVALID_STATE : len > slot->cap ? ESP_ERR_INVALID_SIZE : ESP_OK;
+	if (err == ESP_OK && !len) r->dropped++;
+	if (err == ESP_OK && len){
+		slot->len = len;
+		slot->profile = profile;
+		slot->jpeg_q = jpeg_q;
+		slot->ts_ms = (uint32_t)(esp_timer_get_time()/1000ULL);
+		r->latest = idx; r->accepted++;
+	}
+	taskEXIT_CRITICAL(&s_lock);
+	if (err != ESP_OK || !len) return err;
+	// Event clip pre-roll (opdi_clip when linked): copies the frame and returns. Clips are full resolution.
+	// Only this writer reserves, and never the newest slot, so it stays intact until the next commit.
+	if (r == &s_rings[OPDI_CAM_LAYER_MAIN]){
+		extern void opdi_cam_clip_frame(const uint8_t *jpeg, size_t len, uint32_t ts_ms);
+		opdi_cam_clip_frame(slot->buf, len, slot->ts_ms);
 	}
-	memcpy(slot->buf, data, len);
-	slot->len = len;
-	slot->profile = profile;
-	slot->jpeg_q = jpeg_q;
-	slot->ts_ms = (uint32_t)(esp_timer_get_time()/1000ULL);
-	s_latest = next; s_accepted++;
 	return ESP_OK;
 }
 
+esp_err_t opdi_cam_stream_push_layer(opdi_cam_layer_t layer, const uint8_t *data, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q){
+	if (!data || !len) return ESP_ERR_INVALID_ARG;
+	uint8_t *dst = opdi_cam_stream_reserve(layer, len);
+	if (!dst) return ESP_FAIL;
+	memcpy(dst, data, len);
+	return opdi_cam_stream_commit(layer, len, profile, jpeg_q);
+}
+
+esp_err_t opdi_cam_stream_push_jpeg(const uint8_t *data, size_t len, opdi_cam_profile_t profile, uint8_t jpeg_q){
+	return opdi_cam_stream_push_layer(OPDI_CAM_LAYER_MAIN, data, len, profile, jpeg_q);
+}
+
+int opdi_cam_stream_copy_layer(opdi_cam_layer_t layer, uint8_t *out, size_t cap, uint8_t *out_q, opdi_cam_profile_t *out_profile, uint32_t *out_ts_ms){
+	cam_stream_ring_t *r = ring_of(layer);
+	taskENTER_CRITICAL(&s_lock);
+	if (r->latest < 0){ taskEXIT_CRITICAL(&s_lock); return 0; }
+	cam_stream_slot_t *slot = &r->slots[r->latest];
+	int len = (int)slot->len;
+	bool copy = out && cap >= slot->len;
+	if (copy){
+		slot->readers++;
+		if (out_q) *out_q = slot->jpeg_q;
+		if (out_profile) *out_profile = slot->profile;
+		if (out_ts_ms) *out_ts_ms = slot->ts_ms;
+	}
+	taskEXIT_CRITICAL(&s_lock);
+	if (!out) return len;
+	if (!copy) return -len;
+	memcpy(out, slot->buf, (size_t)len); // pinned: the writer reserves around it
+	taskENTER_CRITICAL(&s_lock);
+	slot->readers--;
+	r->served++;
+	taskEXIT_CRITICAL(&s_lock);
+	return len;
+}
+
 int opdi_cam_stream_copy_latest(uint8_t *out, size_t cap, uint8_t *out_q, opdi_cam_profile_t *out_profile, uint32_t *out_ts_ms){
-	if (s_latest < 0) return 0;
-	cam_stream_slot_t *slot = &s_slots[s_latest];
-	if (!out){ return (int)slot->len; }
-	if (cap < slot->len) return -(int)slot->len;
-	memcpy(out, slot->buf, slot->len);
-	if (out_q) *out_q = slot->jpeg_q;
-	if (out_profile) *out_profile = slot->profile;
-	if (out_ts_ms) *out_ts_ms = slot->ts_ms;
-	s_served++;
-	return (int)slot->len;
+	return opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_MAIN, out, cap, out_q, out_profile, out_ts_ms);
+}
+
+void opdi_cam_stream_client(opdi_cam_layer_t layer, bool join){
+	cam_stream_ring_t *r = ring_of(layer);
+	taskENTER_CRITICAL(&s_lock);
+	if (join) r->clients++;
+	else if (r->clients) r->clients--;
+	taskEXIT_CRITICAL(&s_lock);
 }
 
+uint32_t opdi_cam_stream_clients(opdi_cam_layer_t layer){ return ring_of(layer)->clients; }
+
 // Hook into telemetry periodic to update drop percentage.
 extern void opdi_cam_adjust_stream_metrics(uint8_t fps_stream, uint8_t drop_pct);
+extern void opdi_cam_adjust_sub_metrics(uint8_t fps_sub);
 __attribute__((weak)) void opdi_cam_stream_periodic_1s(void){
 	// Compute drops vs accepted over last window - simplistic (resets every sec by caller if needed)
-	static uint32_t last_acc=0, last_drop=0;
-	uint32_t acc_delta = s_accepted - last_acc;
-	uint32_t drop_delta = s_dropped - last_drop;
-	last_acc = s_accepted; last_drop = s_dropped;
+	static uint32_t last_acc[OPDI_CAM_LAYERS], last_drop;
+	cam_stream_ring_t *m = &s_rings[OPDI_CAM_LAYER_MAIN], *sub = &s_rings[OPDI_CAM_LAYER_SUB];
+	uint32_t acc_delta = m->accepted - last_acc[OPDI_CAM_LAYER_MAIN];
+	uint32_t drop_delta = m->dropped - last_drop;
+	uint32_t sub_delta = sub->accepted - last_acc[OPDI_CAM_LAYER_SUB];
+	last_acc[OPDI_CAM_LAYER_MAIN] = m->accepted; last_acc[OPDI_CAM_LAYER_SUB] = sub->accepted; last_drop = m->dropped;
 	uint8_t drop_pct = 0;
 	if (acc_delta + drop_delta){ drop_pct = (uint8_t)((drop_delta * 100U) / (acc_delta + drop_delta)); }
 	// fps_stream approximated as accepted frames in last second
 	opdi_cam_adjust_stream_metrics((uint8_t)acc_delta, drop_pct);
+	opdi_cam_adjust_sub_metrics((uint8_t)sub_delta);
 }
 
 // Stats accessor for governor (accepted - served backlog)
+void opdi_cam_stream_layer_stats(opdi_cam_layer_t layer, uint32_t *accepted, uint32_t *served, uint32_t *dropped){
+	cam_stream_ring_t *r = ring_of(layer);
+	if (accepted) *accepted = r->accepted;
+	if (served) *served = r->served;
+	if (dropped) *dropped = r->dropped;
+}
+
 void opdi_cam_stream_stats(uint32_t *accepted, uint32_t *served, uint32_t *dropped){
-	if (accepted) *accepted = s_accepted;
-	if (served) *served = s_served;
-	if (dropped) *dropped = s_dropped;
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_MAIN, accepted, served, dropped);
 }
@@ -47,16 +47,30 @@ void opdi_cam_periodic_1s(void){
 	// allow streaming module to refine stream fps & drop % (will call back)
 	extern void opdi_cam_stream_periodic_1s(void);
 	opdi_cam_stream_periodic_1s();
+	extern void opdi_cam_recog_periodic_1s(void);
+	opdi_cam_recog_periodic_1s();
 	// Governor evaluation after metrics
 	extern void opdi_cam_governor_periodic(void);
 	opdi_cam_governor_periodic();
-	// Broadcast telemetry over WS
-	char buf[256];
+	// The governor moves each layer's profile and quality in the config
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	s_tel.active_profile = c.profile;
+	s_tel.jpeg_q_current = c.jpeg_q;
+	s_tel.sub_profile = c.sub_profile;
+	s_tel.sub_jpeg_q = c.sub_jpeg_q;
+	// Broadcast telemetry over WS (coalesced: a queued older sample is replaced, never sent late)
+	char buf[320];
 	int n = snprintf(buf, sizeof(buf),
-		"{\"type\":\"cam.telemetry\",\"profile\":%u,\"fps\":%u,\"fps_stream\":%u,\"jpeg_q\":%u,\"luma\":%u,\"ir_mode\":%u,\"ir_active\":%s}",
+		"{\"type\":\"cam.telemetry\",\"profile\":%u,\"fps\":%u,\"fps_stream\":%u,\"jpeg_q\":%u,\"luma\":%u,\"ir_mode\":%u,\"ir_active\":%s,\"recog_hit\":%u,\"embed_ps\":%u",
 		(unsigned)s_tel.active_profile, s_tel.fps_capture, s_tel.fps_stream, s_tel.jpeg_q_current,
-		s_tel.luma_avg, (unsigned)s_tel.ir_mode_cfg, s_tel.ir_active?"true":"false");
-	opdi_api_ws_broadcast(buf, (size_t)n);
+		s_tel.luma_avg, (unsigned)s_tel.ir_mode_cfg, s_tel.ir_active?"true":"false",
+		s_tel.recog_hit_pct, s_tel.recog_embed_ps);
+	if (c.simulcast){
+		n += snprintf(buf + n, sizeof(buf) - n, ",\"sub_profile\":%u,\"sub_jpeg_q\":%u,\"fps_sub\":%u",
+			(unsigned)s_tel.sub_profile, s_tel.sub_jpeg_q, s_tel.fps_sub);
+	}
+	n += snprintf(buf + n, sizeof(buf) - n, "}");
+	opdi_api_ws_publish("cam.telemetry", buf, (size_t)n);
 	ESP_LOGD(TAG_TEL, "ws cam.telemetry sent");
 }
 
@@ -65,3 +79,14 @@ void opdi_cam_adjust_stream_metrics(uint8_t fps_stream, uint8_t drop_pct){
 	s_tel.fps_stream = fps_stream;
 	s_tel.drop_pct = drop_pct;
 }
+
+// SUB layer frames pushed in the last second (0 while nobody watches it)
+void opdi_cam_adjust_sub_metrics(uint8_t fps_sub){
+	s_tel.fps_sub = fps_sub;
+}
+
+// Called by the recognition cache (opdi_recog) from the same tick
+void opdi_cam_adjust_recog_metrics(uint8_t hit_pct, uint16_t embeds_ps){
+	s_tel.recog_hit_pct = hit_pct;
+	s_tel.recog_embed_ps = embeds_ps;
+}
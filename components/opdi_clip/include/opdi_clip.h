@@ -0,0 +1,74 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Event clips: every JPEG frame that reaches the stream ring is also kept in a PSRAM pre-roll ring.
+// A trigger (detection, tamper, REST) records CONFIG_OPDI_CLIP_PRE_S seconds before it and
+// CONFIG_OPDI_CLIP_POST_S after the last trigger into <dir>/clip_NNNNN_<reason>.avi, an AVI
+// (MJPEG) file with an idx1 index that VLC, ffmpeg and most players open as is.
+
+#define OPDI_CLIP_NAME_MAX 32
+
+// Allocate the ring, create dir (NULL: CONFIG_OPDI_CLIP_DIR); frames are kept from here on. Idempotent.
+esp_err_t opdi_clip_init(const char *dir);
+// init, then start the writer task
+esp_err_t opdi_clip_start(const char *dir);
+
+// One encoded frame (ts: esp_timer ms). Copies into the ring and returns; never waits on the card.
+// One producer: the stream ring calls it for every frame it accepts.
+void opdi_clip_push_jpeg(const uint8_t *jpeg, size_t len, uint32_t ts_ms);
+
+// Start a clip, or extend the one being recorded. reason ("face", "tamper", ...) ends up in the
+// file name, reduced to [a-z0-9-]. ESP_ERR_INVALID_STATE: not initialized.
+esp_err_t opdi_clip_trigger(const char *reason);
+
+typedef struct {
+    char name[OPDI_CLIP_NAME_MAX];
+    char reason[16];
+    uint32_t seq;
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t duration_ms;
+    uint16_t width, height;   // 0: no SOF found in the first frame
+} opdi_clip_info_t;
+
+// Finished clips, newest first (at most max; the clip being written is not listed)
+esp_err_t opdi_clip_list(opdi_clip_info_t *out, size_t max, size_t *count);
+// Full path of a finished clip. ESP_ERR_INVALID_ARG: not a clip name; ESP_ERR_NOT_FOUND;
+// ESP_ERR_INVALID_STATE: still being written.
+esp_err_t opdi_clip_path(const char *name, char *path, size_t cap);
+esp_err_t opdi_clip_delete(const char *name);
+
+typedef struct {
+    uint32_t frames;         // frames taken into the ring
+    uint32_t dropped;        // frames lost to clips: the ring was full of frames not yet on the card
+    uint32_t triggers;
+    uint32_t clips;          // clips finished
+    uint32_t errors;         // clips abandoned (no card, card full, write error)
+    uint32_t written;        // frames stored in clips
+    uint64_t bytes;          // bytes written to the card
+    uint32_t writes;         // write calls: one per CONFIG_OPDI_CLIP_WRITE_KB, plus the tail of each clip
+    uint32_t write_max_ms;   // slowest write call
+    uint32_t ring_bytes;     // oldest to newest frame in the ring
+    uint32_t preroll_ms;     // time span of the ring
+    bool recording;
+    char active[OPDI_CLIP_NAME_MAX];   // clip being written, "" if none
+} opdi_clip_stats_t;
+void opdi_clip_get_stats(opdi_clip_stats_t *out);
+
+// Test hooks: a fixed clock for triggers and the post-roll deadline (0: esp_timer), and the writer
+// run in the caller until it has to wait. Returns frames written.
+void opdi_clip_test_clock(uint32_t ms);
+size_t opdi_clip_test_pump(void);
+// Drop the clip being written, empty the ring and zero the stats
+void opdi_clip_test_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,400 @@
+// Event clip recorder: every streamed JPEG frame is copied into a PSRAM pre-roll ring. A trigger pins
+// the ring from CONFIG_OPDI_CLIP_PRE_S back, and one writer task moves the pinned frames and the
+// post-roll that follows into an AVI file. Capture never waits on the card: when the writer falls
+// behind and the ring fills up with frames it has not stored yet, new frames are dropped instead.
+#include "opdi_clip.h"
+#include "opdi_clip_avi.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *TAG = "opdi_clip";
+
+#define RING_BYTES  ((uint32_t)CONFIG_OPDI_CLIP_RING_KB * 1024)
+#define WRITE_BYTES ((size_t)CONFIG_OPDI_CLIP_WRITE_KB * 1024)
+#define RING_FRAMES 512                                // frame records in the ring
+#define IDX_FRAMES  (CONFIG_OPDI_CLIP_MAX_S * 30)     // index entries per clip: 30 fps at most
+#define PRE_MS      ((uint32_t)CONFIG_OPDI_CLIP_PRE_S * 1000)
+#define POST_MS     ((uint32_t)CONFIG_OPDI_CLIP_POST_S * 1000)
+#define MAX_MS      ((uint32_t)CONFIG_OPDI_CLIP_MAX_S * 1000)
+#define PREFIX      "clip_"
+#define EXT         ".avi"
+#define PATH_MAX_LEN 96
+
+// A frame in the ring; frames never wrap, a frame that does not fit at the end starts at 0
+typedef struct {
+    uint32_t off, len, ts_ms;
+} clip_frame_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t *s_ring;
+static clip_frame_t *s_frames;        // by sequence number % RING_FRAMES
+static uint32_t s_first, s_next;      // sequence numbers: oldest frame, next frame
+static uint32_t s_head;               // ring offset after the newest frame
+// Recording: frames from s_cursor on are pinned until the writer has staged them
+static bool s_rec, s_rec_new;
+static uint32_t s_cursor, s_end_ms, s_hard_end_ms;
+static char s_reason[16];
+static char s_active[OPDI_CLIP_NAME_MAX];
+static opdi_clip_stats_t s_st;
+static uint32_t s_test_ms;
+static TaskHandle_t s_task;
+static char s_dir[64];
+
+// Writer task only
+static clip_avi_t s_avi;
+static bool s_open;
+static char s_path[PATH_MAX_LEN];
+static uint8_t *s_wbuf;
+static uint32_t *s_idx;
+static uint32_t s_file_seq;
+
+static uint32_t now_ms(void){
+    return s_test_ms ? s_test_ms : (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static bool after(uint32_t a, uint32_t b){
+    return (int32_t)(a - b) > 0;
+}
+
+// Stream ring hook (opdi_cam_stream.c), replaces the no-op in opdi_cam_manager.c
+void opdi_cam_clip_frame(const uint8_t *jpeg, size_t len, uint32_t ts_ms){
+    opdi_clip_push_jpeg(jpeg, len, ts_ms);
+}
+
+// RGB565 encode stage (opdi_cam_encode.c): keep MAIN encoded for the pre-roll while nobody watches
+bool opdi_cam_clip_wants_frames(void){
+    return s_ring != NULL;
+}
+
+void opdi_clip_push_jpeg(const uint8_t *jpeg, size_t len, uint32_t ts_ms){
+    if (!s_ring || !jpeg || !len) return;
+    uint32_t need = ((uint32_t)len + 3) & ~3u;
+    bool ok = need <= RING_BYTES / 4;
+    taskENTER_CRITICAL(&s_lock);
+    bool wrap = s_head + need > RING_BYTES;
+    uint32_t off = wrap ? 0 : s_head, end = off + need;
+    // Evict the oldest frames in the way: past the head up to the end of the ring, then from 0
+    while (ok && s_first != s_next) {
+        const clip_frame_t *f = &s_frames[s_first % RING_FRAMES];
+        bool in_way = s_next - s_first == RING_FRAMES ||
+                      (wrap ? (f->off >= s_head || f->off < end) : (f->off >= s_head && f->off < end));
+        if (!in_way) break;
+        if (s_rec && !after(s_cursor, s_first)) ok = false;   // pinned: the writer is behind
+        else s_first++;
+    }
+    if (!ok) s_st.dropped++;
+    taskEXIT_CRITICAL(&s_lock);
+    if (!ok) return;
+    // Outside the lock: the range is no frame's any more and the writer reads only committed frames
+    memcpy(s_ring + off, jpeg, len);
+    taskENTER_CRITICAL(&s_lock);
+    clip_frame_t *f = &s_frames[s_next % RING_FRAMES];
+    f->off = off; f->len = (uint32_t)len; f->ts_ms = ts_ms;
+    s_next++;
+    s_head = end;
+    s_st.frames++;
+    bool wake = s_rec;
+    taskEXIT_CRITICAL(&s_lock);
+    if (wake && s_task) xTaskNotifyGive(s_task);
+}
+
+esp_err_t opdi_clip_trigger(const char *reason){
+    if (!s_ring) return ESP_ERR_INVALID_STATE;
+    uint32_t now = now_ms();
+    taskENTER_CRITICAL(&s_lock);
+    s_st.triggers++;
+    if (s_rec) {
+        uint32_t end = after(now + POST_MS, s_hard_end_ms) ? s_hard_end_ms : now + POST_MS;
+        if (after(end, s_end_ms)) s_end_ms = end;
+    } else {
+        uint32_t from = now - PRE_MS;
+        s_cursor = s_first;
+        while (s_cursor != s_next && after(from, s_frames[s_cursor % RING_FRAMES].ts_ms)) s_cursor++;
+        s_end_ms = now + POST_MS;
+        s_hard_end_ms = from + MAX_MS;
+        if (after(s_end_ms, s_hard_end_ms)) s_end_ms = s_hard_end_ms;
+        size_t n = 0;
+        for (const char *p = reason ? reason : ""; *p && n < sizeof(s_reason) - 1; p++) {
+            char c = *p >= 'A' && *p <= 'Z' ? (char)(*p + 32) : *p;
+            if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-') s_reason[n++] = c;
+        }
+        if (!n) n = (size_t)snprintf(s_reason, sizeof(s_reason), "event");
+        s_reason[n] = 0;
+        s_rec = s_rec_new = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (s_task) xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+// ---- writer ----
+// Remove the oldest clip when there are more than CONFIG_OPDI_CLIP_KEEP; false when there are not
+static bool prune_one(void){
+    DIR *d = opendir(s_dir);
+    if (!d) return false;
+    uint32_t oldest = UINT32_MAX, n = 0;
+    char name[OPDI_CLIP_NAME_MAX] = "";
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned seq;
+        if (sscanf(e->d_name, PREFIX "%u", &seq) != 1 || strlen(e->d_name) >= sizeof(name)) continue;
+        n++;
+        if (seq < oldest) { oldest = seq; strcpy(name, e->d_name); }
+    }
+    closedir(d);
+    if (n <= CONFIG_OPDI_CLIP_KEEP || !name[0]) return false;
+    char path[PATH_MAX_LEN];
+    snprintf(path, sizeof(path), "%s/%s", s_dir, name);
+    if (remove(path)) return false;
+    ESP_LOGI(TAG, "removed %s (keeping %d)", name, CONFIG_OPDI_CLIP_KEEP);
+    return true;
+}
+
+static void end_clip(bool ok){
+    if (s_open) {
+        if (ok && clip_avi_close(&s_avi) != ESP_OK) ok = false;
+        if (!ok) clip_avi_abort(&s_avi, s_path);
+    }
+    taskENTER_CRITICAL(&s_lock);
+    if (s_open || !ok) {
+        if (ok) { s_st.clips++; s_st.written += s_avi.n; }
+        else s_st.errors++;
+        s_st.bytes += s_avi.bytes;
+        s_st.writes += s_avi.writes;
+        if (s_avi.write_max_us / 1000 > s_st.write_max_ms) s_st.write_max_ms = s_avi.write_max_us / 1000;
+    }
+    s_rec = false;
+    s_active[0] = 0;
+    taskEXIT_CRITICAL(&s_lock);
+    if (!s_open) return;
+    s_open = false;
+    if (ok) {
+        ESP_LOGI(TAG, "%s: %u frames, %u KB in %u writes", s_path, (unsigned)s_avi.n, (unsigned)(s_avi.bytes / 1024), (unsigned)s_avi.writes);
+        while (prune_one()) { }
+    } else {
+        ESP_LOGW(TAG, "%s: write failed, clip dropped", s_path);
+    }
+}
+
+static esp_err_t open_clip(const char *reason){
+    char name[OPDI_CLIP_NAME_MAX];
+    snprintf(name, sizeof(name), PREFIX "%05u_%s" EXT, (unsigned)s_file_seq++, reason);
+    snprintf(s_path, sizeof(s_path), "%s/%s", s_dir, name);
+    esp_err_t err = clip_avi_open(&s_avi, s_path, s_wbuf, WRITE_BYTES, s_idx, IDX_FRAMES);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "cannot create %s (card missing or full?)", s_path);
+        clip_avi_abort(&s_avi, s_path);
+        return err;
+    }
+    s_open = true;
+    taskENTER_CRITICAL(&s_lock);
+    strcpy(s_active, name);
+    taskEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+// Stage pinned frames into the clip; close it once past its end. Returns frames written.
+static size_t writer_run(void){
+    static char reason[sizeof(s_reason)];   // of the clip the next file is for
+    size_t n = 0;
+    for (;;) {
+        taskENTER_CRITICAL(&s_lock);
+        bool rec = s_rec;
+        uint32_t seq = s_cursor, end = s_end_ms;
+        bool have = rec && seq != s_next;
+        clip_frame_t f = have ? s_frames[seq % RING_FRAMES] : (clip_frame_t){ 0 };
+        // A trigger only starts a clip after end_clip(), so no file is open here
+        if (s_rec_new) strcpy(reason, s_reason);
+        s_rec_new = false;
+        taskEXIT_CRITICAL(&s_lock);
+        if (!rec) return n;
+        if (have ? after(f.ts_ms, end) : after(now_ms(), end)) { end_clip(true); return n; }
+        if (!have) return n;
+        // The file is created with the first frame: a trigger without frames leaves nothing behind
+        if (!s_open && open_clip(reason) != ESP_OK) { end_clip(false); return n; }
+        esp_err_t err = clip_avi_frame(&s_avi, s_ring + f.off, f.len, f.ts_ms);
+        taskENTER_CRITICAL(&s_lock);
+        s_cursor = seq + 1;   // staged: the ring may reuse it
+        taskEXIT_CRITICAL(&s_lock);
+        if (err == ESP_ERR_NO_MEM) { end_clip(true); return n; }   // index full: the next trigger starts a new clip
+        if (err != ESP_OK) { end_clip(false); return n; }
+        n++;
+    }
+}
+
+static void writer_task(void *arg){
+    for (;;) {
+        // The post-roll ends on time even when no frame comes
+        ulTaskNotifyTake(pdTRUE, s_rec ? pdMS_TO_TICKS(200) : portMAX_DELAY);
+        writer_run();
+    }
+}
+
+static uint32_t scan_next_seq(void){
+    uint32_t next = 0;
+    DIR *d = opendir(s_dir);
+    if (!d) return 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned seq;
+        if (sscanf(e->d_name, PREFIX "%u", &seq) == 1 && seq + 1 > next) next = seq + 1;
+    }
+    closedir(d);
+    return next;
+}
+
+esp_err_t opdi_clip_init(const char *dir){
+    if (s_ring) return ESP_OK;
+    snprintf(s_dir, sizeof(s_dir), "%s", dir ? dir : CONFIG_OPDI_CLIP_DIR);
+    uint8_t *ring = heap_caps_malloc(RING_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_frames = heap_caps_calloc(RING_FRAMES, sizeof(clip_frame_t), MALLOC_CAP_SPIRAM);
+    s_idx = heap_caps_malloc(IDX_FRAMES * 2 * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    // Staging in internal DMA-capable RAM: the SD driver writes it without a bounce copy
+    s_wbuf = heap_caps_aligned_alloc(64, WRITE_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!s_wbuf) s_wbuf = heap_caps_aligned_alloc(64, WRITE_BYTES, MALLOC_CAP_SPIRAM);
+    if (!ring || !s_frames || !s_idx || !s_wbuf) {
+        heap_caps_free(ring); heap_caps_free(s_frames); heap_caps_free(s_idx); heap_caps_free(s_wbuf);
+        s_frames = NULL; s_idx = NULL; s_wbuf = NULL;
+        ESP_LOGE(TAG, "no memory for the %u KB pre-roll ring", (unsigned)CONFIG_OPDI_CLIP_RING_KB);
+        return ESP_ERR_NO_MEM;
+    }
+    if (mkdir(s_dir, 0775) && errno != EEXIST) ESP_LOGW(TAG, "cannot create %s; clips fail until it exists", s_dir);
+    s_file_seq = scan_next_seq();
+    s_ring = ring;
+    ESP_LOGI(TAG, "%u KB pre-roll ring, clips in %s from #%u", (unsigned)CONFIG_OPDI_CLIP_RING_KB, s_dir, (unsigned)s_file_seq);
+    return ESP_OK;
+}
+
+esp_err_t opdi_clip_start(const char *dir){
+    esp_err_t err = opdi_clip_init(dir);
+    if (err != ESP_OK) return err;
+    // Stack: directory scans and the file path; frames are staged from the ring, not copied
+    if (!s_task && xTaskCreate(writer_task, "clip_wr", 4096, NULL, CONFIG_OPDI_CLIP_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "writer task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// ---- finished clips ----
+static bool valid_name(const char *name){
+    size_t n = strlen(name), e = strlen(EXT);
+    unsigned seq;
+    if (n >= OPDI_CLIP_NAME_MAX || n <= e || strcmp(name + n - e, EXT) || sscanf(name, PREFIX "%u", &seq) != 1) return false;
+    return !strchr(name, '/') && !strchr(name, '\\') && !strstr(name, "..");
+}
+
+static bool is_active(const char *name){
+    taskENTER_CRITICAL(&s_lock);
+    bool a = !strcmp(name, s_active);
+    taskEXIT_CRITICAL(&s_lock);
+    return a;
+}
+
+esp_err_t opdi_clip_list(opdi_clip_info_t *out, size_t max, size_t *count){
+    *count = 0;
+    DIR *d = opendir(s_dir);
+    if (!d) return ESP_ERR_NOT_FOUND;
+    size_t n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (!valid_name(e->d_name) || is_active(e->d_name)) continue;
+        unsigned seq;
+        sscanf(e->d_name, PREFIX "%u", &seq);
+        // Full: keep the newest, replacing the oldest kept so far
+        size_t slot = n;
+        if (n == max) {
+            slot = 0;
+            for (size_t i=1; i<n; i++) if (out[i].seq < out[slot].seq) slot = i;
+            if (!max || out[slot].seq > seq) continue;
+        } else {
+            n++;
+        }
+        opdi_clip_info_t *c = &out[slot];
+        memset(c, 0, sizeof(*c));
+        strcpy(c->name, e->d_name);
+        c->seq = seq;
+        const char *r = strchr(e->d_name + strlen(PREFIX), '_');
+        if (r) snprintf(c->reason, sizeof(c->reason), "%.*s", (int)(strlen(r + 1) - strlen(EXT)), r + 1);
+    }
+    closedir(d);
+    for (size_t i=0; i<n; i++) {
+        char path[PATH_MAX_LEN];
+        struct stat st;
+        clip_avi_info_t info;
+        snprintf(path, sizeof(path), "%s/%s", s_dir, out[i].name);
+        if (!stat(path, &st)) out[i].bytes = (uint32_t)st.st_size;
+        if (clip_avi_read_info(path, &info) == ESP_OK) {
+            out[i].frames = info.frames;
+            out[i].duration_ms = (uint32_t)((uint64_t)info.frames * info.us_per_frame / 1000);
+            out[i].width = info.w; out[i].height = info.h;
+        }
+    }
+    // Newest first
+    for (size_t i=1; i<n; i++) {
+        opdi_clip_info_t t = out[i];
+        size_t j = i;
+        for (; j > 0 && out[j - 1].seq < t.seq; j--) out[j] = out[j - 1];
+        out[j] = t;
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+esp_err_t opdi_clip_path(const char *name, char *path, size_t cap){
+    if (!name || !valid_name(name)) return ESP_ERR_INVALID_ARG;
+    if (is_active(name)) return ESP_ERR_INVALID_STATE;
+    snprintf(path, cap, "%s/%s", s_dir, name);
+    struct stat st;
+    return stat(path, &st) ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+esp_err_t opdi_clip_delete(const char *name){
+    char path[PATH_MAX_LEN];
+    esp_err_t err = opdi_clip_path(name, path, sizeof(path));
+    if (err != ESP_OK) return err;
+    return remove(path) ? ESP_FAIL : ESP_OK;
+}
+
+void opdi_clip_get_stats(opdi_clip_stats_t *out){
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    out->recording = s_rec;
+    strcpy(out->active, s_active);
+    out->ring_bytes = out->preroll_ms = 0;
+    if (s_first != s_next) {
+        const clip_frame_t *a = &s_frames[s_first % RING_FRAMES], *z = &s_frames[(s_next - 1) % RING_FRAMES];
+        out->ring_bytes = s_head > a->off ? s_head - a->off : RING_BYTES - a->off + s_head;
+        out->preroll_ms = z->ts_ms - a->ts_ms;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void opdi_clip_test_clock(uint32_t ms){
+    s_test_ms = ms;
+}
+
+size_t opdi_clip_test_pump(void){
+    return writer_run();
+}
+
+void opdi_clip_test_reset(void){
+    if (s_open) clip_avi_abort(&s_avi, s_path);
+    s_open = false;
+    taskENTER_CRITICAL(&s_lock);
+    s_first = s_next = s_head = 0;
+    s_rec = s_rec_new = false;
+    s_active[0] = 0;
+    memset(&s_st, 0, sizeof(s_st));
+    taskEXIT_CRITICAL(&s_lock);
+}
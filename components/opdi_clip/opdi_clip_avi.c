@@ -0,0 +1,179 @@
+// AVI (MJPEG) container for event clips: header placeholder, 00dc chunks, idx1, final header
+#include "opdi_clip_avi.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#define MOVI_FOURCC_AT (CLIP_AVI_HDR - 4)   // idx1 offsets count from the "movi" fourcc
+#define AVIF_HASINDEX  0x10
+#define AVIIF_KEYFRAME 0x10
+#define DEFAULT_US_PER_FRAME 66666           // 15 fps when a clip has a single frame
+
+static void put32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static void put16(uint8_t *p, uint16_t v){
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+}
+
+static uint32_t get32(const uint8_t *p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void fourcc(uint8_t *p, const char *cc){
+    memcpy(p, cc, 4);
+}
+
+static void build_header(const clip_avi_t *a, uint8_t *h){
+    uint32_t us = DEFAULT_US_PER_FRAME;
+    if (a->n > 1) {
+        us = (uint32_t)((uint64_t)(a->last_ts - a->first_ts) * 1000 / (a->n - 1));
+        if (us < 1000) us = 1000;
+    }
+    uint32_t idx1 = 8 + a->n * 16;
+    memset(h, 0, CLIP_AVI_HDR);
+    fourcc(h, "RIFF"); put32(h + 4, CLIP_AVI_HDR - 8 + a->movi_bytes + idx1); fourcc(h + 8, "AVI ");
+    fourcc(h + 12, "LIST"); put32(h + 16, 192); fourcc(h + 20, "hdrl");
+    // avih
+    fourcc(h + 24, "avih"); put32(h + 28, 56);
+    put32(h + 32, us);
+    put32(h + 36, (uint32_t)((uint64_t)a->max_frame * 1000000 / us));
+    put32(h + 44, AVIF_HASINDEX);
+    put32(h + 48, a->n);
+    put32(h + 56, 1);                  // streams
+    put32(h + 60, a->max_frame);
+    put32(h + 64, a->w); put32(h + 68, a->h);
+    // strl: strh + strf
+    fourcc(h + 88, "LIST"); put32(h + 92, 116); fourcc(h + 96, "strl");
+    fourcc(h + 100, "strh"); put32(h + 104, 56);
+    fourcc(h + 108, "vids"); fourcc(h + 112, "MJPG");
+    put32(h + 128, us); put32(h + 132, 1000000);   // rate / scale = fps
+    put32(h + 140, a->n);
+    put32(h + 144, a->max_frame);
+    put32(h + 148, 0xffffffff);       // quality: default
+    put16(h + 160, a->w); put16(h + 162, a->h);
+    fourcc(h + 164, "strf"); put32(h + 168, 40);
+    put32(h + 172, 40); put32(h + 176, a->w); put32(h + 180, a->h);
+    put16(h + 184, 1); put16(h + 186, 24);
+    fourcc(h + 188, "MJPG"); put32(h + 192, (uint32_t)a->w * a->h * 3);
+    // movi list; its chunks follow
+    fourcc(h + 212, "LIST"); put32(h + 216, 4 + a->movi_bytes); fourcc(h + 220, "movi");
+}
+
+static esp_err_t flush(clip_avi_t *a){
+    if (!a->fill) return ESP_OK;
+    int64_t t0 = esp_timer_get_time();
+    size_t n = fwrite(a->buf, 1, a->fill, a->f);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    a->writes++;
+    if (us > a->write_max_us) a->write_max_us = us;
+    if (n != a->fill) return ESP_FAIL;
+    a->bytes += n;
+    a->fill = 0;
+    return ESP_OK;
+}
+
+static esp_err_t stage(clip_avi_t *a, const void *data, size_t len){
+    const uint8_t *p = data;
+    while (len) {
+        size_t room = a->cap - a->fill, n = len < room ? len : room;
+        memcpy(a->buf + a->fill, p, n);
+        a->fill += n; p += n; len -= n;
+        if (a->fill == a->cap && flush(a) != ESP_OK) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t clip_avi_open(clip_avi_t *a, const char *path, uint8_t *buf, size_t cap, uint32_t *idx, uint32_t idx_max){
+    memset(a, 0, sizeof(*a));
+    a->f = fopen(path, "wb");
+    if (!a->f) return ESP_ERR_NOT_FOUND;
+    // Writes are already whole units; stdio buffering would only split them
+    setvbuf(a->f, NULL, _IONBF, 0);
+    a->buf = buf; a->cap = cap;
+    a->idx = idx; a->idx_max = idx_max;
+    uint8_t h[CLIP_AVI_HDR];
+    build_header(a, h);
+    return stage(a, h, sizeof(h));
+}
+
+esp_err_t clip_avi_frame(clip_avi_t *a, const uint8_t *jpeg, size_t len, uint32_t ts_ms){
+    if (a->n == a->idx_max) return ESP_ERR_NO_MEM;
+    if (!a->n) {
+        a->first_ts = ts_ms;
+        clip_jpeg_size(jpeg, len, &a->w, &a->h);
+    }
+    uint8_t ch[8];
+    fourcc(ch, "00dc"); put32(ch + 4, (uint32_t)len);
+    a->idx[2 * a->n] = 4 + a->movi_bytes;
+    a->idx[2 * a->n + 1] = (uint32_t)len;
+    static const uint8_t pad = 0;
+    if (stage(a, ch, 8) != ESP_OK || stage(a, jpeg, len) != ESP_OK || ((len & 1) && stage(a, &pad, 1) != ESP_OK)) return ESP_FAIL;
+    a->movi_bytes += 8 + (uint32_t)((len + 1) & ~(size_t)1);
+    if (len > a->max_frame) a->max_frame = (uint32_t)len;
+    a->last_ts = ts_ms;
+    a->n++;
+    return ESP_OK;
+}
+
+esp_err_t clip_avi_close(clip_avi_t *a){
+    uint8_t e[16];
+    fourcc(e, "idx1"); put32(e + 4, a->n * 16);
+    esp_err_t err = stage(a, e, 8);
+    for (uint32_t i=0; i<a->n && err == ESP_OK; i++) {
+        fourcc(e, "00dc"); put32(e + 4, AVIIF_KEYFRAME);
+        put32(e + 8, a->idx[2 * i]); put32(e + 12, a->idx[2 * i + 1]);
+        err = stage(a, e, 16);
+    }
+    if (err == ESP_OK) err = flush(a);
+    // The header was written with zero counts when the clip was opened
+    uint8_t h[CLIP_AVI_HDR];
+    build_header(a, h);
+    if (err == ESP_OK && (fseek(a->f, 0, SEEK_SET) || fwrite(h, 1, sizeof(h), a->f) != sizeof(h))) err = ESP_FAIL;
+    if (fclose(a->f) && err == ESP_OK) err = ESP_FAIL;
+    a->f = NULL;
+    return err;
+}
+
+void clip_avi_abort(clip_avi_t *a, const char *path){
+    if (a->f) fclose(a->f);
+    a->f = NULL;
+    remove(path);
+}
+
+esp_err_t clip_avi_read_info(const char *path, clip_avi_info_t *out){
+    uint8_t h[CLIP_AVI_HDR];
+    FILE *f = fopen(path, "rb");
+    if (!f) return ESP_ERR_NOT_FOUND;
+    size_t n = fread(h, 1, sizeof(h), f);
+    fclose(f);
+    if (n != sizeof(h) || memcmp(h, "RIFF", 4) || memcmp(h + 8, "AVI ", 4) || memcmp(h + 24, "avih", 4)) return ESP_ERR_INVALID_RESPONSE;
+    out->us_per_frame = get32(h + 32);
+    out->frames = get32(h + 48);
+    out->w = (uint16_t)get32(h + 64);
+    out->h = (uint16_t)get32(h + 68);
+    return ESP_OK;
+}
+
+bool clip_jpeg_size(const uint8_t *p, size_t len, uint16_t *w, uint16_t *h){
+    *w = *h = 0;
+    size_t i = 2;
+    if (len < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+    while (i + 4 <= len) {
+        if (p[i] != 0xFF) return false;
+        uint8_t m = p[i + 1];
+        if (m == 0xFF) { i++; continue; }
+        if (m == 0x01 || (m >= 0xD0 && m <= 0xD7)) { i += 2; continue; }
+        if (m == 0xDA || m == 0xD9) return false;
+        size_t seg = (size_t)(p[i + 2] << 8 | p[i + 3]);
+        // SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+        if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+            if (i + 9 > len) return false;
+            *h = (uint16_t)(p[i + 5] << 8 | p[i + 6]);
+            *w = (uint16_t)(p[i + 7] << 8 | p[i + 8]);
+            return true;
+        }
+        i += 2 + seg;
+    }
+    return false;
+}
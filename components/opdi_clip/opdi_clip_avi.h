@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+// AVI (RIFF, MJPEG) writer under the clip recorder. One 00dc chunk per JPEG frame in the movi list,
+// then an idx1 index; a player needs nothing else.
+
+#define CLIP_AVI_HDR 224   // RIFF + hdrl (avih, strl/strh/strf) + movi list header
+
+// Everything goes through buf and leaves it in whole units of cap bytes, so each fwrite starts at a
+// multiple of cap in the file. The header is rewritten in place when the clip is closed.
+typedef struct {
+    FILE *f;
+    uint8_t *buf;
+    size_t cap, fill;
+    uint32_t *idx;              // (offset from the movi fourcc, size) per frame
+    uint32_t n, idx_max;
+    uint32_t movi_bytes;        // chunks in the movi list
+    uint32_t max_frame;
+    uint32_t first_ts, last_ts;
+    uint16_t w, h;
+    uint64_t bytes;             // written to the file
+    uint32_t writes, write_max_us;
+} clip_avi_t;
+
+esp_err_t clip_avi_open(clip_avi_t *a, const char *path, uint8_t *buf, size_t cap, uint32_t *idx, uint32_t idx_max);
+// ESP_ERR_NO_MEM: the index is full (the clip should be closed); ESP_FAIL: write error
+esp_err_t clip_avi_frame(clip_avi_t *a, const uint8_t *jpeg, size_t len, uint32_t ts_ms);
+// Index and final header; the file is closed in every case
+esp_err_t clip_avi_close(clip_avi_t *a);
+// Close and delete a clip that cannot be finished
+void clip_avi_abort(clip_avi_t *a, const char *path);
+
+typedef struct {
+    uint32_t frames, us_per_frame;
+    uint16_t w, h;
+} clip_avi_info_t;
+esp_err_t clip_avi_read_info(const char *path, clip_avi_info_t *out);
+
+// Width and height from the SOF marker
+bool clip_jpeg_size(const uint8_t *jpeg, size_t len, uint16_t *w, uint16_t *h);
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Face gallery (SRD FR-4/FR-5, §6 "Gallery"): fixed-length {id, label, int8 embedding} records.
+// The table lives in PSRAM; every change is written through to CONFIG_OPDI_GALLERY_PATH on `storage`.
+#define OPDI_GALLERY_DIM        CONFIG_OPDI_GALLERY_EMBED_DIM
+#define OPDI_GALLERY_CAPACITY   CONFIG_OPDI_GALLERY_MAX_IDENTITIES
+#define OPDI_GALLERY_LABEL_LEN  32   // including the terminator
+#define OPDI_GALLERY_Q_SCALE    127  // a unit-norm embedding is stored as round(x * 127)
+
+typedef struct {
+    uint16_t id;                          // stable across deletes and reboots, never reused
+    char label[OPDI_GALLERY_LABEL_LEN];
+    uint32_t created;                     // unix time (0 if SNTP had not synced)
+} opdi_gallery_entry_t;
+
+typedef struct {
+    uint16_t id;      // best entry (valid when the gallery is not empty)
+    bool matched;     // score >= CONFIG_OPDI_GALLERY_MATCH_THRESHOLD / 100
+    float score;      // cosine similarity of the int8 vectors, -1..1
+    float dist;       // L2 distance of the dequantized vectors (0..2 for unit-norm embeddings)
+    float second;     // best score among the other identities (-1 if none): a small margin means ambiguous
+    uint32_t scan_us; // time spent scanning the table
+} opdi_gallery_match_t;
+
+// Allocate the table and load the gallery file. path NULL = CONFIG_OPDI_GALLERY_PATH.
+esp_err_t opdi_gallery_init(const char *path);
+void opdi_gallery_deinit(void);
+
+// Add an identity. ESP_ERR_NO_MEM when the gallery is full; the write-through error otherwise.
+esp_err_t opdi_gallery_add(const char *label, const int8_t *emb, uint16_t *out_id);
+esp_err_t opdi_gallery_rename(uint16_t id, const char *label);
+esp_err_t opdi_gallery_delete(uint16_t id);
+// Copy one entry (and its embedding when emb != NULL, OPDI_GALLERY_DIM bytes). ESP_ERR_NOT_FOUND.
+esp_err_t opdi_gallery_get(uint16_t id, opdi_gallery_entry_t *out, int8_t *emb);
+size_t opdi_gallery_count(void);
+// Copy up to max entries in table order; returns the number copied
+size_t opdi_gallery_list(opdi_gallery_entry_t *out, size_t max);
+// Rewrite the whole file (also repairs a missing or foreign file)
+esp_err_t opdi_gallery_save(void);
+
+// ---- Bulk transfer (SRD FR-7) ----
+#define OPDI_GALLERY_BATCH_MAX 64    // records per opdi_gallery_put_batch()
+
+typedef struct {
+    opdi_gallery_entry_t entry;
+    int8_t emb[OPDI_GALLERY_DIM];
+} opdi_gallery_record_t;
+
+// Copy the record at table position i (0 .. count-1). ESP_ERR_NOT_FOUND past the end.
+esp_err_t opdi_gallery_get_at(size_t i, opdi_gallery_record_t *out);
+// Remove every identity (ids are still not reused)
+esp_err_t opdi_gallery_clear(void);
+// Store up to OPDI_GALLERY_BATCH_MAX records with their own ids: an existing id is overwritten,
+// a new one appended. The file is committed once for the whole batch. ESP_ERR_NO_MEM when the
+// gallery fills up (the records before that are kept).
+esp_err_t opdi_gallery_put_batch(const opdi_gallery_record_t *recs, size_t n);
+
+typedef enum {
+    OPDI_GALLERY_FMT_JSON,   // {"format":"opdi-gallery",...,"identities":[{id,label,created,emb(base64)}],"count":n}
+    OPDI_GALLERY_FMT_GAL,    // the gallery file format: header + fixed-length binary records
+} opdi_gallery_fmt_t;
+
+typedef esp_err_t (*opdi_gallery_write_t)(void *ctx, const char *data, size_t len);
+
+// Stream the gallery record by record through write (an HTTP chunk sink, a file, ...). The table
+// lock is only held while one record is copied, so matching keeps running during a slow download.
+esp_err_t opdi_gallery_export(opdi_gallery_fmt_t fmt, opdi_gallery_write_t write, void *ctx, size_t *out_count);
+
+// Incremental import: feed the document in pieces of any size as they arrive. Records are
+// collected into batches of CONFIG_OPDI_GALLERY_IMPORT_BATCH and stored with
+// opdi_gallery_put_batch(). replace: the gallery is cleared when the first batch is stored, so a
+// document rejected at its header leaves it untouched.
+typedef struct opdi_gallery_import opdi_gallery_import_t;
+esp_err_t opdi_gallery_import_begin(opdi_gallery_fmt_t fmt, bool replace, opdi_gallery_import_t **out);
+// ESP_ERR_INVALID_ARG: malformed document or record, ESP_ERR_INVALID_VERSION: a .gal header of
+// another version or dimension, ESP_ERR_INVALID_SIZE: a record or base64 embedding of the wrong size.
+// After an error the import only accepts opdi_gallery_import_end().
+esp_err_t opdi_gallery_import_feed(opdi_gallery_import_t *im, const void *data, size_t len);
+// Store the last batch and free the import. Returns the first error of the import, or
+// ESP_ERR_INVALID_SIZE when the document ended early. out_count: records stored.
+esp_err_t opdi_gallery_import_end(opdi_gallery_import_t *im, size_t *out_count);
+
+// Best match for a query embedding. ESP_ERR_NOT_FOUND when the gallery is empty.
+esp_err_t opdi_gallery_match(const int8_t *query, opdi_gallery_match_t *out);
+
+// Change hook: runs after every add, rename, delete, clear and import batch, with the gallery lock held
+// (keep it short). Weak no-op here; opdi_recog_cache.c provides the real one when linked.
+void opdi_gallery_changed(void);
+
+// L2-normalize a float embedding and quantize it to int8 (the stored representation)
+void opdi_gallery_quantize(const float *in, int8_t *out, size_t dim);
+
+// Dot product kernels. opdi_gallery_dot_s8 is the matcher's 4-accumulator loop; opdi_gallery_dot_s8_ref is the
+// plain scalar reference it is tested and benchmarked against.
+int32_t opdi_gallery_dot_s8(const int8_t *a, const int8_t *b, size_t n);
+int32_t opdi_gallery_dot_s8_ref(const int8_t *a, const int8_t *b, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
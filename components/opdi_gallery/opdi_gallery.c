@@ -0,0 +1,346 @@
+// Face gallery store: PSRAM table of fixed-length records, written through to a file on `storage`
+#include "opdi_gallery.h"
+#include "opdi_gallery_file.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "opdi_gallery";
+
+_Static_assert(OPDI_GALLERY_DIM % 16 == 0, "OPDI_GALLERY_EMBED_DIM must be a multiple of 16 (SIMD block)");
+
+static opdi_gallery_entry_t *s_meta;  // PSRAM, OPDI_GALLERY_CAPACITY
+static int8_t *s_emb;                 // PSRAM, 16-byte aligned rows of OPDI_GALLERY_DIM
+static float *s_inv_norm;             // 1/|row| for the cosine score
+static size_t s_count;
+static uint16_t s_next_id = 1;
+static char s_path[64];
+static SemaphoreHandle_t s_lock;
+
+static inline int8_t *row(size_t i){ return s_emb + i * OPDI_GALLERY_DIM; }
+
+static float inv_norm(const int8_t *v){
+    int32_t n2 = opdi_gallery_dot_s8(v, v, OPDI_GALLERY_DIM);
+    return n2 > 0 ? 1.0f / sqrtf((float)n2) : 0.0f;
+}
+
+static int find(uint16_t id){
+    for (size_t i=0; i<s_count; i++) if (s_meta[i].id == id) return (int)i;
+    return -1;
+}
+
+static void copy_label(char *dst, const char *src){
+    memset(dst, 0, OPDI_GALLERY_LABEL_LEN);
+    strlcpy(dst, src ? src : "", OPDI_GALLERY_LABEL_LEN);
+}
+
+static void hdr_fill(gal_hdr_t *h){
+    memcpy(h->magic, GAL_MAGIC, 4);
+    h->version = GAL_VERSION;
+    h->dim = OPDI_GALLERY_DIM;
+    h->count = (uint32_t)s_count;
+    h->next_id = s_next_id;
+    h->label_len = OPDI_GALLERY_LABEL_LEN;
+}
+
+void gal_hdr_snapshot(gal_hdr_t *h){
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+    hdr_fill(h);
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static bool rec_write(FILE *f, size_t i){
+    gal_rec_t r = { .id = s_meta[i].id, .created = s_meta[i].created };
+    memcpy(r.label, s_meta[i].label, OPDI_GALLERY_LABEL_LEN);
+    return fwrite(&r, sizeof(r), 1, f) == 1 && fwrite(row(i), OPDI_GALLERY_DIM, 1, f) == 1;
+}
+
+static esp_err_t save_locked(void){
+    FILE *f = fopen(s_path, "wb");
+    if (!f){ ESP_LOGE(TAG, "cannot write %s", s_path); return ESP_FAIL; }
+    gal_hdr_t h; hdr_fill(&h);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (size_t i=0; ok && i<s_count; i++) ok = rec_write(f, i);
+    if (fclose(f) != 0) ok = false;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+// Write record i (if i >= 0) and the header in place; fall back to a full rewrite when the file
+// is missing or shorter than expected
+static esp_err_t persist_locked(int i){
+    FILE *f = fopen(s_path, "r+b");
+    if (!f) return save_locked();
+    bool ok = true;
+    if (i >= 0){
+        ok = fseek(f, (long)(sizeof(gal_hdr_t) + (size_t)i * REC_BYTES), SEEK_SET) == 0 && rec_write(f, (size_t)i);
+    }
+    gal_hdr_t h; hdr_fill(&h);
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1;
+    if (fclose(f) != 0) ok = false;
+    return ok ? ESP_OK : save_locked();
+}
+
+static void load_locked(void){
+    FILE *f = fopen(s_path, "rb");
+    if (!f){ ESP_LOGI(TAG, "no gallery at %s, starting empty", s_path); return; }
+    gal_hdr_t h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, GAL_MAGIC, 4) || h.version != GAL_VERSION ||
+        h.dim != OPDI_GALLERY_DIM || h.label_len != OPDI_GALLERY_LABEL_LEN){
+        // A different embedding size means a different model: those vectors cannot be matched
+        ESP_LOGW(TAG, "%s: not a v%d gallery with dim %d, ignored (replaced on the next change)", s_path, GAL_VERSION, OPDI_GALLERY_DIM);
+        fclose(f);
+        return;
+    }
+    size_t n = h.count;
+    if (n > OPDI_GALLERY_CAPACITY){
+        ESP_LOGW(TAG, "%s holds %u identities, capacity is %d", s_path, (unsigned)n, OPDI_GALLERY_CAPACITY);
+        n = OPDI_GALLERY_CAPACITY;
+    }
+    gal_rec_t r;
+    while (s_count < n && fread(&r, sizeof(r), 1, f) == 1 && fread(row(s_count), OPDI_GALLERY_DIM, 1, f) == 1){
+        opdi_gallery_entry_t *e = &s_meta[s_count];
+        e->id = r.id; e->created = r.created;
+        memcpy(e->label, r.label, OPDI_GALLERY_LABEL_LEN);
+        e->label[OPDI_GALLERY_LABEL_LEN - 1] = 0;
+        s_inv_norm[s_count] = inv_norm(row(s_count));
+        if (r.id >= h.next_id) h.next_id = r.id + 1;
+        s_count++;
+    }
+    fclose(f);
+    s_next_id = h.next_id ? h.next_id : 1;
+    if (s_count < n) ESP_LOGW(TAG, "%s truncated: %u of %u records", s_path, (unsigned)s_count, (unsigned)n);
+    // Past the capacity the header count must shrink too, or the next in-place write revives them
+    if (s_count != h.count) save_locked();
+}
+
+esp_err_t opdi_gallery_init(const char *path){
+    if (s_lock) return ESP_OK;
+    s_meta = heap_caps_calloc(OPDI_GALLERY_CAPACITY, sizeof(*s_meta), MALLOC_CAP_SPIRAM);
+    s_emb = heap_caps_aligned_alloc(16, (size_t)OPDI_GALLERY_CAPACITY * OPDI_GALLERY_DIM, MALLOC_CAP_SPIRAM);
+    s_inv_norm = heap_caps_malloc(OPDI_GALLERY_CAPACITY * sizeof(float), MALLOC_CAP_SPIRAM);
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_meta || !s_emb || !s_inv_norm || !s_lock){
+        opdi_gallery_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    strlcpy(s_path, path ? path : CONFIG_OPDI_GALLERY_PATH, sizeof(s_path));
+    s_count = 0; s_next_id = 1;
+    load_locked();
+    ESP_LOGI(TAG, "%u/%d identities, dim %d, %u KB PSRAM", (unsigned)s_count, OPDI_GALLERY_CAPACITY, OPDI_GALLERY_DIM,
+             (unsigned)((size_t)OPDI_GALLERY_CAPACITY * (OPDI_GALLERY_DIM + sizeof(*s_meta) + sizeof(float)) / 1024));
+    return ESP_OK;
+}
+
+void opdi_gallery_deinit(void){
+    heap_caps_free(s_meta); s_meta = NULL;
+    heap_caps_free(s_emb); s_emb = NULL;
+    heap_caps_free(s_inv_norm); s_inv_norm = NULL;
+    if (s_lock){ vSemaphoreDelete(s_lock); s_lock = NULL; }
+    s_count = 0;
+}
+
+// Change hook placeholder (opdi_recog_cache.c provides the real one when linked)
+__attribute__((weak)) void opdi_gallery_changed(void){ }
+
+esp_err_t opdi_gallery_add(const char *label, const int8_t *emb, uint16_t *out_id){
+    if (!emb || !label || !label[0]) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_count >= OPDI_GALLERY_CAPACITY || s_next_id == UINT16_MAX){
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t i = s_count;
+    opdi_gallery_entry_t *e = &s_meta[i];
+    e->id = s_next_id++;
+    copy_label(e->label, label);
+    time_t now = time(NULL);
+    e->created = now > 1600000000 ? (uint32_t)now : 0;   // before SNTP sync the clock starts at 1970
+    memcpy(row(i), emb, OPDI_GALLERY_DIM);
+    s_inv_norm[i] = inv_norm(row(i));
+    s_count++;
+    if (out_id) *out_id = e->id;
+    esp_err_t err = persist_locked((int)i);
+    opdi_gallery_changed();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_rename(uint16_t id, const char *label){
+    if (!label || !label[0]) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = find(id);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (i >= 0){
+        copy_label(s_meta[i].label, label);
+        err = persist_locked(i);
+        opdi_gallery_changed();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_delete(uint16_t id){
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = find(id);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (i >= 0){
+        // Keep the table dense: the last record moves into the hole (ids stay, order does not)
+        size_t last = s_count - 1;
+        if ((size_t)i != last){
+            s_meta[i] = s_meta[last];
+            memcpy(row(i), row(last), OPDI_GALLERY_DIM);
+            s_inv_norm[i] = s_inv_norm[last];
+        }
+        s_count--;
+        err = persist_locked((size_t)i < s_count ? i : -1);
+        opdi_gallery_changed();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_get(uint16_t id, opdi_gallery_entry_t *out, int8_t *emb){
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = find(id);
+    if (i >= 0){
+        if (out) *out = s_meta[i];
+        if (emb) memcpy(emb, row(i), OPDI_GALLERY_DIM);
+    }
+    xSemaphoreGive(s_lock);
+    return i >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+size_t opdi_gallery_count(void){
+    return s_count;
+}
+
+size_t opdi_gallery_list(opdi_gallery_entry_t *out, size_t max){
+    if (!s_lock || !out) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t n = s_count < max ? s_count : max;
+    memcpy(out, s_meta, n * sizeof(*out));
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+esp_err_t opdi_gallery_get_at(size_t i, opdi_gallery_record_t *out){
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = i < s_count;
+    if (ok){
+        out->entry = s_meta[i];
+        memcpy(out->emb, row(i), OPDI_GALLERY_DIM);
+    }
+    xSemaphoreGive(s_lock);
+    return ok ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t opdi_gallery_clear(void){
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_count = 0;   // next_id stays: ids are never reused
+    esp_err_t err = save_locked();
+    opdi_gallery_changed();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_put_batch(const opdi_gallery_record_t *recs, size_t n){
+    if (!recs || n > OPDI_GALLERY_BATCH_MAX) return ESP_ERR_INVALID_ARG;
+    for (size_t k=0; k<n; k++) if (!recs[k].entry.id || recs[k].entry.id == UINT16_MAX || !recs[k].entry.label[0]) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint16_t idx[OPDI_GALLERY_BATCH_MAX];
+    size_t done = 0;
+    esp_err_t err = ESP_OK;
+    for (; done<n; done++){
+        const opdi_gallery_record_t *r = &recs[done];
+        int i = find(r->entry.id);
+        if (i < 0){
+            if (s_count >= OPDI_GALLERY_CAPACITY){ err = ESP_ERR_NO_MEM; break; }
+            i = (int)s_count++;
+        }
+        s_meta[i].id = r->entry.id;
+        s_meta[i].created = r->entry.created;
+        copy_label(s_meta[i].label, r->entry.label);
+        memcpy(row(i), r->emb, OPDI_GALLERY_DIM);
+        s_inv_norm[i] = inv_norm(row(i));
+        if (r->entry.id >= s_next_id) s_next_id = r->entry.id + 1;
+        idx[done] = (uint16_t)i;
+    }
+    // One commit for the batch: every touched record in place, then the header once
+    FILE *f = done ? fopen(s_path, "r+b") : NULL;
+    bool ok = f != NULL;
+    for (size_t k=0; ok && k<done; k++){
+        ok = fseek(f, (long)(sizeof(gal_hdr_t) + (size_t)idx[k] * REC_BYTES), SEEK_SET) == 0 && rec_write(f, idx[k]);
+    }
+    if (f){
+        gal_hdr_t h; hdr_fill(&h);
+        ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1;
+        if (fclose(f) != 0) ok = false;
+    }
+    if (done && !ok && save_locked() != ESP_OK && err == ESP_OK) err = ESP_FAIL;
+    if (done) opdi_gallery_changed();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_save(void){
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = save_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t opdi_gallery_match(const int8_t *query, opdi_gallery_match_t *out){
+    if (!query || !out) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    memset(out, 0, sizeof(*out));
+    out->score = out->second = -1.0f;
+    // Queries from the caller's stack or a model output are rarely 16-byte aligned
+    int8_t q[OPDI_GALLERY_DIM] __attribute__((aligned(16)));
+    memcpy(q, query, sizeof(q));
+    float inv_q = inv_norm(q);
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int best = -1;
+    for (size_t i=0; i<s_count; i++){
+        float s = (float)opdi_gallery_dot_s8(q, row(i), OPDI_GALLERY_DIM) * inv_q * s_inv_norm[i];
+        if (s > out->score){ out->second = out->score; out->score = s; best = (int)i; }
+        else if (s > out->second) out->second = s;
+    }
+    if (best >= 0){
+        out->id = s_meta[best].id;
+        // |a-b|^2 = |a|^2 + |b|^2 - 2ab on the unit vectors the int8 rows approximate
+        float d2 = 2.0f - 2.0f * out->score;
+        out->dist = d2 > 0.0f ? sqrtf(d2) : 0.0f;
+        out->matched = out->score * 100.0f >= (float)CONFIG_OPDI_GALLERY_MATCH_THRESHOLD;
+    }
+    xSemaphoreGive(s_lock);
+    out->scan_us = (uint32_t)(esp_timer_get_time() - t0);
+    return best >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void opdi_gallery_quantize(const float *in, int8_t *out, size_t dim){
+    if (!in || !out) return;
+    float n2 = 0.0f;
+    for (size_t i=0; i<dim; i++) n2 += in[i] * in[i];
+    float k = n2 > 0.0f ? (float)OPDI_GALLERY_Q_SCALE / sqrtf(n2) : 0.0f;
+    for (size_t i=0; i<dim; i++){
+        long v = lroundf(in[i] * k);
+        out[i] = (int8_t)(v > 127 ? 127 : v < -127 ? -127 : v);
+    }
+}
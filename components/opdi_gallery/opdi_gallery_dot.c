@@ -0,0 +1,22 @@
+// int8 dot product kernels for the gallery matcher (no RTOS dependencies)
+#include "opdi_gallery.h"
+
+int32_t opdi_gallery_dot_s8_ref(const int8_t *a, const int8_t *b, size_t n){
+    int32_t acc = 0;
+    for (size_t i=0; i<n; i++) acc += (int32_t)a[i] * (int32_t)b[i];
+    return acc;
+}
+
+int32_t opdi_gallery_dot_s8(const int8_t *a, const int8_t *b, size_t n){
+    // Four independent accumulators: no loop-carried dependency, and the host compiler vectorizes it
+    int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4){
+        s0 += (int32_t)a[i]     * b[i];
+        s1 += (int32_t)a[i + 1] * b[i + 1];
+        s2 += (int32_t)a[i + 2] * b[i + 2];
+        s3 += (int32_t)a[i + 3] * b[i + 3];
+    }
+    for (; i<n; i++) s0 += (int32_t)a[i] * b[i];
+    return s0 + s1 + s2 + s3;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "opdi_gallery.h"
+
+// Gallery file layout (little-endian): header, then `count` records in table order. The same bytes
+// are the .gal transfer format, so a file copied off one device imports on another as is.
+// A record is rewritten in place when it changes, so an add or rename writes one record and the
+// header, not the file.
+#define GAL_MAGIC   "OPGL"
+#define GAL_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint16_t version;
+    uint16_t dim;
+    uint32_t count;
+    uint16_t next_id;
+    uint16_t label_len;
+} gal_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t id;
+    uint16_t flags;
+    uint32_t created;
+    char label[OPDI_GALLERY_LABEL_LEN];
+} gal_rec_t;              // followed by OPDI_GALLERY_DIM int8 values
+
+#define REC_BYTES (sizeof(gal_rec_t) + OPDI_GALLERY_DIM)
+
+// Header of the gallery as it is now (count, next id), for the .gal export
+void gal_hdr_snapshot(gal_hdr_t *h);
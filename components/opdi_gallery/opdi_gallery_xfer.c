@@ -0,0 +1,321 @@
+// Gallery bulk transfer: streaming JSON (base64 embeddings) and .gal export, incremental import
+#include "opdi_gallery.h"
+#include "opdi_gallery_file.h"
+#include "opdi_api_json.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "opdi_gallery";
+
+#define B64_LEN(n)   ((((n) + 2) / 3) * 4)
+#define EMB_B64      B64_LEN(OPDI_GALLERY_DIM)
+// One JSON record: the embedding plus id/label/created, with room for a fully \u-escaped label
+#define JSON_REC_MAX (EMB_B64 + 320)
+#define BATCH        CONFIG_OPDI_GALLERY_IMPORT_BATCH
+#define JSON_NEST    8
+
+_Static_assert(BATCH <= OPDI_GALLERY_BATCH_MAX, "CONFIG_OPDI_GALLERY_IMPORT_BATCH too large");
+
+static const char k_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t b64_encode(const uint8_t *in, size_t n, char *out){
+    char *o = out;
+    for (size_t i=0; i<n; i+=3){
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < n ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < n ? in[i + 2] : 0);
+        *o++ = k_b64[v >> 18];
+        *o++ = k_b64[(v >> 12) & 63];
+        *o++ = i + 1 < n ? k_b64[(v >> 6) & 63] : '=';
+        *o++ = i + 2 < n ? k_b64[v & 63] : '=';
+    }
+    *o = 0;
+    return (size_t)(o - out);
+}
+
+static int b64_val(char c){
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decode exactly `want` bytes: ESP_ERR_INVALID_SIZE for any other length, INVALID_ARG for bad input
+static esp_err_t b64_decode(const char *in, size_t len, uint8_t *out, size_t want){
+    if (len % 4) return ESP_ERR_INVALID_ARG;
+    size_t pad = len && in[len - 1] == '=' ? (in[len - 2] == '=' ? 2 : 1) : 0;
+    if (len / 4 * 3 - pad != want) return ESP_ERR_INVALID_SIZE;
+    for (size_t i=0, o=0; i<len; i+=4){
+        int v[4];
+        for (int k=0; k<4; k++){
+            v[k] = (in[i + k] == '=' && i + k >= len - pad) ? 0 : b64_val(in[i + k]);
+            if (v[k] < 0) return ESP_ERR_INVALID_ARG;
+        }
+        uint32_t w = (uint32_t)v[0] << 18 | (uint32_t)v[1] << 12 | (uint32_t)v[2] << 6 | (uint32_t)v[3];
+        if (o < want) out[o++] = (uint8_t)(w >> 16);
+        if (o < want) out[o++] = (uint8_t)(w >> 8);
+        if (o < want) out[o++] = (uint8_t)w;
+    }
+    return ESP_OK;
+}
+
+// ---- Export ----
+typedef struct {
+    opdi_gallery_record_t rec;
+    union {
+        char b64[EMB_B64 + 1];
+        uint8_t gal[REC_BYTES];
+    };
+    char scratch[512];   // JSON writer flush unit
+} export_buf_t;
+
+static esp_err_t export_gal(export_buf_t *b, opdi_gallery_write_t write, void *ctx, size_t *n){
+    gal_hdr_t h;
+    gal_hdr_snapshot(&h);
+    esp_err_t err = write(ctx, (const char *)&h, sizeof(h));
+    // Stops early if identities are deleted meanwhile; the importer reports the short file
+    for (size_t i=0; err == ESP_OK && i<h.count && opdi_gallery_get_at(i, &b->rec) == ESP_OK; i++){
+        gal_rec_t r = { .id = b->rec.entry.id, .created = b->rec.entry.created };
+        memcpy(r.label, b->rec.entry.label, OPDI_GALLERY_LABEL_LEN);
+        memcpy(b->gal, &r, sizeof(r));
+        memcpy(b->gal + sizeof(r), b->rec.emb, OPDI_GALLERY_DIM);
+        err = write(ctx, (const char *)b->gal, REC_BYTES);
+        if (err == ESP_OK) (*n)++;
+    }
+    return err;
+}
+
+static esp_err_t export_json(export_buf_t *b, opdi_gallery_write_t write, void *ctx, size_t *n){
+    opdi_json_t w;
+    opdi_json_init(&w, b->scratch, sizeof(b->scratch), write, ctx);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "format", "opdi-gallery");
+    opdi_json_kv_uint(&w, "version", GAL_VERSION);
+    opdi_json_kv_uint(&w, "dim", OPDI_GALLERY_DIM);
+    opdi_json_kv_uint(&w, "q_scale", OPDI_GALLERY_Q_SCALE);
+    opdi_json_key(&w, "identities");
+    opdi_json_arr_begin(&w);
+    for (size_t i=0; w.err == ESP_OK && opdi_gallery_get_at(i, &b->rec) == ESP_OK; i++){
+        opdi_json_obj_begin(&w);
+        opdi_json_kv_uint(&w, "id", b->rec.entry.id);
+        opdi_json_kv_str(&w, "label", b->rec.entry.label);
+        opdi_json_kv_uint(&w, "created", b->rec.entry.created);
+        b64_encode((const uint8_t *)b->rec.emb, OPDI_GALLERY_DIM, b->b64);
+        opdi_json_kv_str(&w, "emb", b->b64);
+        opdi_json_obj_end(&w);
+        (*n)++;
+    }
+    opdi_json_arr_end(&w);
+    opdi_json_kv_uint(&w, "count", *n);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w);
+}
+
+esp_err_t opdi_gallery_export(opdi_gallery_fmt_t fmt, opdi_gallery_write_t write, void *ctx, size_t *out_count){
+    if (!write || (fmt != OPDI_GALLERY_FMT_JSON && fmt != OPDI_GALLERY_FMT_GAL)) return ESP_ERR_INVALID_ARG;
+    export_buf_t *b = heap_caps_malloc(sizeof(*b), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!b) return ESP_ERR_NO_MEM;
+    size_t n = 0;
+    esp_err_t err = fmt == OPDI_GALLERY_FMT_GAL ? export_gal(b, write, ctx, &n) : export_json(b, write, ctx, &n);
+    heap_caps_free(b);
+    if (out_count) *out_count = n;
+    return err;
+}
+
+// ---- Import ----
+struct opdi_gallery_import {
+    opdi_gallery_fmt_t fmt;
+    bool replace, cleared;
+    esp_err_t err;
+    size_t stored;
+    size_t batch_n;
+    opdi_gallery_record_t batch[BATCH];
+    // .gal: header, then `need` records
+    bool have_hdr;
+    uint32_t need;
+    // JSON: structure scanner; one record object at a time is captured into buf
+    uint8_t depth;
+    bool started, done, in_str, esc, in_ids, capturing;
+    char last_str[16];     // last string at depth 1 (the key before "identities":[)
+    uint8_t last_len;
+    size_t fill;
+    char buf[JSON_REC_MAX > REC_BYTES ? JSON_REC_MAX : REC_BYTES];
+};
+
+static void flush_batch(opdi_gallery_import_t *im){
+    if (!im->batch_n || im->err != ESP_OK) return;
+    if (im->replace && !im->cleared){
+        im->err = opdi_gallery_clear();
+        im->cleared = true;
+        if (im->err != ESP_OK) return;
+    }
+    im->err = opdi_gallery_put_batch(im->batch, im->batch_n);
+    if (im->err == ESP_OK) im->stored += im->batch_n;
+    im->batch_n = 0;
+}
+
+static opdi_gallery_record_t *next_slot(opdi_gallery_import_t *im){
+    opdi_gallery_record_t *r = &im->batch[im->batch_n];
+    memset(&r->entry, 0, sizeof(r->entry));
+    return r;
+}
+
+static void push_record(opdi_gallery_import_t *im){
+    if (++im->batch_n == BATCH) flush_batch(im);
+}
+
+typedef struct {
+    uint16_t id;
+    char label[OPDI_GALLERY_LABEL_LEN];
+    uint32_t created;
+} json_rec_t;
+
+static const opdi_json_field_t k_rec_fields[] = {
+    OPDI_JSON_UINT(json_rec_t, id, "id"),
+    OPDI_JSON_STR(json_rec_t, label, "label"),
+    OPDI_JSON_UINT(json_rec_t, created, "created"),
+};
+
+static esp_err_t json_record(opdi_gallery_import_t *im){
+    json_rec_t jr = {0};
+    uint32_t seen = 0;
+    esp_err_t err = opdi_json_bind(im->buf, im->fill, OPDI_JSON_FIELDS(k_rec_fields), &jr, &seen, NULL);
+    if (err != ESP_OK) return err;
+    if ((seen & 3) != 3 || !jr.id || jr.id == UINT16_MAX || !jr.label[0]) return ESP_ERR_INVALID_ARG;
+    // The embedding string is longer than a bindable member: find its token and decode in place
+    opdi_json_tok_t toks[24];
+    size_t n;
+    if (opdi_json_tokenize(im->buf, im->fill, toks, 24, &n) != ESP_OK) return ESP_ERR_INVALID_ARG;
+    opdi_gallery_record_t *r = next_slot(im);
+    err = ESP_ERR_INVALID_ARG;   // no "emb"
+    for (size_t k=1; k + 1 < n; k = toks[k + 1].next){
+        const opdi_json_tok_t *key = &toks[k], *val = &toks[k + 1];
+        if (key->len == 3 && !memcmp(im->buf + key->start, "emb", 3) && val->type == OPDI_JSON_STR){
+            err = b64_decode(im->buf + val->start, val->len, (uint8_t *)r->emb, OPDI_GALLERY_DIM);
+            break;
+        }
+    }
+    if (err != ESP_OK) return err;
+    r->entry.id = jr.id;
+    r->entry.created = jr.created;
+    memcpy(r->entry.label, jr.label, sizeof(jr.label));
+    push_record(im);
+    return im->err;
+}
+
+static esp_err_t json_feed(opdi_gallery_import_t *im, const char *p, size_t len){
+    for (size_t i=0; i<len; i++){
+        char c = p[i];
+        if (im->capturing){
+            if (im->fill == sizeof(im->buf)) return ESP_ERR_INVALID_SIZE;
+            im->buf[im->fill++] = c;
+        }
+        if (im->in_str){
+            if (im->esc) im->esc = false;
+            else if (c == '\\') im->esc = true;
+            else if (c == '"') im->in_str = false;
+            else if (im->depth == 1 && im->last_len < sizeof(im->last_str) - 1) im->last_str[im->last_len++] = c;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+        if (im->done || (!im->started && c != '{')) return ESP_ERR_INVALID_ARG;
+        im->started = true;
+        switch (c){
+        case '"':
+            im->in_str = true;
+            if (im->depth == 1) im->last_len = 0;
+            break;
+        case '{': case '[':
+            if (++im->depth > JSON_NEST) return ESP_ERR_INVALID_ARG;
+            if (c == '[' && im->depth == 2) im->in_ids = im->last_len == 10 && !memcmp(im->last_str, "identities", 10);
+            if (c == '{' && im->depth == 3 && im->in_ids){
+                im->capturing = true;
+                im->buf[0] = '{';
+                im->fill = 1;
+            }
+            break;
+        case '}': case ']':
+            if (!im->depth) return ESP_ERR_INVALID_ARG;
+            if (im->capturing && im->depth == 3){
+                im->capturing = false;
+                esp_err_t err = json_record(im);
+                if (err != ESP_OK) return err;
+            }
+            if (--im->depth == 1) im->in_ids = false;
+            if (!im->depth) im->done = true;
+            break;
+        default:
+            break;   // numbers, literals, separators: only records are interpreted
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t gal_feed(opdi_gallery_import_t *im, const uint8_t *p, size_t len){
+    while (len && !(im->have_hdr && !im->need)){
+        size_t want = im->have_hdr ? REC_BYTES : sizeof(gal_hdr_t);
+        size_t k = want - im->fill < len ? want - im->fill : len;
+        memcpy(im->buf + im->fill, p, k);
+        im->fill += k; p += k; len -= k;
+        if (im->fill < want) break;
+        im->fill = 0;
+        if (!im->have_hdr){
+            gal_hdr_t h;
+            memcpy(&h, im->buf, sizeof(h));
+            if (memcmp(h.magic, GAL_MAGIC, 4)) return ESP_ERR_INVALID_ARG;
+            if (h.version != GAL_VERSION || h.dim != OPDI_GALLERY_DIM || h.label_len != OPDI_GALLERY_LABEL_LEN){
+                ESP_LOGW(TAG, "import: .gal v%u dim %u, expected v%d dim %d", h.version, h.dim, GAL_VERSION, OPDI_GALLERY_DIM);
+                return ESP_ERR_INVALID_VERSION;
+            }
+            im->have_hdr = true;
+            im->need = h.count;
+            continue;
+        }
+        gal_rec_t g;
+        memcpy(&g, im->buf, sizeof(g));
+        if (!g.id || g.id == UINT16_MAX) return ESP_ERR_INVALID_ARG;
+        opdi_gallery_record_t *r = next_slot(im);
+        r->entry.id = g.id;
+        r->entry.created = g.created;
+        memcpy(r->entry.label, g.label, OPDI_GALLERY_LABEL_LEN);
+        r->entry.label[OPDI_GALLERY_LABEL_LEN - 1] = 0;
+        if (!r->entry.label[0]) return ESP_ERR_INVALID_ARG;
+        memcpy(r->emb, im->buf + sizeof(g), OPDI_GALLERY_DIM);
+        im->need--;
+        push_record(im);
+        if (im->err != ESP_OK) return im->err;
+    }
+    return ESP_OK;   // bytes after the last record are ignored
+}
+
+esp_err_t opdi_gallery_import_begin(opdi_gallery_fmt_t fmt, bool replace, opdi_gallery_import_t **out){
+    if (!out || (fmt != OPDI_GALLERY_FMT_JSON && fmt != OPDI_GALLERY_FMT_GAL)) return ESP_ERR_INVALID_ARG;
+    opdi_gallery_import_t *im = heap_caps_calloc(1, sizeof(*im), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!im) return ESP_ERR_NO_MEM;
+    im->fmt = fmt;
+    im->replace = replace;
+    *out = im;
+    return ESP_OK;
+}
+
+esp_err_t opdi_gallery_import_feed(opdi_gallery_import_t *im, const void *data, size_t len){
+    if (!im || (len && !data)) return ESP_ERR_INVALID_ARG;
+    if (im->err != ESP_OK) return im->err;
+    esp_err_t err = im->fmt == OPDI_GALLERY_FMT_GAL ? gal_feed(im, data, len) : json_feed(im, data, len);
+    if (err != ESP_OK && im->err == ESP_OK) im->err = err;
+    return im->err;
+}
+
+esp_err_t opdi_gallery_import_end(opdi_gallery_import_t *im, size_t *out_count){
+    if (!im) return ESP_ERR_INVALID_ARG;
+    // Whole records parsed before an early end are kept, like the batches already stored
+    flush_batch(im);
+    bool complete = im->fmt == OPDI_GALLERY_FMT_GAL ? im->have_hdr && !im->need : im->done;
+    if (im->err == ESP_OK && complete && im->replace && !im->cleared) im->err = opdi_gallery_clear();
+    esp_err_t err = im->err != ESP_OK ? im->err : complete ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    if (out_count) *out_count = im->stored;
+    heap_caps_free(im);
+    return err;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MQTT publisher (SRD 6.3). Fed by the /ws event stream through its tap, so every producer that
+// publishes to /ws reaches the broker too:
+//   <prefix>/face/events     recognize events (and detect with CONFIG_OPDI_MQTT_DETECT), QoS CONFIG_OPDI_MQTT_QOS
+//   <prefix>/system/metrics  periodic snapshot: heap, network, queue stats, latest cam.telemetry; QoS 0
+// Events wait in a PSRAM queue that is kept across Wi-Fi and broker drops. A publish carries one
+// event as-is, or several as a JSON array [a,b,...] when they queued up behind the in-flight window.
+// Retain is off; nothing is subscribed to.
+
+// Allocate the queue and attach to the event stream; events queue from here on. Idempotent.
+esp_err_t opdi_mqtt_init(void);
+// init, then connect to broker_uri (NULL: CONFIG_OPDI_MQTT_BROKER) and start the sender task.
+// Reconnects on its own. ESP_ERR_INVALID_ARG: no broker configured.
+esp_err_t opdi_mqtt_start(const char *broker_uri);
+// Disconnect; queued events are kept for the next start
+void opdi_mqtt_stop(void);
+
+typedef struct {
+    uint32_t events;         // queued for face/events
+    uint32_t dropped;        // queue full, or larger than CONFIG_OPDI_MQTT_BATCH_BYTES
+    uint32_t publishes;      // face/events publishes
+    uint32_t batched;        // events that shared a publish with others
+    uint32_t resent;         // events sent again after a disconnect
+    uint32_t failed;         // publishes the client refused (retried)
+    uint32_t metrics;        // system/metrics publishes
+    uint32_t connects;       // broker sessions established
+    uint32_t queued;         // events waiting or in flight
+    uint32_t queued_bytes;
+    uint32_t queue_hw_bytes; // queue high-water mark
+    uint8_t inflight;        // publishes not yet acknowledged
+    bool connected;
+} opdi_mqtt_stats_t;
+void opdi_mqtt_get_stats(opdi_mqtt_stats_t *out);
+
+// Test hooks: pub() stands in for the client (returns the message id, 0 at QoS 0, < 0 to refuse;
+// NULL restores the client), link/ack/expire play the client's connection, PUBACK and outbox expiry
+// events, and pump runs the sender until it has to wait. Returns face/events publishes made.
+typedef int (*opdi_mqtt_test_pub_t)(const char *topic, const char *data, size_t len, int qos);
+void opdi_mqtt_test_transport(opdi_mqtt_test_pub_t pub);
+void opdi_mqtt_test_link(bool up);
+void opdi_mqtt_test_ack(int msg_id);
+void opdi_mqtt_test_expire(int msg_id);
+size_t opdi_mqtt_test_pump(void);
+// Empty the queue and zero the stats
+void opdi_mqtt_test_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,442 @@
+// MQTT publisher: the /ws event tap copies each event into a PSRAM byte ring and returns; one sender
+// task joins what is queued into publishes and keeps the broker's acknowledgement window. Events
+// leave the ring only once acknowledged (QoS 1) or written (QoS 0), so a drop of the link rewinds the
+// in-flight ones and the next session sends them again.
+#include "opdi_mqtt.h"
+#include "opdi_mqtt_port.h"
+#include "opdi_api_ws.h"
+#include "opdi_api_json.h"
+#include "opdi_net.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <unistd.h>
+#else
+#include "esp_mac.h"
+#endif
+
+static const char *TAG = "opdi_mqtt";
+
+#define RING_BYTES  CONFIG_OPDI_MQTT_QUEUE_BYTES
+#define BATCH_BYTES CONFIG_OPDI_MQTT_BATCH_BYTES
+#define INFLIGHT    CONFIG_OPDI_MQTT_INFLIGHT
+#define REC_HDR     2              // u16 payload length, then the event JSON
+#define PENDING     (-1)           // publish handed to the client, message id not known yet
+#define CAM_MAX     512            // latest cam.telemetry event kept for the metrics snapshot
+
+#define TOPIC_EVENTS  CONFIG_OPDI_TOPIC_PREFIX "/face/events"
+#define TOPIC_METRICS CONFIG_OPDI_TOPIC_PREFIX "/system/metrics"
+
+// One publish not yet released from the ring: its events are the oldest ones there
+typedef struct {
+    int msg_id;
+    uint32_t bytes;
+    uint16_t events;
+    bool done;         // acknowledged (QoS 1) or written (QoS 0), waiting for older ones
+} mq_pub_t;
+
+// s_lock guards the indices and counters only; ring bytes are copied outside it. s_put serializes the
+// producers: the holder owns the free space past the queue tail, which the sender never reads.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_put;
+static uint8_t *s_ring;
+static uint32_t s_head;               // offset of the oldest event
+static uint32_t s_used, s_n_used;     // bytes / events from s_head: in flight first, then waiting
+static uint32_t s_sent, s_n_sent;     // bytes / events from s_head handed to the client
+static mq_pub_t s_inf[INFLIGHT];
+static uint8_t s_n_inf;
+static int s_early_ack;               // acknowledgement that beat publish() returning its id
+static uint32_t s_gen;                // bumped on every rewind (disconnect, expiry): stale publishes are ignored
+static bool s_up, s_metrics_due;
+static char s_cam[CAM_MAX];
+static size_t s_cam_len;
+static opdi_mqtt_stats_t s_st;
+static char *s_batch;
+static TaskHandle_t s_task;
+static opdi_mqtt_test_pub_t s_pub = opdi_mqtt_port_publish;
+
+static void wake(void){
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
+static void ring_put(uint32_t off, const void *src, size_t n){
+    size_t a = n < RING_BYTES - off ? n : RING_BYTES - off;
+    memcpy(s_ring + off, src, a);
+    memcpy(s_ring, (const uint8_t *)src + a, n - a);
+}
+
+static void ring_get(uint32_t off, void *dst, size_t n){
+    size_t a = n < RING_BYTES - off ? n : RING_BYTES - off;
+    memcpy(dst, s_ring + off, a);
+    memcpy((uint8_t *)dst + a, s_ring, n - a);
+}
+
+static uint16_t rec_len_at(uint32_t off){
+    uint8_t h[REC_HDR];
+    ring_get(off, h, REC_HDR);
+    return (uint16_t)(h[0] | (h[1] << 8));
+}
+
+static void drop_oldest_locked(void){
+    uint32_t n = REC_HDR + rec_len_at(s_head);
+    s_head = (s_head + n) % RING_BYTES;
+    s_used -= n; s_n_used--;
+    s_st.dropped++;
+}
+
+static void queue_event(const char *json, size_t len){
+    uint32_t need = REC_HDR + (uint32_t)len;
+    if (!s_ring || len + 2 > BATCH_BYTES) {
+        taskENTER_CRITICAL(&s_lock); s_st.dropped++; taskEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    uint8_t h[REC_HDR] = { (uint8_t)len, (uint8_t)(len >> 8) };
+    xSemaphoreTake(s_put, portMAX_DELAY);
+    taskENTER_CRITICAL(&s_lock);
+    // Offline nothing is in flight and the oldest events make room. Otherwise the oldest bytes
+    // belong to unacknowledged publishes, and the new event is the one dropped.
+    while (s_used + need > RING_BYTES && s_n_used && !s_sent) drop_oldest_locked();
+    bool fits = s_used + need <= RING_BYTES;
+    uint32_t off = (s_head + s_used) % RING_BYTES; // head + used only moves here
+    if (!fits) s_st.dropped++;
+    taskEXIT_CRITICAL(&s_lock);
+    if (fits) {
+        // Not visible to the sender until s_used covers it
+        ring_put(off, h, REC_HDR);
+        ring_put((off + REC_HDR) % RING_BYTES, json, len);
+        taskENTER_CRITICAL(&s_lock);
+        s_used += need; s_n_used++;
+        s_st.events++;
+        if (s_used > s_st.queue_hw_bytes) s_st.queue_hw_bytes = s_used;
+        taskEXIT_CRITICAL(&s_lock);
+    }
+    xSemaphoreGive(s_put);
+    wake();
+}
+
+// Runs in the publisher's context (see opdi_api_ws_set_tap): copy and return
+static void on_event(opdi_ws_channel_t ch, const char *json, size_t len){
+    if (ch == OPDI_WS_CH_CAM_TELEMETRY) {
+        taskENTER_CRITICAL(&s_lock);
+        s_cam_len = len <= CAM_MAX ? len : 0;
+        memcpy(s_cam, json, s_cam_len);
+        taskEXIT_CRITICAL(&s_lock);
+    } else if (ch == OPDI_WS_CH_NET) {
+        // The snapshot reads the new state from opdi_net
+        s_metrics_due = true;
+        wake();
+    } else {
+        queue_event(json, len);
+    }
+}
+
+// Release acknowledged publishes from the front of the window
+static void release_locked(void){
+    while (s_n_inf && s_inf[0].done) {
+        s_head = (s_head + s_inf[0].bytes) % RING_BYTES;
+        s_used -= s_inf[0].bytes; s_sent -= s_inf[0].bytes;
+        s_n_used -= s_inf[0].events; s_n_sent -= s_inf[0].events;
+        memmove(&s_inf[0], &s_inf[1], (size_t)--s_n_inf * sizeof(s_inf[0]));
+    }
+}
+
+void opdi_mqtt_port_connected(void){
+    taskENTER_CRITICAL(&s_lock);
+    s_up = true; s_metrics_due = true;
+    s_st.connects++;
+    taskEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "connected, %u events queued", (unsigned)s_n_used);
+    wake();
+}
+
+void opdi_mqtt_port_disconnected(void){
+    taskENTER_CRITICAL(&s_lock);
+    bool was_up = s_up;
+    // Unacknowledged publishes go back to the queue, in order, ahead of what was waiting
+    s_st.resent += s_n_sent;
+    s_sent = 0; s_n_sent = 0; s_n_inf = 0;
+    s_early_ack = 0; s_up = false; s_gen++;
+    taskEXIT_CRITICAL(&s_lock);
+    if (was_up) ESP_LOGW(TAG, "disconnected, %u events queued", (unsigned)s_n_used);
+}
+
+void opdi_mqtt_port_expired(int msg_id){
+    taskENTER_CRITICAL(&s_lock);
+    // The ring is released in order, so the expired publish and every newer one go back to the queue
+    int i = 0;
+    while (i < s_n_inf && s_inf[i].msg_id != msg_id) i++;
+    bool found = i < s_n_inf && !s_inf[i].done;
+    if (found) {
+        uint32_t bytes = 0, events = 0;
+        for (int k=0; k<i; k++) { bytes += s_inf[k].bytes; events += s_inf[k].events; }
+        s_st.resent += s_n_sent - events;
+        s_sent = bytes; s_n_sent = events; s_n_inf = (uint8_t)i;
+        s_gen++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (found) {
+        ESP_LOGW(TAG, "msg %d expired unacknowledged, resending", msg_id);
+        wake();
+    }
+}
+
+void opdi_mqtt_port_published(int msg_id){
+    taskENTER_CRITICAL(&s_lock);
+    bool found = false;
+    for (uint8_t i=0; i<s_n_inf; i++) {
+        if (s_inf[i].msg_id == msg_id) { s_inf[i].done = true; found = true; break; }
+    }
+    if (!found) s_early_ack = msg_id;
+    release_locked();
+    taskEXIT_CRITICAL(&s_lock);
+    wake();
+}
+
+typedef enum { SEND_IDLE, SEND_OK, SEND_FAILED } send_result_t;
+
+// One publish of everything that fits, oldest first
+static send_result_t send_batch(void){
+    taskENTER_CRITICAL(&s_lock);
+    if (!s_up || s_n_inf >= INFLIGHT || s_sent == s_used) {
+        taskEXIT_CRITICAL(&s_lock);
+        return SEND_IDLE;
+    }
+    // Reserve the batch by its record headers; the payloads are copied once the lock is dropped
+    uint32_t start = (s_head + s_sent) % RING_BYTES, off = start, bytes = 0;
+    uint16_t n = 0;
+    size_t len = 1;                       // s_batch[0] is the '[' of a batch
+    while (s_sent + bytes < s_used && n < CONFIG_OPDI_MQTT_BATCH_MAX) {
+        uint16_t l = rec_len_at(off);
+        if (n && len + 1 + l + 1 > BATCH_BYTES) break;
+        len += (n ? 1 : 0) + l; n++;
+        bytes += REC_HDR + l;
+        off = (off + REC_HDR + l) % RING_BYTES;
+    }
+    s_sent += bytes; s_n_sent += n;
+    s_inf[s_n_inf++] = (mq_pub_t){ .msg_id = PENDING, .bytes = bytes, .events = n };
+    uint32_t gen = s_gen;
+    taskEXIT_CRITICAL(&s_lock);
+
+    // Sent bytes are neither dropped nor released while their publish is pending
+    len = 1; off = start;
+    for (uint16_t i=0; i<n; i++) {
+        uint16_t l = rec_len_at(off);
+        if (i) s_batch[len++] = ',';
+        ring_get((off + REC_HDR) % RING_BYTES, s_batch + len, l);
+        len += l;
+        off = (off + REC_HDR + l) % RING_BYTES;
+    }
+    // ... unless a rewind came in meanwhile: the batch is back in the queue and may have been overwritten
+    taskENTER_CRITICAL(&s_lock);
+    bool stale = gen != s_gen;
+    taskEXIT_CRITICAL(&s_lock);
+    if (stale) return SEND_IDLE;
+
+    // A lone event goes as-is
+    const char *data = s_batch;
+    if (n == 1) { data++; len--; } else { s_batch[0] = '['; s_batch[len++] = ']'; }
+    int id = s_pub(TOPIC_EVENTS, data, len, CONFIG_OPDI_MQTT_QOS);
+
+    taskENTER_CRITICAL(&s_lock);
+    if (gen == s_gen) {
+        // Single sender: the pending publish is the newest in the window
+        mq_pub_t *p = &s_inf[s_n_inf - 1];
+        if (id < 0) {
+            s_n_inf--; s_sent -= bytes; s_n_sent -= n;
+            s_st.failed++;
+        } else {
+            p->msg_id = id;
+            if (CONFIG_OPDI_MQTT_QOS == 0 || id == s_early_ack) p->done = true;
+            s_st.publishes++;
+            if (n > 1) s_st.batched += n;
+            release_locked();
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return id < 0 ? SEND_FAILED : SEND_OK;
+}
+
+static const char *net_state_name(opdi_net_state_t st){
+    switch (st) {
+    case NET_STA_CONNECT: return "connecting";
+    case NET_STA_CONNECTED: return "connected";
+    case NET_AP_ACTIVE: return "ap";
+    default: return "init";
+    }
+}
+
+static void publish_metrics(void){
+    s_metrics_due = false;
+    if (!s_up) return;
+    char buf[512 + CAM_MAX]; opdi_json_t w;
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "type", "metrics");
+    opdi_json_kv_uint(&w, "uptime_s", (uint64_t)(esp_timer_get_time() / 1000000));
+#if !CONFIG_IDF_TARGET_LINUX
+    opdi_json_kv_uint(&w, "heap_free", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    opdi_json_kv_uint(&w, "heap_min", heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    opdi_json_kv_uint(&w, "psram_free", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+#endif
+    opdi_net_metrics_t nm; opdi_net_get_metrics(&nm);
+    int8_t rssi = 0;
+    opdi_json_key(&w, "net"); opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "state", net_state_name(opdi_net_get_state()));
+    const char *ip = opdi_net_ip_cached();
+    opdi_json_kv_str(&w, "ip", ip ? ip : "");
+    if (opdi_net_sta_rssi(&rssi) == ESP_OK) opdi_json_kv_int(&w, "rssi", rssi);
+    opdi_json_kv_uint(&w, "connects", nm.connects_success);
+    opdi_json_kv_uint(&w, "boot_to_ip_ms", nm.boot_to_ip_ms);
+    opdi_json_obj_end(&w);
+    opdi_api_ws_stats_t ws; opdi_api_ws_get_stats(&ws);
+    opdi_json_key(&w, "ws"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "clients", ws.clients);
+    opdi_json_kv_uint(&w, "dropped", ws.dropped);
+    opdi_json_obj_end(&w);
+    opdi_mqtt_stats_t st; opdi_mqtt_get_stats(&st);
+    opdi_json_key(&w, "mqtt"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "queued", st.queued);
+    opdi_json_kv_uint(&w, "queue_hw_bytes", st.queue_hw_bytes);
+    opdi_json_kv_uint(&w, "publishes", st.publishes);
+    opdi_json_kv_uint(&w, "batched", st.batched);
+    opdi_json_kv_uint(&w, "dropped", st.dropped);
+    opdi_json_kv_uint(&w, "resent", st.resent);
+    opdi_json_kv_uint(&w, "connects", st.connects);
+    opdi_json_obj_end(&w);
+    char cam[CAM_MAX + 1];
+    taskENTER_CRITICAL(&s_lock);
+    memcpy(cam, s_cam, s_cam_len); cam[s_cam_len] = 0;
+    taskEXIT_CRITICAL(&s_lock);
+    if (cam[0]) { opdi_json_key(&w, "cam"); opdi_json_raw(&w, cam); }
+    opdi_json_obj_end(&w);
+    if (opdi_json_finish(&w) != ESP_OK) { ESP_LOGW(TAG, "metrics snapshot too large"); return; }
+    if (s_pub(TOPIC_METRICS, w.buf, w.len, 0) >= 0) {
+        taskENTER_CRITICAL(&s_lock); s_st.metrics++; taskEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static size_t pump(bool *failed){
+    size_t n = 0;
+    send_result_t r;
+    while ((r = send_batch()) == SEND_OK) n++;
+    *failed = r == SEND_FAILED;
+    return n;
+}
+
+static void sender_task(void *arg){
+    const int64_t period_us = (int64_t)CONFIG_OPDI_MQTT_METRICS_S * 1000000;
+    int64_t next = esp_timer_get_time() + period_us;
+    for (;;) {
+        int64_t wait_ms = (next - esp_timer_get_time()) / 1000;
+        ulTaskNotifyTake(pdTRUE, wait_ms > 0 ? pdMS_TO_TICKS(wait_ms) : 0);
+        // Gather window: events of a burst share a publish
+        if (CONFIG_OPDI_MQTT_BATCH_MS && s_up) vTaskDelay(pdMS_TO_TICKS(CONFIG_OPDI_MQTT_BATCH_MS));
+        if (s_metrics_due || esp_timer_get_time() >= next) {
+            publish_metrics();
+            next = esp_timer_get_time() + period_us;
+        }
+        bool failed;
+        pump(&failed);
+        // Refused (client outbox full, socket error): retry shortly; a disconnect rewinds anyway
+        if (failed) {
+            vTaskDelay(pdMS_TO_TICKS(500));
+            xTaskNotifyGive(s_task);
+        }
+    }
+}
+
+esp_err_t opdi_mqtt_init(void){
+    if (s_ring) return ESP_OK;
+    uint8_t *ring = heap_caps_malloc(RING_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring) ring = malloc(RING_BYTES);
+    s_batch = malloc(BATCH_BYTES);
+    if (!s_put) s_put = xSemaphoreCreateMutex();
+    if (!ring || !s_batch || !s_put) {
+        heap_caps_free(ring); free(s_batch); s_batch = NULL;
+        ESP_LOGE(TAG, "no memory for the %u B queue", (unsigned)RING_BYTES);
+        return ESP_ERR_NO_MEM;
+    }
+    s_ring = ring;
+    uint32_t mask = OPDI_WS_CH_BIT(OPDI_WS_CH_RECOGNIZE) | OPDI_WS_CH_BIT(OPDI_WS_CH_CAM_TELEMETRY) | OPDI_WS_CH_BIT(OPDI_WS_CH_NET);
+#if CONFIG_OPDI_MQTT_DETECT
+    mask |= OPDI_WS_CH_BIT(OPDI_WS_CH_DETECT);
+#endif
+    opdi_api_ws_set_tap(mask, on_event);
+    return ESP_OK;
+}
+
+esp_err_t opdi_mqtt_start(const char *broker_uri){
+    const char *uri = broker_uri ? broker_uri : CONFIG_OPDI_MQTT_BROKER;
+    if (!uri[0]) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = opdi_mqtt_init();
+    if (err != ESP_OK) return err;
+    // Stack: the metrics snapshot and its cam.telemetry copy
+    if (!s_task && xTaskCreate(sender_task, "mqtt_tx", 4096, NULL, CONFIG_OPDI_MQTT_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "sender task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+    char client_id[48];
+#if CONFIG_IDF_TARGET_LINUX
+    snprintf(client_id, sizeof(client_id), "%s-host-%d", CONFIG_OPDI_TOPIC_PREFIX, (int)getpid());
+#else
+    uint8_t mac[6] = { 0 };
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(client_id, sizeof(client_id), "%s-%02x%02x%02x", CONFIG_OPDI_TOPIC_PREFIX, mac[3], mac[4], mac[5]);
+#endif
+    ESP_LOGI(TAG, "broker %s as %s, QoS %d", uri, client_id, CONFIG_OPDI_MQTT_QOS);
+    return opdi_mqtt_port_start(uri, client_id);
+}
+
+void opdi_mqtt_stop(void){
+    opdi_mqtt_port_stop();
+    opdi_mqtt_port_disconnected();
+}
+
+void opdi_mqtt_get_stats(opdi_mqtt_stats_t *out){
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    out->queued = s_n_used;
+    out->queued_bytes = s_used;
+    out->inflight = s_n_inf;
+    out->connected = s_up;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void opdi_mqtt_test_transport(opdi_mqtt_test_pub_t pub){
+    s_pub = pub ? pub : opdi_mqtt_port_publish;
+}
+
+void opdi_mqtt_test_link(bool up){
+    if (up) opdi_mqtt_port_connected(); else opdi_mqtt_port_disconnected();
+}
+
+void opdi_mqtt_test_ack(int msg_id){
+    opdi_mqtt_port_published(msg_id);
+}
+
+void opdi_mqtt_test_expire(int msg_id){
+    opdi_mqtt_port_expired(msg_id);
+}
+
+size_t opdi_mqtt_test_pump(void){
+    if (s_metrics_due) publish_metrics();
+    bool failed;
+    return pump(&failed);
+}
+
+void opdi_mqtt_test_reset(void){
+    taskENTER_CRITICAL(&s_lock);
+    s_head = s_used = s_n_used = s_sent = s_n_sent = 0;
+    s_n_inf = 0; s_early_ack = 0; s_gen++;
+    s_up = false; s_metrics_due = false; s_cam_len = 0;
+    memset(&s_st, 0, sizeof(s_st));
+    taskEXIT_CRITICAL(&s_lock);
+}
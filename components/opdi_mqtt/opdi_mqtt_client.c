@@ -0,0 +1,64 @@
+// esp-mqtt under the publisher: connection and PUBACK events are forwarded to opdi_mqtt.c
+#include "opdi_mqtt_port.h"
+#include "mqtt_client.h"
+#include "esp_log.h"
+
+static const char *TAG = "opdi_mqtt_client";
+
+static esp_mqtt_client_handle_t s_client;
+
+static void on_mqtt_event(void *arg, esp_event_base_t base, int32_t id, void *data){
+    esp_mqtt_event_handle_t ev = data;
+    switch ((esp_mqtt_event_id_t)id) {
+    case MQTT_EVENT_CONNECTED:
+        opdi_mqtt_port_connected();
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        opdi_mqtt_port_disconnected();
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        opdi_mqtt_port_published(ev->msg_id);
+        break;
+    case MQTT_EVENT_DELETED:
+        // Expired in the client's outbox without an ack: the client will not send it again, the publisher does
+        opdi_mqtt_port_expired(ev->msg_id);
+        break;
+    case MQTT_EVENT_ERROR:
+        if (ev->error_handle && ev->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+            ESP_LOGW(TAG, "connection refused (%d)", ev->error_handle->connect_return_code);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t opdi_mqtt_port_start(const char *uri, const char *client_id){
+    if (s_client) return ESP_OK;
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = uri,
+        .credentials.client_id = client_id,
+        .session.keepalive = 30,
+        .network.reconnect_timeout_ms = 5000,
+    };
+    s_client = esp_mqtt_client_init(&cfg);
+    if (!s_client) return ESP_ERR_NO_MEM;
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, on_mqtt_event, NULL);
+    esp_err_t err = esp_mqtt_client_start(s_client);
+    if (err != ESP_OK) {
+        esp_mqtt_client_destroy(s_client);
+        s_client = NULL;
+    }
+    return err;
+}
+
+void opdi_mqtt_port_stop(void){
+    if (!s_client) return;
+    esp_mqtt_client_destroy(s_client);
+    s_client = NULL;
+}
+
+int opdi_mqtt_port_publish(const char *topic, const char *data, size_t len, int qos){
+    // -1 error, -2 outbox full
+    return s_client ? esp_mqtt_client_publish(s_client, topic, data, (int)len, qos, 0) : -1;
+}
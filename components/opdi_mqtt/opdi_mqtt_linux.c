@@ -0,0 +1,204 @@
+// Host build: a minimal MQTT 3.1.1 publisher over POSIX sockets in place of esp-mqtt (CONNECT,
+// PUBLISH at QoS 0/1, PUBACK, PINGREQ), enough to run the publisher against a local mosquitto.
+#include "opdi_mqtt_port.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char *TAG = "opdi_mqtt_linux";
+
+#define KEEPALIVE_S  30
+#define RECONNECT_MS 2000
+
+static char s_host[64], s_port[8], s_client_id[48];
+static int s_fd = -1;
+static SemaphoreHandle_t s_tx_lock;   // one packet on the socket at a time
+static uint16_t s_next_id;
+static int64_t s_last_tx_us;
+static volatile bool s_run;
+static TaskHandle_t s_task;
+
+// "mqtt://host[:port]" or "host[:port]"
+static bool parse_uri(const char *uri){
+    const char *p = strstr(uri, "://");
+    if (p && strncmp(uri, "mqtt://", 7)) return false;  // no TLS / websocket transport here
+    p = p ? p + 3 : uri;
+    const char *colon = strchr(p, ':');
+    size_t hl = colon ? (size_t)(colon - p) : strcspn(p, "/");
+    if (!hl || hl >= sizeof(s_host)) return false;
+    memcpy(s_host, p, hl); s_host[hl] = 0;
+    snprintf(s_port, sizeof(s_port), "%.*s", colon ? (int)strcspn(colon + 1, "/") : 4, colon ? colon + 1 : "1883");
+    return true;
+}
+
+static size_t put_len(uint8_t *p, size_t n){
+    size_t i = 0;
+    do { p[i] = n & 0x7f; n >>= 7; if (n) p[i] |= 0x80; i++; } while (n);
+    return i;
+}
+
+static size_t put_str(uint8_t *p, const char *s, size_t n){
+    p[0] = (uint8_t)(n >> 8); p[1] = (uint8_t)n;
+    memcpy(p + 2, s, n);
+    return 2 + n;
+}
+
+static bool send_all(int fd, const void *data, size_t len){
+    const uint8_t *p = data;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n; len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void *data, size_t len){
+    return len == 0 || recv(fd, data, len, MSG_WAITALL) == (ssize_t)len;
+}
+
+// One packet; the body is truncated to cap (the broker only sends us short acks). < 0: link lost.
+static int read_packet(int fd, uint8_t *type, uint8_t *body, size_t cap){
+    uint8_t b;
+    size_t len = 0;
+    if (!recv_all(fd, type, 1)) return -1;
+    for (int shift=0; shift<28; shift+=7) {
+        if (!recv_all(fd, &b, 1)) return -1;
+        len |= (size_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    size_t keep = len < cap ? len : cap;
+    if (!recv_all(fd, body, keep)) return -1;
+    for (size_t rest=len - keep; rest; ) {
+        uint8_t skip[64];
+        size_t n = rest < sizeof(skip) ? rest : sizeof(skip);
+        if (!recv_all(fd, skip, n)) return -1;
+        rest -= n;
+    }
+    return (int)keep;
+}
+
+static int open_session(void){
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(s_host, s_port, &hints, &res)) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen)) { close(fd); fd = -1; }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    // CONNECT: protocol "MQTT" level 4, clean session, no will, no credentials
+    uint8_t pkt[128], *p = pkt + 5;
+    size_t id_len = strlen(s_client_id);
+    p += put_str(p, "MQTT", 4);
+    *p++ = 4; *p++ = 0x02;
+    *p++ = 0; *p++ = KEEPALIVE_S;
+    p += put_str(p, s_client_id, id_len);
+    size_t body = (size_t)(p - (pkt + 5));
+    uint8_t hdr[5] = { 0x10 };
+    size_t hl = 1 + put_len(hdr + 1, body);
+    memcpy(pkt + 5 - hl, hdr, hl);
+    uint8_t type, ack[2];
+    if (!send_all(fd, pkt + 5 - hl, hl + body) || read_packet(fd, &type, ack, sizeof(ack)) != 2 || type != 0x20 || ack[1]) {
+        ESP_LOGW(TAG, "CONNECT to %s:%s refused", s_host, s_port);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void client_task(void *arg){
+    while (s_run) {
+        int fd = open_session();
+        if (fd < 0) { vTaskDelay(pdMS_TO_TICKS(RECONNECT_MS)); continue; }
+        xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+        s_fd = fd; s_last_tx_us = esp_timer_get_time();
+        xSemaphoreGive(s_tx_lock);
+        opdi_mqtt_port_connected();
+        while (s_run) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            int r = poll(&pfd, 1, 200);
+            if (r < 0) break;
+            if (r > 0) {
+                uint8_t type, body[4];
+                int n = read_packet(fd, &type, body, sizeof(body));
+                if (n < 0) break;
+                if ((type & 0xf0) == 0x40 && n >= 2) opdi_mqtt_port_published((body[0] << 8) | body[1]);
+            }
+            // PINGREQ when idle for half the keepalive
+            xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+            bool ok = true;
+            if (esp_timer_get_time() - s_last_tx_us > KEEPALIVE_S * 500000LL) {
+                static const uint8_t ping[2] = { 0xc0, 0 };
+                ok = send_all(fd, ping, sizeof(ping));
+                s_last_tx_us = esp_timer_get_time();
+            }
+            xSemaphoreGive(s_tx_lock);
+            if (!ok) break;
+        }
+        xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+        if (!s_run) { static const uint8_t bye[2] = { 0xe0, 0 }; send_all(fd, bye, sizeof(bye)); }
+        s_fd = -1;
+        close(fd);
+        xSemaphoreGive(s_tx_lock);
+        opdi_mqtt_port_disconnected();
+        if (s_run) vTaskDelay(pdMS_TO_TICKS(RECONNECT_MS));
+    }
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t opdi_mqtt_port_start(const char *uri, const char *client_id){
+    if (s_task) return ESP_OK;
+    if (!parse_uri(uri)) return ESP_ERR_INVALID_ARG;
+    snprintf(s_client_id, sizeof(s_client_id), "%s", client_id);
+    if (!s_tx_lock) s_tx_lock = xSemaphoreCreateMutex();
+    s_run = true;
+    if (xTaskCreate(client_task, "mqtt_rx", 4096, NULL, 5, &s_task) != pdPASS) {
+        s_run = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void opdi_mqtt_port_stop(void){
+    s_run = false;
+    // The client task sends DISCONNECT and closes within one poll period
+    for (int i=0; i<20 && s_task; i++) vTaskDelay(pdMS_TO_TICKS(50));
+}
+
+int opdi_mqtt_port_publish(const char *topic, const char *data, size_t len, int qos){
+    size_t tl = strlen(topic);
+    uint8_t hdr[5 + 2 + 128 + 2];
+    if (tl > 128) return -1;
+    uint8_t *p = hdr + 5;
+    p += put_str(p, topic, tl);
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    if (s_fd < 0) { xSemaphoreGive(s_tx_lock); return -1; }
+    int id = 0;
+    if (qos) {
+        if (!++s_next_id) s_next_id = 1;
+        id = s_next_id;
+        *p++ = (uint8_t)(id >> 8); *p++ = (uint8_t)id;
+    }
+    size_t vh = (size_t)(p - (hdr + 5));
+    uint8_t fh[5] = { (uint8_t)(0x30 | (qos << 1)) };
+    size_t fl = 1 + put_len(fh + 1, vh + len);
+    memcpy(hdr + 5 - fl, fh, fl);
+    bool ok = send_all(s_fd, hdr + 5 - fl, fl + vh) && send_all(s_fd, data, len);
+    // A half-written packet corrupts the stream: drop the session, the client task reconnects
+    if (!ok) shutdown(s_fd, SHUT_RDWR);
+    else s_last_tx_us = esp_timer_get_time();
+    xSemaphoreGive(s_tx_lock);
+    return ok ? id : -1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+
+// Client under the publisher: esp-mqtt on the device (opdi_mqtt_client.c), a minimal MQTT 3.1.1
+// client over POSIX sockets on the linux host (opdi_mqtt_linux.c).
+
+// Connect in the background and keep reconnecting until stop
+esp_err_t opdi_mqtt_port_start(const char *uri, const char *client_id);
+void opdi_mqtt_port_stop(void);
+// Message id (> 0 at QoS 1, 0 at QoS 0) once written or queued by the client; < 0 not sent
+int opdi_mqtt_port_publish(const char *topic, const char *data, size_t len, int qos);
+
+// Called by the port from its own task
+void opdi_mqtt_port_connected(void);
+void opdi_mqtt_port_disconnected(void);
+void opdi_mqtt_port_published(int msg_id);
+// The client gave up on a QoS 1 publish (outbox expiry): it and the newer ones in flight are sent again
+void opdi_mqtt_port_expired(int msg_id);
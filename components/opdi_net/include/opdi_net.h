@@ -21,6 +21,8 @@ esp_err_t opdi_net_add_profile(const opdi_net_profile_t *p);
 esp_err_t opdi_net_forget(const char *ssid);
 esp_err_t opdi_net_connect(const char *ssid_or_null);
 opdi_net_state_t opdi_net_get_state(void);
+// RSSI of the associated AP; ESP_ERR_INVALID_STATE when not connected
+esp_err_t opdi_net_sta_rssi(int8_t *out);
 
 // AP config (persisted) - simple setter/getter for fallback AP mode
 esp_err_t opdi_net_ap_set(const char *ssid, uint8_t channel);
@@ -33,6 +35,10 @@ typedef struct {
     uint32_t avg_connect_time_ms;   // average time between attempt start and IP acquisition
     uint32_t scan_count;            // number of Wi-Fi scans performed
     uint32_t current_retries;       // retries since last successful connection
+    uint32_t last_time_to_ip_ms;    // attempt start -> IP for the most recent connection
+    uint32_t boot_to_ip_ms;         // boot -> first IP (SRD boot-to-ready target 8 s); 0 until connected
+    uint32_t directed_attempts;     // connects tried on the cached BSSID/channel only
+    uint32_t directed_fallbacks;    // directed attempts that failed and fell back to a full scan
 } opdi_net_metrics_t;
 
 void opdi_net_get_metrics(opdi_net_metrics_t *out);
@@ -42,12 +48,53 @@ const char *opdi_net_gw_cached(void);
 // Hosted firmware version (may be empty if not available)
 const char *opdi_net_hosted_fw_version(void);
 
+// Shared scan service -----------------------------------------------------------
+// One radio scan at a time; results are cached and every caller reads the same table.
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t auth;       // WIFI_AUTH_* enum
+    uint8_t channel;
+} opdi_net_scan_ap_t;
+
+// Make sure results younger than max_age_ms exist (0 always starts or joins a fresh scan).
+// ESP_OK: the cache is fresh enough, read it now.
+// ESP_ERR_NOT_FINISHED: a scan is in flight (started or joined); completion is signalled through
+//   the weak hook opdi_net_emit_scan() and opdi_net_scan_in_progress() turning false.
+// Other errors: the radio refused (e.g. STA mid-connect); the previous results stay readable.
+esp_err_t opdi_net_scan_request(uint32_t max_age_ms);
+// Copy cached results (strongest first, CONFIG_OPDI_NET_SCAN_MIN_RSSI applied); returns count.
+// *out_age_ms receives the cache age, UINT32_MAX if no scan has completed yet.
+size_t opdi_net_scan_results(opdi_net_scan_ap_t *out, size_t cap, uint32_t *out_age_ms);
+bool opdi_net_scan_in_progress(void);
+
 // Serialize recent log events (JSON array) into provided buffer; returns length (0 if insufficient)
 size_t opdi_net_logs_serialize(char *out, size_t cap);
+// Visit recent log events oldest first with a copy of each entry; return false from cb to stop
+void opdi_net_logs_foreach(bool (*cb)(uint32_t ts_ms, const char *msg, void *arg), void *arg);
+
+// Stored profile as exposed over the API (SSID masked: only its length and a digest tail)
+typedef struct {
+    char id[9];         // last 4 bytes of SHA1(ssid), hex; DELETE /net/sta/profiles/{id} accepts a prefix
+    uint8_t ssid_len;
+    bool hidden;
+    uint32_t success;
+    uint8_t channel;    // reconnect hint, 0 = unknown
+} opdi_net_profile_info_t;
+// Visit stored profiles (from the RAM credential cache); return false from cb to stop
+void opdi_net_profiles_foreach(bool (*cb)(const opdi_net_profile_info_t *p, void *arg), void *arg);
 
 #ifdef CONFIG_OPDI_NET_TESTING
 void opdi_net_test_force_state(opdi_net_state_t st);
 void opdi_net_test_simulate_sta_connected(const char *ip, const char *gw, int rssi);
+void opdi_net_test_simulate_sta_disconnected(int reason);
+// GOT_IP with the given AP record (stores the profile's reconnect hint)
+void opdi_net_test_simulate_got_ip(const char *ip, const uint8_t bssid[6], uint8_t channel);
+// NVS handle opens + credential blob reads since boot (profile cache verification)
+uint32_t opdi_net_test_nvs_ops(void);
+// Complete the scan in flight with the given records (the radio is not used under test)
+void opdi_net_test_simulate_scan_done(const opdi_net_scan_ap_t *aps, size_t count);
 #endif
 
 #ifdef __cplusplus
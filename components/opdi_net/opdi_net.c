@@ -10,6 +10,8 @@
 #include "esp_check.h"
 #include "esp_timer.h"
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_netif.h"
 #include "lwip/ip4_addr.h" // for IP4_ADDR macro
 #include "esp_random.h" // for esp_random() used in AP SSID fallback
@@ -45,8 +47,17 @@ typedef struct {
     bool hidden;
     uint64_t last_ts; // esp_timer_get_time() snapshot (us). Phase1 simple.
     uint32_t success_count;
+    // Last successful association, used for a directed single-channel reconnect (0 = unknown)
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t pmf; // CRED_PMF_* from the AP's auth mode
 } stored_cred_t;
 
+// Blob layout before BSSID/channel were added; still accepted on load (no hint)
+typedef struct { char ssid[33]; char psk[65]; uint8_t auth; bool hidden; uint64_t last_ts; uint32_t success_count; } stored_cred_v1_t;
+#define CRED_PMF_CAPABLE  0x01
+#define CRED_PMF_REQUIRED 0x02
+
 // Context structures forward declarations for callbacks
 struct forget_ctx { const char *pid; uint8_t digest[20]; char ssid[33]; bool found; };
 
@@ -64,7 +75,13 @@ static bool forget_cb(const uint8_t d[20], const stored_cred_t *c, void *arg) {
 
 // State -----------------------------------------------------------------------
 static opdi_net_state_t g_state = NET_INIT;
-static mru_list_t g_mru; // guarded by esp_event loop context (single threaded modifications)
+static mru_list_t g_mru; // guarded by s_store
+// g_mru and the credential cache are used from the httpd task (profiles REST), the Wi-Fi/IP event task and
+// the retry timer. Recursive so the public calls can hold it across helpers that take it again; NULL before
+// opdi_net_init() (single task then).
+static SemaphoreHandle_t s_store;
+static inline void store_lock(void) { if (s_store) xSemaphoreTakeRecursive(s_store, portMAX_DELAY); }
+static inline void store_unlock(void) { if (s_store) xSemaphoreGiveRecursive(s_store); }
 static uint32_t g_total_retries = 0; // counts attempts since boot or last successful connect
 static uint64_t g_current_profile_start_ts = 0; // microseconds timestamp when current attempt began
 static uint8_t g_current_profile_digest[20];
@@ -74,12 +91,20 @@ static char g_last_ip[16] = ""; // cached dotted quad
 static char g_last_gw[16] = ""; // cached gateway
 static char g_ap_ssid[33] = "OPDI_SKPR-XXXX"; // persisted fallback AP SSID
 static uint8_t g_ap_channel = CONFIG_OPDI_AP_CHANNEL;
+static uint32_t g_nvs_ops = 0; // NVS handle opens + credential blob reads (test visibility)
 
 // Metrics -------------------------------------------------------------------
 static uint32_t g_metric_connect_attempts = 0;
 static uint32_t g_metric_connect_success = 0;
 static uint64_t g_metric_connect_time_accum_ms = 0; // sum of ms
 static uint32_t g_metric_scan_count = 0;
+static uint32_t g_metric_last_ttip_ms = 0;      // attempt start -> IP, most recent connection
+static uint32_t g_metric_boot_to_ip_ms = 0;     // boot -> first IP
+static uint32_t g_metric_directed_attempts = 0;
+static uint32_t g_metric_directed_fallbacks = 0;
+// Directed (cached BSSID/channel) connect state for the current profile attempt
+static bool g_directed_attempt = false; // last connect issued was directed
+static bool g_directed_failed = false;  // directed failed in this window -> use full scan
 // Hosted (C6) firmware version (captured if available)
 static char g_hosted_fw_version[32] = "";
 
@@ -127,22 +152,20 @@ static esp_err_t start_ap_mode(void);
 static wifi_auth_mode_t map_auth_mode(uint8_t stored);
 static void schedule_internal_scan(void);
 static void handle_scan_done(void);
+// Shared scan service (opdi_net_scan.c): drains the driver's records on every SCAN_DONE
+void opdi_net_scan_on_done(void);
 
 // Internal scan timer (to kick off scan a short delay after AP starts)
 static esp_timer_handle_t s_internal_scan_timer;
 static void internal_scan_timer_cb(void *arg){
     if (g_state != NET_AP_ACTIVE) return;
-    // Use active scan with very short dwell to minimize driver stack usage in event task
-    wifi_scan_config_t sc = {0};
-    sc.show_hidden = true;
-    sc.scan_type = WIFI_SCAN_TYPE_ACTIVE; // passive caused stack protection fault on sys_evt
-    sc.channel = g_ap_channel; // single channel only
-    // Configure minimal dwell time (values in ms) – guard with IDF struct layout
-    sc.scan_time.active.min = 50; // 50ms
-    sc.scan_time.active.max = 100; // 100ms
-    esp_err_t r = esp_wifi_scan_start(&sc, false);
-    ESP_LOGI(TAG, "internal scan start ch=%u r=%d", (unsigned)g_ap_channel, (int)r);
-    if (r!=ESP_OK) log_event("scan_err"); else log_event("scan_start");
+    // Goes through the shared scan service: a full active scan of all channels (80-120 ms dwell each,
+    // ~1.5 s off the AP channel) instead of the old single-channel probe, once per AP entry. It is the
+    // scan the provisioning UI would start anyway; now its first /net/scan is served from the cache.
+    esp_err_t r = opdi_net_scan_request(CONFIG_OPDI_NET_SCAN_TTL_MS);
+    ESP_LOGI(TAG, "internal scan start r=%d", (int)r);
+    if (r==ESP_OK) { handle_scan_done(); return; } // cache already fresh
+    if (r!=ESP_ERR_NOT_FINISHED) log_event("scan_err"); else log_event("scan_start");
 }
 static void schedule_internal_scan(void){
     if (s_internal_scan_timer){ esp_timer_stop(s_internal_scan_timer); }
@@ -152,18 +175,14 @@ static void schedule_internal_scan(void){
     esp_timer_start_once(s_internal_scan_timer, 2000000ULL);
 }
 static void handle_scan_done(void){
-    // Reduce on-stack allocation size: make static & smaller to avoid exhausting sys_evt stack
-    uint16_t ap_num=0; static wifi_ap_record_t recs[8];
-    esp_wifi_scan_get_ap_num(&ap_num);
-    if (ap_num > 8) ap_num = 8;
-    esp_err_t gr = esp_wifi_scan_get_ap_records(&ap_num, recs);
+    // Reads the shared cache (static: keep it off the sys_evt stack)
+    static opdi_net_scan_ap_t aps[CONFIG_OPDI_NET_SCAN_MAX_APS];
+    size_t ap_num = opdi_net_scan_results(aps, CONFIG_OPDI_NET_SCAN_MAX_APS, NULL);
     bool found=false; int rssi=0;
-    if (gr==ESP_OK){
-        for (int i=0;i<ap_num;i++) {
-            if (strncmp((const char*)recs[i].ssid, g_ap_ssid, sizeof(recs[i].ssid))==0){ found=true; rssi=recs[i].rssi; break; }
-        }
+    for (size_t i=0;i<ap_num;i++) {
+        if (strncmp(aps[i].ssid, g_ap_ssid, sizeof(aps[i].ssid))==0){ found=true; rssi=aps[i].rssi; break; }
     }
-    ESP_LOGI(TAG, "internal scan done (gr=%d aps=%u) found_self=%d rssi=%d", (int)gr, (unsigned)ap_num, found, rssi);
+    ESP_LOGI(TAG, "internal scan done (aps=%u) found_self=%d rssi=%d", (unsigned)ap_num, found, rssi);
     log_event(found?"self_found":"self_miss");
 }
 
@@ -236,7 +255,7 @@ static esp_err_t migrate_placeholder_digests(void) {
             for (int i=0;i<20;i++){ unsigned int b=0; sscanf(&info.key[5+i*2], "%02x", &b); old_digest[i]=(uint8_t)b; }
             if (is_placeholder_digest(old_digest)) {
                 stored_cred_t cred={0}; size_t sz=sizeof(cred);
-                if (nvs_get_blob(h, info.key, &cred, &sz)==ESP_OK && sz==sizeof(cred)) {
+                if (nvs_get_blob(h, info.key, &cred, &sz)==ESP_OK && (sz==sizeof(cred) || sz==sizeof(stored_cred_v1_t))) {
                     uint8_t new_digest[20]; if (sha1_of_ssid(cred.ssid, new_digest)==ESP_OK && memcmp(new_digest, old_digest, 20)!=0) {
                         char new_key[6+40+1]; strcpy(new_key, "cred/");
                         for (int i=0;i<20;i++) { sprintf(&new_key[5+i*2], "%02x", new_digest[i]); }
@@ -311,6 +330,11 @@ static void mru_promote_or_add(const uint8_t sha1[20]) {
     }
 }
 
+static size_t mru_count(void) {
+    store_lock(); size_t n = g_mru.count; store_unlock();
+    return n;
+}
+
 static void mru_remove(const uint8_t sha1[20]) {
     int idx = mru_index_of(sha1);
     if (idx < 0) return;
@@ -322,6 +346,7 @@ static void mru_remove(const uint8_t sha1[20]) {
 
 // Persistence -----------------------------------------------------------------
 static esp_err_t nvs_open_net(nvs_handle_t *h) {
+    g_nvs_ops++;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, h);
     if (err == ESP_ERR_NVS_NOT_INITIALIZED) {
         // caller should have initialized flash; propagate
@@ -348,6 +373,60 @@ static esp_err_t load_mru(void) {
     return err;
 }
 
+// Credential cache --------------------------------------------------------------
+// All profiles are mirrored in RAM: loaded once in opdi_net_init() and kept in sync by
+// save/erase, so connect retries and REST listings never iterate or read NVS. Lookups go
+// through a small open-addressed index keyed by the (uniformly distributed) SHA1 digest.
+#define CRED_SLOTS 64 // power of two >= 2 * MAX_PROFILES keeps probe chains short
+_Static_assert(CRED_SLOTS >= 2 * MAX_PROFILES && (CRED_SLOTS & (CRED_SLOTS - 1)) == 0, "CRED_SLOTS");
+typedef struct { uint8_t digest[20]; stored_cred_t cred; } cred_entry_t;
+static cred_entry_t g_creds[MAX_PROFILES];
+static size_t g_cred_count = 0;
+static uint8_t g_cred_index[CRED_SLOTS]; // 0 empty, else 1 + index into g_creds
+
+static inline uint32_t cred_hash(const uint8_t d[20]) { return ((uint32_t)d[0] | ((uint32_t)d[1] << 8)) & (CRED_SLOTS - 1); }
+
+static void cred_index_rebuild(void) {
+    memset(g_cred_index, 0, sizeof(g_cred_index));
+    for (size_t i=0;i<g_cred_count;i++) {
+        uint32_t s = cred_hash(g_creds[i].digest);
+        while (g_cred_index[s]) s = (s + 1) & (CRED_SLOTS - 1);
+        g_cred_index[s] = (uint8_t)(i + 1);
+    }
+}
+
+static cred_entry_t *cred_find(const uint8_t d[20]) {
+    for (uint32_t s = cred_hash(d), n = 0; n < CRED_SLOTS && g_cred_index[s]; s = (s + 1) & (CRED_SLOTS - 1), n++) {
+        cred_entry_t *e = &g_creds[g_cred_index[s] - 1];
+        if (memcmp(e->digest, d, 20)==0) return e;
+    }
+    return NULL;
+}
+
+static void cred_drop(const uint8_t d[20]) {
+    cred_entry_t *e = cred_find(d);
+    if (!e) return;
+    *e = g_creds[--g_cred_count]; // swap-remove; index is rebuilt (forget/evict are rare)
+    cred_index_rebuild();
+}
+
+static void cred_put(const uint8_t d[20], const stored_cred_t *cred) {
+    cred_entry_t *e = cred_find(d);
+    if (e) { e->cred = *cred; return; }
+    if (g_cred_count == MAX_PROFILES) {
+        // Full (NVS may hold blobs the MRU already dropped): evict one outside the MRU, else the LRU
+        size_t victim = 0; bool found = false;
+        for (size_t i=0;i<g_cred_count && !found;i++) if (mru_index_of(g_creds[i].digest) < 0) { victim = i; found = true; }
+        if (!found && g_mru.count) { cred_entry_t *lru = cred_find(g_mru.sha1[g_mru.count-1]); if (lru) victim = (size_t)(lru - g_creds); }
+        cred_drop(g_creds[victim].digest);
+    }
+    e = &g_creds[g_cred_count];
+    memcpy(e->digest, d, 20); e->cred = *cred;
+    uint32_t s = cred_hash(d);
+    while (g_cred_index[s]) s = (s + 1) & (CRED_SLOTS - 1);
+    g_cred_index[s] = (uint8_t)++g_cred_count;
+}
+
 static esp_err_t save_profile(const stored_cred_t *cred) {
     uint8_t digest[20]; sha1_of_ssid(cred->ssid, digest);
     char key[6 + 40 + 1]; // 'cred/' + 40hex
@@ -355,17 +434,20 @@ static esp_err_t save_profile(const stored_cred_t *cred) {
     // quick hex using digest minimal uniqueness for placeholder
     for (int i=0;i<20;i++) sprintf(&key[5+i*2], "%02x", digest[i]);
     key[5+40] = '\0';
-    nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { ESP_LOGE(TAG, "open prof err=%d", e); return e; }
+    store_lock();
+    nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { store_unlock(); ESP_LOGE(TAG, "open prof err=%d", e); return e; }
     esp_err_t err = nvs_set_blob(h, key, cred, sizeof(*cred));
     if (err==ESP_OK) err = nvs_commit(h);
     nvs_close(h);
+    if (err==ESP_OK) cred_put(digest, cred);
+    store_unlock();
     return err;
 }
 
-// Enumerate profiles: iterate over NVS entries with key prefix "cred/".
+// Enumerate profiles: iterate over NVS entries with key prefix "cred/" (boot-time cache fill only).
 typedef bool (*profile_enum_cb)(const uint8_t digest[20], const stored_cred_t *cred, void *arg);
 
-static esp_err_t foreach_profile(profile_enum_cb cb, void *arg) {
+static esp_err_t nvs_foreach_profile(profile_enum_cb cb, void *arg) {
     nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { ESP_LOGE(TAG, "open foreach err=%d", e); return e; }
     nvs_iterator_t it = NULL;
     esp_err_t err = nvs_entry_find(NULL, NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
@@ -379,7 +461,8 @@ static esp_err_t foreach_profile(profile_enum_cb cb, void *arg) {
                     unsigned int byte=0; sscanf(&info.key[5+i*2], "%02x", &byte); digest[i]=(uint8_t)byte; }
             }
             stored_cred_t cred = {0}; size_t sz = sizeof(cred);
-            if (nvs_get_blob(h, info.key, &cred, &sz)==ESP_OK && sz==sizeof(cred)) {
+            g_nvs_ops++;
+            if (nvs_get_blob(h, info.key, &cred, &sz)==ESP_OK && (sz==sizeof(cred) || sz==sizeof(stored_cred_v1_t))) {
                 if (!cb(digest, &cred, arg)) break;
             }
         }
@@ -390,19 +473,37 @@ static esp_err_t foreach_profile(profile_enum_cb cb, void *arg) {
     return ESP_OK;
 }
 
-// Lookup a profile by SSID (loads full credential). Returns ESP_ERR_NOT_FOUND if absent.
+// Enumerate cached profiles (no flash access). Callback returns false to stop; it runs under s_store.
+static void foreach_profile(profile_enum_cb cb, void *arg) {
+    store_lock();
+    for (size_t i=0;i<g_cred_count;i++) if (!cb(g_creds[i].digest, &g_creds[i].cred, arg)) break;
+    store_unlock();
+}
+
+static bool cred_load_cb(const uint8_t d[20], const stored_cred_t *c, void *arg) {
+    (void)arg;
+    uint8_t real[20];
+    // Only well-formed keys whose digest matches the stored SSID enter the cache
+    if (sha1_of_ssid(c->ssid, real)==ESP_OK && memcmp(real, d, 20)==0) cred_put(d, c);
+    return true;
+}
+
+static void cred_cache_load(void) {
+    g_cred_count = 0; cred_index_rebuild();
+    nvs_foreach_profile(cred_load_cb, NULL);
+    ESP_LOGI(TAG, "credential cache: %u profiles", (unsigned)g_cred_count);
+}
+
+// Lookup a profile by SSID (full credential from the cache). Returns ESP_ERR_NOT_FOUND if absent.
 static esp_err_t load_profile_by_ssid(const char *ssid, stored_cred_t *out, uint8_t out_digest[20]) {
     if (!ssid) return ESP_ERR_INVALID_ARG;
-    uint8_t digest[20]; sha1_of_ssid(ssid, digest);
+    uint8_t digest[20]; esp_err_t e = sha1_of_ssid(ssid, digest); if (e!=ESP_OK) return e;
     if (out_digest) memcpy(out_digest, digest, 20);
-    char key[6 + 40 + 1]; strcpy(key, "cred/");
-    for (int i=0;i<20;i++) sprintf(&key[5+i*2], "%02x", digest[i]);
-    key[5+40]='\0';
-    nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { ESP_LOGE(TAG, "open load prof err=%d", e); return e; }
-    size_t sz = sizeof(stored_cred_t);
-    esp_err_t err = nvs_get_blob(h, key, out, &sz);
-    nvs_close(h);
-    return err;
+    store_lock();
+    const cred_entry_t *c = cred_find(digest);
+    if (c) *out = c->cred;
+    store_unlock();
+    return c ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
 static esp_err_t erase_profile_by_ssid(const char *ssid) {
@@ -410,13 +511,16 @@ static esp_err_t erase_profile_by_ssid(const char *ssid) {
     char key[6 + 40 + 1]; strcpy(key, "cred/");
     for (int i=0;i<20;i++) sprintf(&key[5+i*2], "%02x", digest[i]);
     key[5+40]='\0';
-    nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { ESP_LOGE(TAG, "open erase prof err=%d", e); return e; }
+    store_lock();
+    nvs_handle_t h; esp_err_t e = nvs_open_net(&h); if (e!=ESP_OK) { store_unlock(); ESP_LOGE(TAG, "open erase prof err=%d", e); return e; }
     esp_err_t err = nvs_erase_key(h, key);
     if (err==ESP_ERR_NVS_NOT_FOUND) err = ESP_OK; // idempotent
     if (err==ESP_OK) err = nvs_commit(h);
     nvs_close(h);
-    // update MRU
+    // update MRU and cache
     mru_remove(digest); save_mru();
+    if (err==ESP_OK) cred_drop(digest);
+    store_unlock();
     return err;
 }
 
@@ -569,6 +673,33 @@ static void schedule_metrics_timer(bool start){
     }
 }
 
+// Configure STA for a stored credential and connect. If the profile remembers the BSSID/channel
+// of its last association, probe that single channel first; once that fails in the current
+// attempt window (or with no hint) fall back to a full all-channel scan.
+static void sta_connect_cred(const stored_cred_t *c) {
+    bool directed = c->channel && !g_directed_failed;
+    g_directed_attempt = directed;
+    if (directed) { g_metric_directed_attempts++; log_event("directed ch%u", c->channel); }
+#if !CONFIG_OPDI_NET_TESTING
+    wifi_config_t wcfg={0};
+    strlcpy((char*)wcfg.sta.ssid, c->ssid, sizeof(wcfg.sta.ssid));
+    if (c->psk[0]) strlcpy((char*)wcfg.sta.password, c->psk, sizeof(wcfg.sta.password));
+    wcfg.sta.threshold.authmode = map_auth_mode(c->auth);
+    wcfg.sta.pmf_cfg.capable = true;
+    if (directed) {
+        wcfg.sta.bssid_set = true; memcpy(wcfg.sta.bssid, c->bssid, 6);
+        wcfg.sta.channel = c->channel;
+        wcfg.sta.scan_method = WIFI_FAST_SCAN;
+        wcfg.sta.pmf_cfg.required = (c->pmf & CRED_PMF_REQUIRED) != 0;
+    } else {
+        wcfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN; // pick the strongest BSSID; it becomes the next hint
+        wcfg.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+    if (c->hidden) log_event("hidden ssid"); // directed probe by SSID works in both modes
+    esp_wifi_set_mode(WIFI_MODE_STA); esp_wifi_set_config(WIFI_IF_STA, &wcfg); esp_wifi_connect();
+#endif
+}
+
 // Connection attempt logic (placeholder)
 static void attempt_next_profile(const char *force_ssid) {
 #if CONFIG_OPDI_NET_TESTING
@@ -586,29 +717,17 @@ static void attempt_next_profile(const char *force_ssid) {
         ESP_LOGI(TAG, "Attempt direct connect to requested SSID (masked) total_retries=%u", g_total_retries);
         stored_cred_t cred; uint8_t digest[20];
         if (load_profile_by_ssid(force_ssid, &cred, digest)==ESP_OK) {
-            mru_promote_or_add(digest); save_mru();
+            store_lock(); mru_promote_or_add(digest); save_mru(); store_unlock();
             memcpy(g_current_profile_digest, digest, 20); g_have_current=true; g_current_profile_start_ts = esp_timer_get_time();
+            g_directed_failed = false;
             g_metric_connect_attempts++; log_event("attempt %s", "direct");
-#if !CONFIG_OPDI_NET_TESTING
-            // Configure and connect now that STA mode should be active
-            wifi_config_t wcfg={0};
-            strlcpy((char*)wcfg.sta.ssid, cred.ssid, sizeof(wcfg.sta.ssid));
-            if (cred.psk[0]) strlcpy((char*)wcfg.sta.password, cred.psk, sizeof(wcfg.sta.password));
-            // Auth / hidden handling
-            wcfg.sta.threshold.authmode = map_auth_mode(cred.auth);
-            if (cred.hidden){
-                // Hidden SSID: rely on directed probe; FAST scan reduces dwell
-                wcfg.sta.scan_method = WIFI_FAST_SCAN;
-                log_event("hidden ssid");
-            }
-            esp_wifi_set_mode(WIFI_MODE_STA); esp_wifi_set_config(WIFI_IF_STA, &wcfg); esp_wifi_connect();
-#endif
+            sta_connect_cred(&cred);
         } else {
             ESP_LOGW(TAG, "Requested SSID not found");
             log_event("ssid not found");
         }
         g_total_retries++;
-    } else if (g_mru.count == 0) {
+    } else if (mru_count() == 0) {
         // No stored profiles: attempt bootstrap SSID if configured and not yet tried
 #if !CONFIG_OPDI_NET_TESTING
         #ifdef CONFIG_OPDI_NET_BOOTSTRAP_SSID
@@ -638,55 +757,49 @@ static void attempt_next_profile(const char *force_ssid) {
         log_event("no profiles");
         // Perform one active scan (scan-before-AP fallback requirement) before switching
         if (!g_bootstrap_scan_started && !g_bootstrap_scan_done) {
-            wifi_scan_config_t sc={0};
-            sc.show_hidden = true; sc.scan_type = WIFI_SCAN_TYPE_ACTIVE;
-            sc.scan_time.active.min = 80; sc.scan_time.active.max = 120; // short dwell
-            esp_err_t sr = esp_wifi_scan_start(&sc, false);
-            if (sr==ESP_OK) { g_bootstrap_scan_started = true; ESP_LOGI(TAG, "Bootstrap scan started prior to AP fallback"); log_event("bs_scan_start"); return; }
+            esp_err_t sr = opdi_net_scan_request(0); // always fresh; joins a scan already in flight
+            if (sr==ESP_ERR_NOT_FINISHED) { g_bootstrap_scan_started = true; ESP_LOGI(TAG, "Bootstrap scan started prior to AP fallback"); log_event("bs_scan_start"); return; }
             ESP_LOGW(TAG, "Bootstrap scan start failed (%d), proceeding to AP", (int)sr);
         }
         enter_state(NET_AP_ACTIVE);
         return;
     } else {
+        // MRU rotation, MRU[0] and its credential are taken in one step: the REST task may add or forget meanwhile
+        stored_cred_t cred; bool have_cred = false;
+        store_lock();
         // Check if current profile exceeded per-SSID timeout
         uint64_t now = esp_timer_get_time();
+        bool retry_current = false;
         if (g_have_current) {
             uint64_t elapsed_s = (now - g_current_profile_start_ts)/1000000ULL;
             if (elapsed_s < CONFIG_OPDI_NET_STA_TIMEOUT_S) {
+                // Still within this profile's window: reconnect (directed hint first, then full scan)
                 ESP_LOGI(TAG, "Continuing attempt (elapsed=%llu s < timeout)", (unsigned long long)elapsed_s);
-                return; // still within timeout window; keep trying
+                retry_current = true;
             } else {
                 ESP_LOGW(TAG, "Profile attempt timed out (%llu s) advancing MRU", (unsigned long long)elapsed_s);
                 // rotate MRU: move current (index 0) to end implicitly by shifting others up and placing at end? Simpler: drop current
                 mru_remove(g_current_profile_digest); save_mru();
                 g_have_current=false;
-                if (g_mru.count==0) { enter_state(NET_AP_ACTIVE); return; }
             }
         }
-        // Attempt first MRU entry
-    ESP_LOGI(TAG, "Attempting MRU[0] (hash tail=%02x%02x) total_retries=%u", g_mru.sha1[0][18], g_mru.sha1[0][19], g_total_retries);
-        memcpy(g_current_profile_digest, g_mru.sha1[0], 20); g_have_current=true; g_current_profile_start_ts = now;
-        g_metric_connect_attempts++; log_event("attempt mru");
-        g_total_retries++;
-#if !CONFIG_OPDI_NET_TESTING
-        // Real Wi-Fi connect for MRU entry (placeholder minimal implementation)
-        // Load credential to obtain SSID/PSK
-        struct load_ctx { uint8_t target[20]; stored_cred_t cred; bool found; } lctx;
-        memcpy(lctx.target, g_current_profile_digest,20); lctx.found=false;
-        bool findcb(const uint8_t d[20], const stored_cred_t *c, void *arg){ struct load_ctx *lc=(struct load_ctx*)arg; if(memcmp(d,lc->target,20)==0){ lc->cred=*c; lc->found=true; return false;} return true; }
-        foreach_profile((profile_enum_cb)findcb, &lctx);
-        if (lctx.found) {
-            wifi_config_t wcfg={0};
-            strlcpy((char*)wcfg.sta.ssid, lctx.cred.ssid, sizeof(wcfg.sta.ssid));
-            if (lctx.cred.psk[0]) strlcpy((char*)wcfg.sta.password, lctx.cred.psk, sizeof(wcfg.sta.password));
-            wcfg.sta.threshold.authmode = map_auth_mode(lctx.cred.auth);
-            if (lctx.cred.hidden){
-                wcfg.sta.scan_method = WIFI_FAST_SCAN;
-                log_event("hidden mru");
-            }
-            esp_wifi_set_mode(WIFI_MODE_STA); esp_wifi_set_config(WIFI_IF_STA, &wcfg); esp_wifi_connect();
+        // Out of profiles (the last one timed out, or was forgotten since the check above)
+        if (!retry_current && g_mru.count==0) { store_unlock(); enter_state(NET_AP_ACTIVE); return; }
+        if (!retry_current) {
+            // Attempt first MRU entry
+            ESP_LOGI(TAG, "Attempting MRU[0] (hash tail=%02x%02x) total_retries=%u", g_mru.sha1[0][18], g_mru.sha1[0][19], g_total_retries);
+            memcpy(g_current_profile_digest, g_mru.sha1[0], 20); g_have_current=true; g_current_profile_start_ts = now;
+            g_directed_failed = false;
+            log_event("attempt mru");
         }
-#endif
+        // Resolve SSID/PSK from the credential cache (no flash access on retries)
+        const cred_entry_t *ce = cred_find(g_current_profile_digest);
+        if (ce) { cred = ce->cred; have_cred = true; }
+        store_unlock();
+        g_metric_connect_attempts++;
+        g_total_retries++;
+        if (have_cred) sta_connect_cred(&cred);
+        else { ESP_LOGW(TAG, "MRU[0] has no stored credential"); log_event("mru no cred"); }
     }
     if (g_total_retries >= CONFIG_OPDI_NET_RETRIES) {
         ESP_LOGW(TAG, "Exceeded retries (%u) -> AP mode", g_total_retries);
@@ -700,39 +813,30 @@ static void wifi_event_handler(void* arg, esp_event_base_t base, int32_t id, voi
     if (base != WIFI_EVENT) return;
     switch (id) {
         case WIFI_EVENT_SCAN_DONE:
-            handle_scan_done();
+            // Whoever started it, the records go to the shared cache (and the net.scan event)
+            opdi_net_scan_on_done();
+            if (g_state == NET_AP_ACTIVE) handle_scan_done();
             // If this was the bootstrap scan, collect top 16 SSIDs by RSSI and then enter AP mode
             if (g_bootstrap_scan_started && !g_bootstrap_scan_done) {
                 g_bootstrap_scan_done = true;
-                uint16_t total=0; esp_wifi_scan_get_ap_num(&total);
-                if (total>0) {
-                    uint16_t fetch = total; if (fetch > 64) fetch = 64; // upper bound
-                    static wifi_ap_record_t recs[64];
-                    if (esp_wifi_scan_get_ap_records(&fetch, recs)==ESP_OK) {
-                        // Simple partial selection sort for top 16 by RSSI
-                        uint16_t limit = fetch < 16 ? fetch : 16;
-                        for (uint16_t i=0;i<limit;i++) {
-                            uint16_t max_i = i;
-                            for (uint16_t j=i+1;j<fetch;j++) if (recs[j].rssi > recs[max_i].rssi) max_i = j;
-                            if (max_i != i) { wifi_ap_record_t tmp = recs[i]; recs[i]=recs[max_i]; recs[max_i]=tmp; }
-                        }
-                        // Build summary JSON-ish string
-                        g_bootstrap_scan_summary[0]='\0';
-                        size_t off=0; off += snprintf(g_bootstrap_scan_summary+off, sizeof(g_bootstrap_scan_summary)-off, "[");
-                        for (uint16_t i=0;i<limit && off < sizeof(g_bootstrap_scan_summary)-16;i++) {
-                            const char *ssid = (const char*)recs[i].ssid;
-                            int n = snprintf(g_bootstrap_scan_summary+off, sizeof(g_bootstrap_scan_summary)-off,
-                                             "%s{\"s\":\"%.*s\",\"r\":%d}",
-                                             (i?",":""), 32, ssid, recs[i].rssi);
-                            if (n<0) {
-                                break;
-                            }
-                            off += n;
+                static opdi_net_scan_ap_t aps[16];
+                size_t limit = opdi_net_scan_results(aps, 16, NULL); // already sorted strongest first
+                if (limit>0) {
+                    // Build summary JSON-ish string
+                    g_bootstrap_scan_summary[0]='\0';
+                    size_t off=0; off += snprintf(g_bootstrap_scan_summary+off, sizeof(g_bootstrap_scan_summary)-off, "[");
+                    for (size_t i=0;i<limit && off < sizeof(g_bootstrap_scan_summary)-16;i++) {
+                        int n = snprintf(g_bootstrap_scan_summary+off, sizeof(g_bootstrap_scan_summary)-off,
+                                         "%s{\"s\":\"%.*s\",\"r\":%d}",
+                                         (i?",":""), 32, aps[i].ssid, aps[i].rssi);
+                        if (n<0) {
+                            break;
                         }
-                        if (off < sizeof(g_bootstrap_scan_summary)-2) { g_bootstrap_scan_summary[off++]=']'; g_bootstrap_scan_summary[off]='\0'; }
-                        ESP_LOGI(TAG, "Bootstrap scan top SSIDs: %s", g_bootstrap_scan_summary);
-                        log_event("bs_scan_done");
+                        off += n;
                     }
+                    if (off < sizeof(g_bootstrap_scan_summary)-2) { g_bootstrap_scan_summary[off++]=']'; g_bootstrap_scan_summary[off]='\0'; }
+                    ESP_LOGI(TAG, "Bootstrap scan top SSIDs: %s", g_bootstrap_scan_summary);
+                    log_event("bs_scan_done");
                 } else {
                     ESP_LOGW(TAG, "Bootstrap scan returned zero APs");
                     log_event("bs_scan_zero");
@@ -748,10 +852,20 @@ static void wifi_event_handler(void* arg, esp_event_base_t base, int32_t id, voi
             log_event("disc %d", reason);
             opdi_net_emit_sta_disconnected(reason);
             // If bootstrap path (no stored profiles) and we haven't scanned yet, kick off scan then AP fallback
-            if (g_bootstrap_attempted && g_mru.count==0 && !g_bootstrap_scan_started && !g_bootstrap_scan_done) {
-                wifi_scan_config_t sc={0}; sc.show_hidden=true; sc.scan_type=WIFI_SCAN_TYPE_ACTIVE; sc.scan_time.active.min=80; sc.scan_time.active.max=120;
-                if (esp_wifi_scan_start(&sc, false)==ESP_OK) { g_bootstrap_scan_started=true; ESP_LOGI(TAG, "Bootstrap disconnect -> scan-before-AP"); log_event("bs_scan_start"); return; }
+            if (g_bootstrap_attempted && mru_count()==0 && !g_bootstrap_scan_started && !g_bootstrap_scan_done) {
+                if (opdi_net_scan_request(0)==ESP_ERR_NOT_FINISHED) { g_bootstrap_scan_started=true; ESP_LOGI(TAG, "Bootstrap disconnect -> scan-before-AP"); log_event("bs_scan_start"); return; }
+            }
+            if (g_state == NET_STA_CONNECTED) {
+                // Link lost after a good session: new attempt window on the same profile, hint first
+                g_current_profile_start_ts = esp_timer_get_time();
+                g_directed_failed = false;
+            } else if (g_directed_attempt) {
+                // Cached BSSID/channel did not work (AP moved/changed channel): full scan next
+                g_directed_failed = true;
+                g_metric_directed_fallbacks++;
+                log_event("directed fail");
             }
+            g_directed_attempt = false;
             if (g_state == NET_STA_CONNECTED || g_state == NET_STA_CONNECT) {
                 if (g_total_retries < CONFIG_OPDI_NET_RETRIES) {
                     enter_state(NET_STA_CONNECT);
@@ -788,41 +902,57 @@ static void wifi_event_handler(void* arg, esp_event_base_t base, int32_t id, voi
     }
 }
 
+// GOT_IP bookkeeping; ap is the associated AP record (NULL if unavailable)
+static void on_sta_got_ip(const ip_event_got_ip_t *ev, const wifi_ap_record_t *ap) {
+    ESP_LOGI(TAG, "Got IP");
+    log_event("got ip");
+    enter_state(NET_STA_CONNECTED);
+    // Update success_count and the reconnect hint (BSSID/channel/PMF) for the active profile
+    if (g_have_current) {
+        store_lock(); // read-modify-write of the cached entry
+        const cred_entry_t *ce = cred_find(g_current_profile_digest);
+        if (ce) {
+            stored_cred_t mod = ce->cred; mod.success_count++; mod.last_ts = esp_timer_get_time();
+            if (ap && ap->primary) {
+                memcpy(mod.bssid, ap->bssid, 6); mod.channel = ap->primary;
+                mod.pmf = CRED_PMF_CAPABLE;
+#ifdef WIFI_AUTH_WPA3_PSK
+                if (ap->authmode == WIFI_AUTH_WPA3_PSK) mod.pmf |= CRED_PMF_REQUIRED;
+#endif
+            }
+            save_profile(&mod);
+        }
+        store_unlock();
+    }
+    g_total_retries = 0;
+    // Extract IP from event structure if available
+    if (ev) {
+        esp_ip4_addr_t ip = ev->ip_info.ip;
+        snprintf(g_last_ip, sizeof(g_last_ip), IPSTR, IP2STR(&ip));
+        esp_ip4_addr_t gw = ev->ip_info.gw;
+        snprintf(g_last_gw, sizeof(g_last_gw), IPSTR, IP2STR(&gw));
+    }
+    opdi_net_emit_sta_connected(g_last_ip[0]?g_last_ip:"0.0.0.0", ap ? ap->rssi : 0, ap ? ap->bssid : NULL);
+    // Metrics success bookkeeping
+    uint64_t now = esp_timer_get_time();
+    g_metric_connect_success++;
+    if (g_current_profile_start_ts) {
+        uint64_t elapsed_ms = (now - g_current_profile_start_ts)/1000ULL;
+        g_metric_last_ttip_ms = (uint32_t)elapsed_ms;
+        if (g_have_current) g_metric_connect_time_accum_ms += elapsed_ms;
+    }
+    if (!g_metric_boot_to_ip_ms) {
+        g_metric_boot_to_ip_ms = (uint32_t)(now/1000ULL);
+        ESP_LOGI(TAG, "boot-to-IP %u ms (attempt-to-IP %u ms, directed=%d)", (unsigned)g_metric_boot_to_ip_ms, (unsigned)g_metric_last_ttip_ms, g_directed_attempt);
+    }
+    g_directed_attempt = false; g_directed_failed = false;
+}
+
 static void ip_event_handler(void* arg, esp_event_base_t base, int32_t id, void* data) {
     if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
-        ESP_LOGI(TAG, "Got IP");
-        log_event("got ip");
-        enter_state(NET_STA_CONNECTED);
-        // Update success_count for active profile digest (if tracked)
-        if (g_have_current) {
-            // Need to load profile by digest - implement quick inline search by iterating
-            struct upd_ctx { uint8_t target[20]; bool done; } uctx; memcpy(uctx.target, g_current_profile_digest,20); uctx.done=false;
-            // Callback updates matching cred
-            bool cbfn(const uint8_t d[20], const stored_cred_t *cred, void *arg){
-                struct upd_ctx *c = (struct upd_ctx*)arg; if (memcmp(d,c->target,20)!=0) return true; // continue
-                stored_cred_t mod = *cred; mod.success_count++; mod.last_ts = esp_timer_get_time(); save_profile(&mod); c->done=true; return false; }
-            foreach_profile((profile_enum_cb)cbfn, &uctx);
-        }
-        g_total_retries = 0;
-        // Query RSSI/BSSID
-        // Extract IP from event structure if available
-        if (data) {
-            // ip_event_got_ip_t defined in esp_netif_ip_addr.h via ip_event.h
-            const ip_event_got_ip_t *ev = (const ip_event_got_ip_t*)data;
-            esp_ip4_addr_t ip = ev->ip_info.ip;
-            snprintf(g_last_ip, sizeof(g_last_ip), IPSTR, IP2STR(&ip));
-            esp_ip4_addr_t gw = ev->ip_info.gw;
-            snprintf(g_last_gw, sizeof(g_last_gw), IPSTR, IP2STR(&gw));
-        }
-        wifi_ap_record_t ap; int rssi=0; uint8_t bssid_local[6]={0}; const uint8_t *bptr=NULL;
-        if (esp_wifi_sta_get_ap_info(&ap)==ESP_OK) { rssi=ap.rssi; memcpy(bssid_local, ap.bssid,6); bptr=bssid_local; }
-        opdi_net_emit_sta_connected(g_last_ip[0]?g_last_ip:"0.0.0.0", rssi, bptr);
-        // Metrics success bookkeeping
-        g_metric_connect_success++;
-        if (g_have_current && g_current_profile_start_ts) {
-            uint64_t elapsed_ms = (esp_timer_get_time() - g_current_profile_start_ts)/1000ULL;
-            g_metric_connect_time_accum_ms += elapsed_ms;
-        }
+        wifi_ap_record_t ap;
+        bool have_ap = esp_wifi_sta_get_ap_info(&ap)==ESP_OK;
+        on_sta_got_ip((const ip_event_got_ip_t*)data, have_ap ? &ap : NULL);
     } else if (base == IP_EVENT && id == IP_EVENT_AP_STAIPASSIGNED) {
         ip_event_ap_staipassigned_t *ev = (ip_event_ap_staipassigned_t*)data;
         if (ev) {
@@ -843,10 +973,15 @@ esp_err_t opdi_net_init(void) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ESP_ERROR_CHECK(nvs_flash_init());
     }
+    if (!s_store) s_store = xSemaphoreCreateRecursiveMutex();
+    if (!s_store) return ESP_ERR_NO_MEM;
+    store_lock();
     {
-        esp_err_t e = load_profiles(); if (e!=ESP_OK) { ESP_LOGE(TAG, "load profiles err=%d", e); return e; }
+        esp_err_t e = load_profiles(); if (e!=ESP_OK) { store_unlock(); ESP_LOGE(TAG, "load profiles err=%d", e); return e; }
     }
     migrate_placeholder_digests();
+    cred_cache_load();
+    store_unlock();
     // Load AP config if exists
     nvs_handle_t h_ap; if (nvs_open_net(&h_ap)==ESP_OK) {
         size_t sl = sizeof(g_ap_ssid); nvs_get_str(h_ap, NVS_KEY_AP_SSID, g_ap_ssid, &sl);
@@ -942,12 +1077,14 @@ esp_err_t opdi_net_add_profile(const opdi_net_profile_t *p) {
     cred.hidden = p->hidden;
     cred.last_ts = esp_timer_get_time();
     cred.success_count = 0; // updated on success
+    uint8_t digest[20]; sha1_of_ssid(p->ssid, digest);
+    store_lock();
     {
-        esp_err_t e = save_profile(&cred); if (e!=ESP_OK) { ESP_LOGE(TAG, "save profile err=%d", e); return e; }
+        esp_err_t e = save_profile(&cred); if (e!=ESP_OK) { store_unlock(); ESP_LOGE(TAG, "save profile err=%d", e); return e; }
     }
-    uint8_t digest[20]; sha1_of_ssid(p->ssid, digest);
     mru_promote_or_add(digest);
     save_mru();
+    store_unlock();
     ESP_LOGI(TAG, "profile added (hidden=%d)", p->hidden);
     // Disable further bootstrap attempts now that a real profile exists
     if (!g_bootstrap_attempted) { g_bootstrap_attempted = true; }
@@ -982,6 +1119,14 @@ esp_err_t opdi_net_connect(const char *ssid_or_null) {
 
 opdi_net_state_t opdi_net_get_state(void) { return g_state; }
 
+esp_err_t opdi_net_sta_rssi(int8_t *out) {
+    if (g_state != NET_STA_CONNECTED) return ESP_ERR_INVALID_STATE;
+    wifi_ap_record_t ap;
+    esp_err_t err = esp_wifi_sta_get_ap_info(&ap);
+    if (err == ESP_OK && out) *out = ap.rssi;
+    return err;
+}
+
 // Internal enumeration exposure for REST (not in public header yet) -------------------------
 typedef struct { char *buf; size_t cap; size_t len; } json_buf_t;
 
@@ -991,8 +1136,8 @@ static bool enum_profiles_json_cb(const uint8_t digest[20], const stored_cred_t
     // mask: use last 2 bytes of digest
     char entry[160];
     snprintf(entry, sizeof(entry),
-             "{\"id\":\"%02x%02x%02x%02x...\",\"ssid_len\":%u,\"hidden\":%s,\"success\":%u},",
-             digest[16], digest[17], digest[18], digest[19], (unsigned)strlen(cred->ssid), cred->hidden?"true":"false", (unsigned)cred->success_count);
+             "{\"id\":\"%02x%02x%02x%02x...\",\"ssid_len\":%u,\"hidden\":%s,\"success\":%u,\"ch\":%u},",
+             digest[16], digest[17], digest[18], digest[19], (unsigned)strlen(cred->ssid), cred->hidden?"true":"false", (unsigned)cred->success_count, (unsigned)cred->channel);
     size_t el = strlen(entry);
     if (jb->len + el >= jb->cap) return false;
     memcpy(jb->buf + jb->len, entry, el); jb->len += el; jb->buf[jb->len] = '\0';
@@ -1009,6 +1154,24 @@ size_t opdi_net_profiles_serialize(char *out, size_t out_cap) {
     return jb.len;
 }
 
+struct info_visit { bool (*cb)(const opdi_net_profile_info_t *p, void *arg); void *arg; };
+static bool info_visit_cb(const uint8_t digest[20], const stored_cred_t *cred, void *arg) {
+    struct info_visit *v = (struct info_visit*)arg;
+    opdi_net_profile_info_t p = {0};
+    snprintf(p.id, sizeof(p.id), "%02x%02x%02x%02x", digest[16], digest[17], digest[18], digest[19]);
+    p.ssid_len = (uint8_t)strnlen(cred->ssid, 32);
+    p.hidden = cred->hidden;
+    p.success = cred->success_count;
+    p.channel = cred->channel;
+    return v->cb(&p, v->arg);
+}
+
+void opdi_net_profiles_foreach(bool (*cb)(const opdi_net_profile_info_t *p, void *arg), void *arg) {
+    if (!cb) return;
+    struct info_visit v = { cb, arg };
+    foreach_profile(info_visit_cb, &v);
+}
+
 esp_err_t opdi_net_forget_hash_tail(const char *partial_id) {
     if (!partial_id) return ESP_ERR_INVALID_ARG;
     // brute force iterate to find match on first 4 displayed bytes (digest[16..19])
@@ -1048,6 +1211,10 @@ void opdi_net_get_metrics(opdi_net_metrics_t *out) {
     }
     out->scan_count = g_metric_scan_count;
     out->current_retries = g_total_retries;
+    out->last_time_to_ip_ms = g_metric_last_ttip_ms;
+    out->boot_to_ip_ms = g_metric_boot_to_ip_ms;
+    out->directed_attempts = g_metric_directed_attempts;
+    out->directed_fallbacks = g_metric_directed_fallbacks;
 }
 
 // Accessors for cached IP/GW (avoid exposing static symbols directly)
@@ -1057,6 +1224,17 @@ const char *opdi_net_gw_cached(void){ return g_last_gw; }
 // Hosted FW version accessor
 const char *opdi_net_hosted_fw_version(void){ return g_hosted_fw_version; }
 
+void opdi_net_logs_foreach(bool (*cb)(uint32_t ts_ms, const char *msg, void *arg), void *arg) {
+    if (!cb) return;
+    size_t count = g_logs_count;
+    size_t start = (g_logs_head + OPDI_NET_LOG_MAX - count) % OPDI_NET_LOG_MAX;
+    for (size_t i=0;i<count;i++) {
+        net_log_t e = g_logs[(start + i) % OPDI_NET_LOG_MAX]; // copy: the ring may advance meanwhile
+        e.msg[sizeof(e.msg)-1] = '\0';
+        if (!cb(e.ts_ms, e.msg, arg)) break;
+    }
+}
+
 size_t opdi_net_logs_serialize(char *out, size_t cap) {
     if (!out || cap < 4) return 0;
     size_t len = 0; out[len++]='['; out[len]='\0';
@@ -1212,6 +1390,17 @@ static esp_err_t start_ap_mode(void){ return ESP_OK; }
 #ifdef CONFIG_OPDI_NET_TESTING
 // Testing helpers ----------------------------------------------------------
 void opdi_net_test_force_state(opdi_net_state_t st){ enter_state(st); }
+uint32_t opdi_net_test_nvs_ops(void){ return g_nvs_ops; }
+void opdi_net_test_simulate_got_ip(const char *ip, const uint8_t bssid[6], uint8_t channel){
+    wifi_ap_record_t ap = { .primary = channel, .rssi = -45, .authmode = WIFI_AUTH_WPA2_PSK };
+    if (bssid) memcpy(ap.bssid, bssid, 6);
+    if (ip) strlcpy(g_last_ip, ip, sizeof(g_last_ip));
+    on_sta_got_ip(NULL, &ap);
+}
+void opdi_net_test_simulate_sta_disconnected(int reason){
+    wifi_event_sta_disconnected_t ev = { .reason = reason };
+    wifi_event_handler(NULL, WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &ev);
+}
 void opdi_net_test_simulate_sta_connected(const char *ip, const char *gw, int rssi){
     if (ip) strlcpy(g_last_ip, ip, sizeof(g_last_ip));
     if (gw) strlcpy(g_last_gw, gw, sizeof(g_last_gw));
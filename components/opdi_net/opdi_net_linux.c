@@ -0,0 +1,284 @@
+// Linux host target: in-memory stand-in for the Wi-Fi manager (opdi_net.c) and the radio under the scan
+// service. Same public API and the same weak emit hooks, so routes_net.c and /ws behave as on the device:
+// connects finish after OPDI_NET_HOST_CONNECT_MS; a scan started by opdi_net_scan.c completes after
+// OPDI_NET_HOST_SCAN_MS and hands it a fixed synthetic AP table through the esp_wifi record calls.
+// Profiles live in RAM only.
+#include "opdi_net.h"
+#include "opdi_net_linux.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/sha1.h"
+#include "freertos/FreeRTOS.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "opdi_net_host";
+
+#define OPDI_NET_HOST_CONNECT_MS 300
+#define OPDI_NET_HOST_SCAN_MS    1500
+#define HOST_IP "127.0.0.1"
+#define HOST_RSSI (-52)
+
+typedef struct { opdi_net_profile_t p; uint8_t digest[20]; uint32_t success; uint8_t channel; } host_profile_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static opdi_net_state_t s_state = NET_INIT;
+static host_profile_t s_profiles[CONFIG_OPDI_NET_MAX_PROFILES];
+static size_t s_profile_count;
+static int s_target = -1;                 // profile being connected
+static char s_ip[16] = "", s_gw[16] = "";
+static char s_ap_ssid[33] = "OPDI_SKPR-HOST";
+static uint8_t s_ap_channel = CONFIG_OPDI_AP_CHANNEL;
+static opdi_net_metrics_t s_metrics;
+static int64_t s_attempt_us;
+static uint64_t s_connect_ms_accum;
+static esp_timer_handle_t s_connect_timer, s_scan_timer;
+static size_t s_scan_pos;                 // next record esp_wifi_scan_get_ap_record hands out
+
+#define LOG_MAX 16
+typedef struct { uint32_t ts_ms; char msg[48]; } net_log_t;
+static net_log_t s_logs[LOG_MAX];
+static size_t s_logs_head, s_logs_count;
+
+__attribute__((weak)) void opdi_net_emit_sta_connected(const char *ip, int rssi, const uint8_t bssid[6]) { (void)ip; (void)rssi; (void)bssid; }
+__attribute__((weak)) void opdi_net_emit_sta_disconnected(int reason) { (void)reason; }
+__attribute__((weak)) void opdi_net_emit_ap_active(const char *ssid, uint8_t channel) { (void)ssid; (void)channel; }
+__attribute__((weak)) void opdi_net_emit_metrics(void) { }
+
+static void log_event(const char *fmt, ...) {
+    net_log_t e = { .ts_ms = (uint32_t)(esp_timer_get_time() / 1000) };
+    va_list ap; va_start(ap, fmt); vsnprintf(e.msg, sizeof(e.msg), fmt, ap); va_end(ap);
+    taskENTER_CRITICAL(&s_lock);
+    s_logs[s_logs_head] = e;
+    s_logs_head = (s_logs_head + 1) % LOG_MAX;
+    if (s_logs_count < LOG_MAX) s_logs_count++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void sha1_of_ssid(const char *ssid, uint8_t out[20]) {
+    mbedtls_sha1_context ctx; mbedtls_sha1_init(&ctx); mbedtls_sha1_starts(&ctx);
+    mbedtls_sha1_update(&ctx, (const unsigned char *)ssid, strnlen(ssid, 32));
+    mbedtls_sha1_finish(&ctx, out);
+    mbedtls_sha1_free(&ctx);
+}
+
+static int find_profile(const char *ssid) {
+    for (size_t i = 0; i < s_profile_count; i++) if (!strcmp(s_profiles[i].p.ssid, ssid)) return (int)i;
+    return -1;
+}
+
+static void enter_state(opdi_net_state_t st) {
+    s_state = st;
+    if (st == NET_AP_ACTIVE) { log_event("ap_active %s", s_ap_ssid); opdi_net_emit_ap_active(s_ap_ssid, s_ap_channel); }
+    opdi_net_emit_metrics();
+}
+
+static void got_ip(const char *ip, const char *gw, int rssi, const uint8_t bssid[6]) {
+    uint32_t ttip = (uint32_t)((esp_timer_get_time() - s_attempt_us) / 1000);
+    strlcpy(s_ip, ip, sizeof(s_ip)); strlcpy(s_gw, gw, sizeof(s_gw));
+    s_metrics.connects_success++;
+    s_connect_ms_accum += ttip;
+    s_metrics.avg_connect_time_ms = (uint32_t)(s_connect_ms_accum / s_metrics.connects_success);
+    s_metrics.last_time_to_ip_ms = ttip;
+    if (!s_metrics.boot_to_ip_ms) s_metrics.boot_to_ip_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    s_metrics.current_retries = 0;
+    if (s_target >= 0) s_profiles[s_target].success++;
+    log_event("got_ip %s", s_ip);
+    enter_state(NET_STA_CONNECTED);
+    opdi_net_emit_sta_connected(s_ip, rssi, bssid);
+}
+
+static void connect_done(void *arg) {
+    (void)arg;
+    if (s_state != NET_STA_CONNECT) return;
+    if (s_target < 0) { s_metrics.current_retries++; log_event("connect failed"); enter_state(NET_AP_ACTIVE); return; }
+    static const uint8_t bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    got_ip(HOST_IP, HOST_IP, HOST_RSSI, bssid);
+}
+
+// Radio stand-in: records in channel order, as the driver reports them; opdi_net_scan.c filters and ranks
+static const struct { const char *ssid; int8_t rssi; uint8_t auth, ch; } k_aps[] = {
+    { "office-5", -58, 3, 1 }, { "", -74, 3, 1 }, { "opdi-lab", -41, 3, 6 }, { "printer-direct", -70, 3, 6 },
+    { "guest", -63, 0, 11 }, { "neighbor", -81, 4, 11 }, { "far-away", -93, 3, 13 },
+};
+#define K_APS (sizeof(k_aps) / sizeof(k_aps[0]))
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block) {
+    (void)config; (void)block;
+    if (!s_scan_timer) return ESP_ERR_INVALID_STATE;
+    esp_timer_stop(s_scan_timer);
+    return esp_timer_start_once(s_scan_timer, OPDI_NET_HOST_SCAN_MS * 1000);
+}
+
+esp_err_t esp_wifi_scan_get_ap_record(wifi_ap_record_t *ap_record) {
+    if (!ap_record || s_scan_pos >= K_APS) return ESP_FAIL;
+    size_t i = s_scan_pos++;
+    memset(ap_record, 0, sizeof(*ap_record));
+    strlcpy((char *)ap_record->ssid, k_aps[i].ssid, sizeof(ap_record->ssid));
+    ap_record->bssid[0] = 0x02; ap_record->bssid[5] = (uint8_t)(i + 1);
+    ap_record->primary = k_aps[i].ch;
+    ap_record->rssi = k_aps[i].rssi;
+    ap_record->authmode = k_aps[i].auth;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_clear_ap_list(void) { s_scan_pos = K_APS; return ESP_OK; }
+
+// Counted here as opdi_net.c does on the device (scan_count metric, "scan" log line)
+void opdi_net_internal_scan_account(void) { s_metrics.scan_count++; log_event("scan"); }
+
+// SCAN_DONE: the list is complete, the scan service drains it
+static void scan_done(void *arg) {
+    (void)arg;
+    s_scan_pos = 0;
+    opdi_net_scan_on_done();
+}
+
+esp_err_t opdi_net_init(void) {
+    if (s_connect_timer) return ESP_OK;
+    const esp_timer_create_args_t ct = { .callback = connect_done, .name = "net_host_conn" };
+    const esp_timer_create_args_t st = { .callback = scan_done, .name = "net_host_scan" };
+    esp_err_t err = esp_timer_create(&ct, &s_connect_timer);
+    if (err == ESP_OK) err = esp_timer_create(&st, &s_scan_timer);
+    if (err != ESP_OK) return err;
+    ESP_LOGI(TAG, "host network stub (no radio)");
+    log_event("init");
+    if (CONFIG_OPDI_NET_BOOTSTRAP_SSID[0]) {
+        opdi_net_profile_t p = {0};
+        strlcpy(p.ssid, CONFIG_OPDI_NET_BOOTSTRAP_SSID, sizeof(p.ssid));
+        opdi_net_add_profile(&p);
+    }
+    if (s_profile_count) return opdi_net_connect(NULL);
+    enter_state(NET_AP_ACTIVE);
+    return ESP_OK;
+}
+
+esp_err_t opdi_net_add_profile(const opdi_net_profile_t *p) {
+    if (!p || !p->ssid[0]) return ESP_ERR_INVALID_ARG;
+    int i = find_profile(p->ssid);
+    if (i < 0) {
+        if (s_profile_count >= CONFIG_OPDI_NET_MAX_PROFILES) return ESP_ERR_NO_MEM;
+        i = (int)s_profile_count++;
+        memset(&s_profiles[i], 0, sizeof(s_profiles[i]));
+    }
+    s_profiles[i].p = *p;
+    sha1_of_ssid(p->ssid, s_profiles[i].digest);
+    log_event("profile add");
+    return ESP_OK;
+}
+
+esp_err_t opdi_net_forget(const char *ssid) {
+    int i = ssid ? find_profile(ssid) : -1;
+    if (i < 0) return ESP_ERR_NOT_FOUND;
+    memmove(&s_profiles[i], &s_profiles[i + 1], (s_profile_count - i - 1) * sizeof(s_profiles[0]));
+    s_profile_count--;
+    if (s_target == i) s_target = -1;
+    else if (s_target > i) s_target--;
+    log_event("profile forget");
+    return ESP_OK;
+}
+
+esp_err_t opdi_net_forget_hash_tail(const char *partial_id) {
+    if (!partial_id) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < s_profile_count; i++) {
+        const uint8_t *d = s_profiles[i].digest;
+        char id[9]; snprintf(id, sizeof(id), "%02x%02x%02x%02x", d[16], d[17], d[18], d[19]);
+        if (!strncmp(id, partial_id, strlen(partial_id))) return opdi_net_forget(s_profiles[i].p.ssid);
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t opdi_net_connect(const char *ssid_or_null) {
+    if (!s_connect_timer) return ESP_ERR_INVALID_STATE;
+    s_target = ssid_or_null ? find_profile(ssid_or_null) : (s_profile_count ? 0 : -1);
+    s_metrics.connect_attempts++;
+    s_attempt_us = esp_timer_get_time();
+    if (s_state == NET_STA_CONNECTED) opdi_net_emit_sta_disconnected(8); // WIFI_REASON_ASSOC_LEAVE
+    s_ip[0] = s_gw[0] = '\0';
+    log_event("connect %s", ssid_or_null ? ssid_or_null : "(mru)");
+    enter_state(NET_STA_CONNECT);
+    esp_timer_stop(s_connect_timer);
+    return esp_timer_start_once(s_connect_timer, OPDI_NET_HOST_CONNECT_MS * 1000);
+}
+
+opdi_net_state_t opdi_net_get_state(void) { return s_state; }
+
+esp_err_t opdi_net_sta_rssi(int8_t *out) {
+    if (s_state != NET_STA_CONNECTED) return ESP_ERR_INVALID_STATE;
+    if (out) *out = HOST_RSSI;
+    return ESP_OK;
+}
+
+esp_err_t opdi_net_ap_set(const char *ssid, uint8_t channel) {
+    if (ssid && ssid[0]) strlcpy(s_ap_ssid, ssid, sizeof(s_ap_ssid));
+    if (channel >= 1 && channel <= 13) s_ap_channel = channel;
+    return ESP_OK;
+}
+
+void opdi_net_ap_get(char *out_ssid, size_t len, uint8_t *out_channel) {
+    if (out_ssid && len) strlcpy(out_ssid, s_ap_ssid, len);
+    if (out_channel) *out_channel = s_ap_channel;
+}
+
+void opdi_net_get_metrics(opdi_net_metrics_t *out) { if (out) *out = s_metrics; }
+const char *opdi_net_ip_cached(void) { return s_ip; }
+const char *opdi_net_gw_cached(void) { return s_gw; }
+const char *opdi_net_hosted_fw_version(void) { return "host"; }
+
+void opdi_net_logs_foreach(bool (*cb)(uint32_t ts_ms, const char *msg, void *arg), void *arg) {
+    if (!cb) return;
+    size_t count = s_logs_count, start = (s_logs_head + LOG_MAX - count) % LOG_MAX;
+    for (size_t i = 0; i < count; i++) {
+        taskENTER_CRITICAL(&s_lock);
+        net_log_t e = s_logs[(start + i) % LOG_MAX];
+        taskEXIT_CRITICAL(&s_lock);
+        if (!cb(e.ts_ms, e.msg, arg)) break;
+    }
+}
+
+struct log_buf { char *out; size_t cap, len; };
+static bool log_json_cb(uint32_t ts_ms, const char *msg, void *arg) {
+    struct log_buf *b = (struct log_buf *)arg;
+    int n = snprintf(b->out + b->len, b->cap - b->len, "%s{\"t\":%lu,\"m\":\"%s\"}", b->len > 1 ? "," : "", (unsigned long)ts_ms, msg);
+    if (n < 0 || b->len + (size_t)n + 2 > b->cap) return false;
+    b->len += (size_t)n;
+    return true;
+}
+
+size_t opdi_net_logs_serialize(char *out, size_t cap) {
+    if (!out || cap < 4) return 0;
+    struct log_buf b = { out, cap, 1 };
+    out[0] = '[';
+    opdi_net_logs_foreach(log_json_cb, &b);
+    out[b.len++] = ']'; out[b.len] = '\0';
+    return b.len;
+}
+
+void opdi_net_profiles_foreach(bool (*cb)(const opdi_net_profile_info_t *p, void *arg), void *arg) {
+    if (!cb) return;
+    for (size_t i = 0; i < s_profile_count; i++) {
+        const host_profile_t *hp = &s_profiles[i];
+        opdi_net_profile_info_t p = { .ssid_len = (uint8_t)strnlen(hp->p.ssid, 32), .hidden = hp->p.hidden,
+                                      .success = hp->success, .channel = hp->channel };
+        snprintf(p.id, sizeof(p.id), "%02x%02x%02x%02x", hp->digest[16], hp->digest[17], hp->digest[18], hp->digest[19]);
+        if (!cb(&p, arg)) break;
+    }
+}
+
+#ifdef CONFIG_OPDI_NET_TESTING
+void opdi_net_test_force_state(opdi_net_state_t st) { enter_state(st); }
+uint32_t opdi_net_test_nvs_ops(void) { return 0; } // no NVS on the host stub
+void opdi_net_test_simulate_sta_connected(const char *ip, const char *gw, int rssi) { got_ip(ip, gw, rssi, NULL); }
+void opdi_net_test_simulate_got_ip(const char *ip, const uint8_t bssid[6], uint8_t channel) {
+    if (s_target >= 0) s_profiles[s_target].channel = channel;
+    got_ip(ip, s_gw[0] ? s_gw : ip, HOST_RSSI, bssid);
+}
+void opdi_net_test_simulate_sta_disconnected(int reason) {
+    s_ip[0] = s_gw[0] = '\0';
+    log_event("disconnected %d", reason);
+    opdi_net_emit_sta_disconnected(reason);
+    enter_state(NET_STA_CONNECT);
+}
+#endif
@@ -0,0 +1,31 @@
+// Host build (linux target): the few esp_wifi scan types and calls opdi_net_scan.c uses, served by
+// opdi_net_linux.c from a fixed AP table (same signatures as esp_wifi.h)
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { WIFI_SCAN_TYPE_ACTIVE = 0, WIFI_SCAN_TYPE_PASSIVE } wifi_scan_type_t;
+typedef struct {
+    uint8_t *ssid;
+    uint8_t *bssid;
+    uint8_t channel;
+    bool show_hidden;
+    wifi_scan_type_t scan_type;
+    struct { struct { uint32_t min, max; } active; uint32_t passive; } scan_time;
+} wifi_scan_config_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+    int authmode;
+} wifi_ap_record_t;
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block);
+esp_err_t esp_wifi_scan_get_ap_record(wifi_ap_record_t *ap_record);
+esp_err_t esp_wifi_clear_ap_list(void);
+
+// opdi_net_scan.c: drains the record list once the (stub) radio reports SCAN_DONE
+void opdi_net_scan_on_done(void);
@@ -0,0 +1,153 @@
+// Shared Wi-Fi scan service: one radio scan at a time, results cached with a timestamp and
+// shared by every caller (REST, WebSocket clients, settings UI, bootstrap/self-check in opdi_net.c).
+#include "opdi_net.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "opdi_net_linux.h"
+#else
+#include "esp_wifi.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "opdi_net_scan";
+
+// A scan whose SCAN_DONE never arrived (driver reset, hosted link hiccup) stops blocking new ones
+#define SCAN_STUCK_US (10 * 1000000LL)
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static opdi_net_scan_ap_t s_aps[CONFIG_OPDI_NET_SCAN_MAX_APS]; // strongest first
+static size_t s_count;
+static int64_t s_done_us = -1;    // completion time of the cached results (-1: never scanned)
+static int64_t s_started_us;      // start time of the scan in flight
+static bool s_in_flight;
+static uint32_t s_waiters;        // requests coalesced onto the scan in flight (including the starter)
+
+__attribute__((weak)) void opdi_net_internal_scan_account(void);
+__attribute__((weak)) void opdi_net_emit_scan(const opdi_net_scan_ap_t *aps, size_t count) {
+    (void)aps; ESP_LOGI(TAG, "emit scan %u APs (stub)", (unsigned)count);
+}
+
+static uint32_t age_ms_locked(int64_t now){
+    if (s_done_us < 0) return UINT32_MAX;
+    int64_t ms = (now - s_done_us) / 1000;
+    return ms > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+}
+
+static esp_err_t radio_scan_start(void){
+#if !CONFIG_OPDI_NET_TESTING
+    wifi_scan_config_t sc = {0};
+    sc.show_hidden = true;
+    sc.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    sc.scan_time.active.min = 80; sc.scan_time.active.max = 120; // short dwell, ~1.5 s for 13 channels
+    return esp_wifi_scan_start(&sc, false);
+#else
+    return ESP_OK; // completed by opdi_net_test_simulate_scan_done()
+#endif
+}
+
+esp_err_t opdi_net_scan_request(uint32_t max_age_ms){
+    int64_t now = esp_timer_get_time();
+    bool start = false;
+    taskENTER_CRITICAL(&s_lock);
+    if (s_done_us >= 0 && age_ms_locked(now) < max_age_ms) {
+        taskEXIT_CRITICAL(&s_lock);
+        return ESP_OK;
+    }
+    if (s_in_flight && now - s_started_us > SCAN_STUCK_US) s_in_flight = false;
+    if (!s_in_flight) { s_in_flight = true; s_started_us = now; s_waiters = 0; start = true; }
+    s_waiters++;
+    taskEXIT_CRITICAL(&s_lock);
+    if (!start) return ESP_ERR_NOT_FINISHED; // joined the scan in flight
+
+    esp_err_t err = radio_scan_start();
+    if (err != ESP_OK) {
+        // Usually ESP_ERR_WIFI_STATE while the STA is mid-connect; the stale cache stays readable
+        ESP_LOGW(TAG, "scan start failed (%s)", esp_err_to_name(err));
+        taskENTER_CRITICAL(&s_lock);
+        s_in_flight = false;
+        taskEXIT_CRITICAL(&s_lock);
+        return err;
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+static void store_results(const opdi_net_scan_ap_t *aps, size_t n){
+    int64_t now = esp_timer_get_time();
+    uint32_t waiters;
+    taskENTER_CRITICAL(&s_lock);
+    if (n > CONFIG_OPDI_NET_SCAN_MAX_APS) n = CONFIG_OPDI_NET_SCAN_MAX_APS;
+    memcpy(s_aps, aps, n * sizeof(*aps));
+    s_count = n;
+    s_done_us = now;
+    waiters = s_waiters;
+    s_in_flight = false;
+    s_waiters = 0;
+    taskEXIT_CRITICAL(&s_lock);
+    if (opdi_net_internal_scan_account) opdi_net_internal_scan_account();
+    ESP_LOGI(TAG, "scan done: %u APs, served %u request(s)", (unsigned)n, (unsigned)waiters);
+    opdi_net_emit_scan(aps, n);
+}
+
+// Insert keeping strongest first; drops the weakest once the table is full
+static size_t insert_sorted(opdi_net_scan_ap_t *aps, size_t n, const opdi_net_scan_ap_t *ap){
+    size_t i = n < CONFIG_OPDI_NET_SCAN_MAX_APS ? n : CONFIG_OPDI_NET_SCAN_MAX_APS - 1;
+    if (n == CONFIG_OPDI_NET_SCAN_MAX_APS && ap->rssi <= aps[i].rssi) return n;
+    while (i > 0 && aps[i-1].rssi < ap->rssi) { aps[i] = aps[i-1]; i--; }
+    aps[i] = *ap;
+    return n < CONFIG_OPDI_NET_SCAN_MAX_APS ? n + 1 : n;
+}
+
+// Called from the WIFI_EVENT_SCAN_DONE handler in opdi_net.c (sys_evt task): the only place
+// that drains the driver's record list, so every scan lands in the cache whoever started it.
+// Records come one at a time in driver (channel) order; all of them are ranked so the cache
+// keeps the strongest CONFIG_OPDI_NET_SCAN_MAX_APS, not the first ones found.
+void opdi_net_scan_on_done(void){
+    // Static: the system event task stack is small
+    static opdi_net_scan_ap_t aps[CONFIG_OPDI_NET_SCAN_MAX_APS];
+    wifi_ap_record_t rec;
+    size_t count = 0;
+    while (esp_wifi_scan_get_ap_record(&rec) == ESP_OK) {
+        if (rec.rssi < CONFIG_OPDI_NET_SCAN_MIN_RSSI) continue;
+        opdi_net_scan_ap_t ap = {0};
+        strlcpy(ap.ssid, (const char*)rec.ssid, sizeof(ap.ssid));
+        memcpy(ap.bssid, rec.bssid, sizeof(ap.bssid));
+        ap.rssi = rec.rssi;
+        ap.auth = (uint8_t)rec.authmode;
+        ap.channel = rec.primary;
+        count = insert_sorted(aps, count, &ap);
+    }
+    esp_wifi_clear_ap_list(); // frees whatever the loop did not take (no-op once drained)
+    store_results(aps, count);
+}
+
+size_t opdi_net_scan_results(opdi_net_scan_ap_t *out, size_t cap, uint32_t *out_age_ms){
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    size_t n = s_count < cap ? s_count : cap;
+    if (out && n) memcpy(out, s_aps, n * sizeof(*out));
+    if (out_age_ms) *out_age_ms = age_ms_locked(now);
+    taskEXIT_CRITICAL(&s_lock);
+    return out ? n : 0;
+}
+
+bool opdi_net_scan_in_progress(void){
+    taskENTER_CRITICAL(&s_lock);
+    bool busy = s_in_flight && esp_timer_get_time() - s_started_us <= SCAN_STUCK_US;
+    taskEXIT_CRITICAL(&s_lock);
+    return busy;
+}
+
+#ifdef CONFIG_OPDI_NET_TESTING
+void opdi_net_test_simulate_scan_done(const opdi_net_scan_ap_t *aps, size_t count){
+    static opdi_net_scan_ap_t sorted[CONFIG_OPDI_NET_SCAN_MAX_APS];
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (aps[i].rssi < CONFIG_OPDI_NET_SCAN_MIN_RSSI) continue;
+        n = insert_sorted(sorted, n, &aps[i]);
+    }
+    store_results(sorted, n);
+}
+#endif
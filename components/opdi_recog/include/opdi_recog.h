@@ -0,0 +1,101 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "opdi_gallery.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Face recognition stage (SRD FR-4): the 5 MNP landmarks of a detection are mapped onto a canonical
+// 112x112 face by a similarity transform, the crop goes through the embedding model, and the
+// L2-normalized feature is quantized and matched against opdi_gallery.
+#define OPDI_RECOG_CROP 112
+#define OPDI_RECOG_CROP_BYTES (OPDI_RECOG_CROP * OPDI_RECOG_CROP * 3) // RGB888, R first
+
+// Crop -> frame mapping: x = a*u - b*v + tx, y = b*u + a*v + ty. sqrt(a^2 + b^2) is the frame size
+// of one crop pixel, so it also measures how large the face is.
+typedef struct {
+    float a, b, tx, ty;
+} opdi_recog_xform_t;
+
+typedef struct {
+    uint32_t align_us;   // transform + warp
+    uint32_t embed_us;   // model preprocess + forward + L2 norm + int8 quantize
+    uint32_t match_us;   // gallery scan
+    uint32_t total_us;
+} opdi_recog_latency_t;
+
+typedef struct {
+    uint16_t id;                          // gallery id of the best match
+    bool matched;                         // score above the gallery threshold
+    float score;                          // cosine similarity
+    char label[OPDI_GALLERY_LABEL_LEN];   // empty when not matched
+    opdi_recog_latency_t lat;
+} opdi_recog_result_t;
+
+// Per-face latency since boot: moving averages (1/8 per face), worst case and the last face
+typedef struct {
+    uint32_t faces;
+    opdi_recog_latency_t avg;
+    opdi_recog_latency_t max;
+    opdi_recog_latency_t last;
+} opdi_recog_stats_t;
+
+// Least-squares similarity from the ArcFace 112x112 template to the detector landmarks
+// (x0,y0 .. x4,y4 in MNP order: left eye, left mouth, nose, right eye, right mouth).
+// ESP_ERR_INVALID_ARG for degenerate landmarks.
+esp_err_t opdi_recog_estimate(const int landmarks[10], opdi_recog_xform_t *out);
+
+// Fixed-point (Q16 coordinates, Q8 weights) bilinear warp of an RGB565 frame into the 112x112 RGB888
+// crop. Samples outside the frame repeat the edge. big_endian: the frame stores RGB565 high byte first
+// (camera frames: OPDI_CAM_RGB565_BIG_ENDIAN, which is 0 on the P4).
+void opdi_recog_warp_rgb565(const uint16_t *frame, int w, int h, bool big_endian,
+                            const opdi_recog_xform_t *m, uint8_t *crop);
+
+// Load the embedding model (CONFIG_OPDI_RECOG_MODEL_*). The output length must be OPDI_GALLERY_DIM.
+esp_err_t opdi_recog_init(void);
+bool opdi_recog_ready(void);
+void opdi_recog_deinit(void);
+
+// Align + embed one face of an RGB565 frame into a quantized gallery vector (OPDI_GALLERY_DIM)
+esp_err_t opdi_recog_embed(const uint16_t *frame, int w, int h, const int landmarks[10],
+                           int8_t *emb, opdi_recog_latency_t *lat);
+// opdi_recog_embed() + opdi_gallery_match(); ESP_ERR_NOT_FOUND when the gallery is empty
+esp_err_t opdi_recog_identify(const uint16_t *frame, int w, int h, const int landmarks[10],
+                              opdi_recog_result_t *out);
+
+void opdi_recog_get_stats(opdi_recog_stats_t *out);
+
+// Per-track result cache. Faces are associated with tracks by box overlap frame to frame; a track
+// reuses its identity until the face scale or pose (nose offset in the aligned crop) drifts past
+// CONFIG_OPDI_RECOG_CACHE_SIZE_PCT / _POSE_PCT or CONFIG_OPDI_RECOG_CACHE_TTL_MS expires. Fresh
+// results are voted per track, so a single off frame does not flip the identity.
+// Single caller (the detect task); only the counters are read from elsewhere.
+typedef struct {
+    uint32_t lookups;    // faces looked up since boot
+    uint32_t hits;       // ... answered from the cache
+    uint32_t embeds;     // fresh results stored (one embedding each)
+    uint8_t tracks;      // live tracks
+} opdi_recog_cache_stats_t;
+
+// Start a frame; tracks not seen for a second are dropped
+void opdi_recog_cache_begin_frame(int64_t now_us);
+// Associate a face (box x0,y0,x1,y1 + landmarks) with a track. true: *out holds the cached, smoothed
+// identity and no embedding is needed. false: run opdi_recog_identify() and hand the result to
+// opdi_recog_cache_put() with the same track.
+bool opdi_recog_cache_get(const int box[4], const int landmarks[10], int64_t now_us,
+                          uint16_t *track, opdi_recog_result_t *out);
+// Vote a fresh result into the track; *out becomes the smoothed identity (may differ from fresh)
+void opdi_recog_cache_put(uint16_t track, const int landmarks[10], const opdi_recog_result_t *fresh,
+                          int64_t now_us, opdi_recog_result_t *out);
+// Forget every track (detector mode switched). Detect task only: gallery changes arrive through
+// opdi_gallery_changed() and take effect at the next opdi_recog_cache_begin_frame()
+void opdi_recog_cache_reset(void);
+void opdi_recog_cache_get_stats(opdi_recog_cache_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
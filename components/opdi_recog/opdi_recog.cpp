@@ -0,0 +1,202 @@
+// Face recognition: aligned crop -> embedding model -> int8 gallery vector -> gallery match
+#include "opdi_recog.h"
+#include "opdi_cam.h"
+#include "dl_model_base.hpp"
+#include "dl_image_preprocessor.hpp"
+#include "dl_feat_postprocessor.hpp"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "opdi_recog";
+
+#define OPDI_RECOG_MODEL_NAME "human_face_feat_mfn_s8_v1.espdl"
+
+// Model location mirrors human_face_detect: packed into rodata, its own flash partition, or the SD card
+#if CONFIG_OPDI_RECOG_MODEL_IN_FLASH_RODATA
+extern const uint8_t opdi_recog_espdl[] asm("_binary_opdi_recog_espdl_start");
+static const char *s_model_path = (const char *)opdi_recog_espdl;
+#elif CONFIG_OPDI_RECOG_MODEL_IN_FLASH_PARTITION
+static const char *s_model_path = "human_face_feat";
+#endif
+
+static dl::Model *s_model;
+static dl::image::ImagePreprocessor *s_pre;
+static dl::feat::FeatPostprocessor *s_post;
+static uint8_t *s_crop;                    // OPDI_RECOG_CROP_BYTES, PSRAM
+static SemaphoreHandle_t s_lock;           // one model instance: callers take turns
+static opdi_recog_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// The camera frame is the same RGB565 buffer the detector reads: low byte first (see opdi_cam.h; esp-dl's
+// DL_IMAGE_CAP_RGB565_BIG_ENDIAN names the uint16 layout of that same buffer, not a swapped one)
+#define FRAME_BIG_ENDIAN (OPDI_CAM_RGB565_BIG_ENDIAN != 0)
+
+esp_err_t opdi_recog_init(void)
+{
+    if (s_model) {
+        return ESP_OK;
+    }
+    int64_t t0 = esp_timer_get_time();
+#if CONFIG_OPDI_RECOG_MODEL_IN_SDCARD
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", CONFIG_OPDI_RECOG_MODEL_SDCARD_DIR, OPDI_RECOG_MODEL_NAME);
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGW(TAG, "%s not found; recognition disabled", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    fclose(f);
+    s_model = new dl::Model(path, fbs::MODEL_LOCATION_IN_SDCARD);
+#else
+    s_model = new dl::Model(s_model_path, OPDI_RECOG_MODEL_NAME,
+                            static_cast<fbs::model_location_type_t>(CONFIG_OPDI_RECOG_MODEL_LOCATION));
+#endif
+    // Input is our aligned RGB888 crop; swap to the BGR order the model was trained on (as the detector does)
+    s_pre = new dl::image::ImagePreprocessor(s_model, {127.5, 127.5, 127.5}, {127.5, 127.5, 127.5}, DL_IMAGE_CAP_RGB_SWAP);
+    s_post = new dl::feat::FeatPostprocessor(s_model);
+    s_crop = (uint8_t *)heap_caps_malloc(OPDI_RECOG_CROP_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_lock = xSemaphoreCreateMutex();
+
+    auto outputs = s_model->get_outputs();
+    int dim = outputs.empty() ? 0 : outputs.begin()->second->get_size();
+    if (!s_crop || !s_lock || dim != OPDI_GALLERY_DIM) {
+        if (dim != OPDI_GALLERY_DIM) {
+            ESP_LOGE(TAG, "model outputs %d values, gallery stores %d (OPDI_GALLERY_EMBED_DIM)", dim, OPDI_GALLERY_DIM);
+        }
+        opdi_recog_deinit();
+        return dim != OPDI_GALLERY_DIM ? ESP_ERR_INVALID_SIZE : ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "embedding model ready (%d-d, loaded in %lld ms)", dim, (long long)(esp_timer_get_time() - t0) / 1000);
+    return ESP_OK;
+}
+
+bool opdi_recog_ready(void)
+{
+    return s_lock != NULL;
+}
+
+void opdi_recog_deinit(void)
+{
+    opdi_recog_cache_reset();
+    delete s_post;
+    s_post = nullptr;
+    delete s_pre;
+    s_pre = nullptr;
+    delete s_model;
+    s_model = nullptr;
+    heap_caps_free(s_crop);
+    s_crop = nullptr;
+    if (s_lock) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+    }
+}
+
+static void stats_add(const opdi_recog_latency_t *l)
+{
+    const uint32_t *v = &l->align_us;
+    taskENTER_CRITICAL(&s_stats_lock);
+    uint32_t *avg = &s_stats.avg.align_us, *max = &s_stats.max.align_us;
+    for (int i = 0; i < 4; i++) {
+        avg[i] = s_stats.faces ? avg[i] - (avg[i] >> 3) + (v[i] >> 3) : v[i];
+        if (v[i] > max[i]) {
+            max[i] = v[i];
+        }
+    }
+    s_stats.last = *l;
+    s_stats.faces++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static esp_err_t embed_locked(const uint16_t *frame, int w, int h, const int landmarks[10],
+                              int8_t *emb, opdi_recog_latency_t *lat)
+{
+    int64_t t0 = esp_timer_get_time();
+    opdi_recog_xform_t m;
+    esp_err_t err = opdi_recog_estimate(landmarks, &m);
+    if (err != ESP_OK) {
+        return err;
+    }
+    opdi_recog_warp_rgb565(frame, w, h, FRAME_BIG_ENDIAN, &m, s_crop);
+    int64_t t1 = esp_timer_get_time();
+
+    dl::image::img_t crop = {};
+    crop.data = s_crop;
+    crop.width = OPDI_RECOG_CROP;
+    crop.height = OPDI_RECOG_CROP;
+    crop.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+    s_pre->preprocess(crop);
+    s_model->run();
+    dl::TensorBase *feat = s_post->postprocess();
+    opdi_gallery_quantize(feat->get_element_ptr<float>(), emb, OPDI_GALLERY_DIM);
+    int64_t t2 = esp_timer_get_time();
+
+    lat->align_us = (uint32_t)(t1 - t0);
+    lat->embed_us = (uint32_t)(t2 - t1);
+    lat->match_us = 0;
+    lat->total_us = (uint32_t)(t2 - t0);
+    return ESP_OK;
+}
+
+esp_err_t opdi_recog_embed(const uint16_t *frame, int w, int h, const int landmarks[10],
+                           int8_t *emb, opdi_recog_latency_t *lat)
+{
+    if (!frame || !landmarks || !emb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    opdi_recog_latency_t l;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = embed_locked(frame, w, h, landmarks, emb, &l);
+    xSemaphoreGive(s_lock);
+    if (err == ESP_OK && lat) {
+        *lat = l;
+    }
+    return err;
+}
+
+esp_err_t opdi_recog_identify(const uint16_t *frame, int w, int h, const int landmarks[10],
+                              opdi_recog_result_t *out)
+{
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+    int8_t emb[OPDI_GALLERY_DIM] __attribute__((aligned(16)));
+    esp_err_t err = opdi_recog_embed(frame, w, h, landmarks, emb, &out->lat);
+    if (err != ESP_OK) {
+        return err;
+    }
+    opdi_gallery_match_t m;
+    err = opdi_gallery_match(emb, &m);
+    out->lat.match_us = m.scan_us;
+    out->lat.total_us += m.scan_us;
+    stats_add(&out->lat);
+    if (err != ESP_OK) {
+        return err;
+    }
+    out->id = m.id;
+    out->score = m.score;
+    out->matched = m.matched;
+    opdi_gallery_entry_t e;
+    if (m.matched && opdi_gallery_get(m.id, &e, NULL) == ESP_OK) {
+        memcpy(out->label, e.label, sizeof(out->label));
+    }
+    return ESP_OK;
+}
+
+void opdi_recog_get_stats(opdi_recog_stats_t *out)
+{
+    if (!out) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,76 @@
+// Face alignment: 5-point similarity transform + fixed-point bilinear warp into the 112x112 crop
+// (no RTOS or esp-dl dependencies, so the host build and tests use it as is)
+#include "opdi_recog.h"
+#include <math.h>
+
+// ArcFace reference landmarks in the 112x112 crop, in the MNP order
+static const float s_tmpl[10] = {
+    38.2946f, 51.6963f,   // left eye
+    41.5493f, 92.3655f,   // left mouth corner
+    56.0252f, 71.7366f,   // nose tip
+    73.5318f, 51.5014f,   // right eye
+    70.7299f, 92.2041f,   // right mouth corner
+};
+
+esp_err_t opdi_recog_estimate(const int landmarks[10], opdi_recog_xform_t *out){
+    if (!landmarks || !out) return ESP_ERR_INVALID_ARG;
+    // Closed-form least squares for q = [a -b; b a] p + t over the centered point sets
+    float pcx = 0, pcy = 0, qcx = 0, qcy = 0;
+    for (int i=0; i<5; i++){
+        pcx += s_tmpl[2*i]; pcy += s_tmpl[2*i + 1];
+        qcx += (float)landmarks[2*i]; qcy += (float)landmarks[2*i + 1];
+    }
+    pcx /= 5; pcy /= 5; qcx /= 5; qcy /= 5;
+    float num_a = 0, num_b = 0, den = 0, qvar = 0;
+    for (int i=0; i<5; i++){
+        float px = s_tmpl[2*i] - pcx, py = s_tmpl[2*i + 1] - pcy;
+        float qx = (float)landmarks[2*i] - qcx, qy = (float)landmarks[2*i + 1] - qcy;
+        num_a += px * qx + py * qy;
+        num_b += px * qy - py * qx;
+        den += px * px + py * py;
+        qvar += qx * qx + qy * qy;
+    }
+    // All landmarks on (almost) one pixel: no usable face
+    if (qvar < 25.0f) return ESP_ERR_INVALID_ARG;
+    out->a = num_a / den;
+    out->b = num_b / den;
+    out->tx = qcx - (out->a * pcx - out->b * pcy);
+    out->ty = qcy - (out->b * pcx + out->a * pcy);
+    return ESP_OK;
+}
+
+static inline uint32_t px_at(const uint16_t *frame, int w, int x, int y, bool be){
+    uint16_t v = frame[y * w + x];
+    return be ? (uint16_t)((v >> 8) | (v << 8)) : v;
+}
+
+#define R8(p) ((((p) >> 8) & 0xf8) | ((p) >> 13))
+#define G8(p) ((((p) >> 3) & 0xfc) | (((p) >> 9) & 3))
+#define B8(p) ((((p) << 3) & 0xf8) | (((p) >> 2) & 7))
+
+void opdi_recog_warp_rgb565(const uint16_t *frame, int w, int h, bool big_endian,
+                            const opdi_recog_xform_t *m, uint8_t *crop){
+    if (!frame || !m || !crop || w < 2 || h < 2) return;
+    // Q16 frame coordinates stepped per crop pixel: 1280 << 16 still fits in int32
+    const int32_t ax = (int32_t)lroundf(m->a * 65536.0f), bx = (int32_t)lroundf(m->b * 65536.0f);
+    const int32_t xmax = (w - 1) << 16, ymax = (h - 1) << 16;
+    for (int v=0; v<OPDI_RECOG_CROP; v++){
+        int32_t x = (int32_t)lroundf((m->tx - m->b * (float)v) * 65536.0f);
+        int32_t y = (int32_t)lroundf((m->ty + m->a * (float)v) * 65536.0f);
+        for (int u=0; u<OPDI_RECOG_CROP; u++, x += ax, y += bx){
+            int32_t cx = x < 0 ? 0 : x > xmax ? xmax : x;
+            int32_t cy = y < 0 ? 0 : y > ymax ? ymax : y;
+            int x0 = cx >> 16, y0 = cy >> 16;
+            int x1 = x0 + 1 < w ? x0 + 1 : x0, y1 = y0 + 1 < h ? y0 + 1 : y0;
+            uint32_t fx = (cx >> 8) & 0xff, fy = (cy >> 8) & 0xff;
+            uint32_t p00 = px_at(frame, w, x0, y0, big_endian), p01 = px_at(frame, w, x1, y0, big_endian);
+            uint32_t p10 = px_at(frame, w, x0, y1, big_endian), p11 = px_at(frame, w, x1, y1, big_endian);
+            uint32_t w00 = (256 - fx) * (256 - fy), w01 = fx * (256 - fy), w10 = (256 - fx) * fy, w11 = fx * fy;
+            // Expand to 8 bits first so the interpolation keeps the fractional levels (weights sum to 1 << 16)
+            crop[0] = (uint8_t)((R8(p00) * w00 + R8(p01) * w01 + R8(p10) * w10 + R8(p11) * w11 + 0x8000) >> 16);
+            crop[1] = (uint8_t)((G8(p00) * w00 + G8(p01) * w01 + G8(p10) * w10 + G8(p11) * w11 + 0x8000) >> 16);
+            crop[2] = (uint8_t)((B8(p00) * w00 + B8(p01) * w01 + B8(p10) * w10 + B8(p11) * w11 + 0x8000) >> 16);
+            crop += 3;
+        }
+    }
+}
@@ -0,0 +1,195 @@
+// Per-track recognition cache: box-overlap tracks, scale/pose/TTL invalidation, identity voting
+#include "opdi_recog.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <string.h>
+
+#define TRACKS CONFIG_OPDI_RECOG_CACHE_TRACKS
+#define VOTE_CANDS 4
+#define VOTE_DECAY 0.6f             // two fresh frames in a row flip an established identity
+#define IOU_MIN 0.3f
+#define TRACK_LOST_US 1000000
+#define UNKNOWN_ID 0xffff           // vote key of "no gallery match"
+
+// Template nose and eye distance (opdi_recog_align.c): pose is the nose offset in the aligned crop
+#define NOSE_U 56.0252f
+#define NOSE_V 71.7366f
+#define EYE_DIST 35.2372f
+
+typedef struct {
+    uint16_t id;                    // 0: free slot
+    bool claimed;                   // matched to a face in this frame
+    int box[4];
+    int64_t seen_us;
+    int64_t embed_us;               // last fresh result, 0: none yet
+    float scale, yaw, pitch;        // face geometry at embed_us
+    opdi_recog_result_t out;        // smoothed identity
+    struct {
+        uint16_t id;
+        float votes;
+        float score;
+        char label[OPDI_GALLERY_LABEL_LEN];
+    } cand[VOTE_CANDS];
+} track_t;
+
+static track_t s_tracks[TRACKS];
+static uint16_t s_next_track = 1;
+// Written by the detect task only; readers take a possibly one-update-old snapshot
+static uint32_t s_lookups, s_hits, s_embeds;
+// Bumped by the gallery change hook (HTTP/import tasks); the detect task drops its tracks on the next frame
+static volatile uint32_t s_gallery_gen;
+static uint32_t s_seen_gen;
+
+static bool face_pose(const int lm[10], float *scale, float *yaw, float *pitch){
+    opdi_recog_xform_t m;
+    if (opdi_recog_estimate(lm, &m) != ESP_OK) return false;
+    // Map the nose back into the crop; roll is aligned away and does not count as a pose change
+    float s2 = m.a * m.a + m.b * m.b;
+    float dx = (float)lm[4] - m.tx, dy = (float)lm[5] - m.ty;
+    float u = (m.a * dx + m.b * dy) / s2, v = (m.a * dy - m.b * dx) / s2;
+    *scale = sqrtf(s2);
+    *yaw = (u - NOSE_U) / EYE_DIST;
+    *pitch = (v - NOSE_V) / EYE_DIST;
+    return true;
+}
+
+static float iou(const int a[4], const int b[4]){
+    int w = (a[2] < b[2] ? a[2] : b[2]) - (a[0] > b[0] ? a[0] : b[0]);
+    int h = (a[3] < b[3] ? a[3] : b[3]) - (a[1] > b[1] ? a[1] : b[1]);
+    if (w <= 0 || h <= 0) return 0;
+    float inter = (float)w * (float)h;
+    float area = (float)(a[2] - a[0]) * (float)(a[3] - a[1]) + (float)(b[2] - b[0]) * (float)(b[3] - b[1]);
+    return inter / (area - inter);
+}
+
+static track_t *find(uint16_t id){
+    for (int i=0; i<TRACKS; i++) if (id && s_tracks[i].id == id) return &s_tracks[i];
+    return NULL;
+}
+
+void opdi_recog_cache_begin_frame(int64_t now_us){
+    uint32_t gen = s_gallery_gen;
+    if (gen != s_seen_gen){
+        s_seen_gen = gen;
+        opdi_recog_cache_reset(); // cached ids and labels may name deleted or renamed identities
+    }
+    for (int i=0; i<TRACKS; i++){
+        track_t *t = &s_tracks[i];
+        t->claimed = false;
+        if (t->id && now_us - t->seen_us > TRACK_LOST_US) t->id = 0;
+    }
+}
+
+bool opdi_recog_cache_get(const int box[4], const int landmarks[10], int64_t now_us,
+                          uint16_t *track, opdi_recog_result_t *out){
+    if (!box || !landmarks || !track || !out) return false;
+    s_lookups++;
+    *track = 0;
+    float scale, yaw, pitch;
+    if (!face_pose(landmarks, &scale, &yaw, &pitch)) return false;
+
+    // Best unclaimed overlap, else a free slot, else the longest unseen track
+    track_t *t = NULL, *spare = NULL;
+    float best = IOU_MIN;
+    for (int i=0; i<TRACKS; i++){
+        track_t *c = &s_tracks[i];
+        if (!c->id){ if (!spare || spare->id) spare = c; continue; }
+        if (c->claimed) continue;
+        float o = iou(box, c->box);
+        if (o >= best){ best = o; t = c; }
+        if (!spare || (spare->id && c->seen_us < spare->seen_us)) spare = c;
+    }
+    if (!t){
+        if (!spare) return false; // every slot claimed in this frame
+        t = spare;
+        memset(t, 0, sizeof(*t));
+        t->id = s_next_track++;
+        if (!s_next_track) s_next_track = 1;
+    }
+    t->claimed = true;
+    memcpy(t->box, box, sizeof(t->box));
+    t->seen_us = now_us;
+    *track = t->id;
+
+    if (!t->embed_us || now_us - t->embed_us >= (int64_t)CONFIG_OPDI_RECOG_CACHE_TTL_MS * 1000) return false;
+    if (fabsf(scale / t->scale - 1.0f) * 100.0f > CONFIG_OPDI_RECOG_CACHE_SIZE_PCT) return false;
+    if ((fabsf(yaw - t->yaw) > CONFIG_OPDI_RECOG_CACHE_POSE_PCT / 100.0f) ||
+        (fabsf(pitch - t->pitch) > CONFIG_OPDI_RECOG_CACHE_POSE_PCT / 100.0f)) return false;
+    *out = t->out;
+    memset(&out->lat, 0, sizeof(out->lat));
+    s_hits++;
+    return true;
+}
+
+void opdi_recog_cache_put(uint16_t track, const int landmarks[10], const opdi_recog_result_t *fresh,
+                          int64_t now_us, opdi_recog_result_t *out){
+    if (!fresh) return;
+    s_embeds++;
+    track_t *t = find(track);
+    if (!t || !landmarks || !face_pose(landmarks, &t->scale, &t->yaw, &t->pitch)){
+        if (out) *out = *fresh;
+        return;
+    }
+    t->embed_us = now_us ? now_us : 1;
+
+    uint16_t key = fresh->matched ? fresh->id : UNKNOWN_ID;
+    int slot = -1, weakest = 0;
+    for (int i=0; i<VOTE_CANDS; i++){
+        t->cand[i].votes *= VOTE_DECAY;
+        if (t->cand[i].votes > 0 && t->cand[i].id == key) slot = i;
+        if (t->cand[i].votes < t->cand[weakest].votes) weakest = i;
+    }
+    if (slot < 0){
+        slot = weakest;
+        t->cand[slot].id = key;
+        t->cand[slot].votes = 0;
+    }
+    t->cand[slot].votes += 1.0f;
+    t->cand[slot].score = fresh->score;
+    memcpy(t->cand[slot].label, fresh->label, sizeof(t->cand[slot].label));
+
+    int win = 0;
+    for (int i=1; i<VOTE_CANDS; i++) if (t->cand[i].votes > t->cand[win].votes) win = i;
+    t->out = *fresh;
+    if (win != slot){
+        t->out.matched = t->cand[win].id != UNKNOWN_ID;
+        if (t->out.matched) t->out.id = t->cand[win].id;
+        t->out.score = t->cand[win].score;
+        memcpy(t->out.label, t->cand[win].label, sizeof(t->out.label));
+    }
+    if (out) *out = t->out;
+}
+
+void opdi_recog_cache_reset(void){
+    memset(s_tracks, 0, sizeof(s_tracks));
+}
+
+// Gallery change hook (weak no-op in opdi_gallery), called under the gallery lock so the bumps serialize
+void opdi_gallery_changed(void){
+    s_gallery_gen++;
+}
+
+void opdi_recog_cache_get_stats(opdi_recog_cache_stats_t *out){
+    if (!out) return;
+    out->lookups = s_lookups;
+    out->hits = s_hits;
+    out->embeds = s_embeds;
+    out->tracks = 0;
+    for (int i=0; i<TRACKS; i++) if (s_tracks[i].id) out->tracks++;
+}
+
+// Camera telemetry hook (weak no-op in opdi_cam): hit rate and embeddings/s over the last tick
+extern void opdi_cam_adjust_recog_metrics(uint8_t hit_pct, uint16_t embeds_ps);
+void opdi_cam_recog_periodic_1s(void){
+    static uint32_t last_lookups, last_hits, last_embeds;
+    static int64_t last_us;
+    int64_t now = esp_timer_get_time();
+    uint32_t lookups = s_lookups, hits = s_hits, embeds = s_embeds;
+    if (last_us && now > last_us){
+        uint32_t dl = lookups - last_lookups, dh = hits - last_hits;
+        uint64_t eps = (uint64_t)(embeds - last_embeds) * 1000000u / (uint64_t)(now - last_us);
+        opdi_cam_adjust_recog_metrics(dl ? (uint8_t)(dh * 100u / dl) : 0, (uint16_t)(eps > 0xffff ? 0xffff : eps));
+    }
+    last_lookups = lookups; last_hits = hits; last_embeds = embeds; last_us = now;
+}
@@ -0,0 +1,60 @@
+// Linux host app: the HTTP surface of the device as a local process, or a Unity test runner
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+
+#ifdef OPDI_HOST_TEST
+
+int run_unity_tests(void);
+
+void app_main(void)
+{
+    nvs_flash_init();
+    exit(run_unity_tests() ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#else
+
+#include "opdi_httpd.h"
+#include "opdi_net.h"
+#include "opdi_cam.h"
+#include "opdi_gallery.h"
+#include "opdi_mqtt.h"
+#include "opdi_clip.h"
+
+static const char *TAG = "host";
+
+void app_main(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    opdi_cam_init();
+    opdi_cam_manager_init();
+    opdi_net_init();
+    // No SPIFFS on the host: the gallery file lives in the working directory
+    opdi_gallery_init("opdi_gallery.bin");
+    // Event clips of the stub frames, triggered over REST, also under the working directory
+    opdi_clip_start("opdi_clips");
+    // MQTT only when asked for: OPDI_MQTT_BROKER=mqtt://127.0.0.1 ./opdi_host.elf
+    if (getenv("OPDI_MQTT_BROKER")) opdi_mqtt_start(getenv("OPDI_MQTT_BROKER"));
+    if (!opdi_httpd_start()) {
+        ESP_LOGE(TAG, "HTTP server failed to start (port %d in use?)", CONFIG_OPDI_HTTPD_PORT);
+        exit(EXIT_FAILURE);
+    }
+    ESP_LOGI(TAG, "serving on http://127.0.0.1:%d (streams on %d)", CONFIG_OPDI_HTTPD_PORT, CONFIG_OPDI_HTTPD_STREAM_PORT);
+
+    // The 1 s camera tick (fps counters, governor, cam.telemetry) runs in the camera manager's task
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+#endif
@@ -9,11 +9,11 @@
 #include "esp_memory_utils.h"
 #include "esp_heap_caps.h"
 #include <sys/stat.h>
-#include <math.h>
 #include "lvgl.h"
 #include "bsp/esp-bsp.h"
 #include "bsp/display.h"
 #include "bsp_board_extra.h"
+#include "opdi_audio.h"
 
 #include "esp_brookesia.hpp"
 #include "app_examples/phone/squareline/src/phone_app_squareline.hpp"
@@ -72,29 +72,16 @@ static void startup_audio_task(void *arg)
 
 #if CONFIG_EXAMPLE_STARTUP_BEEP_ENABLE
     if (!played) {
-        const int sample_rate = CODEC_DEFAULT_SAMPLE_RATE; // 16000
-        const int duration_ms = CONFIG_EXAMPLE_STARTUP_BEEP_DURATION_MS;
-        const int total_samples = sample_rate * duration_ms / 1000;
-        const float freq = (float)CONFIG_EXAMPLE_STARTUP_BEEP_FREQ;
-        const float amplitude = 0.25f; // 25% of full scale
-        size_t frame_bytes = 2 * CODEC_DEFAULT_CHANNEL; // 16-bit * channels
-        int16_t *pcm = (int16_t *)heap_caps_malloc(total_samples * frame_bytes, MALLOC_CAP_8BIT);
-        if (pcm) {
-            for (int i = 0; i < total_samples; ++i) {
-                float s = sinf(2.0f * 3.14159265f * freq * i / sample_rate);
-                int16_t v = (int16_t)(s * 32767.0f * amplitude);
-                pcm[2 * i + 0] = v;
-                pcm[2 * i + 1] = v; // stereo duplicate
-            }
-            size_t written = 0;
-            if (bsp_extra_i2s_write(pcm, total_samples * frame_bytes, &written, 200) == ESP_OK) {
-                ESP_LOGI(TAG, "Fallback tone played (%d samples, %u bytes, %d Hz)", total_samples, (unsigned)written, CONFIG_EXAMPLE_STARTUP_BEEP_FREQ);
-            } else {
-                ESP_LOGW(TAG, "Failed to play fallback tone");
-            }
-            free(pcm);
+        // Cached earcon: the tone cache rendered it from these settings at init; handed to the mixer without
+        // blocking. Without a mixer it is rendered and written to I2S here (blocks for the tone's length).
+        bool mixed = opdi_audio_mixer_ready();
+        esp_err_t tone_err = mixed ? opdi_audio_tone_play(OPDI_AUDIO_TONE_STARTUP, OPDI_AUDIO_PRIO_EVENT)
+                                   : opdi_audio_tone_play_direct(OPDI_AUDIO_TONE_STARTUP);
+        if (tone_err == ESP_OK) {
+            ESP_LOGI(TAG, "Fallback tone %s (%d Hz, %d ms)", mixed ? "queued" : "played directly on I2S",
+                     CONFIG_EXAMPLE_STARTUP_BEEP_FREQ, CONFIG_EXAMPLE_STARTUP_BEEP_DURATION_MS);
         } else {
-            ESP_LOGW(TAG, "Failed to allocate buffer for fallback tone");
+            ESP_LOGW(TAG, "Failed to play fallback tone: %s", esp_err_to_name(tone_err));
         }
     }
 #else
@@ -107,51 +94,14 @@ static void startup_audio_task(void *arg)
     vTaskDelete(nullptr);
 }
 
-// --- Network & HTTP integration (merged from previous app_main.c) ---
-#include "esp_http_server.h"
+// --- Network & HTTP integration (servers and routes: opdi_httpd.c) ---
 #include "opdi_net.h"
-#include "opdi_api_ws.h"
 #include "opdi_cam.h"
-
-// Forward declarations for previously separate C files (ensure C linkage)
-#ifdef __cplusplus
-extern "C" {
-#endif
-void routes_net_register(httpd_handle_t server);
-void opdi_api_static_register(httpd_handle_t server);
-#ifdef __cplusplus
-}
-#endif
-
-// System info endpoint handler (moved to file scope from inside opdi_start_httpd)
-static esp_err_t sysinfo_get(httpd_req_t *r) {
-    char buf[256];
-    int n = snprintf(buf, sizeof(buf),
-        "{\"device\":\"OPDI_SKPR\",\"idf\":\"%s\",\"uptime_s\":%ld}",
-        esp_get_idf_version(), (long)(esp_timer_get_time()/1000000LL));
-    httpd_resp_set_type(r, "application/json");
-    httpd_resp_send(r, buf, n);
-    return ESP_OK;
-}
-
-static httpd_handle_t opdi_start_httpd(void) {
-    httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
-    cfg.server_port = 80;
-    // We register a fairly large set of endpoints (system info + ~10 net REST routes + metrics/logs +
-    // websocket endpoint + several static file handlers). The default (typically 8) is insufficient
-    // and produced 'httpd_register_uri_handler: no slots left' warnings. Bump this to provide headroom.
-    cfg.max_uri_handlers = 24;
-    httpd_handle_t h = NULL;
-    if (httpd_start(&h, &cfg) != ESP_OK) return NULL;
-    httpd_uri_t u_sys = { .uri = "/api/v1/system/info", .method = HTTP_GET, .handler = sysinfo_get };
-    httpd_register_uri_handler(h, &u_sys);
-    // Register networking routes, websocket endpoint and static UI assets
-    routes_net_register(h);
-    opdi_api_ws_register(h);
-    opdi_api_static_register(h);
-    ESP_LOGI(TAG, "HTTP server started (port %d)", cfg.server_port);
-    return h;
-}
+#include "opdi_gallery.h"
+#include "opdi_httpd.h"
+#include "opdi_mqtt.h"
+#include "opdi_clip.h"
+#include "camera/app_detect_bench.h"
 
 extern "C" void app_main(void)
 {
@@ -175,6 +125,13 @@ extern "C" void app_main(void)
     if (audio_err != ESP_OK) {
         ESP_LOGW(TAG, "Audio codec not initialized (err=%s). Continuing without audio.", esp_err_to_name(audio_err));
     } else {
+        // Single I2S consumer: the mixer task owns bsp_extra_i2s_write, the player becomes one of its streams
+        if (opdi_audio_mixer_init() == ESP_OK) {
+            bsp_extra_player_set_output(opdi_audio_player_write, opdi_audio_player_clk_set);
+            opdi_audio_tone_cache_init();
+        } else {
+            ESP_LOGW(TAG, "Audio mixer init failed; player and startup beep write directly to I2S");
+        }
         if (bsp_extra_player_init() == ESP_OK) {
 #if CONFIG_EXAMPLE_AUDIO_ASYNC_STARTUP
             BaseType_t task_ok = xTaskCreate(startup_audio_task, "startup_audio", 4096, nullptr, tskIDLE_PRIORITY + 2, nullptr);
@@ -216,10 +173,40 @@ extern "C" void app_main(void)
 
     // Initialize camera config (Phase1 stub)
     opdi_cam_init();
+    // Stream/profile config, the 1 s telemetry and governor tick; frames come from the camera app's encode stage
+    opdi_cam_manager_init();
+
+    // Face gallery: PSRAM table loaded from the storage partition (mounted above)
+    if (opdi_gallery_init(nullptr) != ESP_OK) {
+        ESP_LOGW(TAG, "Face gallery unavailable (no PSRAM?); recognition disabled");
+    }
+
+#if CONFIG_OPDI_CLIP_ENABLE && CONFIG_EXAMPLE_ENABLE_SD_CARD
+    // Event clips: pre-roll ring in PSRAM, AVI files on the SD card mounted above
+    if (opdi_clip_start(nullptr) != ESP_OK) {
+        ESP_LOGW(TAG, "Event clips unavailable (no PSRAM for the pre-roll ring?)");
+    }
+#endif
+
+#if CONFIG_CAMERA_DETECT_BENCH
+    // Benchmark build: recorded frames from the SD card through the detectors before anything else runs
+    app_detect_bench_boot();
+#endif
+
+#if CONFIG_OPDI_MQTT_ENABLE
+    // MQTT publisher: events queue from boot and go out once Wi-Fi and the broker are up
+    err = opdi_mqtt_start(nullptr);
+    if (err == ESP_ERR_INVALID_ARG) {
+        opdi_mqtt_init();
+        ESP_LOGW(TAG, "No MQTT broker configured (CONFIG_OPDI_MQTT_BROKER); events are only queued");
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "MQTT publisher not started: %s", esp_err_to_name(err));
+    }
+#endif
 
     // Network manager + HTTP server bootstrap (after storage ready)
     opdi_net_init();
-    opdi_start_httpd();
+    opdi_httpd_start();
     ESP_LOGI(TAG, "OPDI_SKPR network stack initialized");
 
     // If headless or display disabled, avoid creating heavy UI objects
@@ -0,0 +1,118 @@
+// HTTP servers: control (port 80) and stream instances with the Kconfig "HTTP server profile"
+#include "opdi_httpd.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_idf_version.h"
+#include "opdi_api_ws.h"
+#include "opdi_api_static.h"
+#include <assert.h>
+#include <stdio.h>
+
+static const char *TAG = "opdi_httpd";
+
+void routes_net_register(httpd_handle_t server);
+void routes_gallery_register(httpd_handle_t server);
+void routes_clips_register(httpd_handle_t server);
+void routes_clips_register_stream(httpd_handle_t server);
+// Optional route sets: camera routes are linked where opdi_cam is, the host build has no /audio/ws
+__attribute__((weak)) void routes_camera_register(httpd_handle_t server);
+__attribute__((weak)) void routes_camera_register_stream(httpd_handle_t server);
+__attribute__((weak)) void opdi_api_audio_ws_register(httpd_handle_t server);
+
+// Host sockets are not drawn from the lwIP pool
+#if !CONFIG_IDF_TARGET_LINUX
+#if CONFIG_OPDI_HTTPD_STREAM_PORT
+static_assert(CONFIG_OPDI_HTTPD_MAX_SOCKETS + CONFIG_OPDI_HTTPD_STREAM_MAX_SOCKETS + 4 <= CONFIG_LWIP_MAX_SOCKETS,
+              "HTTP server profile needs more LWIP_MAX_SOCKETS (sessions + listen/control socket per server)");
+#else
+static_assert(CONFIG_OPDI_HTTPD_MAX_SOCKETS + 2 <= CONFIG_LWIP_MAX_SOCKETS, "raise LWIP_MAX_SOCKETS");
+#endif
+#endif
+
+static esp_err_t sysinfo_get(httpd_req_t *r) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf),
+        "{\"device\":\"OPDI_SKPR\",\"idf\":\"%s\",\"uptime_s\":%ld}",
+        esp_get_idf_version(), (long)(esp_timer_get_time()/1000000LL));
+    httpd_resp_set_type(r, "application/json");
+    httpd_resp_send(r, buf, n);
+    return ESP_OK;
+}
+
+// Server profile shared by both instances (see "HTTP server profile" in Kconfig)
+static httpd_config_t opdi_httpd_profile(void) {
+    httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
+    cfg.max_open_sockets = CONFIG_OPDI_HTTPD_MAX_SOCKETS;
+    cfg.backlog_conn = 5;
+#if CONFIG_OPDI_HTTPD_LRU_PURGE
+    cfg.lru_purge_enable = true;
+#endif
+    cfg.recv_wait_timeout = CONFIG_OPDI_HTTPD_RECV_TIMEOUT_S;
+    cfg.send_wait_timeout = CONFIG_OPDI_HTTPD_SEND_TIMEOUT_S;
+    cfg.task_priority = CONFIG_OPDI_HTTPD_TASK_PRIO;
+#if CONFIG_OPDI_HTTPD_KEEPALIVE
+    cfg.keep_alive_enable = true;
+    cfg.keep_alive_idle = CONFIG_OPDI_HTTPD_KEEPALIVE_IDLE_S;
+    cfg.keep_alive_interval = CONFIG_OPDI_HTTPD_KEEPALIVE_INTERVAL_S;
+    cfg.keep_alive_count = CONFIG_OPDI_HTTPD_KEEPALIVE_COUNT;
+#endif
+    // A closed socket is reusable at once instead of sitting in TIME_WAIT
+    cfg.enable_so_linger = true;
+    cfg.linger_timeout = 0;
+    return cfg;
+}
+
+#if CONFIG_OPDI_HTTPD_STREAM_PORT
+// Second instance for long-lived streams: its own task, socket pool and a short send timeout
+static httpd_handle_t opdi_start_stream_httpd(uint16_t main_ctrl_port) {
+    httpd_config_t cfg = opdi_httpd_profile();
+    cfg.server_port = CONFIG_OPDI_HTTPD_STREAM_PORT;
+    cfg.ctrl_port = main_ctrl_port + 1;
+    cfg.max_open_sockets = CONFIG_OPDI_HTTPD_STREAM_MAX_SOCKETS;
+    cfg.max_uri_handlers = 4;
+    cfg.send_wait_timeout = CONFIG_OPDI_HTTPD_STREAM_SEND_TIMEOUT_S;
+    cfg.stack_size = 4096;
+    httpd_handle_t h = NULL;
+    if (httpd_start(&h, &cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "stream server start failed (port %d)", cfg.server_port);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "Stream server started (port %d, %d sockets)", cfg.server_port, cfg.max_open_sockets);
+    return h;
+}
+#endif
+
+httpd_handle_t opdi_httpd_start(void) {
+    httpd_config_t cfg = opdi_httpd_profile();
+    cfg.server_port = CONFIG_OPDI_HTTPD_PORT;
+    // System info + ~15 net REST routes + 7 camera + gallery + clips + /ws + static UI handlers.
+    // The default (typically 8) produced 'no slots left' warnings.
+    cfg.max_uri_handlers = 40;
+    // Handlers stream JSON from stack snapshots (scan list + writer scratch) instead of static buffers
+    cfg.stack_size = 6144;
+    // /ws clients leave the event bus with their socket, however the session ends
+    cfg.close_fn = opdi_api_ws_close_fn;
+    httpd_handle_t h = NULL;
+    if (httpd_start(&h, &cfg) != ESP_OK) return NULL;
+    httpd_uri_t u_sys = { .uri = "/api/v1/system/info", .method = HTTP_GET, .handler = sysinfo_get };
+    httpd_register_uri_handler(h, &u_sys);
+    // Register networking routes, websocket endpoint and static UI assets
+    routes_net_register(h);
+    if (routes_camera_register) routes_camera_register(h);
+    routes_gallery_register(h);
+    routes_clips_register(h);
+    opdi_api_ws_register(h);
+    opdi_api_static_register(h);
+    // Streams go to the stream server when there is one (falls back to the control port if it fails to start)
+    httpd_handle_t hs = h;
+#if CONFIG_OPDI_HTTPD_STREAM_PORT
+    httpd_handle_t stream = opdi_start_stream_httpd(cfg.ctrl_port);
+    if (stream) hs = stream;
+#endif
+    if (opdi_api_audio_ws_register) opdi_api_audio_ws_register(hs);
+    if (routes_camera_register_stream) routes_camera_register_stream(hs);
+    routes_clips_register_stream(hs);
+    ESP_LOGI(TAG, "HTTP server started (port %d, %d sockets, lru_purge=%d)", cfg.server_port, cfg.max_open_sockets, cfg.lru_purge_enable);
+    return h;
+}
@@ -0,0 +1,15 @@
+#pragma once
+// HTTP bring-up shared by the device app (main.cpp) and the linux host app (host/main)
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start the control server (port 80: REST, /ws, UI) and, with CONFIG_OPDI_HTTPD_STREAM_PORT, the
+// stream server (/stream, /audio/ws). Routes whose sources are not linked are skipped.
+httpd_handle_t opdi_httpd_start(void);
+
+#ifdef __cplusplus
+}
+#endif
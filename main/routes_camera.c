@@ -1,12 +1,19 @@
 // Camera REST endpoints (logic-layer scaffold)
 #include "esp_http_server.h"
 #include "esp_log.h"
-#include "cJSON.h"
 #include "opdi_cam.h"
+#include "opdi_api_json.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static const char *TAG = "routes_cam";
 
+// Scratch for the streaming JSON writer
+#define JSON_SCRATCH 256
+
 static const char *profile_str(opdi_cam_profile_t p){
     switch(p){
         case OPDI_CAM_PROFILE_720P: return "720p";
@@ -26,73 +33,113 @@ static const char *state_str(opdi_cam_state_t s){
 
 static esp_err_t cam_info_get(httpd_req_t *req){
     opdi_cam_telemetry_t t; opdi_cam_get_telemetry(&t);
-    char buf[320];
-    int n = snprintf(buf, sizeof(buf),
-        "{\"state\":\"%s\",\"profile\":\"%s\",\"fps_target\":%u,\"fps_capture\":%u,\"fps_stream\":%u,\"jpeg_q\":%u,\"luma_avg\":%u,\"ir\":{\"mode\":%u,\"active\":%s}}",
-        state_str(opdi_cam_manager_get_state()), profile_str(t.active_profile), t.fps_target, t.fps_capture, t.fps_stream,
-        t.jpeg_q_current, t.luma_avg, (unsigned)t.ir_mode_cfg, t.ir_active?"true":"false");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, buf, n);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_str(&w, "state", state_str(opdi_cam_manager_get_state()));
+    opdi_json_kv_str(&w, "profile", profile_str(t.active_profile));
+    opdi_json_kv_uint(&w, "fps_target", t.fps_target);
+    opdi_json_kv_uint(&w, "fps_capture", t.fps_capture);
+    opdi_json_kv_uint(&w, "fps_stream", t.fps_stream);
+    opdi_json_kv_uint(&w, "jpeg_q", t.jpeg_q_current);
+    opdi_json_kv_uint(&w, "luma_avg", t.luma_avg);
+    opdi_json_key(&w, "ir"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "mode", (unsigned)t.ir_mode_cfg);
+    opdi_json_kv_bool(&w, "active", t.ir_active);
+    opdi_json_obj_end(&w);
+    opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+    if (c.simulcast){
+        opdi_json_key(&w, "sub"); opdi_json_obj_begin(&w);
+        opdi_json_kv_str(&w, "profile", profile_str(t.sub_profile));
+        opdi_json_kv_uint(&w, "jpeg_q", t.sub_jpeg_q);
+        opdi_json_kv_uint(&w, "fps", t.fps_sub);
+        opdi_json_kv_uint(&w, "clients", opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB));
+        opdi_json_obj_end(&w);
+    }
+    // RGB565 encode stage cost per profile (profiles not encoded yet are left out)
+    opdi_json_key(&w, "encode"); opdi_json_obj_begin(&w);
+    for (int p = OPDI_CAM_PROFILE_240P; p <= OPDI_CAM_PROFILE_720P; p++){
+        opdi_cam_encode_stats_t e; opdi_cam_encode_get_stats((opdi_cam_profile_t)p, &e);
+        if (!e.frames) continue;
+        opdi_json_key(&w, profile_str((opdi_cam_profile_t)p)); opdi_json_obj_begin(&w);
+        opdi_json_kv_uint(&w, "frames", e.frames);
+        opdi_json_kv_uint(&w, "us_avg", e.encode_us_avg);
+        opdi_json_kv_uint(&w, "us_max", e.encode_us_max);
+        opdi_json_kv_uint(&w, "bytes_avg", e.bytes_avg);
+        opdi_json_kv_uint(&w, "bytes_max", e.bytes_max);
+        opdi_json_kv_uint(&w, "w", e.width);
+        opdi_json_kv_uint(&w, "h", e.height);
+        opdi_json_obj_end(&w);
+    }
+    opdi_json_obj_end(&w);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 static esp_err_t cam_config_get(httpd_req_t *req){
     opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
-    char buf[384];
-    int n = snprintf(buf, sizeof(buf),
-        "{\"version\":%u,\"profile\":\"%s\",\"fps\":%u,\"jpeg_q\":%u,\"ae_lock\":%s,\"exposure_us\":%u,\"agc_gain\":%u,\"wb\":%u,\"flip\":%s,\"mirror\":%s,\"ir_mode\":%u,\"ir_thresh\":{\"y_low\":%u,\"y_high\":%u,\"h_on\":%u,\"h_off\":%u}}",
-        c.version, profile_str(c.profile), c.fps_target, c.jpeg_q, c.ae_lock?"true":"false", c.exposure_us, c.agc_gain, c.wb_mode,
-        c.flip?"true":"false", c.mirror?"true":"false", c.ir_mode, c.ir_y_low, c.ir_y_high, c.ir_hyst_on_ms, c.ir_hyst_off_ms);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, buf, n);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "version", c.version);
+    opdi_json_kv_str(&w, "profile", profile_str(c.profile));
+    opdi_json_kv_uint(&w, "fps", c.fps_target);
+    opdi_json_kv_uint(&w, "jpeg_q", c.jpeg_q);
+    opdi_json_kv_bool(&w, "ae_lock", c.ae_lock);
+    opdi_json_kv_uint(&w, "exposure_us", c.exposure_us);
+    opdi_json_kv_uint(&w, "agc_gain", c.agc_gain);
+    opdi_json_kv_uint(&w, "wb", c.wb_mode);
+    opdi_json_kv_bool(&w, "flip", c.flip);
+    opdi_json_kv_bool(&w, "mirror", c.mirror);
+    opdi_json_kv_uint(&w, "ir_mode", c.ir_mode);
+    opdi_json_kv_bool(&w, "simulcast", c.simulcast);
+    opdi_json_kv_str(&w, "sub_profile", profile_str(c.sub_profile));
+    opdi_json_kv_uint(&w, "sub_jpeg_q", c.sub_jpeg_q);
+    opdi_json_key(&w, "ir_thresh"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "y_low", c.ir_y_low);
+    opdi_json_kv_uint(&w, "y_high", c.ir_y_high);
+    opdi_json_kv_uint(&w, "h_on", c.ir_hyst_on_ms);
+    opdi_json_kv_uint(&w, "h_off", c.ir_hyst_off_ms);
+    opdi_json_obj_end(&w);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
+// Names indexed by enum value (PUT accepts exactly these; unknown names are a 400)
+static const char *const k_profiles[] = {
+    [OPDI_CAM_PROFILE_240P] = "240p", [OPDI_CAM_PROFILE_480P] = "480p", [OPDI_CAM_PROFILE_720P] = "720p",
+};
+static const char *const k_ir_modes[] = {
+    [OPDI_IR_MODE_AUTO] = "auto", [OPDI_IR_MODE_ON] = "on", [OPDI_IR_MODE_OFF] = "off",
+};
+static const opdi_json_field_t k_ir_thresh_fields[] = {
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, ir_y_low, "y_low"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, ir_y_high, "y_high"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, ir_hyst_on_ms, "hyst_on_ms"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, ir_hyst_off_ms, "hyst_off_ms"),
+};
+static const opdi_json_field_t k_cam_fields[] = {
+    OPDI_JSON_ENUM(opdi_cam_ext_config_t, profile, "profile", k_profiles),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, fps_target, "fps"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, jpeg_q, "jpeg_q"),
+    OPDI_JSON_BOOL(opdi_cam_ext_config_t, ae_lock, "ae_lock"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, exposure_us, "exposure_us"),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, agc_gain, "agc_gain"),
+    OPDI_JSON_BOOL(opdi_cam_ext_config_t, flip, "flip"),
+    OPDI_JSON_BOOL(opdi_cam_ext_config_t, mirror, "mirror"),
+    OPDI_JSON_ENUM(opdi_cam_ext_config_t, ir_mode, "ir_mode", k_ir_modes),
+    OPDI_JSON_OBJ("ir_thresh", k_ir_thresh_fields),
+    OPDI_JSON_BOOL(opdi_cam_ext_config_t, simulcast, "simulcast"),
+    OPDI_JSON_ENUM(opdi_cam_ext_config_t, sub_profile, "sub_profile", k_profiles),
+    OPDI_JSON_UINT(opdi_cam_ext_config_t, sub_jpeg_q, "sub_jpeg_q"),
+};
+
 static esp_err_t cam_config_put(httpd_req_t *req){
-    char content[512]; int received = httpd_req_recv(req, content, sizeof(content)-1);
-    if (received <= 0){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "empty"); return ESP_OK; }
-    content[received]='\0';
-    cJSON *root = cJSON_Parse(content);
-    if (!root){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "json"); return ESP_OK; }
+    char content[512];
     opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
-    cJSON *j_prof = cJSON_GetObjectItemCaseSensitive(root, "profile");
-    cJSON *j_fps = cJSON_GetObjectItemCaseSensitive(root, "fps");
-    cJSON *j_q = cJSON_GetObjectItemCaseSensitive(root, "jpeg_q");
-    cJSON *j_ae = cJSON_GetObjectItemCaseSensitive(root, "ae_lock");
-    cJSON *j_exp = cJSON_GetObjectItemCaseSensitive(root, "exposure_us");
-    cJSON *j_gain = cJSON_GetObjectItemCaseSensitive(root, "agc_gain");
-    cJSON *j_flip = cJSON_GetObjectItemCaseSensitive(root, "flip");
-    cJSON *j_mirror = cJSON_GetObjectItemCaseSensitive(root, "mirror");
-    cJSON *j_ir_mode = cJSON_GetObjectItemCaseSensitive(root, "ir_mode");
-    cJSON *j_ir_thresh = cJSON_GetObjectItemCaseSensitive(root, "ir_thresh");
-    if (cJSON_IsString(j_prof)){
-        if (strcmp(j_prof->valuestring, "720p")==0) c.profile = OPDI_CAM_PROFILE_720P;
-        else if (strcmp(j_prof->valuestring, "240p")==0) c.profile = OPDI_CAM_PROFILE_240P;
-        else c.profile = OPDI_CAM_PROFILE_480P;
-    }
-    if (cJSON_IsNumber(j_fps)) c.fps_target = (uint8_t)j_fps->valuedouble;
-    if (cJSON_IsNumber(j_q)) c.jpeg_q = (uint8_t)j_q->valuedouble;
-    if (cJSON_IsBool(j_ae)) c.ae_lock = cJSON_IsTrue(j_ae);
-    if (cJSON_IsNumber(j_exp)) c.exposure_us = (uint32_t)j_exp->valuedouble;
-    if (cJSON_IsNumber(j_gain)) c.agc_gain = (uint16_t)j_gain->valuedouble;
-    if (cJSON_IsBool(j_flip)) c.flip = cJSON_IsTrue(j_flip);
-    if (cJSON_IsBool(j_mirror)) c.mirror = cJSON_IsTrue(j_mirror);
-    if (cJSON_IsString(j_ir_mode)){
-        if (strcmp(j_ir_mode->valuestring, "on")==0) c.ir_mode = OPDI_IR_MODE_ON;
-        else if (strcmp(j_ir_mode->valuestring, "off")==0) c.ir_mode = OPDI_IR_MODE_OFF;
-        else c.ir_mode = OPDI_IR_MODE_AUTO;
-    }
-    if (cJSON_IsObject(j_ir_thresh)){
-        cJSON *jl = cJSON_GetObjectItemCaseSensitive(j_ir_thresh, "y_low");
-        cJSON *jh = cJSON_GetObjectItemCaseSensitive(j_ir_thresh, "y_high");
-        cJSON *jon = cJSON_GetObjectItemCaseSensitive(j_ir_thresh, "hyst_on_ms");
-        cJSON *joff = cJSON_GetObjectItemCaseSensitive(j_ir_thresh, "hyst_off_ms");
-        if (cJSON_IsNumber(jl)) c.ir_y_low = (uint16_t)jl->valuedouble;
-        if (cJSON_IsNumber(jh)) c.ir_y_high = (uint16_t)jh->valuedouble;
-        if (cJSON_IsNumber(jon)) c.ir_hyst_on_ms = (uint16_t)jon->valuedouble;
-        if (cJSON_IsNumber(joff)) c.ir_hyst_off_ms = (uint16_t)joff->valuedouble;
-    }
-    cJSON_Delete(root);
+    uint32_t seen;
+    if (opdi_json_bind_req(req, content, sizeof(content), OPDI_JSON_FIELDS(k_cam_fields), &c, &seen)!=ESP_OK) return ESP_OK;
+    if (!seen){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "empty"); return ESP_OK; }
     opdi_cam_ext_config_set(&c);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
@@ -118,30 +165,91 @@ void routes_camera_register(httpd_handle_t server){
     ESP_LOGI(TAG, "camera routes registered");
 }
 
-// MJPEG streaming endpoint (poll-based; basic implementation)
-static esp_err_t cam_stream_get(httpd_req_t *req){
+// ?layer=main (default) | sub; sub falls back to main while simulcast is off
+static bool stream_layer(httpd_req_t *req, opdi_cam_layer_t *out){
+    char q[48], v[8];
+    *out = OPDI_CAM_LAYER_MAIN;
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) != ESP_OK || httpd_query_key_value(q, "layer", v, sizeof(v)) != ESP_OK) return true;
+    if (strcmp(v, "sub") == 0){
+        opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+        if (c.simulcast) *out = OPDI_CAM_LAYER_SUB;
+        return true;
+    }
+    return strcmp(v, "main") == 0;
+}
+
+// MJPEG viewers: each one is handed off (httpd async request) to its own task that paces its layer, so
+// the stream server's task is free again for the next viewer, /audio/ws and clip downloads
+#define STREAM_VIEWERS_MAX 4
+#define STREAM_FRAME_MAX   (64 * 1024)  // crude cap; prevent huge allocations
+#define STREAM_MIN_GAP_MS  50           // ~20 FPS cap per viewer
+
+typedef struct { httpd_req_t *req; opdi_cam_layer_t layer; } stream_viewer_t;
+
+static portMUX_TYPE s_viewers_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_viewers;
+
+static void stream_viewer_task(void *arg){
+    stream_viewer_t v = *(stream_viewer_t *)arg;
+    free(arg);
     static const char *BOUNDARY = "frame";
-    httpd_resp_set_type(req, "multipart/x-mixed-replace;boundary=frame");
+    // Headers go on the async copy: they are sent with its first chunk
+    httpd_resp_set_type(v.req, "multipart/x-mixed-replace;boundary=frame");
+    httpd_resp_set_hdr(v.req, "X-Layer", v.layer == OPDI_CAM_LAYER_SUB ? "sub" : "main");
+    // Counted as a viewer of the layer: SUB is only encoded while it has one
+    opdi_cam_stream_client(v.layer, true);
     char header[128];
+    uint8_t *buf = NULL; size_t cap = 0;
+    uint32_t last_ts = 0; bool sent_any = false;
+    TickType_t last_send = xTaskGetTickCount();
     while(1){
         // Acquire latest frame (copy). If none yet, delay.
-        int need = opdi_cam_stream_copy_latest(NULL, 0, NULL, NULL, NULL);
-        if (need <= 0){ vTaskDelay(pdMS_TO_TICKS(100)); continue; }
-        if (need > 64*1024){ // crude cap; prevent huge allocations
-            vTaskDelay(pdMS_TO_TICKS(100)); continue;
+        int need = opdi_cam_stream_copy_layer(v.layer, NULL, 0, NULL, NULL, NULL);
+        if (need <= 0 || need > STREAM_FRAME_MAX){ vTaskDelay(pdMS_TO_TICKS(100)); continue; }
+        if ((size_t)need > cap){
+            uint8_t *nb = realloc(buf, need);
+            if (!nb){ vTaskDelay(pdMS_TO_TICKS(200)); continue; }
+            buf = nb; cap = need;
         }
-        uint8_t *tmp = malloc(need);
-        if (!tmp){ vTaskDelay(pdMS_TO_TICKS(200)); continue; }
         uint8_t q=0; opdi_cam_profile_t prof=0; uint32_t ts=0;
-        int got = opdi_cam_stream_copy_latest(tmp, need, &q, &prof, &ts);
-        if (got != need || got<=0){ free(tmp); vTaskDelay(pdMS_TO_TICKS(50)); continue; }
-        int hn = snprintf(header, sizeof(header), "--%s\r\nContent-Type: image/jpeg\r\nX-Profile: %d\r\nX-JPEG-Q: %u\r\nX-Timestamp: %u\r\nContent-Length: %d\r\n\r\n", BOUNDARY, (int)prof, q, ts, got);
-        if (httpd_resp_send_chunk(req, header, hn)!=ESP_OK || httpd_resp_send_chunk(req, (const char*)tmp, got)!=ESP_OK || httpd_resp_send_chunk(req, "\r\n", 2)!=ESP_OK){
-            free(tmp); break; // client gone
+        int got = opdi_cam_stream_copy_layer(v.layer, buf, cap, &q, &prof, &ts);
+        if (got <= 0){ vTaskDelay(pdMS_TO_TICKS(50)); continue; }
+        // Each frame once: wait for the layer's next one rather than resending it
+        if (sent_any && ts == last_ts){ vTaskDelay(pdMS_TO_TICKS(10)); continue; }
+        int hn = snprintf(header, sizeof(header), "--%s\r\nContent-Type: image/jpeg\r\nX-Profile: %d\r\nX-JPEG-Q: %u\r\nX-Timestamp: %u\r\nContent-Length: %d\r\n\r\n", BOUNDARY, (int)prof, q, (unsigned)ts, got);
+        if (httpd_resp_send_chunk(v.req, header, hn)!=ESP_OK || httpd_resp_send_chunk(v.req, (const char*)buf, got)!=ESP_OK || httpd_resp_send_chunk(v.req, "\r\n", 2)!=ESP_OK){
+            break; // client gone
         }
-        free(tmp);
-        vTaskDelay(pdMS_TO_TICKS(50)); // ~20 FPS cap
+        last_ts = ts; sent_any = true;
+        xTaskDelayUntil(&last_send, pdMS_TO_TICKS(STREAM_MIN_GAP_MS));
+    }
+    free(buf);
+    opdi_cam_stream_client(v.layer, false);
+    httpd_req_async_handler_complete(v.req);
+    taskENTER_CRITICAL(&s_viewers_lock); s_viewers--; taskEXIT_CRITICAL(&s_viewers_lock);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t cam_stream_get(httpd_req_t *req){
+    opdi_cam_layer_t layer;
+    if (!stream_layer(req, &layer)){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "layer: main|sub"); return ESP_OK; }
+    taskENTER_CRITICAL(&s_viewers_lock);
+    bool room = s_viewers < STREAM_VIEWERS_MAX;
+    if (room) s_viewers++;
+    taskEXIT_CRITICAL(&s_viewers_lock);
+    if (!room){ httpd_resp_set_status(req, "503 Service Unavailable"); httpd_resp_sendstr(req, "too many viewers"); return ESP_OK; }
+    stream_viewer_t *v = malloc(sizeof(*v));
+    httpd_req_t *copy = NULL;
+    if (v && httpd_req_async_handler_begin(req, &copy) == ESP_OK){
+        v->req = copy; v->layer = layer;
+        if (xTaskCreate(stream_viewer_task, "cam_view", 4096, v, 5, NULL) == pdPASS) return ESP_OK;
+        req = copy; // the copy owns the session now: answer and release it
     }
+    free(v);
+    taskENTER_CRITICAL(&s_viewers_lock); s_viewers--; taskEXIT_CRITICAL(&s_viewers_lock);
+    ESP_LOGW(TAG, "stream viewer hand-off failed");
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "viewer");
+    if (copy) httpd_req_async_handler_complete(copy);
     return ESP_OK;
 }
 
@@ -0,0 +1,137 @@
+// Event clip REST endpoints: list, trigger, delete; downloads on the stream server
+#include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "opdi_clip.h"
+#include "opdi_api_json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "routes_clips";
+
+#define JSON_SCRATCH 256
+#define LIST_MAX 64
+// Read unit for downloads: a few TCP segments per send, in PSRAM
+#define FILE_CHUNK (16 * 1024)
+
+static bool query_name(httpd_req_t *req, char *name, size_t cap){
+    char q[96];
+    return httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK && httpd_query_key_value(q, "name", name, cap) == ESP_OK;
+}
+
+static esp_err_t send_err(httpd_req_t *req, esp_err_t err){
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "clip is still being recorded");
+        return ESP_OK;
+    }
+    return httpd_resp_send_err(req, err == ESP_ERR_NOT_FOUND ? HTTPD_404_NOT_FOUND : HTTPD_400_BAD_REQUEST,
+                               err == ESP_ERR_NOT_FOUND ? "no such clip" : "name");
+}
+
+static esp_err_t clips_get(httpd_req_t *req){
+    opdi_clip_info_t *list = heap_caps_malloc(LIST_MAX * sizeof(*list), MALLOC_CAP_SPIRAM);
+    if (!list) { httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no mem"); return ESP_OK; }
+    size_t n = 0;
+    opdi_clip_list(list, LIST_MAX, &n);
+    opdi_clip_stats_t st; opdi_clip_get_stats(&st);
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_bool(&w, "recording", st.recording);
+    opdi_json_kv_str(&w, "active", st.active);
+    opdi_json_key(&w, "stats"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "frames", st.frames);
+    opdi_json_kv_uint(&w, "dropped", st.dropped);
+    opdi_json_kv_uint(&w, "triggers", st.triggers);
+    opdi_json_kv_uint(&w, "clips", st.clips);
+    opdi_json_kv_uint(&w, "errors", st.errors);
+    opdi_json_kv_uint(&w, "written", st.written);
+    opdi_json_kv_uint(&w, "bytes", st.bytes);
+    opdi_json_kv_uint(&w, "writes", st.writes);
+    opdi_json_kv_uint(&w, "write_max_ms", st.write_max_ms);
+    opdi_json_kv_uint(&w, "ring_bytes", st.ring_bytes);
+    opdi_json_kv_uint(&w, "preroll_ms", st.preroll_ms);
+    opdi_json_obj_end(&w);
+    opdi_json_key(&w, "clips"); opdi_json_arr_begin(&w);
+    for (size_t i=0; i<n && w.err == ESP_OK; i++){
+        opdi_json_obj_begin(&w);
+        opdi_json_kv_str(&w, "name", list[i].name);
+        opdi_json_kv_str(&w, "reason", list[i].reason);
+        opdi_json_kv_uint(&w, "bytes", list[i].bytes);
+        opdi_json_kv_uint(&w, "frames", list[i].frames);
+        opdi_json_kv_uint(&w, "ms", list[i].duration_ms);
+        opdi_json_kv_uint(&w, "w", list[i].width);
+        opdi_json_kv_uint(&w, "h", list[i].height);
+        opdi_json_obj_end(&w);
+    }
+    opdi_json_arr_end(&w);
+    opdi_json_obj_end(&w);
+    heap_caps_free(list);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t clips_delete(httpd_req_t *req){
+    char name[OPDI_CLIP_NAME_MAX];
+    if (!query_name(req, name, sizeof(name))) return send_err(req, ESP_ERR_INVALID_ARG);
+    esp_err_t err = opdi_clip_delete(name);
+    if (err != ESP_OK) return send_err(req, err);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"ok\":true}");
+    return ESP_OK;
+}
+
+// ?reason=tamper (default "manual")
+static esp_err_t clips_trigger_post(httpd_req_t *req){
+    char q[64], reason[16] = "manual";
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK) httpd_query_key_value(q, "reason", reason, sizeof(reason));
+    esp_err_t err = opdi_clip_trigger(reason);
+    if (err != ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "clips not available"); return ESP_OK; }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"ok\":true}");
+    return ESP_OK;
+}
+
+static esp_err_t clips_file_get(httpd_req_t *req){
+    char name[OPDI_CLIP_NAME_MAX], path[128];
+    if (!query_name(req, name, sizeof(name))) return send_err(req, ESP_ERR_INVALID_ARG);
+    esp_err_t err = opdi_clip_path(name, path, sizeof(path));
+    if (err != ESP_OK) return send_err(req, err);
+    FILE *f = fopen(path, "rb");
+    char *buf = heap_caps_malloc(FILE_CHUNK, MALLOC_CAP_SPIRAM);
+    if (!f || !buf){
+        if (f) fclose(f);
+        heap_caps_free(buf);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "open");
+        return ESP_OK;
+    }
+    char disp[64];
+    snprintf(disp, sizeof(disp), "attachment; filename=\"%s\"", name);
+    httpd_resp_set_type(req, "video/x-msvideo");
+    httpd_resp_set_hdr(req, "Content-Disposition", disp);
+    size_t n;
+    err = ESP_OK;
+    while (err == ESP_OK && (n = fread(buf, 1, FILE_CHUNK, f)) > 0) err = httpd_resp_send_chunk(req, buf, n);
+    if (err == ESP_OK) err = httpd_resp_send_chunk(req, NULL, 0);
+    fclose(f);
+    heap_caps_free(buf);
+    if (err != ESP_OK) ESP_LOGW(TAG, "download of %s cut short (%s)", name, esp_err_to_name(err));
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+void routes_clips_register(httpd_handle_t server){
+    const httpd_uri_t endpoints[] = {
+        { .uri="/api/v1/clips",         .method=HTTP_GET,    .handler=clips_get },
+        { .uri="/api/v1/clips",         .method=HTTP_DELETE, .handler=clips_delete },
+        { .uri="/api/v1/clips/trigger", .method=HTTP_POST,   .handler=clips_trigger_post },
+    };
+    for (size_t i=0;i<sizeof(endpoints)/sizeof(endpoints[0]);++i) httpd_register_uri_handler(server, &endpoints[i]);
+    ESP_LOGI(TAG, "clip routes registered");
+}
+
+// Downloads are several MB read off the card: kept off the control server's single task
+void routes_clips_register_stream(httpd_handle_t server){
+    httpd_uri_t u = { .uri="/api/v1/clips/file", .method=HTTP_GET, .handler=clips_file_get };
+    httpd_register_uri_handler(server, &u);
+}
@@ -0,0 +1,117 @@
+// Face gallery REST endpoints: identity list and streaming bulk export/import (SRD FR-7)
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "opdi_gallery.h"
+#include "opdi_api_json.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "routes_gallery";
+
+#define JSON_SCRATCH 256
+// Receive unit for imports: a few TCP segments, on the handler stack
+#define IMPORT_CHUNK 1024
+
+static esp_err_t chunk_sink(void *ctx, const char *data, size_t len){
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// ?format=json (default) | gal
+static bool query_format(httpd_req_t *req, opdi_gallery_fmt_t *fmt, bool *replace){
+    char q[64], v[16];
+    *fmt = OPDI_GALLERY_FMT_JSON;
+    if (replace) *replace = false;
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) != ESP_OK) return true;
+    if (httpd_query_key_value(q, "format", v, sizeof(v)) == ESP_OK){
+        if (!strcmp(v, "gal")) *fmt = OPDI_GALLERY_FMT_GAL;
+        else if (strcmp(v, "json")) return false;
+    }
+    if (replace && httpd_query_key_value(q, "mode", v, sizeof(v)) == ESP_OK){
+        if (!strcmp(v, "replace")) *replace = true;
+        else if (strcmp(v, "merge")) return false;
+    }
+    return true;
+}
+
+static esp_err_t gallery_get(httpd_req_t *req){
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "count", opdi_gallery_count());
+    opdi_json_kv_uint(&w, "capacity", OPDI_GALLERY_CAPACITY);
+    opdi_json_kv_uint(&w, "dim", OPDI_GALLERY_DIM);
+    opdi_json_key(&w, "identities"); opdi_json_arr_begin(&w);
+    opdi_gallery_record_t r;   // labels only; the embedding part is not sent
+    for (size_t i=0; w.err == ESP_OK && opdi_gallery_get_at(i, &r) == ESP_OK; i++){
+        opdi_json_obj_begin(&w);
+        opdi_json_kv_uint(&w, "id", r.entry.id);
+        opdi_json_kv_str(&w, "label", r.entry.label);
+        opdi_json_kv_uint(&w, "created", r.entry.created);
+        opdi_json_obj_end(&w);
+    }
+    opdi_json_arr_end(&w);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t gallery_export_get(httpd_req_t *req){
+    opdi_gallery_fmt_t fmt;
+    if (!query_format(req, &fmt, NULL)){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format"); return ESP_OK; }
+    bool gal = fmt == OPDI_GALLERY_FMT_GAL;
+    httpd_resp_set_type(req, gal ? "application/octet-stream" : "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", gal ? "attachment; filename=\"gallery.gal\"" : "attachment; filename=\"gallery.json\"");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    int64_t t0 = esp_timer_get_time();
+    size_t n = 0;
+    esp_err_t err = opdi_gallery_export(fmt, chunk_sink, req, &n);
+    if (err == ESP_OK) err = httpd_resp_send_chunk(req, NULL, 0);
+    int64_t us = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "export %s: %u records in %lld ms (%s)", gal ? "gal" : "json", (unsigned)n, (long long)(us / 1000), esp_err_to_name(err));
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t gallery_import_post(httpd_req_t *req){
+    opdi_gallery_fmt_t fmt; bool replace;
+    if (!query_format(req, &fmt, &replace)){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format/mode"); return ESP_OK; }
+    opdi_gallery_import_t *im;
+    if (opdi_gallery_import_begin(fmt, replace, &im) != ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no mem"); return ESP_OK; }
+    int64_t t0 = esp_timer_get_time();
+    char buf[IMPORT_CHUNK];
+    size_t left = req->content_len;
+    esp_err_t err = ESP_OK;
+    // Parse as it arrives: the body is never held in RAM
+    while (left && err == ESP_OK){
+        int r = httpd_req_recv(req, buf, left < sizeof(buf) ? left : sizeof(buf));
+        if (r == HTTPD_SOCK_ERR_TIMEOUT) continue;
+        if (r <= 0){ err = ESP_ERR_TIMEOUT; break; }
+        left -= (size_t)r;
+        err = opdi_gallery_import_feed(im, buf, (size_t)r);
+    }
+    size_t n = 0;
+    esp_err_t end = opdi_gallery_import_end(im, &n);
+    if (err == ESP_OK) err = end;
+    int64_t us = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "import %s: %u records in %lld ms (%s)", fmt == OPDI_GALLERY_FMT_GAL ? "gal" : "json", (unsigned)n, (long long)(us / 1000), esp_err_to_name(err));
+    if (err == ESP_ERR_TIMEOUT) return ESP_FAIL;   // client gone: nothing to answer
+    char out[160];
+    snprintf(out, sizeof(out), "{\"ok\":%s,\"imported\":%u,\"count\":%u,\"ms\":%lld,\"error\":\"%s\"}",
+             err == ESP_OK ? "true" : "false", (unsigned)n, (unsigned)opdi_gallery_count(), (long long)(us / 1000),
+             err == ESP_OK ? "" : esp_err_to_name(err));
+    if (err == ESP_ERR_NO_MEM) httpd_resp_set_status(req, "507 Insufficient Storage");
+    else if (err == ESP_ERR_INVALID_STATE || err == ESP_FAIL) httpd_resp_set_status(req, HTTPD_500);
+    else if (err != ESP_OK) httpd_resp_set_status(req, HTTPD_400);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    return ESP_OK;
+}
+
+void routes_gallery_register(httpd_handle_t server){
+    const httpd_uri_t endpoints[] = {
+        { .uri="/api/v1/gallery",        .method=HTTP_GET,  .handler=gallery_get },
+        { .uri="/api/v1/gallery/export", .method=HTTP_GET,  .handler=gallery_export_get },
+        { .uri="/api/v1/gallery/import", .method=HTTP_POST, .handler=gallery_import_post },
+    };
+    for (size_t i=0;i<sizeof(endpoints)/sizeof(endpoints[0]);++i) httpd_register_uri_handler(server, &endpoints[i]);
+    ESP_LOGI(TAG, "gallery routes registered");
+}
@@ -5,18 +5,19 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "opdi_net.h"
-#include "esp_wifi.h" // for scan/types
-#include "cJSON.h"
 #include "esp_idf_version.h"
 #include "opdi_cam.h"
+#include "opdi_api_json.h"
+#include "opdi_api_ws.h"
 
 // Internal metrics/logs access
 extern void opdi_net_get_metrics(opdi_net_metrics_t *out);
-extern size_t opdi_net_logs_serialize(char *out, size_t cap);
-__attribute__((weak)) void opdi_net_internal_scan_account(void); // from opdi_net.c
 
 static const char *TAG = "routes_net";
 
+// Scratch for the streaming JSON writer; larger responses go out in several chunks
+#define JSON_SCRATCH 256
+
 static const char *state_str(opdi_net_state_t s){
     switch(s){
         case NET_STA_CONNECTED: return "STA_CONNECTED";
@@ -36,7 +37,7 @@ static void build_status_json(char *buf, size_t cap){
     const opdi_net_state_t st = opdi_net_get_state();
     int rssi_val = 0; bool have=false; char ip_field[48]="null"; char gw_field[48]="null";
     if (st == NET_STA_CONNECTED){
-        wifi_ap_record_t ap; if (esp_wifi_sta_get_ap_info(&ap)==ESP_OK){ rssi_val=ap.rssi; have=true; }
+        int8_t rssi; if (opdi_net_sta_rssi(&rssi)==ESP_OK){ rssi_val=rssi; have=true; }
         const char *cip=opdi_net_cached_ip(); if(cip&&cip[0]) snprintf(ip_field,sizeof(ip_field),"\"%s\"",cip);
         const char *cgw=opdi_net_cached_gw(); if(cgw&&cgw[0]) snprintf(gw_field,sizeof(gw_field),"\"%s\"",cgw);
     }
@@ -67,38 +68,41 @@ static void build_status_json(char *buf, size_t cap){
 }
 static esp_err_t net_status_get(httpd_req_t *req){ char buf[512]; build_status_json(buf,sizeof(buf)); httpd_resp_set_type(req,"application/json"); httpd_resp_sendstr(req,buf); return ESP_OK; }
 
-// Profiles list (enumeration)
-extern size_t opdi_net_profiles_serialize(char *out, size_t out_cap);
+// Profiles list (enumeration), streamed straight from the credential cache
+static bool profile_json_cb(const opdi_net_profile_info_t *p, void *arg){
+    opdi_json_t *w = (opdi_json_t*)arg;
+    char id[12]; snprintf(id, sizeof(id), "%s...", p->id); // masked id, as the UI has always shown it
+    opdi_json_obj_begin(w);
+    opdi_json_kv_str(w, "id", id);
+    opdi_json_kv_uint(w, "ssid_len", p->ssid_len);
+    opdi_json_kv_bool(w, "hidden", p->hidden);
+    opdi_json_kv_uint(w, "success", p->success);
+    opdi_json_kv_uint(w, "ch", p->channel);
+    opdi_json_obj_end(w);
+    return w->err == ESP_OK;
+}
 static esp_err_t net_profiles_get(httpd_req_t *req){
-    static char buf[1024];
-    size_t n = opdi_net_profiles_serialize(buf, sizeof(buf));
-    if (n==0) { strcpy(buf, "[]"); n=2; }
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, buf, n);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_arr_begin(&w);
+    opdi_net_profiles_foreach(profile_json_cb, &w);
+    opdi_json_arr_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
 // Add/update profile
+static const opdi_json_field_t k_profile_fields[] = {
+    OPDI_JSON_STR(opdi_net_profile_t, ssid, "ssid"),
+    OPDI_JSON_STR(opdi_net_profile_t, psk, "psk"),
+    OPDI_JSON_BOOL(opdi_net_profile_t, hidden, "hidden"),
+    OPDI_JSON_UINT(opdi_net_profile_t, auth, "auth"),
+};
 static esp_err_t net_profiles_post(httpd_req_t *req){
     char content[384];
-    int received = httpd_req_recv(req, content, sizeof(content)-1);
-    if (received <= 0) { httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "empty body"); return ESP_OK; }
-    content[received] = '\0';
-    cJSON *root = cJSON_Parse(content);
-    if (!root){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid json"); return ESP_OK; }
-    cJSON *j_ssid = cJSON_GetObjectItemCaseSensitive(root, "ssid");
-    if (!cJSON_IsString(j_ssid) || j_ssid->valuestring[0]=='\0') { cJSON_Delete(root); httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "ssid required"); return ESP_OK; }
-    cJSON *j_psk = cJSON_GetObjectItemCaseSensitive(root, "psk");
-    cJSON *j_hidden = cJSON_GetObjectItemCaseSensitive(root, "hidden");
-    cJSON *j_auth = cJSON_GetObjectItemCaseSensitive(root, "auth");
     opdi_net_profile_t p = {0};
-    strlcpy(p.ssid, j_ssid->valuestring, sizeof(p.ssid));
-    if (cJSON_IsString(j_psk)) strlcpy(p.psk, j_psk->valuestring, sizeof(p.psk));
-    p.hidden = cJSON_IsBool(j_hidden) ? cJSON_IsTrue(j_hidden) : false;
-    p.auth = (cJSON_IsNumber(j_auth) && j_auth->valuedouble>=0) ? (uint8_t)j_auth->valuedouble : 0;
-    esp_err_t err = opdi_net_add_profile(&p);
-    cJSON_Delete(root);
-    if (err!=ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "add fail"); return ESP_OK; }
+    if (opdi_json_bind_req(req, content, sizeof(content), OPDI_JSON_FIELDS(k_profile_fields), &p, NULL)!=ESP_OK) return ESP_OK;
+    if (!p.ssid[0]) { httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "ssid required"); return ESP_OK; }
+    if (opdi_net_add_profile(&p)!=ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "add fail"); return ESP_OK; }
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
@@ -119,144 +123,131 @@ static esp_err_t net_profiles_delete(httpd_req_t *req){
 }
 
 // Trigger connect
+typedef struct { char ssid[33]; } connect_req_t;
+static const opdi_json_field_t k_connect_fields[] = { OPDI_JSON_STR(connect_req_t, ssid, "ssid") };
 static esp_err_t net_connect_post(httpd_req_t *req){
-    char content[160]; int received = httpd_req_recv(req, content, sizeof(content)-1);
-    const char *ssid = NULL; content[0]='\0';
-    if (received > 0){
-        content[received]='\0';
-        cJSON *root = cJSON_Parse(content);
-        if (root){
-            cJSON *j_ssid = cJSON_GetObjectItemCaseSensitive(root, "ssid");
-            if (cJSON_IsString(j_ssid) && j_ssid->valuestring[0]) ssid = j_ssid->valuestring;
-        }
-        // We don't need to keep JSON DOM after extracting pointer, copy if present
-        static char ssid_copy[33];
-        if (ssid){ strlcpy(ssid_copy, ssid, sizeof(ssid_copy)); ssid = ssid_copy; }
-        if (root) cJSON_Delete(root);
-    }
-    opdi_net_connect(ssid);
+    char content[160];
+    connect_req_t c = {0}; // empty body or no ssid: connect to the MRU profile
+    if (opdi_json_bind_req(req, content, sizeof(content), OPDI_JSON_FIELDS(k_connect_fields), &c, NULL)!=ESP_OK) return ESP_OK;
+    opdi_net_connect(c.ssid[0] ? c.ssid : NULL);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
 }
 
-// Scan (placeholder returns empty array)
-static esp_err_t net_scan_get(httpd_req_t *req){
-    httpd_resp_set_type(req, "application/json");
-    // Perform a blocking active scan (Phase1 simple). Limit records to e.g. 20.
-    wifi_scan_config_t cfg = {0};
-    cfg.show_hidden = true; // allow discovering hidden if broadcasting at moment
-    cfg.scan_type = WIFI_SCAN_TYPE_ACTIVE;
-    esp_err_t err = esp_wifi_scan_start(&cfg, true); // block until done
-    if (err != ESP_OK){
-        httpd_resp_sendstr(req, "[]");
-        return ESP_OK;
-    }
-    if (opdi_net_internal_scan_account) opdi_net_internal_scan_account();
-    uint16_t ap_count = 0; esp_wifi_scan_get_ap_num(&ap_count);
-    if (ap_count > 32) ap_count = 32; // cap
-    wifi_ap_record_t *recs = calloc(ap_count, sizeof(wifi_ap_record_t));
-    if (!recs){ httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    if (esp_wifi_scan_get_ap_records(&ap_count, recs)!=ESP_OK){ free(recs); httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    static char json[2048]; size_t len = 0; json[len++]='['; json[len]='\0';
-    for (uint16_t i=0;i<ap_count;i++) {
-        if (recs[i].rssi < CONFIG_OPDI_NET_SCAN_MIN_RSSI) continue;
-        char entry[160];
-        // auth mode numeric, channel, rssi
-        const uint8_t *b = recs[i].bssid;
-        int n = snprintf(entry, sizeof(entry),
-            "{\"ssid\":\"%.*s\",\"bssid\":\"%02x:%02x:%02x:%02x:%02x:%02x\",\"rssi\":%d,\"auth\":%d,\"ch\":%u},",
-            32, (const char*)recs[i].ssid, b[0],b[1],b[2],b[3],b[4],b[5], recs[i].rssi, recs[i].authmode, recs[i].primary);
-        if (n <= 0) continue;
-        if (len + (size_t)n >= sizeof(json)-2) break; // leave room for closing
-        memcpy(json+len, entry, n); len += n; json[len]='\0';
-    }
-    if (len>1 && json[len-1]==',') { json[len-1]=']'; json[len]='\0'; }
-    else { json[len++]=']'; json[len]='\0'; }
-    httpd_resp_send(req, json, len);
-    free(recs);
-    return ESP_OK;
+// Scans go through the shared service in opdi_net and never block the httpd worker.
+// ?max_age=<ms> (default CONFIG_OPDI_NET_SCAN_TTL_MS) bounds how old the cached results may be:
+//   200 - cache fresh enough
+//   202 - scan started/joined; body holds the previous results, new ones follow as the net.scan WS event
+// X-Scan-Age-Ms carries the age of the returned results.
+static size_t scan_fetch(httpd_req_t *req, opdi_net_scan_ap_t *aps, size_t cap, char age_hdr[12]){
+    uint32_t max_age = CONFIG_OPDI_NET_SCAN_TTL_MS;
+    char q[32], v[12];
+    if (httpd_req_get_url_query_str(req, q, sizeof(q))==ESP_OK && httpd_query_key_value(q, "max_age", v, sizeof(v))==ESP_OK)
+        max_age = (uint32_t)strtoul(v, NULL, 10);
+    esp_err_t r = opdi_net_scan_request(max_age);
+    if (r == ESP_ERR_NOT_FINISHED) httpd_resp_set_status(req, "202 Accepted");
+    else if (r != ESP_OK) ESP_LOGW(TAG, "scan refused (%s), serving cached results", esp_err_to_name(r));
+    uint32_t age = 0;
+    size_t n = opdi_net_scan_results(aps, cap, &age);
+    if (age != UINT32_MAX) { snprintf(age_hdr, 12, "%lu", (unsigned long)age); httpd_resp_set_hdr(req, "X-Scan-Age-Ms", age_hdr); }
+    return n;
 }
 
-// Quick scan summary (top 16 by RSSI) - performs a fresh scan (blocking) similar to net_scan_get but trims to 16 sorted results.
-static esp_err_t net_scan_summary_get(httpd_req_t *req){
-    httpd_resp_set_type(req, "application/json");
-    wifi_scan_config_t cfg = {0};
-    cfg.show_hidden = true; cfg.scan_type = WIFI_SCAN_TYPE_ACTIVE;
-    if (esp_wifi_scan_start(&cfg, true) != ESP_OK){ httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    if (opdi_net_internal_scan_account) opdi_net_internal_scan_account();
-    uint16_t ap_total = 0; esp_wifi_scan_get_ap_num(&ap_total);
-    if (ap_total == 0){ httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    if (ap_total > 64) ap_total = 64; // temp cap
-    wifi_ap_record_t *recs = calloc(ap_total, sizeof(wifi_ap_record_t));
-    if (!recs){ httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    if (esp_wifi_scan_get_ap_records(&ap_total, recs)!=ESP_OK){ free(recs); httpd_resp_sendstr(req, "[]"); return ESP_OK; }
-    // Simple selection sort for top 16 by RSSI (descending)
-    uint16_t limit = ap_total < 16 ? ap_total : 16;
-    for (uint16_t i=0;i<limit;i++){
-        uint16_t max_i = i; for (uint16_t j=i+1;j<ap_total;j++){ if (recs[j].rssi > recs[max_i].rssi) max_i = j; }
-        if (max_i != i){ wifi_ap_record_t tmp = recs[i]; recs[i]=recs[max_i]; recs[max_i]=tmp; }
-    }
-    static char json[1600]; size_t len=0; json[len++]='['; json[len]='\0';
-    for (uint16_t i=0;i<limit;i++){
-        if (recs[i].rssi < CONFIG_OPDI_NET_SCAN_MIN_RSSI) continue;
-        char entry[128];
-        int n = snprintf(entry,sizeof(entry),"{\"ssid\":\"%.*s\",\"rssi\":%d,\"auth\":%d,\"ch\":%u},",32,(const char*)recs[i].ssid,recs[i].rssi,recs[i].authmode,recs[i].primary);
-        if (n<=0) continue;
-        if (len + (size_t)n >= sizeof(json)-2) break;
-        memcpy(json+len, entry, n);
-        len+=n;
-        json[len]='\0';
+static esp_err_t scan_send(httpd_req_t *req, size_t cap, bool with_bssid){
+    opdi_net_scan_ap_t aps[CONFIG_OPDI_NET_SCAN_MAX_APS]; // snapshot: a scan may complete while we send
+    char age_hdr[12];
+    size_t count = scan_fetch(req, aps, cap, age_hdr);
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_arr_begin(&w);
+    for (size_t i=0;i<count;i++) {
+        opdi_json_obj_begin(&w);
+        opdi_json_key(&w, "ssid"); opdi_json_strn(&w, aps[i].ssid, 32);
+        if (with_bssid) {
+            const uint8_t *b = aps[i].bssid; char bssid[18];
+            snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x", b[0],b[1],b[2],b[3],b[4],b[5]);
+            opdi_json_kv_str(&w, "bssid", bssid);
+        }
+        opdi_json_kv_int(&w, "rssi", aps[i].rssi);
+        opdi_json_kv_uint(&w, "auth", aps[i].auth);
+        opdi_json_kv_uint(&w, "ch", aps[i].channel);
+        opdi_json_obj_end(&w);
     }
-    if (len>1 && json[len-1]==',') json[len-1]=']'; else { json[len++]=']'; json[len]='\0'; }
-    httpd_resp_send(req, json, len);
-    free(recs);
-    return ESP_OK;
+    opdi_json_arr_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
+static esp_err_t net_scan_get(httpd_req_t *req){ return scan_send(req, CONFIG_OPDI_NET_SCAN_MAX_APS, true); }
+
+// Quick scan summary: top 16 by RSSI from the same cache (results are kept strongest first)
+static esp_err_t net_scan_summary_get(httpd_req_t *req){ return scan_send(req, 16, false); }
+
 // Metrics endpoint (explicit)
 static esp_err_t net_metrics_get(httpd_req_t *req){
     opdi_net_metrics_t m; opdi_net_get_metrics(&m);
-    char buf[192];
-    // Cast to unsigned long to satisfy format expectations under -Werror=format (riscv32 toolchain typedefs)
-    snprintf(buf, sizeof(buf), "{\"attempts\":%lu,\"success\":%lu,\"avg_ms\":%lu,\"scans\":%lu,\"retries\":%lu}",
-             (unsigned long)m.connect_attempts,
-             (unsigned long)m.connects_success,
-             (unsigned long)m.avg_connect_time_ms,
-             (unsigned long)m.scan_count,
-             (unsigned long)m.current_retries);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, buf);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "attempts", m.connect_attempts);
+    opdi_json_kv_uint(&w, "success", m.connects_success);
+    opdi_json_kv_uint(&w, "avg_ms", m.avg_connect_time_ms);
+    opdi_json_kv_uint(&w, "scans", m.scan_count);
+    opdi_json_kv_uint(&w, "retries", m.current_retries);
+    opdi_json_kv_uint(&w, "ttip_ms", m.last_time_to_ip_ms);
+    opdi_json_kv_uint(&w, "boot_ip_ms", m.boot_to_ip_ms);
+    opdi_json_kv_uint(&w, "directed", m.directed_attempts);
+    opdi_json_kv_uint(&w, "fallbacks", m.directed_fallbacks);
+    // WS event bus
+    opdi_api_ws_stats_t ws; opdi_api_ws_get_stats(&ws);
+    opdi_json_key(&w, "ws"); opdi_json_obj_begin(&w);
+    opdi_json_kv_uint(&w, "clients", ws.clients);
+    opdi_json_kv_uint(&w, "published", ws.published);
+    opdi_json_kv_uint(&w, "coalesced", ws.coalesced);
+    opdi_json_kv_uint(&w, "dropped", ws.dropped);
+    opdi_json_kv_uint(&w, "frames", ws.frames);
+    opdi_json_kv_uint(&w, "batched", ws.batched);
+    opdi_json_kv_uint(&w, "bin_frames", ws.bin_frames);
+    opdi_json_kv_uint(&w, "rendered", ws.rendered);
+    opdi_json_kv_uint(&w, "slow_dropped", ws.clients_dropped);
+    opdi_json_kv_uint(&w, "queue_hw", ws.queue_hw);
+    opdi_json_obj_end(&w);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
-// Logs endpoint
+// Logs endpoint: the whole ring, messages escaped
+static bool log_json_cb(uint32_t ts_ms, const char *msg, void *arg){
+    opdi_json_t *w = (opdi_json_t*)arg;
+    opdi_json_obj_begin(w);
+    opdi_json_kv_uint(w, "t", ts_ms);
+    opdi_json_kv_str(w, "m", msg);
+    opdi_json_obj_end(w);
+    return w->err == ESP_OK;
+}
 static esp_err_t net_logs_get(httpd_req_t *req){
-    static char buf[1024]; size_t n = opdi_net_logs_serialize(buf, sizeof(buf));
-    if (!n){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "log buf"); return ESP_OK; }
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, buf, n);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_arr_begin(&w);
+    opdi_net_logs_foreach(log_json_cb, &w);
+    opdi_json_arr_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
 
-// AP config override (not persisted yet) - placeholder
+// AP config override (persisted by opdi_net_ap_set)
+typedef struct { char ssid[33]; int channel; } ap_config_req_t;
+static const opdi_json_field_t k_ap_fields[] = {
+    OPDI_JSON_STR(ap_config_req_t, ssid, "ssid"),
+    OPDI_JSON_INT(ap_config_req_t, channel, "channel"),
+};
 static esp_err_t net_ap_config_post(httpd_req_t *req){
-    char content[256]; int received = httpd_req_recv(req, content, sizeof(content)-1);
-    const char *new_ssid=NULL; int new_ch=-1;
-    if (received>0){
-        content[received]='\0';
-        cJSON *root = cJSON_Parse(content);
-        if (root){
-            cJSON *j_ssid = cJSON_GetObjectItemCaseSensitive(root, "ssid");
-            cJSON *j_ch = cJSON_GetObjectItemCaseSensitive(root, "channel");
-            if (cJSON_IsString(j_ssid) && j_ssid->valuestring[0]) new_ssid = j_ssid->valuestring;
-            if (cJSON_IsNumber(j_ch)) new_ch = (int)j_ch->valuedouble;
-            static char ssid_copy[33];
-            if (new_ssid){ strlcpy(ssid_copy, new_ssid, sizeof(ssid_copy)); new_ssid = ssid_copy; }
-            cJSON_Delete(root);
-        }
-    }
-    if (opdi_net_ap_set(new_ssid, (uint8_t)new_ch)!=ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "persist"); return ESP_OK; }
+    char content[256];
+    ap_config_req_t c = { .channel = -1 };
+    uint32_t seen = 0;
+    if (opdi_json_bind_req(req, content, sizeof(content), OPDI_JSON_FIELDS(k_ap_fields), &c, &seen)!=ESP_OK) return ESP_OK;
+    // Optional, but 2.4 GHz 1..13 when given (the uint8_t cast below would wrap 262 to 6)
+    if ((seen & (1u << 1)) && (c.channel < 1 || c.channel > 13)){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "channel"); return ESP_OK; }
+    if (opdi_net_ap_set(c.ssid[0] ? c.ssid : NULL, (uint8_t)c.channel)!=ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "persist"); return ESP_OK; }
     char ssid_now[33]; uint8_t ch_now; opdi_net_ap_get(ssid_now, sizeof(ssid_now), &ch_now);
     char resp[128]; snprintf(resp, sizeof(resp), "{\"ok\":true,\"ssid\":\"%s\",\"channel\":%u}", ssid_now, ch_now);
     httpd_resp_set_type(req, "application/json");
@@ -297,29 +288,28 @@ static esp_err_t cam_snapshot_get(httpd_req_t *req){
 }
 static esp_err_t cam_config_get(httpd_req_t *req){
     opdi_cam_config_t c; opdi_cam_get_config(&c);
-    char resp[160];
-    snprintf(resp,sizeof(resp),"{\"brightness\":%d,\"contrast\":%d,\"saturation\":%d,\"auto_exposure\":%s}",
-        c.brightness,c.contrast,c.saturation,c.auto_exposure?"true":"false");
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, resp);
-    return ESP_OK;
+    char scratch[JSON_SCRATCH]; opdi_json_t w;
+    opdi_json_init_httpd(&w, req, scratch, sizeof(scratch));
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_int(&w, "brightness", c.brightness);
+    opdi_json_kv_int(&w, "contrast", c.contrast);
+    opdi_json_kv_int(&w, "saturation", c.saturation);
+    opdi_json_kv_bool(&w, "auto_exposure", c.auto_exposure);
+    opdi_json_obj_end(&w);
+    return opdi_json_finish(&w)==ESP_OK ? ESP_OK : ESP_FAIL;
 }
+static const opdi_json_field_t k_cam_fields[] = {
+    OPDI_JSON_INT(opdi_cam_config_t, brightness, "brightness"),
+    OPDI_JSON_INT(opdi_cam_config_t, contrast, "contrast"),
+    OPDI_JSON_INT(opdi_cam_config_t, saturation, "saturation"),
+    OPDI_JSON_BOOL(opdi_cam_config_t, auto_exposure, "auto_exposure"),
+};
 static esp_err_t cam_config_post(httpd_req_t *req){
-    char content[256]; int received = httpd_req_recv(req, content, sizeof(content)-1);
-    if (received<=0){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "empty"); return ESP_OK; }
-    content[received]='\0';
-    cJSON *root = cJSON_Parse(content);
-    if(!root){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "json"); return ESP_OK; }
+    char content[256];
     opdi_cam_config_t c; opdi_cam_get_config(&c);
-    cJSON *j_b = cJSON_GetObjectItemCaseSensitive(root,"brightness");
-    cJSON *j_c = cJSON_GetObjectItemCaseSensitive(root,"contrast");
-    cJSON *j_s = cJSON_GetObjectItemCaseSensitive(root,"saturation");
-    cJSON *j_ae = cJSON_GetObjectItemCaseSensitive(root,"auto_exposure");
-    if (cJSON_IsNumber(j_b)) c.brightness = (int)j_b->valuedouble;
-    if (cJSON_IsNumber(j_c)) c.contrast = (int)j_c->valuedouble;
-    if (cJSON_IsNumber(j_s)) c.saturation = (int)j_s->valuedouble;
-    if (cJSON_IsBool(j_ae)) c.auto_exposure = cJSON_IsTrue(j_ae);
-    cJSON_Delete(root);
+    uint32_t seen;
+    if (opdi_json_bind_req(req, content, sizeof(content), OPDI_JSON_FIELDS(k_cam_fields), &c, &seen)!=ESP_OK) return ESP_OK;
+    if (!seen){ httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "empty"); return ESP_OK; }
     if (opdi_cam_set_config(&c)!=ESP_OK){ httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "persist"); return ESP_OK; }
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true}");
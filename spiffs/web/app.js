@@ -26,8 +26,10 @@ async function refreshMetricsOnce(){try{const js=await fetchJSON('/api/v1/net/me
 
 async function refreshProfiles(){try{const arr=await fetchJSON('/api/v1/net/sta/profiles');profilesBody.innerHTML='';arr.forEach(p=>{const tr=document.createElement('tr');tr.innerHTML=`<td>${p.id}</td><td>${p.ssid_len}</td><td>${p.hidden}</td><td>${p.success}</td><td><button data-id="${p.id}" class="del">Del</button></td>`;profilesBody.appendChild(tr);});}catch(e){log('profiles err '+e);} }
 
-async function runScan(){scanBody.innerHTML='<tr><td colspan=6>Scanning...</td></tr>';try{const arr=await fetchJSON('/api/v1/net/scan');renderScan(arr);}catch(e){scanBody.innerHTML='<tr><td colspan=6>Scan failed</td></tr>';log('scan fail '+e);} }
-async function runScanSummary(){scanBody.innerHTML='<tr><td colspan=6>Scanning (summary)...</td></tr>';try{const arr=await fetchJSON('/api/v1/net/scan_summary');renderScan(arr);}catch(e){scanBody.innerHTML='<tr><td colspan=6>Scan summary failed</td></tr>';log('scan summary fail '+e);} }
+// 200 = fresh cache; 202 = previous results while a scan runs, the fresh list follows as the net.scan WS event
+async function fetchScan(url){const r=await fetch(url);if(!r.ok) throw new Error(`${url} ${r.status}`);const arr=await r.json();if(r.status===202) log('scan started');return {arr,pending:r.status===202};}
+async function runScan(){scanBody.innerHTML='<tr><td colspan=6>Scanning...</td></tr>';try{const {arr,pending}=await fetchScan('/api/v1/net/scan');if(arr.length||!pending) renderScan(arr);}catch(e){scanBody.innerHTML='<tr><td colspan=6>Scan failed</td></tr>';log('scan fail '+e);} }
+async function runScanSummary(){scanBody.innerHTML='<tr><td colspan=6>Scanning (summary)...</td></tr>';try{const {arr,pending}=await fetchScan('/api/v1/net/scan_summary');if(arr.length||!pending) renderScan(arr);}catch(e){scanBody.innerHTML='<tr><td colspan=6>Scan summary failed</td></tr>';log('scan summary fail '+e);} }
 function renderScan(arr){scanBody.innerHTML='';arr.forEach(ap=>{const tr=document.createElement('tr');tr.innerHTML=`<td>${ap.ssid}</td><td>${ap.rssi}</td><td>${ap.auth}</td><td>${ap.ch}</td><td>${ap.bssid||''}</td><td><button class="connect" data-ssid="${ap.ssid}">Connect</button></td>`;scanBody.appendChild(tr);});if(!arr.length)scanBody.innerHTML='<tr><td colspan=6>No APs</td></tr>'}
 
 document.getElementById('btnScan').addEventListener('click',runScan);document.getElementById('btnScanSummary').addEventListener('click',runScanSummary);
@@ -44,7 +46,9 @@ function updateMetrics(m){if(!m) return; if('attempts' in m){mAttempts.textConte
 function tryParseJSON(s){try{return JSON.parse(s);}catch(_){return null;}}
 // Wrap original connectWS to decode metrics
 const _origConnectWS = connectWS;
-connectWS = function(){try{const ws=new WebSocket(`ws://${location.host}/ws`);ws.onopen=()=>log('ws open');ws.onmessage=ev=>{log('evt '+ev.data);const obj=tryParseJSON(ev.data);if(obj&&obj.type==='net'){if(obj.sub==='metrics'){updateMetrics({attempts:obj.attempts,success:obj.success,avg_ms:obj.avg_ms,scans:obj.scans,retries:obj.retries});} if(obj.sub==='sta_connected'||obj.sub==='ap_active'){refreshStatus();}}};ws.onclose=()=>{log('ws closed; retrying...');setTimeout(connectWS,2000);} }catch(e){log('ws error '+e);setTimeout(connectWS,4000);} };
+connectWS = function(){try{const ws=new WebSocket(`ws://${location.host}/ws`);ws.onopen=()=>log('ws open');ws.onmessage=ev=>{log('evt '+ev.data);const data=tryParseJSON(ev.data);if(data){(Array.isArray(data)?data:[data]).forEach(onWsEvent);}};ws.onclose=()=>{log('ws closed; retrying...');setTimeout(connectWS,2000);} }catch(e){log('ws error '+e);setTimeout(connectWS,4000);} };
+// The device batches bursts of events into one frame as a JSON array
+function onWsEvent(obj){if(!obj||obj.type!=='net') return; if(obj.sub==='metrics'){updateMetrics({attempts:obj.attempts,success:obj.success,avg_ms:obj.avg_ms,scans:obj.scans,retries:obj.retries});} if(obj.sub==='sta_connected'||obj.sub==='ap_active'){refreshStatus();} if(obj.sub==='scan'){renderScan(obj.aps||[]);}}
 
 refreshStatus();refreshProfiles();refreshVersion();refreshMetricsOnce();connectWS();
 setInterval(refreshStatus,5000);
@@ -0,0 +1,163 @@
+#include "unity.h"
+#include "opdi_api_json.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Streaming JSON writer: escaping, automatic commas, chunked output through a tiny scratch
+// buffer, overflow detection in fixed-buffer mode, and cost against the snprintf builders it replaced.
+
+static char out[4096];
+static size_t out_len;
+static int chunks;
+static esp_err_t collect(void *ctx, const char *data, size_t len){
+    (void)ctx;
+    if (out_len + len >= sizeof(out)) return ESP_ERR_NO_MEM;
+    memcpy(out + out_len, data, len); out_len += len; out[out_len] = '\0';
+    chunks++;
+    return ESP_OK;
+}
+static esp_err_t fail_sink(void *ctx, const char *data, size_t len){ (void)ctx; (void)data; (void)len; return ESP_FAIL; }
+
+typedef struct { const char *ssid; int rssi; unsigned auth, ch; } ap_t;
+static const ap_t APS[] = {
+    { "home", -41, 3, 6 }, { "Cafe \"Guest\"", -67, 0, 1 }, { "tab\there", -72, 4, 11 }, { "back\\slash", -80, 3, 13 },
+};
+
+static void write_aps(opdi_json_t *w, const ap_t *aps, size_t n){
+    opdi_json_arr_begin(w);
+    for (size_t i=0; i<n; i++){
+        opdi_json_obj_begin(w);
+        opdi_json_kv_str(w, "ssid", aps[i].ssid);
+        opdi_json_kv_int(w, "rssi", aps[i].rssi);
+        opdi_json_kv_uint(w, "auth", aps[i].auth);
+        opdi_json_kv_uint(w, "ch", aps[i].ch);
+        opdi_json_obj_end(w);
+    }
+    opdi_json_arr_end(w);
+}
+
+void setUp(void) {
+    out_len = 0; out[0] = '\0'; chunks = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_commas_nesting_and_scalars(void) {
+    char buf[256]; opdi_json_t w;
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_obj_begin(&w);
+    opdi_json_kv_int(&w, "neg", -2147483648LL);
+    opdi_json_kv_uint(&w, "big", 18446744073709551615ULL);
+    opdi_json_kv_bool(&w, "t", true);
+    opdi_json_key(&w, "n"); opdi_json_null(&w);
+    opdi_json_key(&w, "empty"); opdi_json_arr_begin(&w); opdi_json_arr_end(&w);
+    opdi_json_key(&w, "o"); opdi_json_obj_begin(&w); opdi_json_kv_uint(&w, "z", 0); opdi_json_obj_end(&w);
+    opdi_json_key(&w, "raw"); opdi_json_raw(&w, "[1,2]");
+    opdi_json_obj_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_finish(&w));
+    TEST_ASSERT_EQUAL_STRING("{\"neg\":-2147483648,\"big\":18446744073709551615,\"t\":true,\"n\":null,\"empty\":[],\"o\":{\"z\":0},\"raw\":[1,2]}", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), w.len);
+}
+
+void test_string_escaping(void) {
+    char buf[128]; opdi_json_t w;
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    const char ssid[] = { 'a', '"', '\\', '\n', '\t', 0x01, 0x1f, (char)0xc3, (char)0xa9, 0 };
+    opdi_json_str(&w, ssid);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_finish(&w));
+    TEST_ASSERT_EQUAL_STRING("\"a\\\"\\\\\\n\\t\\u0001\\u001f\xc3\xa9\"", buf); // UTF-8 passes through
+    // Fixed-width SSID fields: strn stops at n or at the first NUL
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_arr_begin(&w);
+    opdi_json_strn(&w, "abcdef", 3);
+    opdi_json_strn(&w, "ab\0cd", 5);
+    opdi_json_str(&w, NULL);
+    opdi_json_arr_end(&w);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_finish(&w));
+    TEST_ASSERT_EQUAL_STRING("[\"abc\",\"ab\",null]", buf);
+}
+
+void test_tiny_scratch_streams_identical_output(void) {
+    char ref[512]; opdi_json_t w;
+    opdi_json_init(&w, ref, sizeof(ref), NULL, NULL);
+    write_aps(&w, APS, sizeof(APS)/sizeof(APS[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_finish(&w));
+    char scratch[8];
+    opdi_json_init(&w, scratch, sizeof(scratch), collect, NULL);
+    write_aps(&w, APS, sizeof(APS)/sizeof(APS[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_finish(&w));
+    TEST_ASSERT_EQUAL_STRING(ref, out);
+    TEST_ASSERT_GREATER_THAN(10, chunks);
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"ssid\":\"Cafe \\\"Guest\\\"\""));
+}
+
+void test_overflow_and_errors_latch(void) {
+    char buf[32]; opdi_json_t w;
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    write_aps(&w, APS, sizeof(APS)/sizeof(APS[0]));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, opdi_json_finish(&w)); // never a silently truncated document
+    char scratch[16];
+    opdi_json_init(&w, scratch, sizeof(scratch), fail_sink, NULL);
+    write_aps(&w, APS, sizeof(APS)/sizeof(APS[0]));
+    TEST_ASSERT_EQUAL(ESP_FAIL, opdi_json_finish(&w));              // client went away mid-response
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_obj_begin(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_json_finish(&w)); // unbalanced
+    opdi_json_init(&w, buf, sizeof(buf), NULL, NULL);
+    opdi_json_arr_end(&w);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_json_finish(&w));
+}
+
+void test_writer_benchmark(void) {
+    static ap_t many[32];
+    for (int i=0; i<32; i++) many[i] = (ap_t){ "neighbour-network", -40 - i, 3, (unsigned)(1 + i % 13) };
+    const int iters = 2000;
+    char scratch[256]; opdi_json_t w;
+    clock_t t0 = clock();
+    for (int k=0; k<iters; k++){
+        out_len = 0;
+        opdi_json_init(&w, scratch, sizeof(scratch), collect, NULL);
+        write_aps(&w, many, 32);
+        opdi_json_finish(&w);
+    }
+    double us_writer = (double)(clock() - t0) * 1e6 / CLOCKS_PER_SEC / iters;
+    size_t writer_len = out_len;
+    // The builder it replaced: snprintf per entry into a static buffer, no escaping
+    static char json[4096];
+    t0 = clock();
+    for (int k=0; k<iters; k++){
+        size_t len = 0; json[len++] = '[';
+        for (int i=0; i<32; i++){
+            char entry[160];
+            int n = snprintf(entry, sizeof(entry), "{\"ssid\":\"%.*s\",\"rssi\":%d,\"auth\":%u,\"ch\":%u},", 32, many[i].ssid, many[i].rssi, many[i].auth, many[i].ch);
+            if (len + (size_t)n >= sizeof(json) - 2) break;
+            memcpy(json + len, entry, n); len += n;
+        }
+        json[len - 1] = ']';
+    }
+    double us_snprintf = (double)(clock() - t0) * 1e6 / CLOCKS_PER_SEC / iters;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "32-AP list (%u B): writer %.1f us (256 B scratch), snprintf builder %.1f us (4 KiB buffer)",
+        (unsigned)writer_len, us_writer, us_snprintf);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(ESP_OK, w.err);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commas_nesting_and_scalars);
+    RUN_TEST(test_string_escaping);
+    RUN_TEST(test_tiny_scratch_streams_identical_output);
+    RUN_TEST(test_overflow_and_errors_latch);
+    RUN_TEST(test_writer_benchmark);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
@@ -0,0 +1,224 @@
+#include "unity.h"
+#include "opdi_api_json.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Request body binding: typed fields, strict validation with the offending key reported, size
+// limits instead of truncation, and parse time / heap high-water against cJSON.
+
+typedef struct {
+    char ssid[33];
+    char psk[65];
+    uint8_t auth;
+    bool hidden;
+    int8_t level;
+    int32_t offset;
+    uint16_t y_low, y_high;
+    int mode;
+} body_t;
+
+static const char *const k_modes[] = { [0] = "auto", [1] = "on", [3] = "off" };
+static const opdi_json_field_t k_thresh[] = {
+    OPDI_JSON_UINT(body_t, y_low, "y_low"),
+    OPDI_JSON_UINT(body_t, y_high, "y_high"),
+};
+static const opdi_json_field_t k_fields[] = {
+    OPDI_JSON_STR(body_t, ssid, "ssid"),
+    OPDI_JSON_STR(body_t, psk, "psk"),
+    OPDI_JSON_UINT(body_t, auth, "auth"),
+    OPDI_JSON_BOOL(body_t, hidden, "hidden"),
+    OPDI_JSON_INT(body_t, level, "level"),
+    OPDI_JSON_INT(body_t, offset, "offset"),
+    OPDI_JSON_ENUM(body_t, mode, "mode", k_modes),
+    OPDI_JSON_OBJ("thresh", k_thresh),
+};
+
+static esp_err_t bind(const char *js, body_t *b, uint32_t *seen, const char **bad){
+    return opdi_json_bind(js, strlen(js), OPDI_JSON_FIELDS(k_fields), b, seen, bad);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_binds_typed_fields(void) {
+    body_t b = { .auth = 9, .mode = 1 };
+    uint32_t seen; const char *bad;
+    const char *js = " { \"ssid\" : \"home\", \"hidden\":true, \"auth\":3, \"level\":-128, \"offset\":-2147483648,"
+                     " \"unknown\":{\"a\":[1,2,{\"b\":null}]}, \"psk\":null, \"mode\":\"off\","
+                     " \"thresh\":{\"y_high\":65535,\"y_low\":0} }\n";
+    TEST_ASSERT_EQUAL(ESP_OK, bind(js, &b, &seen, &bad));
+    TEST_ASSERT_EQUAL_STRING("home", b.ssid);
+    TEST_ASSERT_EQUAL_STRING("", b.psk);
+    TEST_ASSERT_TRUE(b.hidden);
+    TEST_ASSERT_EQUAL_UINT8(3, b.auth);
+    TEST_ASSERT_EQUAL(-128, b.level);
+    TEST_ASSERT_EQUAL(INT32_MIN, b.offset);
+    TEST_ASSERT_EQUAL(3, b.mode);
+    TEST_ASSERT_EQUAL(65535, b.y_high);
+    // psk was null: untouched and not reported as seen
+    TEST_ASSERT_EQUAL_HEX32(0xFD, seen);
+}
+
+void test_string_unescape(void) {
+    body_t b = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, bind("{\"ssid\":\"a\\\"b\\\\c\\/d\\n\\u00e9\\u20ac\\ud83d\\ude00\"}", &b, NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\n\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", b.ssid);
+    const char *bad;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bind("{\"ssid\":\"\\u0000\"}", &b, NULL, &bad));   // no embedded NUL
+    TEST_ASSERT_EQUAL_STRING("ssid", bad);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bind("{\"ssid\":\"\\ud83d\"}", &b, NULL, &bad));   // lone surrogate
+}
+
+void test_rejects_instead_of_truncating(void) {
+    body_t b = {0}; const char *bad;
+    char js[128];
+    snprintf(js, sizeof(js), "{\"ssid\":\"%s\"}", "0123456789abcdef0123456789abcdef"); // 32: fits
+    TEST_ASSERT_EQUAL(ESP_OK, bind(js, &b, NULL, &bad));
+    snprintf(js, sizeof(js), "{\"ssid\":\"%s\"}", "0123456789abcdef0123456789abcdefX");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, bind(js, &b, NULL, &bad));
+    TEST_ASSERT_EQUAL_STRING("ssid", bad);
+    static const struct { const char *js, *key; } cases[] = {
+        { "{\"auth\":256}", "auth" }, { "{\"auth\":-1}", "auth" }, { "{\"level\":128}", "level" },
+        { "{\"level\":-129}", "level" }, { "{\"offset\":2147483648}", "offset" }, { "{\"auth\":1.5}", "auth" },
+        { "{\"auth\":1e2}", "auth" }, { "{\"auth\":\"3\"}", "auth" }, { "{\"hidden\":1}", "hidden" },
+        { "{\"ssid\":5}", "ssid" }, { "{\"mode\":\"sometimes\"}", "mode" }, { "{\"mode\":\"\"}", "mode" },
+        { "{\"thresh\":{\"y_low\":70000}}", "y_low" }, { "{\"thresh\":[]}", "thresh" },
+        { "{\"auth\":99999999999999999999999}", "auth" },
+    };
+    for (size_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+        TEST_ASSERT_EQUAL_MESSAGE(ESP_ERR_INVALID_ARG, bind(cases[i].js, &b, NULL, &bad), cases[i].js);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(cases[i].key, bad, cases[i].js);
+    }
+}
+
+void test_rejects_malformed_documents(void) {
+    static const char *const bad_docs[] = {
+        "", "   ", "[]", "\"x\"", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{,}", "{\"a\":1}x", "{\"a\":01}",
+        "{\"a\":-}", "{\"a\":tru}", "{\"a\":\"\\x\"}", "{\"a\":\"\\u12G4\"}", "{\"a\":\"tab\there\"}", "{'a':1}",
+        "{\"a\":1 \"b\":2}", "{\"a\":[1,2}", "{\"a\":[[[[[[[[[]]]]]]]]]}",
+    };
+    body_t b = {0}; const char *bad = "x";
+    for (size_t i=0; i<sizeof(bad_docs)/sizeof(bad_docs[0]); i++) {
+        TEST_ASSERT_EQUAL_MESSAGE(ESP_ERR_INVALID_ARG, bind(bad_docs[i], &b, NULL, &bad), bad_docs[i]);
+        TEST_ASSERT_NULL(bad);
+    }
+    // Token budget is a hard limit, not a truncation point
+    char js[512]; size_t n = 0;
+    n += snprintf(js + n, sizeof(js) - n, "{\"a\":[");
+    for (int i=0; i<OPDI_JSON_MAX_TOKENS; i++) n += snprintf(js + n, sizeof(js) - n, "%s0", i ? "," : "");
+    snprintf(js + n, sizeof(js) - n, "]}");
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, bind(js, &b, NULL, &bad));
+}
+
+void test_tokenizer_layout(void) {
+    opdi_json_tok_t t[8]; size_t n = 0;
+    const char *js = "{\"a\":[1,true],\"b\":\"x\"}";
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_json_tokenize(js, strlen(js), t, 8, &n));
+    TEST_ASSERT_EQUAL(7, n);
+    TEST_ASSERT_EQUAL(OPDI_JSON_OBJ, t[0].type); TEST_ASSERT_EQUAL(7, t[0].next); TEST_ASSERT_EQUAL(strlen(js), t[0].len);
+    TEST_ASSERT_EQUAL(OPDI_JSON_ARR, t[2].type); TEST_ASSERT_EQUAL(5, t[2].next);   // skips its two children
+    TEST_ASSERT_EQUAL(OPDI_JSON_PRIM, t[4].type); TEST_ASSERT_EQUAL(4, t[4].len);
+    TEST_ASSERT_EQUAL(OPDI_JSON_STR, t[6].type); TEST_ASSERT_EQUAL('x', js[t[6].start]);
+}
+
+// ---- Benchmark against cJSON (the parser these handlers used before) ----
+
+static size_t s_heap_cur, s_heap_peak, s_allocs;
+static void *count_malloc(size_t sz){
+    size_t *p = malloc(sz + sizeof(size_t)); if (!p) return NULL;
+    *p = sz; s_heap_cur += sz; s_allocs++;
+    if (s_heap_cur > s_heap_peak) s_heap_peak = s_heap_cur;
+    return p + 1;
+}
+static void count_free(void *ptr){ if (!ptr) return; size_t *p = (size_t *)ptr - 1; s_heap_cur -= *p; free(p); }
+
+typedef struct { uint8_t profile, fps, jpeg_q; bool ae_lock, flip, mirror; uint32_t exposure_us; uint16_t agc_gain, y_low, y_high, h_on, h_off; int ir_mode; } cam_body_t;
+static const char *const k_profiles[] = { "240p", "480p", "720p" };
+static const char *const k_ir[] = { "auto", "on", "off" };
+static const opdi_json_field_t k_cam_ir[] = {
+    OPDI_JSON_UINT(cam_body_t, y_low, "y_low"), OPDI_JSON_UINT(cam_body_t, y_high, "y_high"),
+    OPDI_JSON_UINT(cam_body_t, h_on, "hyst_on_ms"), OPDI_JSON_UINT(cam_body_t, h_off, "hyst_off_ms"),
+};
+static const opdi_json_field_t k_cam[] = {
+    OPDI_JSON_ENUM(cam_body_t, profile, "profile", k_profiles), OPDI_JSON_UINT(cam_body_t, fps, "fps"),
+    OPDI_JSON_UINT(cam_body_t, jpeg_q, "jpeg_q"), OPDI_JSON_BOOL(cam_body_t, ae_lock, "ae_lock"),
+    OPDI_JSON_UINT(cam_body_t, exposure_us, "exposure_us"), OPDI_JSON_UINT(cam_body_t, agc_gain, "agc_gain"),
+    OPDI_JSON_BOOL(cam_body_t, flip, "flip"), OPDI_JSON_BOOL(cam_body_t, mirror, "mirror"),
+    OPDI_JSON_ENUM(cam_body_t, ir_mode, "ir_mode", k_ir), OPDI_JSON_OBJ("ir_thresh", k_cam_ir),
+};
+static const char k_cam_body[] = "{\"profile\":\"720p\",\"fps\":25,\"jpeg_q\":80,\"ae_lock\":false,\"exposure_us\":20000,"
+    "\"agc_gain\":16,\"flip\":true,\"mirror\":false,\"ir_mode\":\"auto\","
+    "\"ir_thresh\":{\"y_low\":40,\"y_high\":90,\"hyst_on_ms\":1500,\"hyst_off_ms\":3000}}";
+
+// What cam_config_put did per request with cJSON
+static void cjson_cam(const char *js, cam_body_t *c){
+    cJSON *root = cJSON_Parse(js);
+    if (!root) return;
+    cJSON *j = cJSON_GetObjectItemCaseSensitive(root, "profile");
+    if (cJSON_IsString(j)) c->profile = !strcmp(j->valuestring, "720p") ? 2 : !strcmp(j->valuestring, "240p") ? 0 : 1;
+    if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(root, "fps"))) c->fps = (uint8_t)j->valuedouble;
+    if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(root, "jpeg_q"))) c->jpeg_q = (uint8_t)j->valuedouble;
+    if (cJSON_IsBool(j = cJSON_GetObjectItemCaseSensitive(root, "ae_lock"))) c->ae_lock = cJSON_IsTrue(j);
+    if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(root, "exposure_us"))) c->exposure_us = (uint32_t)j->valuedouble;
+    if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(root, "agc_gain"))) c->agc_gain = (uint16_t)j->valuedouble;
+    if (cJSON_IsBool(j = cJSON_GetObjectItemCaseSensitive(root, "flip"))) c->flip = cJSON_IsTrue(j);
+    if (cJSON_IsBool(j = cJSON_GetObjectItemCaseSensitive(root, "mirror"))) c->mirror = cJSON_IsTrue(j);
+    if (cJSON_IsString(j = cJSON_GetObjectItemCaseSensitive(root, "ir_mode"))) c->ir_mode = !strcmp(j->valuestring, "on") ? 1 : !strcmp(j->valuestring, "off") ? 2 : 0;
+    cJSON *t = cJSON_GetObjectItemCaseSensitive(root, "ir_thresh");
+    if (cJSON_IsObject(t)) {
+        if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(t, "y_low"))) c->y_low = (uint16_t)j->valuedouble;
+        if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(t, "y_high"))) c->y_high = (uint16_t)j->valuedouble;
+        if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(t, "hyst_on_ms"))) c->h_on = (uint16_t)j->valuedouble;
+        if (cJSON_IsNumber(j = cJSON_GetObjectItemCaseSensitive(t, "hyst_off_ms"))) c->h_off = (uint16_t)j->valuedouble;
+    }
+    cJSON_Delete(root);
+}
+
+void test_bind_vs_cjson_benchmark(void) {
+    const int iters = 5000;
+    cam_body_t a = {0}, b = {0};
+    cJSON_Hooks hooks = { .malloc_fn = count_malloc, .free_fn = count_free };
+    cJSON_InitHooks(&hooks);
+    s_heap_cur = s_heap_peak = s_allocs = 0;
+    clock_t t0 = clock();
+    for (int i=0; i<iters; i++) cjson_cam(k_cam_body, &a);
+    double us_cjson = (double)(clock() - t0) * 1e6 / CLOCKS_PER_SEC / iters;
+    cJSON_InitHooks(NULL);
+    size_t peak = s_heap_peak, allocs = s_allocs / iters;
+    TEST_ASSERT_EQUAL(0, s_heap_cur);
+
+    t0 = clock();
+    for (int i=0; i<iters; i++) TEST_ASSERT_EQUAL(ESP_OK, opdi_json_bind(k_cam_body, sizeof(k_cam_body) - 1, OPDI_JSON_FIELDS(k_cam), &b, NULL, NULL));
+    double us_bind = (double)(clock() - t0) * 1e6 / CLOCKS_PER_SEC / iters;
+    TEST_ASSERT_EQUAL_MEMORY(&a, &b, sizeof(a));
+
+    char msg[192];
+    snprintf(msg, sizeof(msg), "cam PUT (%u B): cJSON %.2f us, %u allocs, heap peak %u B | bind %.2f us, 0 allocs, %u B token stack",
+             (unsigned)(sizeof(k_cam_body) - 1), us_cjson, (unsigned)allocs, (unsigned)peak, us_bind,
+             (unsigned)(OPDI_JSON_MAX_TOKENS * sizeof(opdi_json_tok_t)));
+    TEST_MESSAGE(msg);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_binds_typed_fields);
+    RUN_TEST(test_string_unescape);
+    RUN_TEST(test_rejects_instead_of_truncating);
+    RUN_TEST(test_rejects_malformed_documents);
+    RUN_TEST(test_tokenizer_layout);
+    RUN_TEST(test_bind_vs_cjson_benchmark);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
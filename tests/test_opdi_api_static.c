@@ -0,0 +1,75 @@
+#include "unity.h"
+#include "opdi_api_static.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+// Web UI assets: the build-time gzip table and If-None-Match evaluation behind the 304 path.
+
+static const char *const k_assets[] = { "index.html", "app.js", "style.css" };
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_etag_match_forms(void) {
+    const char *tag = "\"0123456789abcdef\"";
+    TEST_ASSERT_TRUE(opdi_api_static_etag_match("\"0123456789abcdef\"", tag));
+    TEST_ASSERT_TRUE(opdi_api_static_etag_match("W/\"0123456789abcdef\"", tag));
+    TEST_ASSERT_TRUE(opdi_api_static_etag_match("\"aaaa\", \"0123456789abcdef\"", tag));
+    TEST_ASSERT_TRUE(opdi_api_static_etag_match("*", tag));
+    TEST_ASSERT_TRUE(opdi_api_static_etag_match(" *", tag));
+    TEST_ASSERT_FALSE(opdi_api_static_etag_match("\"0123456789abcdee\"", tag));
+    TEST_ASSERT_FALSE(opdi_api_static_etag_match("\"0123456789abcdef0\"", tag)); // longer tag, not ours
+    TEST_ASSERT_FALSE(opdi_api_static_etag_match("", tag));
+    TEST_ASSERT_FALSE(opdi_api_static_etag_match(NULL, tag));
+}
+
+void test_embedded_assets_are_gzip_with_strong_etags(void) {
+#if CONFIG_OPDI_API_WEB_EMBED
+    const char *tags[3];
+    size_t raw_total = 0, gz_total = 0;
+    for (int i=0; i<3; i++) {
+        const uint8_t *gz; size_t gz_len, raw_len;
+        tags[i] = opdi_api_static_test_asset(k_assets[i], &gz, &gz_len, &raw_len);
+        TEST_ASSERT_NOT_NULL_MESSAGE(tags[i], k_assets[i]);
+        // gzip member header, deflate, no mtime (reproducible builds keep the ETag)
+        TEST_ASSERT_EQUAL_HEX8(0x1f, gz[0]);
+        TEST_ASSERT_EQUAL_HEX8(0x8b, gz[1]);
+        TEST_ASSERT_EQUAL_HEX8(8, gz[2]);
+        TEST_ASSERT_EQUAL(0, gz[4] | gz[5] | gz[6] | gz[7]);
+        // ISIZE trailer is the uncompressed length
+        size_t isize = gz[gz_len - 4] | (gz[gz_len - 3] << 8) | (gz[gz_len - 2] << 16) | ((size_t)gz[gz_len - 1] << 24);
+        TEST_ASSERT_EQUAL(raw_len, isize);
+        TEST_ASSERT_LESS_THAN(raw_len, gz_len);
+        // Strong: quoted, no W/ prefix
+        TEST_ASSERT_EQUAL('"', tags[i][0]);
+        TEST_ASSERT_EQUAL('"', tags[i][strlen(tags[i]) - 1]);
+        raw_total += raw_len; gz_total += gz_len;
+    }
+    TEST_ASSERT_TRUE(strcmp(tags[0], tags[1]) && strcmp(tags[1], tags[2]) && strcmp(tags[0], tags[2]));
+    TEST_ASSERT_NULL(opdi_api_static_test_asset("missing.js", NULL, NULL, NULL));
+    char msg[96];
+    snprintf(msg, sizeof(msg), "web UI: %u B -> %u B gzip (%u%%)", (unsigned)raw_total, (unsigned)gz_total, (unsigned)(gz_total * 100 / raw_total));
+    TEST_MESSAGE(msg);
+#else
+    TEST_IGNORE_MESSAGE("CONFIG_OPDI_API_WEB_EMBED disabled");
+#endif
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_etag_match_forms);
+    RUN_TEST(test_embedded_assets_are_gzip_with_strong_etags);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
@@ -0,0 +1,114 @@
+#include "unity.h"
+#include "opdi_api_ws.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// WS event bus: ordering, batching into JSON arrays, coalescing of snapshot topics and drop-newest
+// when full. The sender task is not started here, so frames are pulled with the test hook exactly
+// as the sender would build them.
+
+static char frame[CONFIG_OPDI_API_WS_QUEUE_BYTES + 64];
+
+static esp_err_t pub(const char *topic, const char *json){ return opdi_api_ws_publish(topic, json, strlen(json)); }
+static void drain(void){ while (opdi_api_ws_test_next_frame(NULL, 0)) { } }
+
+void setUp(void) {
+    drain();
+}
+
+void tearDown(void) {
+}
+
+void test_single_event_sent_unchanged(void) {
+    opdi_api_ws_broadcast("{\"type\":\"net\",\"sub\":\"ap_active\"}", 33);
+    TEST_ASSERT_EQUAL(33, opdi_api_ws_test_next_frame(frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"net\",\"sub\":\"ap_active\"}", frame);
+    TEST_ASSERT_EQUAL(0, opdi_api_ws_test_next_frame(frame, sizeof(frame)));
+}
+
+void test_burst_batched_in_order(void) {
+    opdi_api_ws_stats_t before; opdi_api_ws_get_stats(&before);
+    TEST_ASSERT_EQUAL(ESP_OK, pub(NULL, "{\"n\":1}"));
+    TEST_ASSERT_EQUAL(ESP_OK, pub(NULL, "{\"n\":2}"));
+    TEST_ASSERT_EQUAL(ESP_OK, pub(NULL, "{\"n\":3}"));
+    opdi_api_ws_test_next_frame(frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_STRING("[{\"n\":1},{\"n\":2},{\"n\":3}]", frame);
+    opdi_api_ws_stats_t st; opdi_api_ws_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(before.frames + 1, st.frames);
+    TEST_ASSERT_EQUAL_UINT32(before.batched + 3, st.batched);
+}
+
+void test_snapshot_topics_coalesce(void) {
+    char js[64];
+    pub(NULL, "{\"type\":\"cam.state\",\"state\":2}");
+    for (int i=0; i<5; i++) { snprintf(js, sizeof(js), "{\"type\":\"cam.telemetry\",\"fps\":%d}", 20 + i); pub("cam.telemetry", js); }
+    pub("net.metrics", "{\"type\":\"net\",\"sub\":\"metrics\",\"scans\":1}");
+    pub(NULL, "{\"type\":\"net\",\"sub\":\"sta_disconnected\"}");
+    pub("net.metrics", "{\"type\":\"net\",\"sub\":\"metrics\",\"scans\":2}");
+    opdi_api_ws_stats_t st; opdi_api_ws_get_stats(&st);
+    TEST_ASSERT_EQUAL(4, st.queued);
+    opdi_api_ws_test_next_frame(frame, sizeof(frame));
+    // Latest telemetry/metrics, each at the position of the first queued sample
+    TEST_ASSERT_EQUAL_STRING("[{\"type\":\"cam.state\",\"state\":2},{\"type\":\"cam.telemetry\",\"fps\":24},"
+                             "{\"type\":\"net\",\"sub\":\"metrics\",\"scans\":2},{\"type\":\"net\",\"sub\":\"sta_disconnected\"}]", frame);
+}
+
+void test_batches_respect_frame_cap(void) {
+    char js[256], big[CONFIG_OPDI_API_WS_BATCH_BYTES + 100];
+    const int events = 24; // ~190 B each: several frames
+    for (int i=0; i<events; i++) { snprintf(js, sizeof(js), "{\"type\":\"log\",\"seq\":%d,\"pad\":\"%0160d\"}", i, 0); pub(NULL, js); }
+    memset(big, 'x', sizeof(big)); memcpy(big, "{\"a\":\"", 6); memcpy(big + sizeof(big) - 3, "\"}", 3);
+    pub(NULL, big);
+    int frames = 0, next_seq = 0; size_t len; bool saw_big = false;
+    while ((len = opdi_api_ws_test_next_frame(frame, sizeof(frame))) != 0) {
+        frames++;
+        if (len == strlen(big)) { saw_big = true; TEST_ASSERT_EQUAL('{', frame[0]); continue; } // oversize event goes alone
+        TEST_ASSERT_LESS_OR_EQUAL(CONFIG_OPDI_API_WS_BATCH_BYTES, len);
+        for (const char *p = frame; (p = strstr(p, "\"seq\":")) != NULL; p++) TEST_ASSERT_EQUAL(next_seq++, atoi(p + 6));
+    }
+    TEST_ASSERT_EQUAL(events, next_seq);
+    TEST_ASSERT_TRUE(saw_big);
+    TEST_ASSERT_GREATER_THAN(2, frames);
+}
+
+void test_full_queue_drops_newest_without_blocking(void) {
+    opdi_api_ws_stats_t before; opdi_api_ws_get_stats(&before);
+    char js[48]; int rejected = 0;
+    int64_t t0 = esp_timer_get_time();
+    for (int i=0; i<CONFIG_OPDI_API_WS_QUEUE_LEN + 8; i++) {
+        snprintf(js, sizeof(js), "{\"seq\":%d}", i);
+        if (pub(NULL, js) == ESP_ERR_NO_MEM) rejected++;
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    TEST_ASSERT_EQUAL(8, rejected);
+    opdi_api_ws_stats_t st; opdi_api_ws_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(before.dropped + 8, st.dropped);
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_API_WS_QUEUE_LEN, st.queue_hw);
+    // The oldest events survive
+    opdi_api_ws_test_next_frame(frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(0, strncmp(frame, "[{\"seq\":0},{\"seq\":1},", 21));
+    char msg[96];
+    snprintf(msg, sizeof(msg), "publish: %.2f us/event (%d events incl. %d rejected)",
+             (double)us / (CONFIG_OPDI_API_WS_QUEUE_LEN + 8), CONFIG_OPDI_API_WS_QUEUE_LEN + 8, rejected);
+    TEST_MESSAGE(msg);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_event_sent_unchanged);
+    RUN_TEST(test_burst_batched_in_order);
+    RUN_TEST(test_snapshot_topics_coalesce);
+    RUN_TEST(test_batches_respect_frame_cap);
+    RUN_TEST(test_full_queue_drops_newest_without_blocking);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
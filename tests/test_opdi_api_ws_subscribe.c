@@ -0,0 +1,224 @@
+#include "unity.h"
+#include "opdi_api_ws.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// /ws subscriptions: per-client channel filters, binary records for the high-rate channels, JSON
+// rendering of the same records for text clients, and frames shared between clients with the same
+// subscription. Clients are fake fds; the test pump stands in for httpd.
+
+#define MAX_CAP 16
+
+typedef struct {
+    int fd;
+    bool binary;
+    size_t len;
+    uint8_t data[1024];
+} cap_t;
+
+static cap_t caps[MAX_CAP];
+static int n_caps;
+
+static void capture(int fd, bool binary, const uint8_t *data, size_t len){
+    TEST_ASSERT_LESS_THAN(MAX_CAP, n_caps);
+    cap_t *c = &caps[n_caps++];
+    c->fd = fd; c->binary = binary; c->len = len < sizeof(c->data) ? len : sizeof(c->data) - 1;
+    memcpy(c->data, data, c->len); c->data[c->len] = 0;
+}
+
+static const cap_t *find_cap(int fd, bool binary){
+    for (int i=0; i<n_caps; i++) if (caps[i].fd == fd && caps[i].binary == binary) return &caps[i];
+    return NULL;
+}
+
+static void pub(const char *topic, const char *json){ TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_publish(topic, json, strlen(json))); }
+
+static void pub_detect(uint32_t t, int count){
+    opdi_ws_detect_hdr_t h = { .t_ms = t, .img_w = 640, .img_h = 480, .model = 1, .count = (uint8_t)count };
+    opdi_ws_box_t b[OPDI_WS_DETECT_MAX_BOXES];
+    for (int i=0; i<count; i++) b[i] = (opdi_ws_box_t){ .x = (int16_t)(10 * i), .y = 20, .w = 100, .h = 120, .score = 90, .cls = 0 };
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_publish_bin(OPDI_WS_CH_DETECT, &h, sizeof(h), b, count * sizeof(b[0])));
+}
+
+void setUp(void) {
+    for (int fd=10; fd<10 + CONFIG_OPDI_API_WS_MAX_CLIENTS; fd++) opdi_api_ws_test_client_remove(fd);
+    while (opdi_api_ws_test_next_frame(NULL, 0)) { }
+    n_caps = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_each_client_gets_its_channels(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(11, "{\"type\":\"sub\",\"topics\":[\"net\"]}"));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(12, "{\"type\":\"sub\",\"topics\":[\"net\",\"detect\"],\"binary\":true}"));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(13, "{\"type\":\"sub\",\"topics\":[\"detect\"]}"));
+    pub(NULL, "{\"type\":\"net\",\"sub\":\"ap_active\"}");
+    pub("cam.telemetry", "{\"type\":\"cam.telemetry\",\"fps\":25}");
+    pub_detect(1234, 2);
+    opdi_api_ws_test_pump(capture);
+
+    // Default subscription: everything but the high-rate channels
+    TEST_ASSERT_EQUAL_STRING("[{\"type\":\"net\",\"sub\":\"ap_active\"},{\"type\":\"cam.telemetry\",\"fps\":25}]", (char *)find_cap(10, false)->data);
+    TEST_ASSERT_NULL(find_cap(10, true));
+    // Lone event: sent unchanged
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"net\",\"sub\":\"ap_active\"}", (char *)find_cap(11, false)->data);
+    // Binary subscriber: JSON events as text, the detection record as-is in a binary frame
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"net\",\"sub\":\"ap_active\"}", (char *)find_cap(12, false)->data);
+    const cap_t *b = find_cap(12, true);
+    TEST_ASSERT_NOT_NULL(b);
+    size_t plen = sizeof(opdi_ws_detect_hdr_t) + 2 * sizeof(opdi_ws_box_t);
+    TEST_ASSERT_EQUAL(OPDI_WS_REC_HDR_LEN + plen, b->len);
+    TEST_ASSERT_EQUAL(OPDI_WS_CH_DETECT, b->data[0]);
+    TEST_ASSERT_EQUAL(plen, b->data[2] | (b->data[3] << 8));
+    opdi_ws_detect_hdr_t h; memcpy(&h, b->data + OPDI_WS_REC_HDR_LEN, sizeof(h));
+    TEST_ASSERT_EQUAL_UINT32(1234, h.t_ms);
+    TEST_ASSERT_EQUAL(2, h.count);
+    // Text subscriber to the same channel: rendered JSON
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"detect\",\"t\":1234,\"w\":640,\"h\":480,\"model\":1,"
+                             "\"boxes\":[[0,20,100,120,90,0],[10,20,100,120,90,0]]}", (char *)find_cap(13, false)->data);
+    TEST_ASSERT_NULL(find_cap(13, true));
+    TEST_ASSERT_EQUAL(5, n_caps);
+}
+
+void test_same_subscription_shares_frames(void) {
+    for (int fd=10; fd<13; fd++) TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(fd, "{\"type\":\"sub\",\"topics\":[\"*\"]}"));
+    opdi_api_ws_stats_t before; opdi_api_ws_get_stats(&before);
+    pub(NULL, "{\"type\":\"cam.state\",\"state\":2}");
+    pub_detect(1, 1);
+    TEST_ASSERT_EQUAL(1, opdi_api_ws_test_pump(capture));
+    TEST_ASSERT_EQUAL(3, n_caps);
+    opdi_api_ws_stats_t st; opdi_api_ws_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(before.frames + 1, st.frames);
+    TEST_ASSERT_EQUAL_UINT32(before.rendered + 1, st.rendered); // rendered once, not per client
+}
+
+void test_records_coalesce_per_channel(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"detect\",\"audio.level\"],\"binary\":true}"));
+    for (uint32_t t=1; t<=5; t++) pub_detect(t, 3);
+    opdi_ws_level_hdr_t lh = { .t_ms = 7, .source = 0, .count = 4 };
+    const uint8_t lv[4] = { 12, 40, 3, 0 };
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_publish_bin(OPDI_WS_CH_AUDIO_LEVEL, &lh, sizeof(lh), lv, sizeof(lv)));
+    opdi_api_ws_stats_t st; opdi_api_ws_get_stats(&st);
+    TEST_ASSERT_EQUAL(2, st.queued);
+    opdi_api_ws_test_pump(capture);
+    const cap_t *b = find_cap(10, true);
+    TEST_ASSERT_NOT_NULL(b);
+    // Both records back to back in one binary frame; the detection one is the newest
+    size_t dlen = OPDI_WS_REC_HDR_LEN + sizeof(opdi_ws_detect_hdr_t) + 3 * sizeof(opdi_ws_box_t);
+    TEST_ASSERT_EQUAL(dlen + OPDI_WS_REC_HDR_LEN + sizeof(lh) + sizeof(lv), b->len);
+    opdi_ws_detect_hdr_t h; memcpy(&h, b->data + OPDI_WS_REC_HDR_LEN, sizeof(h));
+    TEST_ASSERT_EQUAL_UINT32(5, h.t_ms);
+    TEST_ASSERT_EQUAL(OPDI_WS_CH_AUDIO_LEVEL, b->data[dlen]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(lv, b->data + dlen + OPDI_WS_REC_HDR_LEN + sizeof(lh), sizeof(lv));
+    TEST_ASSERT_NULL(find_cap(10, false));
+}
+
+void test_bad_subscription_keeps_previous(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"cam.ir\"]}"));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"bogus\"]}"));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":\"net\"}"));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"binary\":1}"));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, opdi_api_ws_test_client(10, "{\"type\":\"ping\",\"topics\":[\"net\"]}"));
+    // Reconnect on the same fd resets to the default subscription; re-apply
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"cam.ir\"]}"));
+    pub(NULL, "{\"type\":\"net\",\"sub\":\"ap_active\"}");
+    pub("cam.ir", "{\"type\":\"cam.ir\",\"mode\":1,\"active\":true}");
+    opdi_api_ws_test_pump(capture);
+    TEST_ASSERT_EQUAL(1, n_caps);
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"cam.ir\",\"mode\":1,\"active\":true}", (char *)caps[0].data);
+}
+
+void test_detect_binary_vs_json_cost(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"detect\"],\"binary\":true}"));
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(11, "{\"type\":\"sub\",\"topics\":[\"detect\"]}"));
+    const int iters = 200, boxes = 8;
+    size_t bin_bytes = 0, json_bytes = 0;
+    int64_t t_bin = 0, t_json = 0;
+    for (int i=0; i<iters; i++) {
+        // Binary-only delivery cost
+        opdi_api_ws_test_client_remove(11);
+        n_caps = 0;
+        int64_t t0 = esp_timer_get_time();
+        pub_detect((uint32_t)i, boxes);
+        opdi_api_ws_test_pump(capture);
+        t_bin += esp_timer_get_time() - t0;
+        bin_bytes += find_cap(10, true)->len;
+        // Text-only delivery cost (renders the record)
+        opdi_api_ws_test_client_remove(10);
+        opdi_api_ws_test_client(11, "{\"type\":\"sub\",\"topics\":[\"detect\"]}");
+        n_caps = 0;
+        t0 = esp_timer_get_time();
+        pub_detect((uint32_t)i, boxes);
+        opdi_api_ws_test_pump(capture);
+        t_json += esp_timer_get_time() - t0;
+        json_bytes += find_cap(11, false)->len;
+        opdi_api_ws_test_client(10, "{\"type\":\"sub\",\"topics\":[\"detect\"],\"binary\":true}");
+    }
+    TEST_ASSERT_LESS_THAN(json_bytes / 2, bin_bytes);
+    char msg[160];
+    snprintf(msg, sizeof(msg), "detect %d boxes: binary %u B %.2f us/frame, json %u B %.2f us/frame",
+             boxes, (unsigned)(bin_bytes / iters), (double)t_bin / iters, (unsigned)(json_bytes / iters), (double)t_json / iters);
+    TEST_MESSAGE(msg);
+}
+
+static char tapped[512];
+static int n_tapped;
+
+static void tap(opdi_ws_channel_t ch, const char *json, size_t len){
+    n_tapped++;
+    snprintf(tapped, sizeof(tapped), "%d %.*s", (int)ch, (int)len, json);
+}
+
+void test_tap_sees_unsubscribed_events(void) {
+    // No client at all: the tap still gets its channels, binary records as JSON
+    opdi_api_ws_set_tap(OPDI_WS_CH_BIT(OPDI_WS_CH_RECOGNIZE) | OPDI_WS_CH_BIT(OPDI_WS_CH_DETECT), tap);
+    n_tapped = 0;
+    pub("recognize", "{\"type\":\"recognize\",\"faces\":[]}");
+    TEST_ASSERT_EQUAL(1, n_tapped);
+    TEST_ASSERT_EQUAL_STRING("6 {\"type\":\"recognize\",\"faces\":[]}", tapped);
+    pub(NULL, "{\"type\":\"net\",\"sub\":\"ap_active\"}");
+    TEST_ASSERT_EQUAL(1, n_tapped);
+    pub_detect(99, 1);
+    TEST_ASSERT_EQUAL(2, n_tapped);
+    TEST_ASSERT_EQUAL_STRING("4 {\"type\":\"detect\",\"t\":99,\"w\":640,\"h\":480,\"model\":1,"
+                             "\"boxes\":[[0,20,100,120,90,0]]}", tapped);
+    opdi_api_ws_set_tap(0, NULL);
+    pub_detect(100, 1);
+    TEST_ASSERT_EQUAL(2, n_tapped);
+}
+
+void test_closed_session_frees_client_slot(void) {
+    // Sessions httpd closes by itself go through the close hook: the slot is free for the next client
+    int fd = open("/dev/null", O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(fd, NULL));
+    for (int i=1; i<CONFIG_OPDI_API_WS_MAX_CLIENTS; i++) TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10 + i, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, opdi_api_ws_test_client(10, NULL));
+    opdi_api_ws_close_fn(NULL, fd);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_api_ws_test_client(10, NULL));
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_each_client_gets_its_channels);
+    RUN_TEST(test_same_subscription_shares_frames);
+    RUN_TEST(test_records_coalesce_per_channel);
+    RUN_TEST(test_bad_subscription_keeps_previous);
+    RUN_TEST(test_detect_binary_vs_json_cost);
+    RUN_TEST(test_tap_sees_unsubscribed_events);
+    RUN_TEST(test_closed_session_frees_client_slot);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
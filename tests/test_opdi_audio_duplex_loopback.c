@@ -0,0 +1,236 @@
+// Unity test for the duplex voice path. The wire format and the uplink ring are tested directly; on the host
+// the engine itself (opdi_audio_duplex_start/rx/stop) runs over the real-time codec stand-in: a burst spoken
+// into the fake mic goes capture -> uplink send -> simulated network -> opdi_audio_duplex_rx -> jitter
+// buffer -> mixer VOICE stream -> speaker, and the mouth-to-ear latency and the engine counters are measured.
+#include "unity.h"
+#include "opdi_audio.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME  OPDI_AUDIO_DUPLEX_FRAME_SAMPLES
+#define FMS    OPDI_AUDIO_DUPLEX_FRAME_MS
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_ws_frame_roundtrip(void) {
+	int16_t in[FRAME], out[FRAME];
+	for (int i=0; i<FRAME; i++) in[i] = (int16_t)(i * 97 - 15000);
+	uint8_t buf[OPDI_AUDIO_WS_FRAME_BYTES];
+	TEST_ASSERT_EQUAL_UINT32(OPDI_AUDIO_WS_FRAME_BYTES, opdi_audio_ws_frame_pack(0xBEEF, 0x12345678, in, FRAME, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_UINT8(0xEF, buf[0]);
+	opdi_audio_ws_hdr_t h; size_t n = 0;
+	TEST_ASSERT_TRUE(opdi_audio_ws_frame_parse(buf, sizeof(buf), &h, out, FRAME, &n));
+	TEST_ASSERT_EQUAL_UINT32(0xBEEF, h.seq);
+	TEST_ASSERT_EQUAL_UINT32(0x12345678, h.ts_ms);
+	TEST_ASSERT_EQUAL_MEMORY(in, out, sizeof(in));
+	TEST_ASSERT_FALSE(opdi_audio_ws_frame_parse(buf, 5, &h, out, FRAME, &n));            // short header
+	TEST_ASSERT_FALSE(opdi_audio_ws_frame_parse(buf, sizeof(buf) - 1, &h, out, FRAME, &n)); // odd payload
+	TEST_ASSERT_FALSE(opdi_audio_ws_frame_parse(buf, sizeof(buf), &h, out, FRAME - 1, &n)); // oversize
+}
+
+void test_spsc_full_and_empty(void) {
+	uint8_t mem[3 * 4], rec[4] = { 1, 2, 3, 4 }, got[4];
+	opdi_audio_spsc_t r;
+	opdi_audio_spsc_init(&r, mem, 4, 3);
+	TEST_ASSERT_FALSE(opdi_audio_spsc_pop(&r, got));
+	for (int i=0; i<3; i++){ rec[0] = (uint8_t)i; TEST_ASSERT_TRUE(opdi_audio_spsc_push(&r, rec)); }
+	TEST_ASSERT_FALSE(opdi_audio_spsc_push(&r, rec));
+	TEST_ASSERT_EQUAL_UINT32(3, opdi_audio_spsc_depth(&r));
+	for (int i=0; i<3; i++){ TEST_ASSERT_TRUE(opdi_audio_spsc_pop(&r, got)); TEST_ASSERT_EQUAL_UINT8(i, got[0]); }
+	TEST_ASSERT_EQUAL_UINT32(0, opdi_audio_spsc_depth(&r));
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+#ifndef CONFIG_OPDI_AUDIO_JITTER_TARGET_MS
+#define CONFIG_OPDI_AUDIO_JITTER_TARGET_MS 80
+#endif
+#define RUN_MS        1600
+#define MOUTH_AT_MS   600   // burst spoken once the jitter buffer is playing
+#define BURST_MS      5
+#define TARGET_FRAMES ((CONFIG_OPDI_AUDIO_JITTER_TARGET_MS + FMS - 1) / FMS)
+#define MAX_INFLIGHT  64
+
+typedef struct {
+	uint32_t base_ms, jitter_ms; // network delay = base + uniform(0..jitter)
+	uint32_t drop_every;         // drop every Nth uplink frame (0 = never)
+} net_cfg_t;
+
+typedef struct { int64_t arrive_us; uint8_t buf[OPDI_AUDIO_WS_FRAME_BYTES]; bool used; } pkt_t;
+
+// Simulated network between the uplink send callback and opdi_audio_duplex_rx
+static SemaphoreHandle_t net_lock;
+static pkt_t inflight[MAX_INFLIGHT];
+static net_cfg_t net;
+static uint32_t sent, dropped;
+static uint32_t lcg = 12345;
+static uint32_t rnd(void){ lcg = lcg * 1103515245u + 12345u; return (lcg >> 16) & 0x7FFF; }
+
+static volatile int64_t start_us, mouth_us, heard_us; // 0 = not yet
+static volatile bool speak;
+
+static esp_err_t net_send(const uint8_t *frame, size_t len, void *ctx){
+	(void)ctx;
+	TEST_ASSERT_EQUAL_UINT32(OPDI_AUDIO_WS_FRAME_BYTES, len);
+	xSemaphoreTake(net_lock, portMAX_DELAY);
+	sent++;
+	if (net.drop_every && sent % net.drop_every == 0) dropped++;
+	else for (int i=0; i<MAX_INFLIGHT; i++) if (!inflight[i].used){
+		uint32_t d = net.base_ms + (net.jitter_ms ? rnd() % (net.jitter_ms + 1) : 0);
+		inflight[i].arrive_us = esp_timer_get_time() + (int64_t)d * 1000;
+		memcpy(inflight[i].buf, frame, len);
+		inflight[i].used = true;
+		break;
+	}
+	xSemaphoreGive(net_lock);
+	return ESP_OK;
+}
+
+// Receiver side: deliver due frames every millisecond (reordering happens naturally with jitter)
+static void net_task(void *arg){
+	(void)arg;
+	static uint8_t buf[OPDI_AUDIO_WS_FRAME_BYTES];
+	while (1){
+		vTaskDelay(1);
+		for (int i=0; i<MAX_INFLIGHT; i++){
+			bool due = false;
+			xSemaphoreTake(net_lock, portMAX_DELAY);
+			if (inflight[i].used && inflight[i].arrive_us <= esp_timer_get_time()){
+				memcpy(buf, inflight[i].buf, sizeof(buf));
+				inflight[i].used = false;
+				due = true;
+			}
+			xSemaphoreGive(net_lock);
+			if (due) opdi_audio_duplex_rx(buf, sizeof(buf));
+		}
+	}
+}
+
+// Fake mic: silence, then one burst at the start of the first read after MOUTH_AT_MS. Called when the read
+// period is complete, so the burst was spoken one period ago.
+static void mic(int16_t *pcm, size_t frames, void *ctx){
+	(void)ctx;
+	memset(pcm, 0, frames * OPDI_AUDIO_FRAME_BYTES);
+	int64_t now = esp_timer_get_time();
+	if (!speak || mouth_us || now - start_us < MOUTH_AT_MS * 1000) return;
+	uint32_t rate = opdi_audio_mixer_rate();
+	size_t n = rate * BURST_MS / 1000;
+	for (size_t f=0; f<n && f<frames; f++){ pcm[2*f] = 8000; pcm[2*f + 1] = 8000; }
+	mouth_us = now - (int64_t)frames * 1000000 / rate;
+}
+
+static void spk(int16_t *pcm, size_t frames, void *ctx){
+	(void)ctx;
+	if (!mouth_us || heard_us) return;
+	uint32_t rate = opdi_audio_mixer_rate();
+	for (size_t f=0; f<frames; f++){
+		if (pcm[2*f] > 4000){ heard_us = esp_timer_get_time() + (int64_t)f * 1000000 / rate; break; }
+	}
+}
+
+typedef struct {
+	int32_t latency_ms;  // -1 if the burst never came out of the speaker
+	opdi_audio_duplex_stats_t st;
+} loop_result_t;
+
+static loop_result_t run_loopback(net_cfg_t cfg){
+	static TaskHandle_t net_th;
+	if (!net_lock) net_lock = xSemaphoreCreateMutex();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_mixer_init());
+	opdi_audio_host_set_io(mic, spk, NULL);
+	if (!net_th) TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(net_task, "net", 4096, NULL, 7, &net_th));
+	xSemaphoreTake(net_lock, portMAX_DELAY);
+	memset(inflight, 0, sizeof(inflight));
+	net = cfg; sent = dropped = 0; lcg = 12345;
+	xSemaphoreGive(net_lock);
+	mouth_us = heard_us = 0;
+	start_us = esp_timer_get_time();
+	speak = true;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_duplex_start(net_send, NULL));
+	TEST_ASSERT_TRUE(opdi_audio_duplex_active());
+	vTaskDelay(pdMS_TO_TICKS(RUN_MS));
+	loop_result_t r = { .latency_ms = -1 };
+	opdi_audio_duplex_get_stats(&r.st);
+	opdi_audio_duplex_stop();
+	speak = false;
+	if (mouth_us && heard_us) r.latency_ms = (int32_t)((heard_us - mouth_us) / 1000);
+	TEST_ASSERT_FALSE(opdi_audio_duplex_active());
+	return r;
+}
+
+void test_loopback_latency_clean_network(void) {
+	loop_result_t r = run_loopback((net_cfg_t){ .base_ms = 5, .jitter_ms = 30 });
+	TEST_ASSERT_GREATER_THAN(0, r.st.tx_frames);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.tx_dropped);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.capture_errors);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.rx_bad);
+	TEST_ASSERT_GREATER_OR_EQUAL(0, r.latency_ms);
+	// capture frame + network + jitter target + playout tick + one frame queued in the mixer stream
+	TEST_ASSERT_LESS_OR_EQUAL(FMS + 35 + TARGET_FRAMES * FMS + FMS + FMS, r.latency_ms);
+	TEST_ASSERT_LESS_OR_EQUAL(350, r.latency_ms); // SRD full-duplex mouth-to-ear target
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.late_frames);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.glitches);
+}
+
+void test_loopback_loss_is_concealed_and_counted(void) {
+	loop_result_t r = run_loopback((net_cfg_t){ .base_ms = 5, .jitter_ms = 10, .drop_every = 10 });
+	TEST_ASSERT_GREATER_THAN(0, dropped);
+	TEST_ASSERT_UINT32_WITHIN(3, sent - dropped, r.st.rx_frames); // the rest is still in flight
+	// Each lost frame costs one concealed playout slot (the newest may not be due yet)
+	TEST_ASSERT_INT_WITHIN(1, dropped, r.st.glitches);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.late_frames);
+	TEST_ASSERT_EQUAL_UINT32(0, r.st.underruns);
+}
+
+void test_loopback_jitter_beyond_target_counts_late(void) {
+	loop_result_t r = run_loopback((net_cfg_t){ .base_ms = 5, .jitter_ms = 200 });
+	TEST_ASSERT_GREATER_THAN(0, r.st.late_frames);
+	TEST_ASSERT_GREATER_THAN(0, r.st.glitches);
+	TEST_ASSERT_GREATER_THAN(0, r.st.rx_jitter_ms);
+}
+
+static esp_err_t stop_on_send(const uint8_t *frame, size_t len, void *ctx){
+	(void)frame; (void)len; (void)ctx;
+	opdi_audio_duplex_stop();
+	return ESP_OK;
+}
+
+void test_stop_from_send_callback(void) {
+	// The sender task may end the session itself (socket gone): stop is called on it and must not block
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_mixer_init());
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_duplex_start(stop_on_send, NULL));
+	for (int i=0; i<20 && opdi_audio_duplex_active(); i++) vTaskDelay(pdMS_TO_TICKS(FMS));
+	TEST_ASSERT_FALSE(opdi_audio_duplex_active());
+	// The next session starts once the old tasks are gone
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_duplex_start(stop_on_send, NULL));
+	for (int i=0; i<20 && opdi_audio_duplex_active(); i++) vTaskDelay(pdMS_TO_TICKS(FMS));
+	TEST_ASSERT_FALSE(opdi_audio_duplex_active());
+}
+#endif
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_ws_frame_roundtrip);
+	RUN_TEST(test_spsc_full_and_empty);
+#if CONFIG_IDF_TARGET_LINUX
+	RUN_TEST(test_loopback_latency_clean_network);
+	RUN_TEST(test_loopback_loss_is_concealed_and_counted);
+	RUN_TEST(test_loopback_jitter_beyond_target_counts_late);
+	RUN_TEST(test_stop_from_send_callback);
+#endif
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
@@ -0,0 +1,181 @@
+// Unity test for the opdi_audio mixing core: clipping, ducking and latency with synthetic sine streams. On the
+// host, the mixer task itself: latency and gain measured at the speaker of the codec stand-in.
+#include "unity.h"
+#include "opdi_audio.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+#define FRAMES 240
+#define RATE   48000
+
+static int16_t a[FRAMES * 2], b[FRAMES * 2], out[FRAMES * 2];
+
+static void fill_sine(int16_t *buf, float hz, float amp){
+	for (int f=0; f<FRAMES; f++){
+		int16_t v = (int16_t)(amp * sinf(2.0f * (float)M_PI * hz * (float)f / RATE));
+		buf[2*f] = v; buf[2*f + 1] = v;
+	}
+}
+
+void setUp(void) {
+	memset(out, 0, sizeof(out));
+}
+
+void tearDown(void) {
+}
+
+void test_mix_full_scale_saturates_without_wrap(void) {
+	fill_sine(a, 1000.0f, 30000.0f);
+	fill_sine(b, 1000.0f, 30000.0f); // in phase: sum peaks near 60000
+	opdi_audio_mix_input_t in[2] = {
+		{ a, FRAMES, OPDI_AUDIO_GAIN_UNITY, OPDI_AUDIO_GAIN_UNITY },
+		{ b, FRAMES, OPDI_AUDIO_GAIN_UNITY, OPDI_AUDIO_GAIN_UNITY },
+	};
+	uint32_t clipped = opdi_audio_mix_block(in, 2, out, FRAMES);
+	TEST_ASSERT_GREATER_THAN_UINT32(0, clipped);
+	for (int i=0; i<FRAMES * 2; i++){
+		// Saturation keeps the sign of the sum: no wrap-around into the opposite rail
+		if (a[i] > 16384) TEST_ASSERT_GREATER_THAN_INT16(0, out[i]);
+		if (a[i] < -16384) TEST_ASSERT_LESS_THAN_INT16(0, out[i]);
+	}
+}
+
+void test_mix_half_gain_no_clipping(void) {
+	fill_sine(a, 440.0f, 32000.0f);
+	fill_sine(b, 1000.0f, 32000.0f);
+	uint16_t half = OPDI_AUDIO_GAIN_UNITY / 2;
+	opdi_audio_mix_input_t in[2] = { { a, FRAMES, half, half }, { b, FRAMES, half, half } };
+	TEST_ASSERT_EQUAL_UINT32(0, opdi_audio_mix_block(in, 2, out, FRAMES));
+	for (int i=0; i<FRAMES * 2; i++){
+		int32_t expect = ((int32_t)a[i] * half >> 8) + ((int32_t)b[i] * half >> 8);
+		TEST_ASSERT_EQUAL_INT16((int16_t)expect, out[i]);
+	}
+}
+
+void test_mix_short_stream_pads_silence(void) {
+	fill_sine(a, 1000.0f, 10000.0f);
+	opdi_audio_mix_input_t in[1] = { { a, FRAMES / 2, OPDI_AUDIO_GAIN_UNITY, OPDI_AUDIO_GAIN_UNITY } };
+	opdi_audio_mix_block(in, 1, out, FRAMES);
+	for (int i=FRAMES; i<FRAMES * 2; i++) TEST_ASSERT_EQUAL_INT16(0, out[i]);
+}
+
+void test_target_gains_duck_lower_priority(void) {
+	uint8_t prio[3] = { OPDI_AUDIO_PRIO_MUSIC, OPDI_AUDIO_PRIO_EVENT, OPDI_AUDIO_PRIO_ALERT };
+	uint8_t gain[3] = { 100, 100, 50 };
+	bool active[3] = { true, true, false };
+	uint16_t q8[3];
+	opdi_audio_mix_target_gains(prio, active, gain, 3, 30, q8);
+	TEST_ASSERT_EQUAL_UINT16(OPDI_AUDIO_GAIN_UNITY * 30 / 100, q8[0]); // music ducked under event
+	TEST_ASSERT_EQUAL_UINT16(OPDI_AUDIO_GAIN_UNITY, q8[1]);
+	TEST_ASSERT_EQUAL_UINT16(OPDI_AUDIO_GAIN_UNITY / 2, q8[2]);       // inactive alert does not duck
+	active[1] = false;
+	opdi_audio_mix_target_gains(prio, active, gain, 3, 30, q8);
+	TEST_ASSERT_EQUAL_UINT16(OPDI_AUDIO_GAIN_UNITY, q8[0]);            // restored once event ends
+}
+
+void test_gain_ramp_has_no_step(void) {
+	for (int i=0; i<FRAMES * 2; i++) a[i] = 20000;
+	opdi_audio_mix_input_t in[1] = { { a, FRAMES, OPDI_AUDIO_GAIN_UNITY, OPDI_AUDIO_GAIN_UNITY * 30 / 100 } };
+	opdi_audio_mix_block(in, 1, out, FRAMES);
+	TEST_ASSERT_EQUAL_INT16(20000, out[0]);
+	for (int f=1; f<FRAMES; f++){
+		int32_t step = (int32_t)out[2*(f-1)] - out[2*f];
+		TEST_ASSERT_TRUE(step >= 0 && step < 200); // monotonic, small per-frame change
+	}
+}
+
+void test_mix_latency_zero_algorithmic_delay(void) {
+	// An impulse at frame k of an input block appears at frame k of the output block, so the
+	// end-to-end latency is bounded by queueing only (ring + one block), never by the mixing core.
+	memset(a, 0, sizeof(a));
+	const int k = 37;
+	a[2*k] = 12345; a[2*k + 1] = 12345;
+	opdi_audio_mix_input_t in[1] = { { a, FRAMES, OPDI_AUDIO_GAIN_UNITY, OPDI_AUDIO_GAIN_UNITY } };
+	opdi_audio_mix_block(in, 1, out, FRAMES);
+	int first = -1;
+	for (int f=0; f<FRAMES && first < 0; f++) if (out[2*f]) first = f;
+	TEST_ASSERT_EQUAL_INT(k, first);
+	TEST_ASSERT_EQUAL_INT16(12345, out[2*k]);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+// The mixer task over the host codec stand-in: the speaker hook sees every block as it starts playing
+static volatile int64_t heard_us;   // when the impulse reached the speaker, 0 = not yet
+static volatile int16_t spk_last;   // last sample of the newest block
+
+static void spk_tap(int16_t *pcm, size_t frames, void *ctx){
+	(void)ctx;
+	uint32_t rate = opdi_audio_mixer_rate();
+	for (size_t f=0; f<frames && !heard_us; f++){
+		if (pcm[2*f] > 6000) heard_us = esp_timer_get_time() + (int64_t)f * 1000000 / rate;
+	}
+	spk_last = pcm[2*(frames - 1)];
+}
+
+static opdi_audio_stream_t host_stream(void){
+	opdi_audio_host_set_io(NULL, spk_tap, NULL);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_mixer_init());
+	opdi_audio_stream_t s;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_stream_open(OPDI_AUDIO_PRIO_EVENT, &s));
+	return s;
+}
+
+void test_mixer_measured_latency_within_reported_bound(void) {
+	opdi_audio_stream_t s = host_stream();
+	memset(a, 0, sizeof(a));
+	const int k = 37;
+	a[2*k] = 12345; a[2*k + 1] = 12345;
+	heard_us = 0;
+	opdi_audio_mixer_stats_t before, st;
+	opdi_audio_mixer_get_stats(&before);
+	int64_t t0 = esp_timer_get_time() + (int64_t)k * 1000000 / opdi_audio_mixer_rate();
+	TEST_ASSERT_EQUAL_UINT32(sizeof(a), opdi_audio_stream_write(s, a, sizeof(a), 100));
+	for (int i=0; i<50 && !heard_us; i++) vTaskDelay(pdMS_TO_TICKS(10));
+	opdi_audio_mixer_get_stats(&st);
+	TEST_ASSERT_NOT_EQUAL(0, heard_us);
+	uint32_t lat_ms = (uint32_t)((heard_us - t0) / 1000);
+	// Empty ring: a full block is mixed at once and starts playing within one block period (plus a tick)
+	uint32_t block_ms = (FRAMES * 1000U + st.sample_rate - 1) / st.sample_rate;
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(block_ms + 2, lat_ms);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(st.latency_ms, lat_ms);
+	TEST_ASSERT_GREATER_THAN_UINT32(before.blocks, st.blocks);
+	TEST_ASSERT_EQUAL_UINT32(before.underruns, st.underruns);
+	opdi_audio_stream_close(s);
+}
+
+void test_mixer_stream_gain_reaches_output(void) {
+	opdi_audio_stream_t s = host_stream();
+	for (int i=0; i<FRAMES * 2; i++) a[i] = 20000;
+	opdi_audio_stream_set_gain(s, 50);
+	// 10 blocks of DC: the ramp from unity settles on the first block, the last sample is at half gain
+	for (int b=0; b<10; b++) TEST_ASSERT_EQUAL_UINT32(sizeof(a), opdi_audio_stream_write(s, a, sizeof(a), 200));
+	vTaskDelay(pdMS_TO_TICKS(30));
+	TEST_ASSERT_INT_WITHIN(2, 10000, spk_last);
+	opdi_audio_stream_close(s);
+}
+#endif
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_mix_full_scale_saturates_without_wrap);
+	RUN_TEST(test_mix_half_gain_no_clipping);
+	RUN_TEST(test_mix_short_stream_pads_silence);
+	RUN_TEST(test_target_gains_duck_lower_priority);
+	RUN_TEST(test_gain_ramp_has_no_step);
+	RUN_TEST(test_mix_latency_zero_algorithmic_delay);
+#if CONFIG_IDF_TARGET_LINUX
+	RUN_TEST(test_mixer_measured_latency_within_reported_bound);
+	RUN_TEST(test_mixer_stream_gain_reaches_output);
+#endif
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
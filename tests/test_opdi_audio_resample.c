@@ -0,0 +1,131 @@
+// Unity test + benchmark for the opdi_audio polyphase resampler (player rate -> fixed device rate)
+#include "unity.h"
+#include "opdi_audio.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OUT_RATE 48000
+#define IN_MAX   48000 // 1 s of input at the highest rate
+
+static int16_t in[IN_MAX * 2];
+static int16_t out[(OUT_RATE + 64) * 2];
+static opdi_audio_resampler_t rs;
+
+static void fill_sine(uint32_t rate, float hz, float amp, size_t frames){
+	for (size_t f=0; f<frames; f++){
+		int16_t v = (int16_t)(amp * sinf(2.0f * (float)M_PI * hz * (float)f / (float)rate));
+		in[2*f] = v; in[2*f + 1] = (int16_t)-v;
+	}
+}
+
+// Feed in player-sized chunks like opdi_audio_player_write does
+static size_t convert(size_t frames){
+	size_t o = 0;
+	for (size_t i=0; i<frames; i+=256){
+		size_t n = frames - i < 256 ? frames - i : 256;
+		o += opdi_audio_resampler_process(&rs, &in[2*i], n, &out[2*o], sizeof(out) / 4 - o);
+	}
+	return o;
+}
+
+void setUp(void) {
+	memset(&rs, 0, sizeof(rs));
+}
+
+void tearDown(void) {
+	opdi_audio_resampler_deinit(&rs);
+}
+
+void test_resample_ratio_reduction(void) {
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, 44100, OUT_RATE));
+	TEST_ASSERT_EQUAL_UINT32(160, rs.L);
+	TEST_ASSERT_EQUAL_UINT32(147, rs.M);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, 16000, OUT_RATE));
+	TEST_ASSERT_EQUAL_UINT32(3, rs.L);
+	TEST_ASSERT_EQUAL_UINT32(1, rs.M);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, OUT_RATE, OUT_RATE));
+	TEST_ASSERT_NULL(rs.coef); // pass-through
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, opdi_audio_resampler_init(&rs, 44101, OUT_RATE));
+}
+
+void test_resample_output_length_and_dc(void) {
+	const uint32_t rates[] = { 16000, 22050, 44100, 48000 };
+	for (size_t r=0; r<sizeof(rates)/sizeof(rates[0]); r++){
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, rates[r], OUT_RATE));
+		for (size_t f=0; f<rates[r]; f++){ in[2*f] = 10000; in[2*f + 1] = -10000; }
+		size_t n = convert(rates[r]);
+		TEST_ASSERT_INT_WITHIN(2, OUT_RATE, n); // 1 s in -> 1 s out
+		// Past the filter delay a constant stays constant (unity DC gain per phase)
+		for (size_t f=OPDI_AUDIO_RESAMPLE_TAPS * 4; f<n; f++){
+			TEST_ASSERT_INT_WITHIN(2, 10000, out[2*f]);
+			TEST_ASSERT_INT_WITHIN(2, -10000, out[2*f + 1]);
+		}
+	}
+}
+
+void test_resample_preserves_tone(void) {
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, 44100, OUT_RATE));
+	fill_sine(44100, 1000.0f, 16000.0f, 44100);
+	size_t n = convert(44100);
+	int crossings = 0, peak = 0;
+	for (size_t f=OPDI_AUDIO_RESAMPLE_TAPS * 4; f<n; f++){
+		if ((out[2*(f-1)] < 0) != (out[2*f] < 0)) crossings++;
+		if (abs(out[2*f]) > peak) peak = abs(out[2*f]);
+	}
+	TEST_ASSERT_INT_WITHIN(6, 2000, crossings);   // still 1 kHz after conversion
+	TEST_ASSERT_INT_WITHIN(400, 16000, peak);     // passband gain ~0 dB
+}
+
+static double goertzel_pow(const int16_t *x, size_t n, double hz, double rate){
+	double w = 2.0 * M_PI * hz / rate, c = 2.0 * cos(w), s1 = 0, s2 = 0;
+	for (size_t i=0; i<n; i++){ double s0 = x[2*i] + c * s1 - s2; s2 = s1; s1 = s0; }
+	return s1 * s1 + s2 * s2 - c * s1 * s2;
+}
+
+void test_resample_rejects_images(void) {
+	// 16 -> 48 kHz: a 3 kHz tone leaves images at 13 and 19 kHz if the interpolation filter is weak
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, 16000, OUT_RATE));
+	fill_sine(16000, 3000.0f, 12000.0f, 16000);
+	size_t n = convert(16000);
+	const int16_t *x = &out[2 * 480]; size_t len = n - 960; // skip edges
+	double tone = goertzel_pow(x, len, 3000.0, OUT_RATE);
+	double img1 = goertzel_pow(x, len, 13000.0, OUT_RATE), img2 = goertzel_pow(x, len, 19000.0, OUT_RATE);
+	TEST_ASSERT_TRUE(10.0 * log10(tone / img1) > 50.0);
+	TEST_ASSERT_TRUE(10.0 * log10(tone / img2) > 50.0);
+}
+
+void test_resample_benchmark(void) {
+	const uint32_t rates[] = { 16000, 22050, 44100 };
+	for (size_t r=0; r<sizeof(rates)/sizeof(rates[0]); r++){
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_resampler_init(&rs, rates[r], OUT_RATE));
+		fill_sine(rates[r], 440.0f, 12000.0f, rates[r]);
+		const int iters = 20;
+		clock_t t0 = clock();
+		for (int i=0; i<iters; i++) convert(rates[r]);
+		double ms = (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC / iters;
+		char msg[96];
+		snprintf(msg, sizeof(msg), "%u -> %u Hz stereo: %.2f ms CPU per second of audio", (unsigned)rates[r], OUT_RATE, ms);
+		TEST_MESSAGE(msg);
+		TEST_ASSERT_TRUE(ms < 1000.0); // must run faster than real time
+	}
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_resample_ratio_reduction);
+	RUN_TEST(test_resample_output_length_and_dc);
+	RUN_TEST(test_resample_preserves_tone);
+	RUN_TEST(test_resample_rejects_images);
+	RUN_TEST(test_resample_benchmark);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
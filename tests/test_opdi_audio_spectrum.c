@@ -0,0 +1,131 @@
+// Unity test + benchmark for the radix-4 fixed-point FFT and the music visualizer band mapping
+#include "unity.h"
+#include "opdi_audio.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define N    OPDI_AUDIO_SPECTRUM_FFT_N
+#define RATE 48000
+
+static int32_t re[N], im[N];
+static int16_t pcm[N];
+
+static void fill_sine(float hz, float amp){
+	for (int i=0; i<N; i++) pcm[i] = (int16_t)(amp * sinf(2.0f * (float)M_PI * hz * (float)i / RATE));
+}
+
+void setUp(void) {
+	uint16_t b[OPDI_AUDIO_SPECTRUM_BANDS];
+	for (int i=0; i<40; i++) opdi_audio_spectrum_poll(b); // let the peak hold decay between tests
+}
+
+void tearDown(void) {
+}
+
+void test_fft_matches_dft(void) {
+	const size_t sizes[] = { 16, 64, 256, N };
+	for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		size_t n = sizes[s];
+		srand(7);
+		for (size_t i=0; i<n; i++){ re[i] = (rand() % 65536) - 32768; im[i] = (rand() % 65536) - 32768; }
+		static double xr[N], xi[N];
+		for (size_t i=0; i<n; i++){ xr[i] = re[i]; xi[i] = im[i]; }
+		opdi_audio_fft_r4(re, im, n);
+		double err = 0, ref = 0;
+		for (size_t k=0; k<n; k++){
+			double ar = 0, ai = 0;
+			for (size_t i=0; i<n; i++){
+				double a = -2.0 * M_PI * (double)((k * i) % n) / (double)n;
+				ar += xr[i] * cos(a) - xi[i] * sin(a);
+				ai += xr[i] * sin(a) + xi[i] * cos(a);
+			}
+			ar /= (double)n; ai /= (double)n;
+			err += (re[k] - ar) * (re[k] - ar) + (im[k] - ai) * (im[k] - ai);
+			ref += ar * ar + ai * ai;
+		}
+		// Scaled fixed point loses ~2 bits per stage; still far beyond what a 4-band display needs
+		TEST_ASSERT_TRUE(10.0 * log10(ref / err) > 30.0);
+	}
+}
+
+void test_fft_single_bin(void) {
+	for (int i=0; i<N; i++){ re[i] = (int32_t)lrint(16384.0 * cos(2.0 * M_PI * 37 * i / N)); im[i] = 0; }
+	opdi_audio_fft_r4(re, im, N);
+	TEST_ASSERT_INT_WITHIN(16, 8192, re[37]);      // X[k]/N = A/2
+	TEST_ASSERT_INT_WITHIN(16, 8192, re[N - 37]);
+	for (int k=0; k<N; k++) if (k != 37 && k != N - 37) TEST_ASSERT_INT_WITHIN(4, 0, re[k]);
+}
+
+void test_tones_land_in_their_band(void) {
+	const float hz[OPDI_AUDIO_SPECTRUM_BANDS] = { 100.0f, 1000.0f, 4000.0f, 10000.0f };
+	for (int b=0; b<OPDI_AUDIO_SPECTRUM_BANDS; b++){
+		uint16_t lv[OPDI_AUDIO_SPECTRUM_BANDS];
+		fill_sine(hz[b], 16000.0f);
+		opdi_audio_spectrum_compute(pcm, RATE, lv);
+		for (int o=0; o<OPDI_AUDIO_SPECTRUM_BANDS; o++){
+			if (o == b) TEST_ASSERT_GREATER_THAN(60, lv[o]);
+			else TEST_ASSERT_LESS_THAN(lv[b] - 30, lv[o]); // Hann leakage stays > 22 dB down
+		}
+	}
+}
+
+void test_levels_track_loudness(void) {
+	uint16_t loud[OPDI_AUDIO_SPECTRUM_BANDS], quiet[OPDI_AUDIO_SPECTRUM_BANDS], none[OPDI_AUDIO_SPECTRUM_BANDS];
+	fill_sine(150.0f, 16000.0f); opdi_audio_spectrum_compute(pcm, RATE, loud);
+	fill_sine(150.0f, 1600.0f);  opdi_audio_spectrum_compute(pcm, RATE, quiet);
+	memset(pcm, 0, sizeof(pcm)); opdi_audio_spectrum_compute(pcm, RATE, none);
+	TEST_ASSERT_INT_WITHIN(3, 27, loud[0] - quiet[0]); // 20 dB = 26.6 steps of 0.75 dB
+	TEST_ASSERT_EQUAL_UINT16(0, none[0]);
+	TEST_ASSERT_LESS_OR_EQUAL(80, loud[0]);
+}
+
+void test_tap_poll_attack_and_release(void) {
+	static int16_t st[2 * N];
+	uint16_t b[OPDI_AUDIO_SPECTRUM_BANDS];
+	// The tap maps bands at the mixer rate (the Kconfig device rate until the mixer starts)
+	TEST_ASSERT_EQUAL_UINT32(RATE, opdi_audio_mixer_rate());
+	fill_sine(100.0f, 16000.0f);
+	for (int i=0; i<N; i++){ st[2*i] = pcm[i]; st[2*i + 1] = pcm[i]; }
+	opdi_audio_spectrum_feed(st, N);
+	opdi_audio_spectrum_poll(b);
+	uint16_t peak = b[0];
+	TEST_ASSERT_GREATER_THAN(60, peak);               // instant attack
+	opdi_audio_spectrum_poll(b);                      // no new samples: decays
+	TEST_ASSERT_LESS_THAN(peak, b[0]);
+	for (int i=0; i<30; i++) opdi_audio_spectrum_poll(b);
+	TEST_ASSERT_EQUAL_UINT16(0, b[0]);                // falls to rest when playback stops
+}
+
+void test_spectrum_benchmark(void) {
+	fill_sine(440.0f, 12000.0f);
+	uint16_t lv[OPDI_AUDIO_SPECTRUM_BANDS];
+	const int iters = 300;
+	clock_t t0 = clock();
+	for (int i=0; i<iters; i++) opdi_audio_spectrum_compute(pcm, RATE, lv);
+	double us = (double)(clock() - t0) * 1e6 / CLOCKS_PER_SEC / iters;
+	char msg[96];
+	snprintf(msg, sizeof(msg), "%d-point window + FFT + bands: %.1f us per frame (%.2f%% CPU at 30 Hz)", N, us, us * 30.0 / 1e4);
+	TEST_MESSAGE(msg);
+	TEST_ASSERT_TRUE(us < 33333.0); // must keep up with the 30 Hz UI tick
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_fft_matches_dft);
+	RUN_TEST(test_fft_single_bin);
+	RUN_TEST(test_tones_land_in_their_band);
+	RUN_TEST(test_levels_track_loudness);
+	RUN_TEST(test_tap_poll_attack_and_release);
+	RUN_TEST(test_spectrum_benchmark);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
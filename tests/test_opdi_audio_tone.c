@@ -0,0 +1,91 @@
+// Unity test for the opdi_audio tone synthesis core (table oscillator used by the earcon cache)
+#include "unity.h"
+#include "opdi_audio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 16000
+
+static int16_t pcm[RATE * 2]; // up to 1 s stereo
+
+void setUp(void) {
+	memset(pcm, 0, sizeof(pcm));
+}
+
+void tearDown(void) {
+}
+
+void test_tone_frame_count(void) {
+	opdi_audio_tone_seg_t segs[2] = { { 440, 120, 25 }, { 0, 30, 0 } };
+	TEST_ASSERT_EQUAL_UINT32(RATE * 150 / 1000, opdi_audio_tone_render(segs, 2, RATE, NULL, 0));
+	// Output is clamped to the caller's buffer
+	TEST_ASSERT_EQUAL_UINT32(100, opdi_audio_tone_render(segs, 2, RATE, pcm, 100));
+}
+
+void test_tone_frequency_and_level(void) {
+	opdi_audio_tone_seg_t seg = { 1000, 500, 25 };
+	size_t n = opdi_audio_tone_render(&seg, 1, RATE, pcm, RATE);
+	int crossings = 0, peak = 0;
+	for (size_t f=1; f<n; f++){
+		if ((pcm[2*(f-1)] < 0) != (pcm[2*f] < 0)) crossings++;
+		if (abs(pcm[2*f]) > peak) peak = abs(pcm[2*f]);
+		TEST_ASSERT_EQUAL_INT16(pcm[2*f], pcm[2*f + 1]); // identical channels
+	}
+	// 1 kHz for 0.5 s = 500 periods = ~1000 sign changes
+	TEST_ASSERT_INT_WITHIN(4, 1000, crossings);
+	TEST_ASSERT_INT_WITHIN(300, 32767 / 4, peak);
+}
+
+void test_tone_ramps_and_rest_are_silent_at_edges(void) {
+	opdi_audio_tone_seg_t segs[3] = { { 880, 60, 50 }, { 0, 30, 0 }, { 880, 60, 50 } };
+	size_t n = opdi_audio_tone_render(segs, 3, RATE, pcm, RATE);
+	size_t seg = RATE * 60 / 1000, rest = RATE * 30 / 1000;
+	TEST_ASSERT_EQUAL_INT16(0, pcm[0]);                       // attack starts at zero
+	TEST_ASSERT_LESS_THAN(200, abs(pcm[2*(seg-1)]));          // release ends near zero
+	for (size_t f=seg; f<seg+rest; f++) TEST_ASSERT_EQUAL_INT16(0, pcm[2*f]);
+	TEST_ASSERT_LESS_THAN(200, abs(pcm[2*(n-1)]));
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+// Cache over the host mixer: rendered at init, so play is a hand-off; an empty definition is legal and silent
+static size_t s_direct_frames;
+static void count_spk(int16_t *pcm, size_t frames, void *ctx) { (void)pcm; (void)ctx; s_direct_frames += frames; }
+
+void test_tone_cache_renders_at_init_and_accepts_empty(void) {
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_audio_tone_play(OPDI_AUDIO_TONE_NOTIFY, OPDI_AUDIO_PRIO_EVENT));
+	// No mixer yet: the direct fallback writes the whole tone to I2S itself
+	opdi_audio_host_set_io(NULL, count_spk, NULL);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_play_direct(OPDI_AUDIO_TONE_STARTUP));
+	opdi_audio_host_set_io(NULL, NULL, NULL);
+	TEST_ASSERT_GREATER_THAN(0, s_direct_frames);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_mixer_init());
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_audio_tone_play_direct(OPDI_AUDIO_TONE_STARTUP));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_cache_init());
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_play(OPDI_AUDIO_TONE_NOTIFY, OPDI_AUDIO_PRIO_EVENT));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_define(OPDI_AUDIO_TONE_OK, NULL, 0));
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_audio_tone_play(OPDI_AUDIO_TONE_OK, OPDI_AUDIO_PRIO_EVENT));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_audio_tone_define(OPDI_AUDIO_TONE_OK, NULL, 1));
+	opdi_audio_tone_seg_t seg = { 990, 40, 25 };
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_define(OPDI_AUDIO_TONE_OK, &seg, 1));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_audio_tone_play(OPDI_AUDIO_TONE_OK, OPDI_AUDIO_PRIO_EVENT));
+	opdi_audio_mixer_cancel_clips();
+}
+#endif
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_tone_frame_count);
+	RUN_TEST(test_tone_frequency_and_level);
+	RUN_TEST(test_tone_ramps_and_rest_are_silent_at_edges);
+#if CONFIG_IDF_TARGET_LINUX
+	RUN_TEST(test_tone_cache_renders_at_init_and_accepts_empty);
+#endif
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
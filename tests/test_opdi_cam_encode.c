@@ -0,0 +1,288 @@
+// Unity test for the RGB565 encode stage: scaler plans, in-place ring slots, demand and pacing, per-profile stats.
+// On the device the last test benchmarks the PPA + JPEG engine path on a synthetic 1280x720 frame.
+#include "unity.h"
+#include "opdi_cam.h"
+#include "nvs_flash.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SRC_W 1280
+#define SRC_H 720
+
+static uint8_t *s_frame;
+
+#if CONFIG_IDF_TARGET_LINUX
+// Host backend: a JPEG-framed block of out_w*out_h/s_fake_div bytes, refused when it does not fit. Like the
+// device, it takes whole cache lines only.
+static uint32_t s_fake_div = 20;
+static uint32_t s_fake_calls;
+esp_err_t opdi_cam_hw_encode(const uint8_t *rgb565, uint16_t w, uint16_t h, const opdi_cam_scale_plan_t *plan,
+                             uint8_t jpeg_q, uint8_t *out, size_t cap, size_t *out_len){
+	(void)rgb565; (void)w; (void)h;
+	s_fake_calls++;
+	if (cap & 127U) return ESP_ERR_INVALID_ARG;
+	size_t need = (size_t)plan->out_w * plan->out_h / s_fake_div;
+	if (need > cap) return ESP_ERR_INVALID_SIZE;
+	memset(out, jpeg_q, need);
+	out[0] = 0xFF; out[1] = 0xD8; out[need - 2] = 0xFF; out[need - 1] = 0xD9;
+	*out_len = need;
+	return ESP_OK;
+}
+#endif
+
+static void set_layers(bool simulcast, opdi_cam_profile_t main_p, uint8_t q, opdi_cam_profile_t sub_p){
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	c.simulcast = simulcast;
+	c.fps_target = 30;
+	c.profile = main_p; c.jpeg_q = q;
+	c.sub_profile = sub_p; c.sub_jpeg_q = 60;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_ext_config_set(&c));
+}
+
+// Next frame is past the fps_target interval (30 fps)
+static void next_frame(void){ vTaskDelay(pdMS_TO_TICKS(40)); }
+
+static uint32_t accepted(opdi_cam_layer_t layer){
+	uint32_t acc; opdi_cam_stream_layer_stats(layer, &acc, NULL, NULL); return acc;
+}
+
+void setUp(void){
+	nvs_flash_init(); opdi_cam_init(); opdi_cam_manager_init();
+	if (!s_frame){
+		s_frame = (uint8_t*)heap_caps_aligned_calloc(128, 1, SRC_W * SRC_H * 2, MALLOC_CAP_SPIRAM);
+		TEST_ASSERT_NOT_NULL(s_frame);
+		// Gradient with some texture so the encoder has work to do
+		uint16_t *px = (uint16_t*)s_frame;
+		for (int y = 0; y < SRC_H; y++)
+			for (int x = 0; x < SRC_W; x++)
+				px[y * SRC_W + x] = (uint16_t)((((x * 31) / SRC_W) << 11) | ((((y * 63) / SRC_H) ^ (x & 7)) << 5) | ((x ^ y) & 31));
+	}
+	opdi_cam_encode_reset_stats();
+}
+
+void tearDown(void){
+	while (opdi_cam_stream_clients(OPDI_CAM_LAYER_MAIN)) opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, false);
+	while (opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB)) opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, false);
+}
+
+void test_encode_plan_geometry(void){
+	opdi_cam_scale_plan_t p;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_plan(SRC_W, SRC_H, OPDI_CAM_PROFILE_720P, &p));
+	TEST_ASSERT_EQUAL_UINT8(16, p.scale_16);
+	TEST_ASSERT_EQUAL_UINT16(1280, p.out_w); TEST_ASSERT_EQUAL_UINT16(720, p.out_h);
+	TEST_ASSERT_EQUAL_UINT16(0, p.crop_x); TEST_ASSERT_EQUAL_UINT16(0, p.crop_y);
+
+	// 11/16 is the step nearest 480 rows; the frame keeps its aspect (880 wide, not 640)
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_plan(SRC_W, SRC_H, OPDI_CAM_PROFILE_480P, &p));
+	TEST_ASSERT_EQUAL_UINT8(11, p.scale_16);
+	TEST_ASSERT_EQUAL_UINT16(880, p.out_w); TEST_ASSERT_EQUAL_UINT16(480, p.out_h);
+	TEST_ASSERT_EQUAL_UINT16(1280, p.crop_w); TEST_ASSERT_EQUAL_UINT16(698, p.crop_h);
+	TEST_ASSERT_EQUAL_UINT16(11, p.crop_y);   // centred
+
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_plan(SRC_W, SRC_H, OPDI_CAM_PROFILE_240P, &p));
+	TEST_ASSERT_EQUAL_UINT8(5, p.scale_16);
+	TEST_ASSERT_EQUAL_UINT16(400, p.out_w); TEST_ASSERT_EQUAL_UINT16(224, p.out_h);
+	// The scaled crop never needs more than the output holds
+	TEST_ASSERT_TRUE((uint32_t)p.crop_w * p.scale_16 / 16U <= p.out_w);
+	TEST_ASSERT_TRUE((uint32_t)p.crop_h * p.scale_16 / 16U <= p.out_h);
+
+	// A 4:3 source lands on the exact sizes
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_plan(640, 480, OPDI_CAM_PROFILE_240P, &p));
+	TEST_ASSERT_EQUAL_UINT8(8, p.scale_16);
+	TEST_ASSERT_EQUAL_UINT16(320, p.out_w); TEST_ASSERT_EQUAL_UINT16(240, p.out_h);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_plan(640, 480, OPDI_CAM_PROFILE_720P, &p));
+	TEST_ASSERT_EQUAL_UINT16(640, p.out_w);   // never upscaled
+
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_cam_encode_plan(8, 8, OPDI_CAM_PROFILE_240P, &p));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_cam_encode_plan(SRC_W, SRC_H, OPDI_CAM_PROFILE_240P, NULL));
+}
+
+void test_encode_ring_reserve_commit(void){
+	static const uint8_t k_jpeg[] = { 0xFF, 0xD8, 9, 8, 7, 0xFF, 0xD9 };
+	uint32_t acc0, drop0;
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_SUB, &acc0, NULL, &drop0);
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_cam_stream_commit(OPDI_CAM_LAYER_SUB, 4, OPDI_CAM_PROFILE_240P, 60));
+
+	uint8_t *slot = opdi_cam_stream_reserve(OPDI_CAM_LAYER_SUB, 4);
+	TEST_ASSERT_NOT_NULL(slot);
+	// Reserving again before the commit grows the same slot
+	slot = opdi_cam_stream_reserve(OPDI_CAM_LAYER_SUB, 4096);
+	TEST_ASSERT_NOT_NULL(slot);
+	memcpy(slot, k_jpeg, sizeof(k_jpeg));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_commit(OPDI_CAM_LAYER_SUB, sizeof(k_jpeg), OPDI_CAM_PROFILE_240P, 61));
+
+	uint8_t buf[16], q = 0; opdi_cam_profile_t p = OPDI_CAM_PROFILE_720P;
+	TEST_ASSERT_EQUAL(sizeof(k_jpeg), opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, sizeof(buf), &q, &p, NULL));
+	TEST_ASSERT_EQUAL_MEMORY(k_jpeg, buf, sizeof(k_jpeg));
+	TEST_ASSERT_EQUAL_UINT8(61, q);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, p);
+
+	// A cancelled slot is a drop, and readers keep the previous frame
+	slot = opdi_cam_stream_reserve(OPDI_CAM_LAYER_SUB, 64);
+	memset(slot, 0, 64);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_commit(OPDI_CAM_LAYER_SUB, 0, OPDI_CAM_PROFILE_240P, 61));
+	TEST_ASSERT_EQUAL(sizeof(k_jpeg), opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, sizeof(buf), NULL, NULL, NULL));
+	TEST_ASSERT_EQUAL_MEMORY(k_jpeg, buf, sizeof(k_jpeg));
+	uint32_t acc, drop;
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_SUB, &acc, NULL, &drop);
+	TEST_ASSERT_EQUAL_UINT32(acc0 + 1, acc);
+	TEST_ASSERT_EQUAL_UINT32(drop0 + 1, drop);
+
+	// Slots of different sizes around the ring: each push fits its own slot
+	for (size_t i = 0; i < 8; i++){
+		size_t len = (i & 1) ? 3000 : 5;
+		uint8_t *big = (uint8_t*)malloc(len);
+		memset(big, (int)i, len);
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_push_layer(OPDI_CAM_LAYER_SUB, big, len, OPDI_CAM_PROFILE_240P, 60));
+		free(big);
+	}
+	TEST_ASSERT_EQUAL(3000, opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, NULL, 0, NULL, NULL, NULL));
+
+	// The writer never gets the newest slot, the one readers copy from, however often it reserves
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_push_layer(OPDI_CAM_LAYER_SUB, k_jpeg, sizeof(k_jpeg), OPDI_CAM_PROFILE_240P, 62));
+	for (int i = 0; i < 2 * CONFIG_OPDI_CAM_STREAM_DEPTH; i++){
+		slot = opdi_cam_stream_reserve(OPDI_CAM_LAYER_SUB, 4096 * (i + 1));
+		TEST_ASSERT_NOT_NULL(slot);
+		memset(slot, 0xAA, 4096 * (i + 1));
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_commit(OPDI_CAM_LAYER_SUB, 0, OPDI_CAM_PROFILE_240P, 62));
+		TEST_ASSERT_EQUAL(sizeof(k_jpeg), opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, sizeof(buf), NULL, NULL, NULL));
+		TEST_ASSERT_EQUAL_MEMORY(k_jpeg, buf, sizeof(k_jpeg));
+	}
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+void test_encode_demand_and_pacing(void){
+	set_layers(true, OPDI_CAM_PROFILE_720P, 75, OPDI_CAM_PROFILE_240P);
+	uint32_t main0 = accepted(OPDI_CAM_LAYER_MAIN), sub0 = accepted(OPDI_CAM_LAYER_SUB);
+
+	// Nobody watches and no clip recorder: the frame only counts as captured
+	s_fake_calls = 0;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL_UINT32(0, s_fake_calls);
+	TEST_ASSERT_TRUE(opdi_cam_encode_active());
+
+	// A SUB viewer: only SUB is encoded, at its own profile
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	next_frame();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL_UINT32(main0, accepted(OPDI_CAM_LAYER_MAIN));
+	TEST_ASSERT_EQUAL_UINT32(sub0 + 1, accepted(OPDI_CAM_LAYER_SUB));
+	opdi_cam_profile_t p; uint8_t q;
+	uint8_t *buf = (uint8_t*)malloc(SRC_W * SRC_H);
+	int n = opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, SRC_W * SRC_H, &q, &p, NULL);
+	TEST_ASSERT_EQUAL(400 * 224 / 20, n);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, p);
+	TEST_ASSERT_EQUAL_UINT8(60, q);
+	TEST_ASSERT_EQUAL_HEX8(0xD8, buf[1]);
+
+	// MAIN viewer too; a frame right behind it is skipped (30 fps target)
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	next_frame();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL_UINT32(main0 + 1, accepted(OPDI_CAM_LAYER_MAIN));
+	TEST_ASSERT_EQUAL_UINT32(sub0 + 2, accepted(OPDI_CAM_LAYER_SUB));
+	n = opdi_cam_stream_copy_latest(buf, SRC_W * SRC_H, &q, &p, NULL);
+	TEST_ASSERT_EQUAL(1280 * 720 / 20, n);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, p);
+	TEST_ASSERT_EQUAL_UINT8(75, q);
+
+	// Simulcast off: the SUB viewer gets nothing new
+	set_layers(false, OPDI_CAM_PROFILE_720P, 75, OPDI_CAM_PROFILE_240P);
+	next_frame();
+	opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H);
+	TEST_ASSERT_EQUAL_UINT32(main0 + 2, accepted(OPDI_CAM_LAYER_MAIN));
+	TEST_ASSERT_EQUAL_UINT32(sub0 + 2, accepted(OPDI_CAM_LAYER_SUB));
+	free(buf);
+}
+
+void test_encode_stats_and_short_slot(void){
+	set_layers(false, OPDI_CAM_PROFILE_480P, 70, OPDI_CAM_PROFILE_240P);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	opdi_cam_encode_stats_t st;
+	opdi_cam_encode_get_stats(OPDI_CAM_PROFILE_480P, &st);
+	TEST_ASSERT_EQUAL_UINT32(0, st.frames);
+
+	// Larger than the first slot estimate (raw/4): retried once at the raw size, not dropped
+	s_fake_div = 1;
+	s_fake_calls = 0;
+	uint32_t drop0; opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_MAIN, NULL, NULL, &drop0);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL_UINT32(2, s_fake_calls);
+	uint32_t drop; opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_MAIN, NULL, NULL, &drop);
+	TEST_ASSERT_EQUAL_UINT32(drop0, drop);
+
+	// Later frames size their slot from the largest one seen: one call each
+	s_fake_div = 20;
+	next_frame();
+	opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H);
+	TEST_ASSERT_EQUAL_UINT32(3, s_fake_calls);
+
+	opdi_cam_encode_get_stats(OPDI_CAM_PROFILE_480P, &st);
+	TEST_ASSERT_EQUAL_UINT32(2, st.frames);
+	TEST_ASSERT_EQUAL_UINT16(880, st.width); TEST_ASSERT_EQUAL_UINT16(480, st.height);
+	TEST_ASSERT_EQUAL_UINT32(880 * 480, st.bytes_max);
+	TEST_ASSERT_EQUAL_UINT32((880 * 480 + 880 * 480 / 20) / 2, st.bytes_avg);
+	TEST_ASSERT_TRUE(st.encode_us_max >= st.encode_us_avg);
+	opdi_cam_encode_get_stats(OPDI_CAM_PROFILE_720P, &st);
+	TEST_ASSERT_EQUAL_UINT32(0, st.frames);
+}
+
+void test_encode_slot_whole_cache_lines(void){
+	set_layers(false, OPDI_CAM_PROFILE_480P, 70, OPDI_CAM_PROFILE_240P);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	// 60342 B frames: the next slot estimate (x1.25 + 4 KB) is not a multiple of 128 until rounded up
+	s_fake_div = 7;
+	s_fake_calls = 0;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	next_frame();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+	TEST_ASSERT_EQUAL_UINT32(2, s_fake_calls);
+	s_fake_div = 20;
+}
+#else
+// Encode ms per frame and bytes per profile through the PPA + JPEG engine path, at the default quality
+void test_encode_benchmark_profiles(void){
+	static const char *names[] = { "240p", "480p", "720p" };
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	for (int p = OPDI_CAM_PROFILE_240P; p <= OPDI_CAM_PROFILE_720P; p++){
+		set_layers(false, (opdi_cam_profile_t)p, CONFIG_OPDI_CAM_DEFAULT_JPEG_Q, OPDI_CAM_PROFILE_240P);
+		for (int i = 0; i < 20; i++){
+			TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_encode_rgb565(s_frame, SRC_W, SRC_H));
+			next_frame();
+		}
+		opdi_cam_encode_stats_t st; opdi_cam_encode_get_stats((opdi_cam_profile_t)p, &st);
+		TEST_ASSERT_EQUAL_UINT32(20, st.frames);
+		char msg[112];
+		snprintf(msg, sizeof(msg), "%s %ux%u q%u: %lu.%02lu ms avg, %lu.%02lu ms max, %lu B avg, %lu B max",
+			names[p], st.width, st.height, CONFIG_OPDI_CAM_DEFAULT_JPEG_Q,
+			(unsigned long)(st.encode_us_avg / 1000), (unsigned long)(st.encode_us_avg % 1000 / 10),
+			(unsigned long)(st.encode_us_max / 1000), (unsigned long)(st.encode_us_max % 1000 / 10),
+			(unsigned long)st.bytes_avg, (unsigned long)st.bytes_max);
+		TEST_MESSAGE(msg);
+	}
+}
+#endif
+
+int run_unity_tests(void){
+	UNITY_BEGIN();
+	RUN_TEST(test_encode_plan_geometry);
+	RUN_TEST(test_encode_ring_reserve_commit);
+#if CONFIG_IDF_TARGET_LINUX
+	RUN_TEST(test_encode_demand_and_pacing);
+	RUN_TEST(test_encode_stats_and_short_slot);
+	RUN_TEST(test_encode_slot_whole_cache_lines);
+#else
+	RUN_TEST(test_encode_benchmark_profiles);
+#endif
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void){ run_unity_tests(); }
+#endif
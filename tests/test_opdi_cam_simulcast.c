@@ -0,0 +1,169 @@
+// Unity test for simulcast: per-layer stream rings, viewer counts, SUB config clamping, per-layer governor
+#include "unity.h"
+#include "opdi_cam.h"
+#include "nvs_flash.h"
+#include <string.h>
+
+void opdi_cam_governor_periodic(void); // 1 s tick, called from opdi_cam_periodic_1s()
+
+static const uint8_t k_main[] = { 0xFF, 0xD8, 1, 2, 3, 4, 5, 6, 0xFF, 0xD9 };
+static const uint8_t k_sub[] = { 0xFF, 0xD8, 7, 0xFF, 0xD9 };
+
+static void set_layers(opdi_cam_profile_t main_p, opdi_cam_profile_t sub_p){
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	c.simulcast = true;
+	c.profile = main_p; c.jpeg_q = 70;
+	c.sub_profile = sub_p; c.sub_jpeg_q = 60;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_ext_config_set(&c));
+}
+
+// One second of frames: pushed to both layers, the viewers of each copy main_served / sub_served of them
+static void second(int pushed, int main_served, int sub_served){
+	uint8_t buf[16];
+	for (int i=0; i<pushed; i++){
+		opdi_cam_stream_push_layer(OPDI_CAM_LAYER_MAIN, k_main, sizeof(k_main), OPDI_CAM_PROFILE_720P, 70);
+		opdi_cam_stream_push_layer(OPDI_CAM_LAYER_SUB, k_sub, sizeof(k_sub), OPDI_CAM_PROFILE_240P, 60);
+		if (i < main_served) opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_MAIN, buf, sizeof(buf), NULL, NULL, NULL);
+		if (i < sub_served) opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, sizeof(buf), NULL, NULL, NULL);
+	}
+	opdi_cam_governor_periodic();
+}
+
+void setUp(void){
+	nvs_flash_init(); opdi_cam_init(); opdi_cam_manager_init();
+	opdi_cam_governor_notify_cpu_load(60);   // neither high nor low: only backlog moves a layer
+}
+
+void tearDown(void){
+	while (opdi_cam_stream_clients(OPDI_CAM_LAYER_MAIN)) opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, false);
+	while (opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB)) opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, false);
+}
+
+void test_simulcast_layers_have_own_rings(void){
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_push_layer(OPDI_CAM_LAYER_MAIN, k_main, sizeof(k_main), OPDI_CAM_PROFILE_720P, 80));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_stream_push_layer(OPDI_CAM_LAYER_SUB, k_sub, sizeof(k_sub), OPDI_CAM_PROFILE_240P, 55));
+	uint32_t main_acc, sub_acc, sub_served;
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_MAIN, &main_acc, NULL, NULL);
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_SUB, &sub_acc, &sub_served, NULL);
+
+	uint8_t buf[16], q = 0; opdi_cam_profile_t p = OPDI_CAM_PROFILE_480P;
+	TEST_ASSERT_EQUAL(sizeof(k_sub), opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, NULL, 0, NULL, NULL, NULL));
+	TEST_ASSERT_EQUAL(sizeof(k_sub), opdi_cam_stream_copy_layer(OPDI_CAM_LAYER_SUB, buf, sizeof(buf), &q, &p, NULL));
+	TEST_ASSERT_EQUAL_MEMORY(k_sub, buf, sizeof(k_sub));
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, p);
+	TEST_ASSERT_EQUAL_UINT8(55, q);
+	// The MAIN-only API is unchanged and sees the MAIN frame
+	TEST_ASSERT_EQUAL(sizeof(k_main), opdi_cam_stream_copy_latest(buf, sizeof(buf), &q, &p, NULL));
+	TEST_ASSERT_EQUAL_MEMORY(k_main, buf, sizeof(k_main));
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, p);
+	TEST_ASSERT_EQUAL(sizeof(k_main), opdi_cam_stream_current_frame_size());
+	TEST_ASSERT_EQUAL(-(int)sizeof(k_main), opdi_cam_stream_copy_latest(buf, 4, NULL, NULL, NULL));
+
+	// Counters are per layer
+	uint32_t acc, served;
+	opdi_cam_stream_layer_stats(OPDI_CAM_LAYER_SUB, &acc, &served, NULL);
+	TEST_ASSERT_EQUAL_UINT32(sub_acc, acc);
+	TEST_ASSERT_EQUAL_UINT32(sub_served + 1, served);
+	opdi_cam_stream_stats(&acc, NULL, NULL);
+	TEST_ASSERT_EQUAL_UINT32(main_acc, acc);
+}
+
+void test_simulcast_viewer_counts(void){
+	TEST_ASSERT_EQUAL_UINT32(0, opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB));
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	TEST_ASSERT_EQUAL_UINT32(2, opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB));
+	TEST_ASSERT_EQUAL_UINT32(1, opdi_cam_stream_clients(OPDI_CAM_LAYER_MAIN));
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, false);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, false);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, false);   // one leave too many is ignored
+	TEST_ASSERT_EQUAL_UINT32(0, opdi_cam_stream_clients(OPDI_CAM_LAYER_SUB));
+	TEST_ASSERT_EQUAL_UINT32(1, opdi_cam_stream_clients(OPDI_CAM_LAYER_MAIN));
+}
+
+void test_simulcast_sub_config_clamped(void){
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL_UINT8(OPDI_CAM_EXT_CONFIG_VERSION, c.version);
+	c.simulcast = true;
+	c.profile = OPDI_CAM_PROFILE_480P;
+	c.sub_profile = OPDI_CAM_PROFILE_720P;   // above MAIN
+	c.sub_jpeg_q = 95;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_cam_ext_config_set(&c));
+	opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_TRUE(c.simulcast);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_480P, c.sub_profile);
+	TEST_ASSERT_EQUAL_UINT8(90, c.sub_jpeg_q);
+	c.sub_jpeg_q = 10;
+	opdi_cam_ext_config_set(&c);
+	opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL_UINT8(50, c.sub_jpeg_q);
+}
+
+#ifdef CONFIG_OPDI_CAM_GOVERNOR
+void test_simulcast_governor_slow_sub_viewer(void){
+	set_layers(OPDI_CAM_PROFILE_720P, OPDI_CAM_PROFILE_480P);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_MAIN, true);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	second(15, 15, 15);   // baseline: both keep up
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, c.profile);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_480P, c.sub_profile);
+
+	// The SUB viewer gets 5 of 15 frames: SUB steps down, MAIN keeps its profile and quality
+	second(15, 15, 5);
+	opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, c.sub_profile);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, c.profile);
+	second(15, 15, 5);
+	opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, c.sub_profile);
+	TEST_ASSERT_EQUAL_UINT8(55, c.sub_jpeg_q);   // at the bottom profile, quality goes instead
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, c.profile);
+	TEST_ASSERT_EQUAL_UINT8(70, c.jpeg_q);
+}
+
+void test_simulcast_governor_cpu_load_moves_main(void){
+	set_layers(OPDI_CAM_PROFILE_720P, OPDI_CAM_PROFILE_240P);
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	second(15, 0, 15);
+	opdi_cam_governor_notify_cpu_load(95);
+	second(15, 0, 15);
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_480P, c.profile);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_240P, c.sub_profile);
+	TEST_ASSERT_EQUAL_UINT8(60, c.sub_jpeg_q);
+}
+
+void test_simulcast_governor_ignores_unwatched_layers(void){
+	set_layers(OPDI_CAM_PROFILE_720P, OPDI_CAM_PROFILE_480P);
+	// Nobody watches: nothing is served, which is not a backlog
+	second(15, 0, 0);
+	second(15, 0, 0);
+	opdi_cam_ext_config_t c; opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_720P, c.profile);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_480P, c.sub_profile);
+	// A viewer joining later is judged on its own second, not on the frames pushed before it came
+	opdi_cam_stream_client(OPDI_CAM_LAYER_SUB, true);
+	second(15, 0, 15);
+	opdi_cam_ext_config_get(&c);
+	TEST_ASSERT_EQUAL(OPDI_CAM_PROFILE_480P, c.sub_profile);
+}
+#endif
+
+int run_unity_tests(void){
+	UNITY_BEGIN();
+	RUN_TEST(test_simulcast_layers_have_own_rings);
+	RUN_TEST(test_simulcast_viewer_counts);
+	RUN_TEST(test_simulcast_sub_config_clamped);
+#ifdef CONFIG_OPDI_CAM_GOVERNOR
+	RUN_TEST(test_simulcast_governor_slow_sub_viewer);
+	RUN_TEST(test_simulcast_governor_cpu_load_moves_main);
+	RUN_TEST(test_simulcast_governor_ignores_unwatched_layers);
+#endif
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void){ run_unity_tests(); }
+#endif
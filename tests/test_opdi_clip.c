@@ -0,0 +1,294 @@
+// Unity test for the event clip recorder: pre/post-roll selection, AVI layout, drop-not-block, listing
+#include "unity.h"
+#include "opdi_clip.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#define CLIP_DIR "/tmp/opdi_clip_test"
+#else
+#define CLIP_DIR "/sdcard/opdi_clip_test" // SD card must be mounted by the test app
+#endif
+#define FPS 15
+#define FRAME_MS (1000 / FPS)
+#define PRE_MS (CONFIG_OPDI_CLIP_PRE_S * 1000)
+#define POST_MS (CONFIG_OPDI_CLIP_POST_S * 1000)
+
+static uint8_t s_jpeg[64 * 1024];
+static uint32_t s_now;
+
+// SOI, SOF0 (w x h), the frame number, filler, EOI
+static size_t make_frame(uint32_t no, size_t len){
+	static const uint8_t sof[] = { 0xFF,0xD8, 0xFF,0xC0,0x00,0x11,0x08, 0x01,0xE0, 0x02,0x80, 0x03,
+	                               0x01,0x22,0x00, 0x02,0x11,0x01, 0x03,0x11,0x01 };
+	memcpy(s_jpeg, sof, sizeof(sof));
+	memcpy(s_jpeg + sizeof(sof), &no, 4);
+	memset(s_jpeg + sizeof(sof) + 4, (int)(no & 0x7f), len - sizeof(sof) - 6);
+	s_jpeg[len - 2] = 0xFF; s_jpeg[len - 1] = 0xD9;
+	return len;
+}
+
+// Frames at FPS from s_now up to until_ms, the clock following them
+static void feed(uint32_t until_ms, size_t len){
+	for (; s_now < until_ms; s_now += FRAME_MS){
+		opdi_clip_test_clock(s_now);
+		opdi_clip_push_jpeg(s_jpeg, make_frame(s_now, len), s_now);
+	}
+	opdi_clip_test_clock(s_now);
+}
+
+static void clear_dir(void){
+	DIR *d = opendir(CLIP_DIR);
+	struct dirent *e;
+	char path[300];
+	while (d && (e = readdir(d)) != NULL){
+		if (e->d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", CLIP_DIR, e->d_name);
+		remove(path);
+	}
+	if (d) closedir(d);
+}
+
+static uint32_t rd32(const uint8_t *p){ return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+typedef struct { uint32_t frames, first_no, last_no, us_per_frame; uint16_t w, h; bool ordered; } avi_check_t;
+
+// Walk the file the way a player does: header counts, idx1 entries -> 00dc chunks holding JPEGs
+static void check_avi(const char *name, avi_check_t *out){
+	char path[128];
+	snprintf(path, sizeof(path), "%s/%s", CLIP_DIR, name);
+	FILE *f = fopen(path, "rb");
+	TEST_ASSERT_NOT_NULL(f);
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *b = malloc(size);
+	TEST_ASSERT_EQUAL(size, fread(b, 1, size, f));
+	fclose(f);
+	TEST_ASSERT_EQUAL_MEMORY("RIFF", b, 4);
+	TEST_ASSERT_EQUAL(size - 8, rd32(b + 4));
+	TEST_ASSERT_EQUAL_MEMORY("AVI ", b + 8, 4);
+	TEST_ASSERT_EQUAL_MEMORY("avih", b + 24, 4);
+	TEST_ASSERT_EQUAL_MEMORY("MJPG", b + 112, 4);
+	TEST_ASSERT_EQUAL_MEMORY("movi", b + 220, 4);
+	out->us_per_frame = rd32(b + 32);
+	out->frames = rd32(b + 48);
+	out->w = (uint16_t)rd32(b + 64); out->h = (uint16_t)rd32(b + 68);
+	TEST_ASSERT_EQUAL(out->frames, rd32(b + 140));     // strh length
+	uint32_t movi_len = rd32(b + 216);
+	uint8_t *idx = b + 220 + movi_len;
+	TEST_ASSERT_EQUAL_MEMORY("idx1", idx, 4);
+	TEST_ASSERT_EQUAL(out->frames * 16, rd32(idx + 4));
+	out->ordered = true;
+	uint32_t prev = 0;
+	for (uint32_t i=0; i<out->frames; i++){
+		const uint8_t *e = idx + 8 + i * 16;
+		const uint8_t *chunk = b + 220 + rd32(e + 8);
+		TEST_ASSERT_EQUAL_MEMORY("00dc", e, 4);
+		TEST_ASSERT_EQUAL_MEMORY("00dc", chunk, 4);
+		TEST_ASSERT_EQUAL(rd32(e + 12), rd32(chunk + 4));
+		TEST_ASSERT_EQUAL_HEX8(0xD8, chunk[9]);
+		TEST_ASSERT_EQUAL_HEX8(0xD9, chunk[8 + rd32(chunk + 4) - 1]);
+		uint32_t no; memcpy(&no, chunk + 8 + 21, 4);
+		if (i == 0) out->first_no = no;
+		if (i && no <= prev) out->ordered = false;
+		prev = out->last_no = no;
+	}
+	free(b);
+}
+
+static size_t list(opdi_clip_info_t *out, size_t max){
+	size_t n = 0;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_clip_list(out, max, &n));
+	return n;
+}
+
+void setUp(void){
+	mkdir(CLIP_DIR, 0775);
+	clear_dir();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_clip_init(CLIP_DIR));
+	opdi_clip_test_reset();
+	s_now = 100000;
+}
+
+void tearDown(void){
+	opdi_clip_test_reset();
+	opdi_clip_test_clock(0);
+	clear_dir();
+}
+
+static void test_clip_pre_and_post_roll(void){
+	feed(s_now + 20000, 3000);                   // more history than the pre-roll
+	uint32_t t = s_now;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_clip_trigger("Face!"));
+	feed(t + POST_MS + 2000, 3000);              // past the post-roll
+	opdi_clip_test_pump();
+	opdi_clip_stats_t st; opdi_clip_get_stats(&st);
+	TEST_ASSERT_FALSE(st.recording);
+	TEST_ASSERT_EQUAL(1, st.clips);
+	opdi_clip_info_t c[4];
+	TEST_ASSERT_EQUAL(1, list(c, 4));
+	TEST_ASSERT_EQUAL_STRING("face", c[0].reason);
+	avi_check_t a; check_avi(c[0].name, &a);
+	TEST_ASSERT_TRUE(a.ordered);
+	// First frame no earlier than trigger - pre-roll, last no later than trigger + post-roll
+	TEST_ASSERT_TRUE(a.first_no >= t - PRE_MS && a.first_no < t - PRE_MS + FRAME_MS);
+	TEST_ASSERT_TRUE(a.last_no <= t + POST_MS && a.last_no > t + POST_MS - FRAME_MS);
+	TEST_ASSERT_UINT_WITHIN(2, (PRE_MS + POST_MS) / FRAME_MS, a.frames);
+	TEST_ASSERT_EQUAL(a.frames, st.written);
+	TEST_ASSERT_EQUAL(a.frames, c[0].frames);
+	TEST_ASSERT_EQUAL(640, a.w); TEST_ASSERT_EQUAL(480, a.h);
+	TEST_ASSERT_UINT_WITHIN(1000, FRAME_MS * 1000, a.us_per_frame);
+	TEST_ASSERT_UINT_WITHIN(FRAME_MS * 2, PRE_MS + POST_MS, c[0].duration_ms);
+	// Whole write units except the tail of the file
+	TEST_ASSERT_EQUAL((c[0].bytes + CONFIG_OPDI_CLIP_WRITE_KB * 1024 - 1) / (CONFIG_OPDI_CLIP_WRITE_KB * 1024), st.writes);
+}
+
+static void test_clip_retrigger_extends(void){
+	feed(s_now + 2000, 2000);
+	uint32_t t = s_now;
+	opdi_clip_trigger("pedestrian");
+	feed(t + POST_MS / 2, 2000);
+	opdi_clip_test_pump();
+	opdi_clip_trigger("face");                   // during the clip: extends it, same file
+	uint32_t t2 = s_now;
+	feed(t + POST_MS + 1000, 2000);
+	opdi_clip_test_pump();
+	opdi_clip_stats_t st; opdi_clip_get_stats(&st);
+	TEST_ASSERT_TRUE(st.recording);              // the first post-roll is over, the second is not
+	TEST_ASSERT_EQUAL_STRING_LEN("clip_", st.active, 5);
+	opdi_clip_info_t c[4];
+	TEST_ASSERT_EQUAL(0, list(c, 4));            // being written: not listed
+	char path[128];
+	char active[OPDI_CLIP_NAME_MAX]; strcpy(active, st.active);
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, opdi_clip_path(active, path, sizeof(path)));
+	feed(t2 + POST_MS + 1000, 2000);
+	opdi_clip_test_pump();
+	TEST_ASSERT_EQUAL(1, list(c, 4));
+	TEST_ASSERT_EQUAL_STRING("pedestrian", c[0].reason);
+	TEST_ASSERT_EQUAL_STRING(active, c[0].name);
+	avi_check_t a; check_avi(c[0].name, &a);
+	TEST_ASSERT_TRUE(a.last_no > t2 + POST_MS - FRAME_MS);
+	opdi_clip_get_stats(&st);
+	TEST_ASSERT_EQUAL(2, st.triggers);
+	TEST_ASSERT_EQUAL(1, st.clips);
+}
+
+static void test_clip_max_length(void){
+	feed(s_now + PRE_MS, 1000);
+	uint32_t t = s_now;
+	opdi_clip_trigger("tamper");
+	// Triggers all along: the clip still ends CONFIG_OPDI_CLIP_MAX_S after its first frame
+	while (s_now < t + CONFIG_OPDI_CLIP_MAX_S * 1000 + 2000){
+		feed(s_now + 1000, 1000);
+		opdi_clip_trigger("tamper");
+		opdi_clip_test_pump();
+	}
+	opdi_clip_info_t c[4];
+	size_t n = list(c, 4);
+	TEST_ASSERT_TRUE(n >= 1);
+	avi_check_t a; check_avi(c[n - 1].name, &a);
+	TEST_ASSERT_TRUE(a.last_no - a.first_no <= CONFIG_OPDI_CLIP_MAX_S * 1000);
+	TEST_ASSERT_TRUE(a.last_no - a.first_no > CONFIG_OPDI_CLIP_MAX_S * 1000 - 2 * FRAME_MS);
+}
+
+// The writer stalls (card busy): capture keeps its pace, the clip loses frames instead
+static void test_clip_writer_behind_drops_not_blocks(void){
+	const size_t len = 40 * 1024;
+	feed(s_now + 1000, len);
+	opdi_clip_trigger("face");
+	int64_t t0 = esp_timer_get_time();
+	uint32_t n0 = s_now;
+	feed(s_now + 60000, len);                    // far more than the ring holds, writer not running
+	int64_t us = esp_timer_get_time() - t0;
+	uint32_t pushed = (s_now - n0) / FRAME_MS;
+	opdi_clip_stats_t st; opdi_clip_get_stats(&st);
+	TEST_ASSERT_TRUE(st.dropped > 0);
+	TEST_ASSERT_TRUE(st.ring_bytes <= CONFIG_OPDI_CLIP_RING_KB * 1024);
+	t0 = esp_timer_get_time();
+	size_t written = opdi_clip_test_pump();
+	int64_t wus = esp_timer_get_time() - t0;
+	opdi_clip_get_stats(&st);
+	TEST_ASSERT_EQUAL(written, st.written);
+	TEST_ASSERT_EQUAL(1, st.clips);
+	TEST_ASSERT_TRUE(written < pushed);
+	char msg[160];
+	snprintf(msg, sizeof(msg), "push %.1f us/frame (%u KB frames, %u dropped); writer %u frames at %.1f MB/s, slowest write %u ms",
+	         (double)us / pushed, (unsigned)(len / 1024), (unsigned)st.dropped, (unsigned)written,
+	         wus ? (double)st.bytes / wus : 0.0, (unsigned)st.write_max_ms);
+	TEST_MESSAGE(msg);
+	// Released: frames are taken again
+	uint32_t d = st.dropped;
+	feed(s_now + 1000, len);
+	opdi_clip_get_stats(&st);
+	TEST_ASSERT_EQUAL(d, st.dropped);
+}
+
+static void test_clip_list_and_names(void){
+	const char *reasons[] = { "face", "tamper", "manual" };
+	for (int i=0; i<3; i++){
+		feed(s_now + 1000, 1500);
+		opdi_clip_trigger(reasons[i]);
+		feed(s_now + POST_MS + 500, 1500);
+		opdi_clip_test_pump();
+	}
+	opdi_clip_info_t c[4];
+	TEST_ASSERT_EQUAL(3, list(c, 4));
+	TEST_ASSERT_EQUAL_STRING("manual", c[0].reason);   // newest first
+	TEST_ASSERT_EQUAL_STRING("face", c[2].reason);
+	TEST_ASSERT_TRUE(c[0].seq > c[1].seq && c[1].seq > c[2].seq);
+	TEST_ASSERT_EQUAL(2, list(c, 2));                  // the newest two
+	TEST_ASSERT_EQUAL_STRING("tamper", c[1].reason);
+	char path[128];
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_clip_path(c[0].name, path, sizeof(path)));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_clip_path("../clip_1_x.avi", path, sizeof(path)));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_clip_path("notes.txt", path, sizeof(path)));
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_clip_path("clip_99999_face.avi", path, sizeof(path)));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_clip_delete(c[1].name));
+	TEST_ASSERT_EQUAL(2, list(c, 4));
+	// A trigger with no frames after it and none before leaves no file
+	opdi_clip_test_reset();
+	opdi_clip_trigger("face");
+	s_now += POST_MS + 1000;
+	opdi_clip_test_clock(s_now);
+	opdi_clip_test_pump();
+	TEST_ASSERT_EQUAL(2, list(c, 4));
+}
+
+static void test_clip_keeps_newest(void){
+	for (int i=0; i<CONFIG_OPDI_CLIP_KEEP + 3; i++){
+		opdi_clip_test_reset();
+		feed(s_now + 200, 500);
+		opdi_clip_trigger("face");
+		s_now += POST_MS + 1;
+		opdi_clip_test_clock(s_now);
+		opdi_clip_test_pump();
+	}
+	static opdi_clip_info_t c[CONFIG_OPDI_CLIP_KEEP + 4];
+	TEST_ASSERT_EQUAL(CONFIG_OPDI_CLIP_KEEP, list(c, CONFIG_OPDI_CLIP_KEEP + 4));
+	TEST_ASSERT_EQUAL(c[0].seq - (CONFIG_OPDI_CLIP_KEEP - 1), c[CONFIG_OPDI_CLIP_KEEP - 1].seq);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_clip_pre_and_post_roll);
+	RUN_TEST(test_clip_retrigger_extends);
+	RUN_TEST(test_clip_max_length);
+	RUN_TEST(test_clip_writer_behind_drops_not_blocks);
+	RUN_TEST(test_clip_list_and_names);
+	RUN_TEST(test_clip_keeps_newest);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
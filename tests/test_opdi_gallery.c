@@ -0,0 +1,227 @@
+// Unity test + benchmark for the face gallery: SIMD vs scalar dot product, match, write-through persistence
+#include "unity.h"
+#include "opdi_gallery.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#define GAL_TEST_PATH "/tmp/opdi_gallery_test.bin"
+#else
+#define GAL_TEST_PATH "/spiffs/gallery_test.bin" // SPIFFS must be mounted by the test app
+#endif
+#define DIM OPDI_GALLERY_DIM
+
+static int8_t q[DIM] __attribute__((aligned(16)));
+static float f[DIM];
+
+static uint32_t s_rng = 12345;
+static int8_t rnd8(void){ s_rng = s_rng * 1664525u + 1013904223u; return (int8_t)(s_rng >> 24); }
+static float rndf(void){ return (float)rnd8() / 128.0f; }
+
+// Random unit-norm identity i (deterministic), quantized like a model output would be
+static void identity(uint32_t i, int8_t *out){
+	s_rng = 0x9e3779b9u * (i + 1);
+	for (size_t k=0; k<DIM; k++) f[k] = rndf();
+	opdi_gallery_quantize(f, out, DIM);
+}
+
+// The same identity seen again: the float embedding plus noise (cosine ~0.9 with the original)
+static void noisy(uint32_t i, int8_t *out){
+	identity(i, out);
+	s_rng = 777 + i;
+	for (size_t k=0; k<DIM; k++) f[k] = (float)out[k] / 127.0f + 0.3f * rndf() / 8.0f;
+	opdi_gallery_quantize(f, out, DIM);
+}
+
+static void fill(size_t n){
+	char label[OPDI_GALLERY_LABEL_LEN];
+	for (size_t i=0; i<n; i++){
+		identity(i, q);
+		snprintf(label, sizeof(label), "person %u", (unsigned)i);
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_add(label, q, NULL));
+	}
+}
+
+void setUp(void) {
+	remove(GAL_TEST_PATH);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_init(GAL_TEST_PATH));
+}
+
+void tearDown(void) {
+	opdi_gallery_deinit();
+	remove(GAL_TEST_PATH);
+}
+
+void test_gallery_dot_matches_reference(void) {
+	static int8_t a[1024 + 16] __attribute__((aligned(16))), b[1024 + 16] __attribute__((aligned(16)));
+	const size_t lens[] = { 1, 15, 16, 17, 64, 128, 500, 512, 1024 };
+	for (size_t r=0; r<3; r++){
+		for (size_t k=0; k<sizeof(a); k++){ a[k] = rnd8(); b[k] = rnd8(); }
+		for (size_t l=0; l<sizeof(lens)/sizeof(lens[0]); l++){
+			TEST_ASSERT_EQUAL_INT32(opdi_gallery_dot_s8_ref(a, b, lens[l]), opdi_gallery_dot_s8(a, b, lens[l]));
+			TEST_ASSERT_EQUAL_INT32(opdi_gallery_dot_s8_ref(a + 1, b + 3, lens[l]), opdi_gallery_dot_s8(a + 1, b + 3, lens[l]));
+		}
+	}
+	// Extremes: -128 * -128 over the longest row must not clip
+	memset(a, 0x80, sizeof(a)); memset(b, 0x80, sizeof(b));
+	TEST_ASSERT_EQUAL_INT32(1024 * 16384, opdi_gallery_dot_s8(a, b, 1024));
+	memset(b, 0x7f, sizeof(b));
+	TEST_ASSERT_EQUAL_INT32(-1024 * 16256, opdi_gallery_dot_s8(a, b, 1024));
+}
+
+void test_gallery_quantize_unit_norm(void) {
+	identity(0, q);
+	int32_t n2 = opdi_gallery_dot_s8_ref(q, q, DIM);
+	TEST_ASSERT_INT_WITHIN(127 * 127 / 50, 127 * 127, n2); // |q| within 1% of the scale
+	for (size_t k=0; k<DIM; k++) f[k] = 0.0f;
+	opdi_gallery_quantize(f, q, DIM);
+	TEST_ASSERT_EQUAL_INT32(0, opdi_gallery_dot_s8_ref(q, q, DIM));
+}
+
+void test_gallery_add_match_delete(void) {
+	opdi_gallery_match_t m;
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_gallery_match(q, &m));
+	fill(40);
+	TEST_ASSERT_EQUAL(40, opdi_gallery_count());
+
+	noisy(17, q);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+	opdi_gallery_entry_t e;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(m.id, &e, NULL));
+	TEST_ASSERT_EQUAL_STRING("person 17", e.label);
+	TEST_ASSERT_TRUE(m.matched);
+	TEST_ASSERT_TRUE(m.score > 0.8f && m.score <= 1.0f);
+	TEST_ASSERT_TRUE(m.second < 0.3f);  // random directions are near orthogonal
+	TEST_ASSERT_TRUE(m.dist > 0.0f && m.dist < 0.7f);
+
+	identity(1000, q); // never enrolled
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+	TEST_ASSERT_FALSE(m.matched);
+
+	uint16_t id17 = e.id;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_rename(id17, "Alice"));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(id17, &e, NULL));
+	TEST_ASSERT_EQUAL_STRING("Alice", e.label);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_delete(id17));
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_gallery_delete(id17));
+	TEST_ASSERT_EQUAL(39, opdi_gallery_count());
+	noisy(17, q);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+	TEST_ASSERT_FALSE(m.matched);
+	// The record moved into the hole is still found under its own id and label
+	noisy(39, q);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(m.id, &e, NULL));
+	TEST_ASSERT_EQUAL_STRING("person 39", e.label);
+
+	uint16_t id;
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_gallery_add("", q, &id));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_add("a label that is far longer than thirty-one bytes", q, &id));
+	TEST_ASSERT_TRUE(id > id17); // ids are never reused
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(id, &e, NULL));
+	TEST_ASSERT_EQUAL(OPDI_GALLERY_LABEL_LEN - 1, strlen(e.label));
+}
+
+void test_gallery_persists_across_init(void) {
+	fill(33);
+	opdi_gallery_entry_t e; static int8_t emb[DIM];
+	opdi_gallery_entry_t before[33];
+	TEST_ASSERT_EQUAL(33, opdi_gallery_list(before, 33));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_delete(before[5].id));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_rename(before[20].id, "Bob"));
+	opdi_gallery_deinit();
+
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_init(GAL_TEST_PATH));
+	TEST_ASSERT_EQUAL(32, opdi_gallery_count());
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_gallery_get(before[5].id, &e, NULL));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(before[20].id, &e, emb));
+	TEST_ASSERT_EQUAL_STRING("Bob", e.label);
+	identity(20, q);
+	TEST_ASSERT_EQUAL_INT8_ARRAY(q, emb, DIM);
+	noisy(32, q);
+	opdi_gallery_match_t m;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+	TEST_ASSERT_EQUAL(before[32].id, m.id);
+	uint16_t id;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_add("new", q, &id));
+	TEST_ASSERT_TRUE(id > before[32].id);
+
+	// A full rewrite reads back the same
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_save());
+	opdi_gallery_deinit();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_init(GAL_TEST_PATH));
+	TEST_ASSERT_EQUAL(33, opdi_gallery_count());
+}
+
+void test_gallery_capacity(void) {
+	fill(OPDI_GALLERY_CAPACITY);
+	identity(0, q);
+	TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, opdi_gallery_add("one too many", q, NULL));
+	TEST_ASSERT_EQUAL(OPDI_GALLERY_CAPACITY, opdi_gallery_count());
+}
+
+void test_gallery_benchmark(void) {
+	// Rows laid out like the gallery table; sizes past the configured capacity use the kernel directly
+	const size_t sizes[] = { 32, 256, 1024, 2048 };
+	const size_t max_rows = 2048;
+	int8_t *rows = heap_caps_aligned_alloc(16, max_rows * DIM, MALLOC_CAP_SPIRAM);
+	TEST_ASSERT_NOT_NULL(rows);
+	for (size_t k=0; k<max_rows * DIM; k++) rows[k] = rnd8();
+	identity(1, q);
+	char msg[128];
+	for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++){
+		size_t n = sizes[s];
+		const int iters = 20;
+		volatile int32_t sink = 0;
+		int64_t t0 = esp_timer_get_time();
+		for (int it=0; it<iters; it++) for (size_t i=0; i<n; i++) sink += opdi_gallery_dot_s8_ref(q, rows + i * DIM, DIM);
+		double ref_us = (double)(esp_timer_get_time() - t0) / iters;
+		t0 = esp_timer_get_time();
+		for (int it=0; it<iters; it++) for (size_t i=0; i<n; i++) sink += opdi_gallery_dot_s8(q, rows + i * DIM, DIM);
+		double simd_us = (double)(esp_timer_get_time() - t0) / iters;
+		snprintf(msg, sizeof(msg), "%4u identities x %d: scalar %.0f us, kernel %.0f us (x%.1f)",
+		         (unsigned)n, DIM, ref_us, simd_us, simd_us > 0 ? ref_us / simd_us : 0.0);
+		TEST_MESSAGE(msg);
+		(void)sink;
+	}
+	heap_caps_free(rows);
+
+	// Full match() over the stored gallery (lock, cosine, best/second) at 1024 or the capacity
+	size_t n = OPDI_GALLERY_CAPACITY < 1024 ? OPDI_GALLERY_CAPACITY : 1024;
+	fill(n);
+	noisy(n / 2, q);
+	opdi_gallery_match_t m;
+	uint32_t worst = 0, total = 0;
+	for (int it=0; it<20; it++){
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_match(q, &m));
+		total += m.scan_us;
+		if (m.scan_us > worst) worst = m.scan_us;
+	}
+	snprintf(msg, sizeof(msg), "opdi_gallery_match over %u identities: avg %u us, worst %u us",
+	         (unsigned)n, (unsigned)(total / 20), (unsigned)worst);
+	TEST_MESSAGE(msg);
+	TEST_ASSERT_TRUE(m.matched);
+	// Negligible next to detection: well under 10% of the 500 ms capture-to-event budget
+	TEST_ASSERT_TRUE(worst < 50000);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_gallery_dot_matches_reference);
+	RUN_TEST(test_gallery_quantize_unit_norm);
+	RUN_TEST(test_gallery_add_match_delete);
+	RUN_TEST(test_gallery_persists_across_init);
+	RUN_TEST(test_gallery_capacity);
+	RUN_TEST(test_gallery_benchmark);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
@@ -0,0 +1,231 @@
+// Unity test + benchmark for gallery bulk transfer: streaming JSON/base64 and .gal export/import
+#include "unity.h"
+#include "opdi_gallery.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#define GAL_TEST_PATH "/tmp/opdi_gallery_xfer_test.bin"
+#else
+#define GAL_TEST_PATH "/spiffs/gallery_test.bin" // SPIFFS must be mounted by the test app
+#endif
+#define DIM OPDI_GALLERY_DIM
+#define BENCH_N (OPDI_GALLERY_CAPACITY < 256 ? OPDI_GALLERY_CAPACITY : 256)
+
+// Growable PSRAM buffer the export writes into, standing in for the HTTP chunk sink
+typedef struct {
+	char *data;
+	size_t len, cap;
+	size_t writes;
+} sink_t;
+
+static sink_t s_out;
+
+static esp_err_t sink_write(void *ctx, const char *data, size_t len){
+	sink_t *s = ctx;
+	if (s->len + len > s->cap){
+		size_t cap = (s->len + len) * 2;
+		char *p = heap_caps_realloc(s->data, cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+		if (!p) return ESP_ERR_NO_MEM;
+		s->data = p; s->cap = cap;
+	}
+	memcpy(s->data + s->len, data, len);
+	s->len += len;
+	s->writes++;
+	return ESP_OK;
+}
+
+static opdi_gallery_record_t *recs;   // BENCH_N reference records
+
+static void make_records(size_t n){
+	uint32_t rng = 99;
+	for (size_t i=0; i<n; i++){
+		opdi_gallery_record_t *r = &recs[i];
+		memset(&r->entry, 0, sizeof(r->entry));
+		r->entry.id = (uint16_t)(10 + 3 * i);   // sparse ids must survive the round trip
+		r->entry.created = 1700000000u + (uint32_t)i;
+		snprintf(r->entry.label, sizeof(r->entry.label), i % 5 ? "person %u" : "q\"uote\\d {%u}", (unsigned)i);
+		for (size_t k=0; k<DIM; k++){ rng = rng * 1664525u + 1013904223u; r->emb[k] = (int8_t)(rng >> 24); }
+	}
+}
+
+static void store(size_t n){
+	for (size_t i=0; i<n; i+=OPDI_GALLERY_BATCH_MAX){
+		size_t k = n - i < OPDI_GALLERY_BATCH_MAX ? n - i : OPDI_GALLERY_BATCH_MAX;
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_put_batch(&recs[i], k));
+	}
+}
+
+static void check_same(size_t n){
+	static opdi_gallery_record_t r;
+	TEST_ASSERT_EQUAL(n, opdi_gallery_count());
+	for (size_t i=0; i<n; i++){
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get_at(i, &r));
+		TEST_ASSERT_EQUAL(recs[i].entry.id, r.entry.id);
+		TEST_ASSERT_EQUAL(recs[i].entry.created, r.entry.created);
+		TEST_ASSERT_EQUAL_STRING(recs[i].entry.label, r.entry.label);
+		TEST_ASSERT_EQUAL_MEMORY(recs[i].emb, r.emb, DIM);
+	}
+}
+
+// Feed s_out in pieces of `chunk` bytes
+static esp_err_t import_all(opdi_gallery_fmt_t fmt, bool replace, size_t chunk, size_t *n){
+	opdi_gallery_import_t *im;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_import_begin(fmt, replace, &im));
+	esp_err_t err = ESP_OK;
+	for (size_t off=0; off<s_out.len && err == ESP_OK; off+=chunk){
+		err = opdi_gallery_import_feed(im, s_out.data + off, s_out.len - off < chunk ? s_out.len - off : chunk);
+	}
+	esp_err_t end = opdi_gallery_import_end(im, n);
+	return err != ESP_OK ? err : end;
+}
+
+void setUp(void) {
+	remove(GAL_TEST_PATH);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_init(GAL_TEST_PATH));
+	if (!recs) recs = heap_caps_malloc(BENCH_N * sizeof(*recs), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	TEST_ASSERT_NOT_NULL(recs);
+	make_records(BENCH_N);
+	s_out.len = s_out.writes = 0;
+}
+
+void tearDown(void) {
+	opdi_gallery_deinit();
+	remove(GAL_TEST_PATH);
+}
+
+static void roundtrip(opdi_gallery_fmt_t fmt, size_t chunk){
+	store(40);
+	size_t n;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_export(fmt, sink_write, &s_out, &n));
+	TEST_ASSERT_EQUAL(40, n);
+	// Streamed: many small writes, never the whole document at once
+	TEST_ASSERT_GREATER_THAN(40, s_out.writes);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_clear());
+	TEST_ASSERT_EQUAL(ESP_OK, import_all(fmt, true, chunk, &n));
+	TEST_ASSERT_EQUAL(40, n);
+	check_same(40);
+	// And it persisted
+	opdi_gallery_deinit();
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_init(GAL_TEST_PATH));
+	check_same(40);
+}
+
+void test_gallery_xfer_json_roundtrip(void) {
+	roundtrip(OPDI_GALLERY_FMT_JSON, 700);
+}
+
+void test_gallery_xfer_json_bytewise(void) {
+	// One byte at a time: records and escaped braces/quotes split at every position
+	roundtrip(OPDI_GALLERY_FMT_JSON, 1);
+}
+
+void test_gallery_xfer_gal_roundtrip(void) {
+	roundtrip(OPDI_GALLERY_FMT_GAL, 333);
+}
+
+void test_gallery_xfer_merge_keeps_ids(void) {
+	store(5);
+	size_t n;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_export(OPDI_GALLERY_FMT_JSON, sink_write, &s_out, &n));
+	// Local changes after the export are overwritten for the same ids; other identities stay
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_rename(recs[0].entry.id, "renamed"));
+	uint16_t local;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_add("local", recs[9].emb, &local));
+	TEST_ASSERT_TRUE(local > recs[4].entry.id);
+	TEST_ASSERT_EQUAL(ESP_OK, import_all(OPDI_GALLERY_FMT_JSON, false, 512, &n));
+	TEST_ASSERT_EQUAL(5, n);
+	TEST_ASSERT_EQUAL(6, opdi_gallery_count());
+	opdi_gallery_entry_t e;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(recs[0].entry.id, &e, NULL));
+	TEST_ASSERT_EQUAL_STRING(recs[0].entry.label, e.label);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_get(local, &e, NULL));
+	// Imported ids are never handed out again
+	uint16_t id;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_add("new", recs[9].emb, &id));
+	TEST_ASSERT_TRUE(id > local);
+}
+
+void test_gallery_xfer_rejects(void) {
+	store(3);
+	size_t n;
+	// .gal of another embedding length: nothing is touched even in replace mode
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_export(OPDI_GALLERY_FMT_GAL, sink_write, &s_out, &n));
+	uint16_t dim = DIM + 16;
+	memcpy(s_out.data + 6, &dim, 2);
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, import_all(OPDI_GALLERY_FMT_GAL, true, 4096, &n));
+	TEST_ASSERT_EQUAL(3, opdi_gallery_count());
+
+	// A short embedding
+	s_out.len = 0;
+	const char *bad = "{\"identities\":[{\"id\":5,\"label\":\"x\",\"emb\":\"AAAA\"}]}";
+	sink_write(&s_out, bad, strlen(bad));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, import_all(OPDI_GALLERY_FMT_JSON, false, 16, &n));
+	// Not JSON at all
+	s_out.len = 0;
+	sink_write(&s_out, "OPGL", 4);
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, import_all(OPDI_GALLERY_FMT_JSON, false, 16, &n));
+
+	// Cut off mid-document: whole records before the cut are kept, the end reports the short body
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_clear());
+	store(40);
+	s_out.len = 0;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_export(OPDI_GALLERY_FMT_GAL, sink_write, &s_out, &n));
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_clear());
+	s_out.len -= 100;
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, import_all(OPDI_GALLERY_FMT_GAL, false, 1000, &n));
+	TEST_ASSERT_EQUAL(39, n);
+	TEST_ASSERT_EQUAL(39, opdi_gallery_count());
+}
+
+void test_gallery_xfer_benchmark(void) {
+	const opdi_gallery_fmt_t fmts[] = { OPDI_GALLERY_FMT_JSON, OPDI_GALLERY_FMT_GAL };
+	const char *names[] = { "json", "gal" };
+	char msg[160];
+	store(BENCH_N);
+	for (int f=0; f<2; f++){
+		size_t n;
+		s_out.len = s_out.writes = 0;
+		int64_t t0 = esp_timer_get_time();
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_gallery_export(fmts[f], sink_write, &s_out, &n));
+		int64_t exp_us = esp_timer_get_time() - t0;
+		TEST_ASSERT_EQUAL(BENCH_N, n);
+		// Import in TCP-segment sized pieces, as the HTTP handler receives them
+		t0 = esp_timer_get_time();
+		TEST_ASSERT_EQUAL(ESP_OK, import_all(fmts[f], true, 1436, &n));
+		int64_t imp_us = esp_timer_get_time() - t0;
+		TEST_ASSERT_EQUAL(BENCH_N, n);
+		double exp_rps = (double)BENCH_N * 1e6 / (double)(exp_us ? exp_us : 1);
+		double imp_rps = (double)BENCH_N * 1e6 / (double)(imp_us ? imp_us : 1);
+		snprintf(msg, sizeof(msg), "%s: %u records, %u bytes: export %.0f rec/s, import %.0f rec/s (batch %d)",
+		         names[f], (unsigned)BENCH_N, (unsigned)s_out.len, exp_rps, imp_rps, CONFIG_OPDI_GALLERY_IMPORT_BATCH);
+		TEST_MESSAGE(msg);
+		// Cloning a full 1024-identity gallery must not take minutes, even through SPIFFS
+		TEST_ASSERT_GREATER_THAN(50, (int)imp_rps);
+	}
+	check_same(BENCH_N);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_gallery_xfer_json_roundtrip);
+	RUN_TEST(test_gallery_xfer_json_bytewise);
+	RUN_TEST(test_gallery_xfer_gal_roundtrip);
+	RUN_TEST(test_gallery_xfer_merge_keeps_ids);
+	RUN_TEST(test_gallery_xfer_rejects);
+	RUN_TEST(test_gallery_xfer_benchmark);
+	int fails = UNITY_END();
+	heap_caps_free(recs);
+	heap_caps_free(s_out.data);
+	return fails;
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
@@ -0,0 +1,341 @@
+// Unity test for the MQTT publisher: batching, the QoS 1 window, the offline queue across link drops,
+// metrics snapshots. Events enter through the /ws bus like on the device; a fake client records the
+// publishes. The last test talks to a real broker (mosquitto on 127.0.0.1:1883, or
+// OPDI_MQTT_TEST_BROKER) and is ignored when none answers.
+#include "unity.h"
+#include "opdi_mqtt.h"
+#include "opdi_api_ws.h"
+#include "opdi_api_json.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENTS_TOPIC  CONFIG_OPDI_TOPIC_PREFIX "/face/events"
+#define METRICS_TOPIC CONFIG_OPDI_TOPIC_PREFIX "/system/metrics"
+
+// Fake client: last publish per topic, message ids from 1, optional immediate ack or refusal
+static char s_last[CONFIG_OPDI_MQTT_BATCH_BYTES + 1], s_metrics[2048];
+static int s_last_qos, s_next_id, s_pubs, s_metric_pubs;
+static bool s_auto_ack, s_refuse;
+// Sequence check over every event published: "seq" values must be consecutive
+static int s_seq_first, s_seq_last, s_seq_gaps;
+
+static void track_seqs(const char *data){
+	for (const char *p = data; (p = strstr(p, "\"seq\":")) != NULL; p += 6) {
+		int seq = atoi(p + 6);
+		if (s_seq_last >= 0 && seq != s_seq_last + 1) s_seq_gaps++;
+		if (s_seq_first < 0) s_seq_first = seq;
+		s_seq_last = seq;
+	}
+}
+
+static int fake_pub(const char *topic, const char *data, size_t len, int qos){
+	if (s_refuse) return -1;
+	if (!strcmp(topic, METRICS_TOPIC)) {
+		TEST_ASSERT_EQUAL(0, qos);
+		TEST_ASSERT_LESS_THAN(sizeof(s_metrics), len);
+		memcpy(s_metrics, data, len); s_metrics[len] = 0;
+		s_metric_pubs++;
+		return 0;
+	}
+	TEST_ASSERT_EQUAL_STRING(EVENTS_TOPIC, topic);
+	TEST_ASSERT_LESS_OR_EQUAL(CONFIG_OPDI_MQTT_BATCH_BYTES, len);
+	memcpy(s_last, data, len); s_last[len] = 0;
+	s_last_qos = qos;
+	s_pubs++;
+	track_seqs(s_last);
+	int id = qos ? ++s_next_id : 0;
+	// PUBACK before publish() returns: the race the publisher has to handle
+	if (s_auto_ack && qos) opdi_mqtt_test_ack(id);
+	return id;
+}
+
+static void drain_ws(void){
+	while (opdi_api_ws_test_next_frame(NULL, 0)) { }
+}
+
+// Through the /ws bus, like Camera.cpp; the WS queue is emptied so it never fills up
+static void ev(int seq, int pad){
+	char js[CONFIG_OPDI_MQTT_BATCH_BYTES];
+	int n = snprintf(js, sizeof(js), "{\"type\":\"recognize\",\"seq\":%d,\"pad\":\"%0*d\"}", seq, pad, 0);
+	opdi_api_ws_publish("recognize", js, (size_t)n);
+	drain_ws();
+}
+
+static void ws_event(const char *topic, const char *json){
+	opdi_api_ws_publish(topic, json, strlen(json));
+	drain_ws();
+}
+
+static opdi_mqtt_stats_t stats(void){
+	opdi_mqtt_stats_t st;
+	opdi_mqtt_get_stats(&st);
+	return st;
+}
+
+void setUp(void) {
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_mqtt_init());
+	opdi_mqtt_test_reset();
+	opdi_mqtt_test_transport(fake_pub);
+	drain_ws();
+	s_last[0] = s_metrics[0] = 0;
+	s_next_id = s_pubs = s_metric_pubs = 0;
+	s_auto_ack = s_refuse = false;
+	s_seq_first = s_seq_last = -1; s_seq_gaps = 0;
+}
+
+void tearDown(void) {
+	opdi_mqtt_test_transport(NULL);
+}
+
+void test_mqtt_batches_queued_events(void) {
+	for (int i=1; i<=3; i++) ev(i, 1);
+	TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());     // no broker yet
+	TEST_ASSERT_EQUAL(3, stats().queued);
+	opdi_mqtt_test_link(true);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL_STRING("[{\"type\":\"recognize\",\"seq\":1,\"pad\":\"0\"},"
+	                         "{\"type\":\"recognize\",\"seq\":2,\"pad\":\"0\"},"
+	                         "{\"type\":\"recognize\",\"seq\":3,\"pad\":\"0\"}]", s_last);
+	TEST_ASSERT_EQUAL(CONFIG_OPDI_MQTT_QOS, s_last_qos);
+	opdi_mqtt_stats_t st = stats();
+	TEST_ASSERT_EQUAL(3, st.batched);
+	if (CONFIG_OPDI_MQTT_QOS) {
+		// Kept until the broker acknowledges
+		TEST_ASSERT_EQUAL(3, st.queued);
+		TEST_ASSERT_EQUAL(1, st.inflight);
+		opdi_mqtt_test_ack(1);
+	}
+	TEST_ASSERT_EQUAL(0, stats().queued);
+	TEST_ASSERT_EQUAL(0, stats().inflight);
+	// A lone event goes unchanged
+	ev(4, 1);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL_STRING("{\"type\":\"recognize\",\"seq\":4,\"pad\":\"0\"}", s_last);
+	// Other channels are not events
+	ws_event("cam.ir", "{\"type\":\"cam.ir\",\"mode\":1}");
+	TEST_ASSERT_EQUAL(4, stats().events);
+}
+
+void test_mqtt_window_limits_inflight(void) {
+	if (!CONFIG_OPDI_MQTT_QOS) TEST_IGNORE_MESSAGE("QoS 0: no acknowledgement window");
+	// Each event over half the payload cap: one per publish
+	const int pad = CONFIG_OPDI_MQTT_BATCH_BYTES / 2 + 1, n = CONFIG_OPDI_MQTT_INFLIGHT + 2;
+	opdi_mqtt_test_link(true);
+	for (int i=0; i<n; i++) ev(i, pad);
+	TEST_ASSERT_EQUAL(CONFIG_OPDI_MQTT_INFLIGHT, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL(CONFIG_OPDI_MQTT_INFLIGHT, stats().inflight);
+	if (CONFIG_OPDI_MQTT_INFLIGHT > 1) {
+		// Acks out of order: nothing is released before the oldest publish is acknowledged
+		opdi_mqtt_test_ack(2);
+		TEST_ASSERT_EQUAL(n, stats().queued);
+		TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());
+	}
+	opdi_mqtt_test_ack(1);
+	int freed = CONFIG_OPDI_MQTT_INFLIGHT > 1 ? 2 : 1;
+	TEST_ASSERT_EQUAL(n - freed, stats().queued);
+	TEST_ASSERT_EQUAL(freed, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL(0, s_seq_gaps);
+}
+
+void test_mqtt_link_drop_resends_unacked(void) {
+	opdi_mqtt_test_link(true);
+	ev(1, 1); ev(2, 1);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	opdi_mqtt_test_link(false);
+	if (CONFIG_OPDI_MQTT_QOS) TEST_ASSERT_EQUAL(2, stats().resent);
+	// The ack of the dead session never comes; a late one must not release anything
+	opdi_mqtt_test_ack(1);
+	ev(3, 1);
+	TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());
+	opdi_mqtt_test_link(true);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	if (CONFIG_OPDI_MQTT_QOS) {
+		// Unacknowledged events first, then the one queued while offline
+		TEST_ASSERT_EQUAL_STRING("[{\"type\":\"recognize\",\"seq\":1,\"pad\":\"0\"},"
+		                         "{\"type\":\"recognize\",\"seq\":2,\"pad\":\"0\"},"
+		                         "{\"type\":\"recognize\",\"seq\":3,\"pad\":\"0\"}]", s_last);
+		opdi_mqtt_test_ack(2);
+	}
+	TEST_ASSERT_EQUAL(0, stats().queued);
+	TEST_ASSERT_EQUAL(2, stats().connects);
+}
+
+void test_mqtt_expired_publish_is_resent(void) {
+	if (!CONFIG_OPDI_MQTT_QOS) TEST_IGNORE_MESSAGE("QoS 0: nothing expires");
+	opdi_mqtt_test_link(true);
+	ev(1, 1);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	ev(2, 1);
+	int sent = (int)opdi_mqtt_test_pump();      // 1 with room in the window, 0 without
+	// The client's outbox dropped msg 1 unacknowledged: it and everything after it go again
+	opdi_mqtt_test_expire(1);
+	opdi_mqtt_stats_t st = stats();
+	TEST_ASSERT_EQUAL(0, st.inflight);
+	TEST_ASSERT_EQUAL(2, st.queued);
+	TEST_ASSERT_EQUAL(1 + sent, st.resent);
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL_STRING("[{\"type\":\"recognize\",\"seq\":1,\"pad\":\"0\"},"
+	                         "{\"type\":\"recognize\",\"seq\":2,\"pad\":\"0\"}]", s_last);
+	// Acks of the rewound publishes release nothing; the resend's does
+	if (sent) opdi_mqtt_test_ack(2);
+	TEST_ASSERT_EQUAL(2, stats().queued);
+	opdi_mqtt_test_ack(s_next_id);
+	TEST_ASSERT_EQUAL(0, stats().queued);
+	TEST_ASSERT_EQUAL(0, stats().inflight);
+}
+
+void test_mqtt_offline_queue_drops_oldest(void) {
+	// About twice the queue while offline: the newest events survive
+	const int n = CONFIG_OPDI_MQTT_QUEUE_BYTES / 30;
+	int64_t t0 = esp_timer_get_time();
+	for (int i=0; i<n; i++) ev(i, 10);
+	int64_t t_queue = esp_timer_get_time() - t0;
+	opdi_mqtt_stats_t st = stats();
+	TEST_ASSERT_EQUAL(n, st.events);
+	TEST_ASSERT_TRUE(st.dropped > 0);
+	TEST_ASSERT_EQUAL(n, st.queued + st.dropped);
+	TEST_ASSERT_LESS_OR_EQUAL(CONFIG_OPDI_MQTT_QUEUE_BYTES, st.queue_hw_bytes);
+
+	s_auto_ack = true;
+	opdi_mqtt_test_link(true);
+	t0 = esp_timer_get_time();
+	size_t pubs = opdi_mqtt_test_pump();
+	int64_t t_send = esp_timer_get_time() - t0;
+	TEST_ASSERT_EQUAL(0, stats().queued);
+	TEST_ASSERT_EQUAL(0, s_seq_gaps);
+	TEST_ASSERT_EQUAL(st.dropped, s_seq_first);
+	TEST_ASSERT_EQUAL(n - 1, s_seq_last);
+	// Backlog drained in full batches
+	TEST_ASSERT_LESS_OR_EQUAL(st.queued / CONFIG_OPDI_MQTT_BATCH_MAX + 1, pubs);
+	char msg[160];
+	snprintf(msg, sizeof(msg), "%d events: %.2f us/event queued, backlog of %u sent in %u publishes, %.2f us/event",
+	         n, (double)t_queue / n, (unsigned)st.queued, (unsigned)pubs, (double)t_send / st.queued);
+	TEST_MESSAGE(msg);
+}
+
+void test_mqtt_refused_publish_is_retried(void) {
+	opdi_mqtt_test_link(true);
+	ev(1, 1);
+	s_refuse = true;
+	TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL(1, stats().failed);
+	TEST_ASSERT_EQUAL(1, stats().queued);
+	TEST_ASSERT_EQUAL(0, stats().inflight);
+	s_refuse = false;
+	TEST_ASSERT_EQUAL(1, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL_STRING("{\"type\":\"recognize\",\"seq\":1,\"pad\":\"0\"}", s_last);
+}
+
+void test_mqtt_metrics_snapshot(void) {
+	ws_event("cam.telemetry", "{\"type\":\"cam.telemetry\",\"fps\":25}");
+	opdi_mqtt_test_link(true);                       // a new session publishes one right away
+	opdi_mqtt_test_pump();
+	TEST_ASSERT_EQUAL(1, s_metric_pubs);
+	TEST_MESSAGE(s_metrics);
+	opdi_json_tok_t toks[64];
+	size_t n;
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_json_tokenize(s_metrics, strlen(s_metrics), toks, 64, &n));
+	TEST_ASSERT_EQUAL(OPDI_JSON_OBJ, toks[0].type);
+	TEST_ASSERT_NOT_NULL(strstr(s_metrics, "{\"type\":\"metrics\",\"uptime_s\":"));
+	TEST_ASSERT_NOT_NULL(strstr(s_metrics, "\"net\":{\"state\":"));
+	TEST_ASSERT_NOT_NULL(strstr(s_metrics, "\"mqtt\":{\"queued\":0,"));
+	TEST_ASSERT_NOT_NULL(strstr(s_metrics, "\"cam\":{\"type\":\"cam.telemetry\",\"fps\":25}}"));
+	// Network events trigger a fresh snapshot; they are not face events
+	ws_event(NULL, "{\"type\":\"net\",\"sub\":\"sta_disconnected\"}");
+	TEST_ASSERT_EQUAL(0, opdi_mqtt_test_pump());
+	TEST_ASSERT_EQUAL(2, s_metric_pubs);
+	TEST_ASSERT_EQUAL(0, stats().events);
+	// Offline: no snapshot
+	opdi_mqtt_test_link(false);
+	ws_event(NULL, "{\"type\":\"net\",\"sub\":\"ap_active\"}");
+	opdi_mqtt_test_pump();
+	TEST_ASSERT_EQUAL(2, s_metric_pubs);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+static bool wait_for(bool (*cond)(void), int ms){
+	for (int t=0; t<ms && !cond(); t+=20) vTaskDelay(pdMS_TO_TICKS(20));
+	return cond();
+}
+static bool is_connected(void) { return stats().connected; }
+static bool is_disconnected(void) { return !stats().connected; }
+static bool all_acked(void) { return stats().queued == 0; }
+#endif
+
+void test_mqtt_broker_roundtrip(void) {
+#if CONFIG_IDF_TARGET_LINUX
+	const char *uri = getenv("OPDI_MQTT_TEST_BROKER");
+	if (!uri) uri = "mqtt://127.0.0.1:1883";
+	char cmd[256];
+	// The subscriber prints each payload on its own line and exits after three
+	snprintf(cmd, sizeof(cmd), "mosquitto_sub -L '%s/%s' -C 3 -W 20 2>/dev/null", uri, EVENTS_TOPIC);
+	FILE *sub = popen(cmd, "r");
+	if (!sub) TEST_IGNORE_MESSAGE("mosquitto_sub not available");
+	opdi_mqtt_test_transport(NULL);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_mqtt_start(uri));
+	if (!wait_for(is_connected, 3000)) {
+		opdi_mqtt_stop();
+		pclose(sub);
+		TEST_IGNORE_MESSAGE("no MQTT broker at " "$OPDI_MQTT_TEST_BROKER / 127.0.0.1:1883");
+	}
+	vTaskDelay(pdMS_TO_TICKS(500));                  // subscriber in place
+
+	// Lone event, acknowledged by the broker
+	ev(1, 1);
+	TEST_ASSERT_TRUE(wait_for(all_acked, 3000));
+	// A burst shares a publish
+	for (int i=2; i<=6; i++) ev(i, 1);
+	TEST_ASSERT_TRUE(wait_for(all_acked, 3000));
+	// Broker gone: queued, then delivered by the next session
+	opdi_mqtt_stop();
+	TEST_ASSERT_TRUE(wait_for(is_disconnected, 2000));
+	ev(7, 1);
+	TEST_ASSERT_EQUAL(1, stats().queued);
+	TEST_ASSERT_EQUAL(ESP_OK, opdi_mqtt_start(uri));
+	TEST_ASSERT_TRUE(wait_for(is_connected, 3000));
+	TEST_ASSERT_TRUE(wait_for(all_acked, 3000));
+
+	char line[512];
+	TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), sub));
+	TEST_ASSERT_EQUAL_STRING("{\"type\":\"recognize\",\"seq\":1,\"pad\":\"0\"}\n", line);
+	TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), sub));
+	TEST_ASSERT_EQUAL('[', line[0]);
+	TEST_ASSERT_NOT_NULL(strstr(line, "\"seq\":2,"));
+	TEST_ASSERT_NOT_NULL(strstr(line, "\"seq\":6,"));
+	TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), sub));
+	TEST_ASSERT_EQUAL_STRING("{\"type\":\"recognize\",\"seq\":7,\"pad\":\"0\"}\n", line);
+	pclose(sub);
+	opdi_mqtt_stop();
+	opdi_mqtt_stats_t st = stats();
+	TEST_ASSERT_EQUAL(3, st.publishes);
+	TEST_ASSERT_EQUAL(0, st.dropped);
+#else
+	TEST_IGNORE_MESSAGE("host only (needs a broker next to the test runner)");
+#endif
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_mqtt_batches_queued_events);
+	RUN_TEST(test_mqtt_window_limits_inflight);
+	RUN_TEST(test_mqtt_link_drop_resends_unacked);
+	RUN_TEST(test_mqtt_expired_publish_is_resent);
+	RUN_TEST(test_mqtt_offline_queue_drops_oldest);
+	RUN_TEST(test_mqtt_refused_publish_is_retried);
+	RUN_TEST(test_mqtt_metrics_snapshot);
+	RUN_TEST(test_mqtt_broker_roundtrip);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
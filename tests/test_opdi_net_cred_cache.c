@@ -0,0 +1,88 @@
+#include "unity.h"
+#include "opdi_net.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CONFIG_OPDI_NET_TESTING
+#warning "Tests require CONFIG_OPDI_NET_TESTING=y"
+#endif
+
+// Credential cache: with the profile table full, reconnects and REST listings must not touch NVS.
+
+extern size_t opdi_net_profiles_serialize(char *out, size_t out_cap);
+extern esp_err_t opdi_net_forget_hash_tail(const char *partial_id);
+
+static char json[2048];
+static bool inited;
+
+static int count_entries(void){
+    opdi_net_profiles_serialize(json, sizeof(json));
+    int n=0; for (char *p=json; *p; ++p) if (strncmp(p, "\"ssid_len\"", 10)==0) n++;
+    return n;
+}
+
+static void add_prof(int i){
+    opdi_net_profile_t p = {0};
+    snprintf(p.ssid, sizeof(p.ssid), "cache-net-%02d", i);
+    snprintf(p.psk, sizeof(p.psk), "secret-%02d", i);
+    p.auth = 3; // WPA2_PSK
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_add_profile(&p));
+}
+
+void setUp(void) {
+    if (!inited) { TEST_ASSERT_EQUAL(ESP_OK, opdi_net_init()); inited = true; }
+}
+
+void tearDown(void) {
+}
+
+void test_fill_table_to_max(void) {
+    for (int i=0; i<CONFIG_OPDI_NET_MAX_PROFILES; i++) add_prof(i);
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_NET_MAX_PROFILES, count_entries());
+    // Re-adding an existing SSID updates in place
+    add_prof(0);
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_NET_MAX_PROFILES, count_entries());
+}
+
+void test_reconnect_does_no_nvs_reads(void) {
+    const int cycles = 10;
+    uint32_t before = opdi_net_test_nvs_ops();
+    for (int i=0; i<cycles; i++) {
+        opdi_net_test_simulate_sta_connected("10.0.0.9", "10.0.0.1", -40);
+        opdi_net_test_simulate_sta_disconnected(8); // ASSOC_LEAVE -> attempt_next_profile(NULL)
+    }
+    uint32_t ops = opdi_net_test_nvs_ops() - before;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%d profiles, %d reconnects: %u NVS ops", CONFIG_OPDI_NET_MAX_PROFILES, cycles, (unsigned)ops);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(0, ops);
+    TEST_ASSERT_EQUAL(NET_STA_CONNECT, opdi_net_get_state());
+}
+
+void test_listing_and_forget_served_from_cache(void) {
+    uint32_t before = opdi_net_test_nvs_ops();
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_NET_MAX_PROFILES, count_entries());
+    TEST_ASSERT_EQUAL_UINT32(0, opdi_net_test_nvs_ops() - before);
+    // Forget one by its displayed id; the cache drops it along with the NVS blob
+    char *id = strstr(json, "\"id\":\"");
+    TEST_ASSERT_NOT_NULL(id);
+    char tail[9] = {0}; memcpy(tail, id + 6, 8);
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_forget_hash_tail(tail));
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_NET_MAX_PROFILES - 1, count_entries());
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, opdi_net_forget_hash_tail(tail));
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_table_to_max);
+    RUN_TEST(test_reconnect_does_no_nvs_reads);
+    RUN_TEST(test_listing_and_forget_served_from_cache);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
@@ -0,0 +1,83 @@
+#include "unity.h"
+#include "opdi_net.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CONFIG_OPDI_NET_TESTING
+#warning "Tests require CONFIG_OPDI_NET_TESTING=y"
+#endif
+
+// Fast reconnect: BSSID/channel cached on GOT_IP, directed single-channel attempt first,
+// full-scan fallback when the hint is stale, time-to-IP in the metrics.
+
+extern size_t opdi_net_profiles_serialize(char *out, size_t out_cap);
+
+static const uint8_t BSSID_A[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+static const uint8_t BSSID_B[6] = { 0x02, 0x66, 0x77, 0x88, 0x99, 0xaa };
+static char json[512];
+
+static opdi_net_metrics_t metrics(void){ opdi_net_metrics_t m; opdi_net_get_metrics(&m); return m; }
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_first_connect_full_scan_then_hint_saved(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_init());
+    opdi_net_profile_t p = {0};
+    strcpy(p.ssid, "fast-net"); strcpy(p.psk, "password1"); p.auth = 3;
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_add_profile(&p));
+    // No hint yet: the MRU attempt is a full scan
+    opdi_net_test_force_state(NET_STA_CONNECT);
+    opdi_net_test_simulate_sta_disconnected(201); // NO_AP_FOUND
+    TEST_ASSERT_EQUAL_UINT32(0, metrics().directed_attempts);
+    opdi_net_test_simulate_got_ip("10.0.0.7", BSSID_A, 6);
+    TEST_ASSERT_EQUAL(NET_STA_CONNECTED, opdi_net_get_state());
+    opdi_net_profiles_serialize(json, sizeof(json));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"ch\":6"));
+    opdi_net_metrics_t m = metrics();
+    TEST_ASSERT_GREATER_THAN(0, m.boot_to_ip_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(m.boot_to_ip_ms, m.last_time_to_ip_ms);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "boot-to-IP %u ms, attempt-to-IP %u ms", (unsigned)m.boot_to_ip_ms, (unsigned)m.last_time_to_ip_ms);
+    TEST_MESSAGE(msg);
+}
+
+void test_reconnect_is_directed(void) {
+    uint32_t before = metrics().directed_attempts;
+    opdi_net_test_simulate_sta_disconnected(8); // link lost while connected
+    TEST_ASSERT_EQUAL(NET_STA_CONNECT, opdi_net_get_state());
+    TEST_ASSERT_EQUAL_UINT32(before + 1, metrics().directed_attempts);
+}
+
+void test_stale_hint_falls_back_and_is_replaced(void) {
+    opdi_net_metrics_t m0 = metrics();
+    // The directed attempt fails (AP moved): next try is a full scan, not another directed one
+    opdi_net_test_simulate_sta_disconnected(201);
+    opdi_net_metrics_t m1 = metrics();
+    TEST_ASSERT_EQUAL_UINT32(m0.directed_fallbacks + 1, m1.directed_fallbacks);
+    TEST_ASSERT_EQUAL_UINT32(m0.directed_attempts, m1.directed_attempts);
+    // Full scan finds the AP on another BSSID/channel; that becomes the new hint
+    opdi_net_test_simulate_got_ip("10.0.0.8", BSSID_B, 11);
+    opdi_net_profiles_serialize(json, sizeof(json));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"ch\":11"));
+    opdi_net_test_simulate_sta_disconnected(8);
+    TEST_ASSERT_EQUAL_UINT32(m1.directed_attempts + 1, metrics().directed_attempts);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_connect_full_scan_then_hint_saved);
+    RUN_TEST(test_reconnect_is_directed);
+    RUN_TEST(test_stale_hint_falls_back_and_is_replaced);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
@@ -0,0 +1,136 @@
+#include "unity.h"
+#include "opdi_net.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CONFIG_OPDI_NET_TESTING
+#warning "Tests require CONFIG_OPDI_NET_TESTING=y"
+#endif
+
+// Shared scan service: concurrent callers coalesce onto one radio scan, results are cached with a
+// TTL, completion is pushed through opdi_net_emit_scan (the net.scan WS event).
+
+static int s_emits;
+static size_t s_emit_count;
+void opdi_net_emit_scan(const opdi_net_scan_ap_t *aps, size_t count) { (void)aps; s_emits++; s_emit_count = count; }
+
+static opdi_net_scan_ap_t ap(const char *ssid, int rssi, uint8_t ch){
+    opdi_net_scan_ap_t a = {0};
+    strcpy(a.ssid, ssid); a.rssi = (int8_t)rssi; a.auth = 3; a.channel = ch;
+    a.bssid[0] = 0x02; a.bssid[5] = ch;
+    return a;
+}
+
+static uint32_t scans(void){ opdi_net_metrics_t m; opdi_net_get_metrics(&m); return m.scan_count; }
+
+static void wait_ms(uint32_t ms){
+    int64_t until = esp_timer_get_time() + (int64_t)ms * 1000;
+    while (esp_timer_get_time() < until) { }
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_boot_without_profiles_starts_bootstrap_scan(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_init());
+    // No profiles: scan-before-AP goes through the service, nothing cached yet
+    TEST_ASSERT_TRUE(opdi_net_scan_in_progress());
+    uint32_t age = 0;
+    opdi_net_scan_ap_t out[4];
+    TEST_ASSERT_EQUAL(0, opdi_net_scan_results(out, 4, &age));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, age);
+}
+
+void test_concurrent_requests_share_one_scan(void) {
+    const int callers = 4; // e.g. two REST tabs, the settings app, the AP self-check (+ the bootstrap scan)
+    uint32_t before = scans();
+    for (int i=0; i<callers; i++) TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, opdi_net_scan_request(CONFIG_OPDI_NET_SCAN_TTL_MS));
+    TEST_ASSERT_TRUE(opdi_net_scan_in_progress());
+    const opdi_net_scan_ap_t recs[] = { ap("weak", -80, 1), ap("strong", -40, 6), ap("below-floor", -99, 11), ap("mid", -60, 11) };
+    opdi_net_test_simulate_scan_done(recs, sizeof(recs)/sizeof(recs[0]));
+    TEST_ASSERT_FALSE(opdi_net_scan_in_progress());
+    TEST_ASSERT_EQUAL_UINT32(before + 1, scans());
+    TEST_ASSERT_EQUAL(1, s_emits);
+    TEST_ASSERT_EQUAL(3, s_emit_count);
+    char msg[80];
+    snprintf(msg, sizeof(msg), "%d concurrent requests -> %u radio scan(s)", callers + 1, (unsigned)(scans() - before));
+    TEST_MESSAGE(msg);
+}
+
+void test_results_sorted_and_filtered(void) {
+    opdi_net_scan_ap_t out[8];
+    uint32_t age = UINT32_MAX;
+    size_t n = opdi_net_scan_results(out, 8, &age);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL_STRING("strong", out[0].ssid);
+    TEST_ASSERT_EQUAL_STRING("mid", out[1].ssid);
+    TEST_ASSERT_EQUAL_STRING("weak", out[2].ssid);
+    TEST_ASSERT_EQUAL_UINT8(6, out[0].channel);
+    TEST_ASSERT_LESS_THAN_UINT32(1000, age);
+    // Caller's cap is honoured (scan_summary takes the top 16 this way)
+    TEST_ASSERT_EQUAL(1, opdi_net_scan_results(out, 1, NULL));
+    TEST_ASSERT_EQUAL_STRING("strong", out[0].ssid);
+}
+
+void test_fresh_cache_served_without_scanning(void) {
+    uint32_t before = scans();
+    for (int i=0; i<10; i++) TEST_ASSERT_EQUAL(ESP_OK, opdi_net_scan_request(CONFIG_OPDI_NET_SCAN_TTL_MS));
+    TEST_ASSERT_FALSE(opdi_net_scan_in_progress());
+    TEST_ASSERT_EQUAL_UINT32(before, scans());
+    TEST_ASSERT_EQUAL(1, s_emits);
+}
+
+void test_max_age_forces_rescan_and_keeps_stale_results_readable(void) {
+    wait_ms(5);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, opdi_net_scan_request(2)); // ?max_age=2
+    // While the new scan runs, the previous results stay available
+    opdi_net_scan_ap_t out[8];
+    uint32_t age = 0;
+    TEST_ASSERT_EQUAL(3, opdi_net_scan_results(out, 8, &age));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5, age);
+    // A caller with the default max_age is still answered from the cache meanwhile
+    TEST_ASSERT_EQUAL(ESP_OK, opdi_net_scan_request(CONFIG_OPDI_NET_SCAN_TTL_MS));
+    const opdi_net_scan_ap_t recs[] = { ap("new-net", -50, 3) };
+    opdi_net_test_simulate_scan_done(recs, 1);
+    TEST_ASSERT_EQUAL(1, opdi_net_scan_results(out, 8, &age));
+    TEST_ASSERT_EQUAL_STRING("new-net", out[0].ssid);
+    TEST_ASSERT_EQUAL(2, s_emits);
+}
+
+void test_table_keeps_strongest_when_full(void) {
+    static opdi_net_scan_ap_t recs[CONFIG_OPDI_NET_SCAN_MAX_APS + 8];
+    const size_t total = sizeof(recs)/sizeof(recs[0]);
+    for (size_t i=0; i<total; i++) { char s[16]; snprintf(s, sizeof(s), "ap-%02u", (unsigned)i); recs[i] = ap(s, -30 - (int)i, 1); }
+    // Strongest last so the insert has to displace entries
+    for (size_t i=0; i<total/2; i++) { opdi_net_scan_ap_t t = recs[i]; recs[i] = recs[total-1-i]; recs[total-1-i] = t; }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, opdi_net_scan_request(0));
+    opdi_net_test_simulate_scan_done(recs, total);
+    static opdi_net_scan_ap_t out[CONFIG_OPDI_NET_SCAN_MAX_APS];
+    size_t n = opdi_net_scan_results(out, CONFIG_OPDI_NET_SCAN_MAX_APS, NULL);
+    TEST_ASSERT_EQUAL(CONFIG_OPDI_NET_SCAN_MAX_APS, n);
+    TEST_ASSERT_EQUAL(-30, out[0].rssi);
+    for (size_t i=1; i<n; i++) TEST_ASSERT_TRUE(out[i-1].rssi >= out[i].rssi);
+    TEST_ASSERT_EQUAL(-30 - (CONFIG_OPDI_NET_SCAN_MAX_APS - 1), out[n-1].rssi);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_without_profiles_starts_bootstrap_scan);
+    RUN_TEST(test_concurrent_requests_share_one_scan);
+    RUN_TEST(test_results_sorted_and_filtered);
+    RUN_TEST(test_fresh_cache_served_without_scanning);
+    RUN_TEST(test_max_age_forces_rescan_and_keeps_stale_results_readable);
+    RUN_TEST(test_table_keeps_strongest_when_full);
+    return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+    run_unity_tests();
+}
+#endif
@@ -0,0 +1,177 @@
+// Unity test + benchmark for face alignment: similarity estimate from MNP landmarks and the RGB565 warp
+#include "unity.h"
+#include "opdi_recog.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FW 320
+#define FH 240
+
+// Same template the component uses; a face placed by a known transform must come back out of estimate()
+static const float tmpl[10] = {
+	38.2946f, 51.6963f, 41.5493f, 92.3655f, 56.0252f, 71.7366f, 73.5318f, 51.5014f, 70.7299f, 92.2041f,
+};
+
+static void place(const opdi_recog_xform_t *m, int lm[10]){
+	for (int i=0; i<5; i++){
+		float u = tmpl[2*i], v = tmpl[2*i + 1];
+		lm[2*i] = (int)lroundf(m->a * u - m->b * v + m->tx);
+		lm[2*i + 1] = (int)lroundf(m->b * u + m->a * v + m->ty);
+	}
+}
+
+// Synthetic frame whose three channels vary independently over x and y, so a swapped channel,
+// byte order or coordinate shows up
+static uint16_t pix(int x, int y){
+	int r = (x / 12) & 31, g = (y / 5) & 63, b = ((x + y) / 24) & 31;
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static uint16_t *make_frame(bool be){
+	uint16_t *fr = heap_caps_malloc(FW * FH * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	TEST_ASSERT_NOT_NULL(fr);
+	for (int y=0; y<FH; y++) for (int x=0; x<FW; x++){
+		uint16_t v = pix(x, y);
+		fr[y * FW + x] = be ? (uint16_t)((v >> 8) | (v << 8)) : v;
+	}
+	return fr;
+}
+
+static uint8_t *crop;
+
+void setUp(void) {
+	crop = heap_caps_malloc(OPDI_RECOG_CROP_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	TEST_ASSERT_NOT_NULL(crop);
+}
+
+void tearDown(void) {
+	heap_caps_free(crop);
+	crop = NULL;
+}
+
+void test_recog_estimate_recovers_similarity(void) {
+	const float angles[] = { 0.0f, 0.2f, -0.35f };
+	const float scales[] = { 0.8f, 1.0f, 1.6f };
+	for (int ai=0; ai<3; ai++) for (int si=0; si<3; si++){
+		opdi_recog_xform_t want = {
+			scales[si] * cosf(angles[ai]), scales[si] * sinf(angles[ai]), 90.0f, 40.0f,
+		}, got;
+		int lm[10];
+		place(&want, lm);
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_recog_estimate(lm, &got));
+		// Landmarks are integers, so allow the rounding of half a pixel spread over a ~35 px baseline
+		TEST_ASSERT_FLOAT_WITHIN(0.02f, want.a, got.a);
+		TEST_ASSERT_FLOAT_WITHIN(0.02f, want.b, got.b);
+		// The crop center must land within a pixel of where it should
+		float wx = want.a * 56 - want.b * 56 + want.tx, wy = want.b * 56 + want.a * 56 + want.ty;
+		float gx = got.a * 56 - got.b * 56 + got.tx, gy = got.b * 56 + got.a * 56 + got.ty;
+		TEST_ASSERT_FLOAT_WITHIN(1.0f, wx, gx);
+		TEST_ASSERT_FLOAT_WITHIN(1.0f, wy, gy);
+	}
+}
+
+void test_recog_estimate_rejects_degenerate(void) {
+	int lm[10];
+	for (int i=0; i<10; i++) lm[i] = 100 + (i & 1);
+	opdi_recog_xform_t m;
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_recog_estimate(lm, &m));
+	TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, opdi_recog_estimate(NULL, &m));
+}
+
+// Crop pixel (u, v) must equal the frame sampled at the transformed position
+static void check_warp(bool be){
+	uint16_t *fr = make_frame(be);
+	// Integer translation + unit scale: every sample falls on a pixel, the result must be exact
+	opdi_recog_xform_t m = { 1.0f, 0.0f, 60.0f, 30.0f };
+	opdi_recog_warp_rgb565(fr, FW, FH, be, &m, crop);
+	for (int v=0; v<OPDI_RECOG_CROP; v++) for (int u=0; u<OPDI_RECOG_CROP; u++){
+		uint16_t p = pix(u + 60, v + 30);
+		const uint8_t *c = crop + (v * OPDI_RECOG_CROP + u) * 3;
+		TEST_ASSERT_EQUAL_UINT8(((p >> 8) & 0xf8) | (p >> 13), c[0]);
+		TEST_ASSERT_EQUAL_UINT8(((p >> 3) & 0xfc) | ((p >> 9) & 3), c[1]);
+		TEST_ASSERT_EQUAL_UINT8(((p << 3) & 0xf8) | ((p >> 2) & 7), c[2]);
+	}
+	// Rotated and scaled: compare against a float bilinear sample of the expanded channels
+	m.a = 1.3f * cosf(0.3f); m.b = 1.3f * sinf(0.3f); m.tx = 120.0f; m.ty = 20.0f;
+	opdi_recog_warp_rgb565(fr, FW, FH, be, &m, crop);
+	int worst = 0;
+	for (int v=0; v<OPDI_RECOG_CROP; v+=7) for (int u=0; u<OPDI_RECOG_CROP; u+=5){
+		float x = m.a * u - m.b * v + m.tx, y = m.b * u + m.a * v + m.ty;
+		int x0 = (int)x, y0 = (int)y;
+		float fx = x - x0, fy = y - y0;
+		uint16_t q[4] = { pix(x0, y0), pix(x0 + 1, y0), pix(x0, y0 + 1), pix(x0 + 1, y0 + 1) };
+		float wt[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+		float g = 0;
+		for (int k=0; k<4; k++) g += wt[k] * (float)(((q[k] >> 3) & 0xfc) | ((q[k] >> 9) & 3));
+		int d = abs((int)lroundf(g) - crop[(v * OPDI_RECOG_CROP + u) * 3 + 1]);
+		if (d > worst) worst = d;
+	}
+	TEST_ASSERT_LESS_OR_EQUAL(2, worst);
+	heap_caps_free(fr);
+}
+
+void test_recog_warp_little_endian(void) {
+	check_warp(false);
+}
+
+void test_recog_warp_big_endian(void) {
+	check_warp(true);
+}
+
+void test_recog_warp_clamps_edges(void) {
+	uint16_t *fr = make_frame(false);
+	// Face hanging off the top-left corner: everything left/above the frame repeats pixel (0, 0)'s row/column
+	opdi_recog_xform_t m = { 1.0f, 0.0f, -50.0f, -50.0f };
+	opdi_recog_warp_rgb565(fr, FW, FH, false, &m, crop);
+	uint16_t p = pix(0, 0);
+	TEST_ASSERT_EQUAL_UINT8(((p >> 8) & 0xf8) | (p >> 13), crop[0]);
+	TEST_ASSERT_EQUAL_UINT8(crop[0], crop[(49 * OPDI_RECOG_CROP + 49) * 3]);
+	// Bottom-right: last row/column repeated, never read past the buffer (ASan on the host build)
+	m.tx = FW - 20; m.ty = FH - 20;
+	opdi_recog_warp_rgb565(fr, FW, FH, false, &m, crop);
+	p = pix(FW - 1, FH - 1);
+	TEST_ASSERT_EQUAL_UINT8(((p >> 3) & 0xfc) | ((p >> 9) & 3), crop[(OPDI_RECOG_CROP * OPDI_RECOG_CROP - 1) * 3 + 1]);
+	heap_caps_free(fr);
+}
+
+void test_recog_align_benchmark(void) {
+	uint16_t *fr = make_frame(true);
+	opdi_recog_xform_t want = { 1.2f * cosf(0.1f), 1.2f * sinf(0.1f), 100.0f, 50.0f }, m;
+	int lm[10];
+	place(&want, lm);
+	const int n = 50;
+	int64_t t0 = esp_timer_get_time();
+	for (int i=0; i<n; i++){
+		TEST_ASSERT_EQUAL(ESP_OK, opdi_recog_estimate(lm, &m));
+		opdi_recog_warp_rgb565(fr, FW, FH, true, &m, crop);
+	}
+	int64_t us = (esp_timer_get_time() - t0) / n;
+	char msg[64];
+	snprintf(msg, sizeof(msg), "align (estimate + 112x112 warp): %lld us/face", (long long)us);
+	TEST_MESSAGE(msg);
+	// A small slice of the 500 ms capture-to-event budget even with several faces per frame
+	TEST_ASSERT_LESS_THAN(20000, (int)us);
+	heap_caps_free(fr);
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_recog_estimate_recovers_similarity);
+	RUN_TEST(test_recog_estimate_rejects_degenerate);
+	RUN_TEST(test_recog_warp_little_endian);
+	RUN_TEST(test_recog_warp_big_endian);
+	RUN_TEST(test_recog_warp_clamps_edges);
+	RUN_TEST(test_recog_align_benchmark);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
@@ -0,0 +1,217 @@
+// Unity test for the per-track recognition cache: association, scale/pose/TTL invalidation, voting, telemetry
+#include "unity.h"
+#include "opdi_recog.h"
+#include "opdi_cam.h"
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MS 1000LL
+
+void opdi_cam_recog_periodic_1s(void); // telemetry hook, called from opdi_cam_periodic_1s()
+
+static const float tmpl[10] = {
+	38.2946f, 51.6963f, 41.5493f, 92.3655f, 56.0252f, 71.7366f, 73.5318f, 51.5014f, 70.7299f, 92.2041f,
+};
+
+// Face of the given size (frame pixels per crop pixel) at (x, y); nose_dx shifts the nose sideways
+// in crop pixels, which reads as turning the head
+typedef struct { int box[4]; int lm[10]; } face_t;
+
+static face_t face(float x, float y, float scale, float nose_dx){
+	face_t f;
+	for (int i=0; i<5; i++){
+		f.lm[2*i] = (int)lroundf(x + scale * (tmpl[2*i] + (i == 2 ? nose_dx : 0)));
+		f.lm[2*i + 1] = (int)lroundf(y + scale * tmpl[2*i + 1]);
+	}
+	f.box[0] = (int)x; f.box[1] = (int)y;
+	f.box[2] = (int)(x + scale * 112); f.box[3] = (int)(y + scale * 112);
+	return f;
+}
+
+static opdi_recog_result_t result(uint16_t id, bool matched, const char *label){
+	opdi_recog_result_t r;
+	memset(&r, 0, sizeof(r));
+	r.id = id;
+	r.matched = matched;
+	r.score = matched ? 0.7f : 0.2f;
+	if (matched) strncpy(r.label, label, sizeof(r.label) - 1);
+	r.lat.total_us = 40000;
+	return r;
+}
+
+// One frame with one face: returns whether the cache answered, and the identity it reports
+static bool step(const face_t *f, int64_t now, const opdi_recog_result_t *fresh, uint16_t *track, opdi_recog_result_t *out){
+	opdi_recog_cache_begin_frame(now);
+	if (opdi_recog_cache_get(f->box, f->lm, now, track, out)) return true;
+	opdi_recog_cache_put(*track, f->lm, fresh, now, out);
+	return false;
+}
+
+void setUp(void) {
+	opdi_recog_cache_reset();
+}
+
+void tearDown(void) {
+}
+
+void test_recog_cache_hits_still_face(void) {
+	face_t f = face(100, 60, 1.0f, 0);
+	opdi_recog_result_t alice = result(3, true, "alice"), out;
+	opdi_recog_cache_stats_t s0, s1;
+	opdi_recog_cache_get_stats(&s0);
+	uint16_t track, t2;
+	TEST_ASSERT_FALSE(step(&f, 1000 * MS, &alice, &track, &out));
+	TEST_ASSERT_NOT_EQUAL(0, track);
+	for (int i=1; i<10; i++){
+		// A few pixels of jitter stay on the same track and inside the thresholds
+		face_t g = face(100 + (i & 3), 60 - (i & 1), 1.0f + 0.01f * (i & 1), 0);
+		TEST_ASSERT_TRUE(step(&g, (1000 + 66 * i) * MS, &alice, &t2, &out));
+		TEST_ASSERT_EQUAL(track, t2);
+		TEST_ASSERT_TRUE(out.matched);
+		TEST_ASSERT_EQUAL(3, out.id);
+		TEST_ASSERT_EQUAL_STRING("alice", out.label);
+		TEST_ASSERT_EQUAL(0, out.lat.total_us);
+	}
+	opdi_recog_cache_get_stats(&s1);
+	TEST_ASSERT_EQUAL(10, s1.lookups - s0.lookups);
+	TEST_ASSERT_EQUAL(9, s1.hits - s0.hits);
+	TEST_ASSERT_EQUAL(1, s1.embeds - s0.embeds);
+	TEST_ASSERT_EQUAL(1, s1.tracks);
+}
+
+void test_recog_cache_recomputes_on_ttl_size_pose(void) {
+	face_t f = face(100, 60, 1.0f, 0);
+	opdi_recog_result_t alice = result(3, true, "alice"), out;
+	uint16_t track;
+	int64_t t = 1000 * MS;
+	TEST_ASSERT_FALSE(step(&f, t, &alice, &track, &out));
+	// TTL: still face, but the identity is refreshed
+	int64_t t0 = t;
+	while ((t += 100 * MS) < t0 + CONFIG_OPDI_RECOG_CACHE_TTL_MS * MS) {
+		TEST_ASSERT_TRUE(step(&f, t, &alice, &track, &out));
+	}
+	TEST_ASSERT_FALSE(step(&f, t, &alice, &track, &out));
+	// Walking towards the camera: 40% larger, box still overlapping
+	face_t g = face(90, 50, 1.4f, 0);
+	t += 33 * MS;
+	TEST_ASSERT_FALSE(step(&g, t, &alice, &track, &out));
+	t += 33 * MS;
+	TEST_ASSERT_TRUE(step(&g, t, &alice, &track, &out));
+	// Turning the head: nose moves by 30% of the eye distance
+	face_t h = face(90, 50, 1.4f, 0.3f * 35.24f);
+	t += 33 * MS;
+	TEST_ASSERT_FALSE(step(&h, t, &alice, &track, &out));
+}
+
+void test_recog_cache_separate_tracks(void) {
+	face_t a = face(20, 40, 1.0f, 0), b = face(300, 40, 1.0f, 0);
+	opdi_recog_result_t ra = result(1, true, "a"), rb = result(2, true, "b"), out;
+	uint16_t ta, tb, t;
+	int64_t now = 1000 * MS;
+	opdi_recog_cache_begin_frame(now);
+	TEST_ASSERT_FALSE(opdi_recog_cache_get(a.box, a.lm, now, &ta, &out));
+	opdi_recog_cache_put(ta, a.lm, &ra, now, &out);
+	TEST_ASSERT_FALSE(opdi_recog_cache_get(b.box, b.lm, now, &tb, &out));
+	opdi_recog_cache_put(tb, b.lm, &rb, now, &out);
+	TEST_ASSERT_NOT_EQUAL(ta, tb);
+	// Next frame in the other order: each face keeps its own track and identity
+	now += 33 * MS;
+	opdi_recog_cache_begin_frame(now);
+	TEST_ASSERT_TRUE(opdi_recog_cache_get(b.box, b.lm, now, &t, &out));
+	TEST_ASSERT_EQUAL(tb, t);
+	TEST_ASSERT_EQUAL(2, out.id);
+	TEST_ASSERT_TRUE(opdi_recog_cache_get(a.box, a.lm, now, &t, &out));
+	TEST_ASSERT_EQUAL(ta, t);
+	TEST_ASSERT_EQUAL(1, out.id);
+	// Face a gone for over a second: its track is dropped and a new face there gets a new one
+	now += 1500 * MS;
+	opdi_recog_cache_begin_frame(now);
+	TEST_ASSERT_FALSE(opdi_recog_cache_get(a.box, a.lm, now, &t, &out));
+	TEST_ASSERT_NOT_EQUAL(ta, t);
+}
+
+void test_recog_cache_vote_smoothing(void) {
+	opdi_recog_result_t alice = result(3, true, "alice"), bob = result(7, true, "bob"), unk = result(3, false, ""), out;
+	uint16_t track;
+	int64_t t = 1000 * MS;
+	// Make every frame miss (turning head back and forth) so each one votes
+	float nose = 0;
+	face_t f;
+	for (int i=0; i<3; i++, t += 33 * MS, nose = nose ? 0 : 8){
+		f = face(100, 60, 1.0f, nose);
+		TEST_ASSERT_FALSE(step(&f, t, &alice, &track, &out));
+	}
+	// One frame of bob, or of unknown, does not flip alice
+	f = face(100, 60, 1.0f, nose); nose = nose ? 0 : 8;
+	TEST_ASSERT_FALSE(step(&f, t, &bob, &track, &out));
+	TEST_ASSERT_EQUAL(3, out.id);
+	TEST_ASSERT_EQUAL_STRING("alice", out.label);
+	t += 33 * MS;
+	f = face(100, 60, 1.0f, nose); nose = nose ? 0 : 8;
+	TEST_ASSERT_FALSE(step(&f, t, &alice, &track, &out));
+	t += 33 * MS;
+	f = face(100, 60, 1.0f, nose); nose = nose ? 0 : 8;
+	TEST_ASSERT_FALSE(step(&f, t, &unk, &track, &out));
+	TEST_ASSERT_TRUE(out.matched);
+	TEST_ASSERT_EQUAL(3, out.id);
+	// Bob persists: identity follows
+	for (int i=0; i<3; i++){
+		t += 33 * MS;
+		f = face(100, 60, 1.0f, nose); nose = nose ? 0 : 8;
+		TEST_ASSERT_FALSE(step(&f, t, &bob, &track, &out));
+	}
+	TEST_ASSERT_EQUAL(7, out.id);
+	TEST_ASSERT_EQUAL_STRING("bob", out.label);
+	// And the cached answer is the smoothed one
+	t += 33 * MS;
+	TEST_ASSERT_TRUE(step(&f, t, &alice, &track, &out));
+	TEST_ASSERT_EQUAL(7, out.id);
+}
+
+void test_recog_cache_gallery_change_drops_tracks(void) {
+	face_t f = face(100, 60, 1.0f, 0);
+	opdi_recog_result_t alice = result(3, true, "alice"), out;
+	uint16_t track;
+	TEST_ASSERT_FALSE(step(&f, 1000 * MS, &alice, &track, &out));
+	TEST_ASSERT_TRUE(step(&f, 1033 * MS, &alice, &track, &out));
+	// Identity 3 renamed or deleted: the next frame embeds again instead of reporting the old label
+	opdi_gallery_changed();
+	opdi_recog_result_t carol = result(3, true, "carol");
+	TEST_ASSERT_FALSE(step(&f, 1066 * MS, &carol, &track, &out));
+	TEST_ASSERT_EQUAL_STRING("carol", out.label);
+	TEST_ASSERT_TRUE(step(&f, 1100 * MS, &carol, &track, &out));
+	TEST_ASSERT_EQUAL_STRING("carol", out.label);
+}
+
+void test_recog_cache_telemetry(void) {
+	face_t f = face(100, 60, 1.0f, 0);
+	opdi_recog_result_t alice = result(3, true, "alice"), out;
+	uint16_t track;
+	opdi_cam_recog_periodic_1s();    // baseline
+	for (int i=0; i<4; i++) step(&f, (1000 + 33 * i) * MS, &alice, &track, &out);
+	usleep(100 * 1000);
+	opdi_cam_recog_periodic_1s();
+	opdi_cam_telemetry_t tel;
+	opdi_cam_get_telemetry(&tel);
+	TEST_ASSERT_EQUAL(75, tel.recog_hit_pct);          // 1 embedding, 3 hits
+	TEST_ASSERT_INT_WITHIN(4, 10, tel.recog_embed_ps); // 1 embedding in ~100 ms
+}
+
+int run_unity_tests(void);
+int run_unity_tests(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_recog_cache_hits_still_face);
+	RUN_TEST(test_recog_cache_recomputes_on_ttl_size_pose);
+	RUN_TEST(test_recog_cache_separate_tracks);
+	RUN_TEST(test_recog_cache_vote_smoothing);
+	RUN_TEST(test_recog_cache_gallery_change_drops_tracks);
+	RUN_TEST(test_recog_cache_telemetry);
+	return UNITY_END();
+}
+
+#ifdef CONFIG_IDF_TARGET_ESP32P4
+void app_main(void) {
+	run_unity_tests();
+}
+#endif
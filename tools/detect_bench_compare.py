@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Compare detection benchmark reports (bench_<model>.json written by CONFIG_CAMERA_DETECT_BENCH).
+
+Prints the baseline and candidate side by side with the relative change. Exits non-zero when the
+candidate's FPS dropped, or its detect p99 grew, by more than --tolerance percent, so a model or
+config change can be gated on it.
+
+Standard library only. Example:
+
+  python tools/detect_bench_compare.py before/bench_humanface.json after/bench_humanface.json
+"""
+import argparse
+import json
+import sys
+
+# (label, path into the report, higher is better (None: no direction), gates the exit code)
+METRICS = [
+    ('fps', ('fps',), True, True),
+    ('wall fps', ('wall_fps',), True, False),
+    ('detect p50 us', ('stages_us', 'detect', 'p50'), False, False),
+    ('detect p90 us', ('stages_us', 'detect', 'p90'), False, False),
+    ('detect p99 us', ('stages_us', 'detect', 'p99'), False, True),
+    ('recog p50 us', ('stages_us', 'recog', 'p50'), False, False),
+    ('recog p99 us', ('stages_us', 'recog', 'p99'), False, False),
+    ('read p50 us', ('stages_us', 'read', 'p50'), False, False),
+    ('heap peak B', ('mem', 'heap_peak'), False, False),
+    ('psram peak B', ('mem', 'psram_peak'), False, False),
+    ('load ms', ('load_ms',), False, False),
+    ('resident B', ('resident_bytes',), False, False),
+    ('detections', ('detections', 'total'), None, False),
+    ('frames with det', ('detections', 'frames_with'), None, False),
+]
+
+
+def get(report, path):
+    for key in path:
+        if not isinstance(report, dict) or key not in report:
+            return None
+        report = report[key]
+    return report
+
+
+def load(path):
+    with open(path, encoding='utf-8') as f:
+        return json.loads(f.read().strip().splitlines()[-1])  # last report if the file was appended to
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('baseline')
+    ap.add_argument('candidate')
+    ap.add_argument('--tolerance', type=float, default=5.0, help='allowed FPS / p99 regression (%%)')
+    args = ap.parse_args()
+    a, b = load(args.baseline), load(args.candidate)
+
+    for key in ('model', 'width', 'height'):
+        if a.get(key) != b.get(key):
+            print('warning: %s differs (%s vs %s)' % (key, a.get(key), b.get(key)))
+    if a.get('frames') != b.get('frames'):
+        print('warning: frame count differs (%s vs %s); detection totals are not comparable' % (a.get('frames'), b.get('frames')))
+    print('%-16s %14s %14s %9s' % ('', a.get('label') or 'baseline', b.get('label') or 'candidate', 'change'))
+
+    failed = []
+    for label, path, higher_better, gated in METRICS:
+        va, vb = get(a, path), get(b, path)
+        if va is None and vb is None:
+            continue
+        change = ''
+        if isinstance(va, (int, float)) and isinstance(vb, (int, float)) and va:
+            pct = (vb - va) * 100.0 / va
+            change = '%+8.1f%%' % pct
+            worse = -pct if higher_better else pct
+            if gated and worse > args.tolerance:
+                failed.append(label)
+                change += ' !'
+        print('%-16s %14s %14s %9s' % (label, '-' if va is None else va, '-' if vb is None else vb, change))
+
+    if failed:
+        print('regressed beyond %.1f%%: %s' % (args.tolerance, ', '.join(failed)))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Gzip web UI assets and emit them as a C table for opdi_api_static.c.
+
+Output is reproducible (no timestamps in the gzip header), so an unchanged asset keeps its ETag
+across builds and browsers keep getting 304s after a firmware update.
+"""
+import argparse
+import gzip
+import hashlib
+import os
+
+
+def c_bytes(data, indent='    ', per_line=16):
+    lines = []
+    for i in range(0, len(data), per_line):
+        lines.append(indent + ', '.join('0x%02x' % b for b in data[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument('-o', '--output', required=True, help='generated C file')
+    ap.add_argument('files', nargs='+', help='assets to embed')
+    args = ap.parse_args()
+
+    arrays, entries = [], []
+    for idx, path in enumerate(args.files):
+        with open(path, 'rb') as f:
+            raw = f.read()
+        gz = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '\\"%s\\"' % hashlib.sha256(gz).hexdigest()[:16]
+        name = os.path.basename(path)
+        arrays.append('// %s: %u B -> %u B gzip\nstatic const uint8_t s_asset_%d[] = {\n%s\n};\n'
+                      % (name, len(raw), len(gz), idx, c_bytes(gz)))
+        entries.append('    { "%s", "%s", s_asset_%d, sizeof(s_asset_%d), %uu },' % (name, etag, idx, idx, len(raw)))
+
+    out = ['// Generated by tools/gzip_web_assets.py - do not edit',
+           '#include "opdi_api_static_assets.h"',
+           '']
+    out += arrays
+    out.append('const opdi_web_asset_t opdi_web_assets[] = {')
+    out += entries
+    out.append('};')
+    out.append('const size_t opdi_web_asset_count = sizeof(opdi_web_assets) / sizeof(opdi_web_assets[0]);')
+    tmp = args.output + '.tmp'
+    with open(tmp, 'w', newline='\n') as f:
+        f.write('\n'.join(out) + '\n')
+    os.replace(tmp, args.output)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Build and run the linux host target (host/) for CI: Unity suites, then an HTTP load run.
+
+Each test file in HOST_TESTS is built as its own host app (idf.py -DOPDI_HOST_TEST=<name>) and run;
+the server app is then started on 127.0.0.1 and tools/httpd_loadgen.py is pointed at it. Needs an
+ESP-IDF environment (IDF_PATH, idf.py on PATH); no board. When mosquitto is on PATH a broker is
+started on 127.0.0.1:1883 for the suites, so test_opdi_mqtt also runs its broker round trip.
+"""
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import time
+import urllib.request
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOST = os.path.join(ROOT, 'host')
+
+# Suites that only touch the opdi_api / camera logic layer / gallery / bench harness / MQTT publisher, and the audio
+# suites (over the real-time codec stand-in). The opdi_net suites exercise the real Wi-Fi state machine (opdi_net.c),
+# which the host build replaces.
+HOST_TESTS = [
+    'test_opdi_api_json',
+    'test_opdi_api_json_parse',
+    'test_opdi_api_static',
+    'test_opdi_api_ws_bus',
+    'test_opdi_api_ws_subscribe',
+    'test_opdi_audio_duplex_loopback',
+    'test_opdi_audio_mixer',
+    'test_opdi_audio_resample',
+    'test_opdi_audio_spectrum',
+    'test_opdi_audio_tone',
+    'test_opdi_bench',
+    'test_opdi_cam_config_roundtrip',
+    'test_opdi_cam_encode',
+    'test_opdi_cam_ext',
+    'test_opdi_cam_simulcast',
+    'test_opdi_cam_snapshot',
+    'test_opdi_clip',
+    'test_opdi_gallery',
+    'test_opdi_gallery_xfer',
+    'test_opdi_mqtt',
+    'test_opdi_recog_align',
+    'test_opdi_recog_cache',
+]
+
+
+def idf_build(build_dir, *defs):
+    cmd = ['idf.py', '--preview', '-C', HOST, '-B', build_dir] + ['-D' + d for d in defs] + ['build']
+    return subprocess.run(cmd, stdout=subprocess.DEVNULL if not VERBOSE else None).returncode == 0
+
+
+def run_tests(names, out_dir, timeout):
+    failed = []
+    for name in names:
+        build_dir = os.path.join(out_dir, name)
+        if not idf_build(build_dir, 'OPDI_HOST_TEST=' + name):
+            print('%-34s BUILD FAILED' % name)
+            failed.append(name)
+            continue
+        t0 = time.monotonic()
+        try:
+            r = subprocess.run([os.path.join(build_dir, 'opdi_host.elf')], capture_output=True, text=True, timeout=timeout)
+            ok, tail = r.returncode == 0, r.stdout.strip().splitlines()[-3:]
+        except subprocess.TimeoutExpired:
+            ok, tail = False, ['timeout after %ds' % timeout]
+        print('%-34s %s  %.1f s' % (name, 'ok' if ok else 'FAILED', time.monotonic() - t0))
+        if not ok or VERBOSE:
+            print('\n'.join('    ' + l for l in tail))
+        if not ok:
+            failed.append(name)
+    return failed
+
+
+def run_load(out_dir, args):
+    build_dir = os.path.join(out_dir, 'server')
+    if not idf_build(build_dir):
+        print('server BUILD FAILED')
+        return False
+    srv = subprocess.Popen([os.path.join(build_dir, 'opdi_host.elf')], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        base = 'http://127.0.0.1:%d' % args.port
+        for _ in range(50):  # up to 5 s for the listener
+            try:
+                urllib.request.urlopen(base + '/api/v1/system/info', timeout=1).read()
+                break
+            except OSError:
+                time.sleep(0.1)
+        else:
+            print('server did not come up on %s' % base)
+            return False
+        cmd = [sys.executable, os.path.join(ROOT, 'tools', 'httpd_loadgen.py'), '--host', '127.0.0.1',
+               '--port', str(args.port), '--stream-port', str(args.stream_port), '--duration', str(args.duration)]
+        if args.json:
+            cmd += ['--json', args.json]
+        return subprocess.run(cmd).returncode == 0
+    finally:
+        srv.terminate()
+        srv.wait(5)
+
+
+def main():
+    global VERBOSE
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('tests', nargs='*', help='test names (default: all host-capable suites)')
+    ap.add_argument('--build-dir', default=os.path.join(HOST, 'build-ci'))
+    ap.add_argument('--timeout', type=int, default=120, help='seconds per suite')
+    ap.add_argument('--no-tests', action='store_true')
+    ap.add_argument('--load', action='store_true', help='run httpd_loadgen.py against the server app')
+    ap.add_argument('--duration', type=float, default=20.0, help='load run length (s)')
+    ap.add_argument('--port', type=int, default=8080, help='CONFIG_OPDI_HTTPD_PORT of host/sdkconfig.defaults')
+    ap.add_argument('--stream-port', type=int, default=8081)
+    ap.add_argument('--json', help='load report file')
+    ap.add_argument('-v', '--verbose', action='store_true')
+    args = ap.parse_args()
+    VERBOSE = args.verbose
+
+    broker = None
+    if not args.no_tests and shutil.which('mosquitto'):
+        broker = subprocess.Popen(['mosquitto', '-p', '1883'], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        failed = [] if args.no_tests else run_tests(args.tests or HOST_TESTS, args.build_dir, args.timeout)
+    finally:
+        if broker:
+            broker.terminate()
+            broker.wait(5)
+    load_ok = run_load(args.build_dir, args) if args.load else True
+    if failed:
+        print('failed: ' + ', '.join(failed))
+    return 0 if not failed and load_ok else 1
+
+
+VERBOSE = False
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+"""Mixed HTTP load generator for the device web server (or a linux-target build).
+
+Runs concurrent keep-alive REST clients, /ws event clients and MJPEG /stream viewers for a fixed
+time and reports latency percentiles per endpoint:
+
+  REST     request sent -> full response read (UI assets revalidate with If-None-Match)
+  WS       handshake time, sub -> sub_ack round trip, gaps between event frames
+  MJPEG    time to first frame, gaps between frames, frame rate per viewer (viewers alternate between
+           ?layer=main and ?layer=sub, so both simulcast layers are served at once)
+
+Standard library only. Example:
+
+  python tools/httpd_loadgen.py --host 192.168.4.1 --duration 30 --rest 4 --ws 2 --mjpeg 2
+"""
+import argparse
+import asyncio
+import base64
+import json
+import os
+import random
+import struct
+import sys
+import time
+
+DEFAULT_PATHS = [
+    # (weight, method, path)
+    (4, 'GET', '/api/v1/net/sta/status'),
+    (2, 'GET', '/api/v1/net/metrics'),
+    (2, 'GET', '/api/v1/system/info'),
+    (1, 'GET', '/api/v1/net/sta/profiles'),
+    (1, 'GET', '/'),
+    (1, 'GET', '/app.js'),
+    (1, 'GET', '/style.css'),
+]
+
+
+class Stats:
+    def __init__(self):
+        self.samples = {}
+        self.errors = {}
+        self.status = {}
+        self.viewers = {}
+
+    def frame(self, viewer, layer, now):
+        v = self.viewers.setdefault(viewer, {'layer': layer, 'frames': 0, 'first': now, 'last': now})
+        v['frames'] += 1
+        v['last'] = now
+
+    def add(self, name, seconds):
+        self.samples.setdefault(name, []).append(seconds * 1000.0)
+
+    def error(self, name, what):
+        key = '%s: %s' % (name, what)
+        self.errors[key] = self.errors.get(key, 0) + 1
+
+    def code(self, name, status):
+        per = self.status.setdefault(name, {})
+        per[status] = per.get(status, 0) + 1
+
+    @staticmethod
+    def pct(sorted_ms, p):
+        if not sorted_ms:
+            return 0.0
+        k = max(0, min(len(sorted_ms) - 1, int(round(p / 100.0 * len(sorted_ms) + 0.5)) - 1))
+        return sorted_ms[k]
+
+    def report(self, duration):
+        rows = {}
+        for name, ms in sorted(self.samples.items()):
+            ms.sort()
+            rows[name] = {
+                'count': len(ms),
+                'rate_per_s': round(len(ms) / duration, 2),
+                'p50_ms': round(self.pct(ms, 50), 2),
+                'p90_ms': round(self.pct(ms, 90), 2),
+                'p99_ms': round(self.pct(ms, 99), 2),
+                'max_ms': round(ms[-1], 2),
+                'status': self.status.get(name, {}),
+            }
+        viewers = []
+        for idx, v in sorted(self.viewers.items()):
+            span = v['last'] - v['first']
+            viewers.append({'viewer': idx, 'layer': v['layer'], 'frames': v['frames'],
+                            'fps': round((v['frames'] - 1) / span, 2) if span > 0 else 0.0})
+        return {'duration_s': duration, 'endpoints': rows, 'viewers': viewers, 'errors': self.errors}
+
+
+async def read_headers(reader):
+    status_line = await reader.readline()
+    if not status_line:
+        raise ConnectionError('closed')
+    parts = status_line.decode('latin-1').split(' ', 2)
+    status = int(parts[1])
+    headers = {}
+    while True:
+        line = await reader.readline()
+        if line in (b'\r\n', b'\n', b''):
+            break
+        k, _, v = line.decode('latin-1').partition(':')
+        headers[k.strip().lower()] = v.strip()
+    return status, headers
+
+
+async def read_body(reader, headers, status):
+    if status in (204, 304):
+        return b''
+    if headers.get('transfer-encoding', '').lower() == 'chunked':
+        body = bytearray()
+        while True:
+            size = int((await reader.readline()).split(b';')[0], 16)
+            if size == 0:
+                await reader.readline()
+                return bytes(body)
+            body += await reader.readexactly(size)
+            await reader.readexactly(2)
+    n = int(headers.get('content-length', '0'))
+    return await reader.readexactly(n) if n else b''
+
+
+async def rest_worker(args, stats, deadline, paths):
+    weights = [w for w, _, _ in paths]
+    etags = {}
+    reader = writer = None
+    while time.monotonic() < deadline:
+        _, method, path = random.choices(paths, weights)[0]
+        name = '%s %s' % (method, path)
+        try:
+            if writer is None:
+                reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+            req = '%s %s HTTP/1.1\r\nHost: %s\r\nAccept-Encoding: gzip\r\nConnection: keep-alive\r\n' % (method, path, args.host)
+            if path in etags:
+                req += 'If-None-Match: %s\r\n' % etags[path]
+            t0 = time.monotonic()
+            writer.write((req + '\r\n').encode())
+            await writer.drain()
+            status, headers = await asyncio.wait_for(read_headers(reader), args.timeout)
+            await asyncio.wait_for(read_body(reader, headers, status), args.timeout)
+            stats.add(name, time.monotonic() - t0)
+            stats.code(name, status)
+            if 'etag' in headers:
+                etags[path] = headers['etag']
+            if headers.get('connection', '').lower() == 'close':
+                writer.close()
+                writer = None
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError, ValueError) as e:
+            stats.error(name, type(e).__name__)
+            if writer is not None:
+                writer.close()
+            writer = None
+            await asyncio.sleep(0.2)
+        if args.think_ms:
+            await asyncio.sleep(random.uniform(0, 2 * args.think_ms) / 1000.0)
+    if writer is not None:
+        writer.close()
+
+
+def ws_frame(opcode, payload):
+    mask = os.urandom(4)
+    n = len(payload)
+    if n < 126:
+        hdr = struct.pack('!BB', 0x80 | opcode, 0x80 | n)
+    elif n < 65536:
+        hdr = struct.pack('!BBH', 0x80 | opcode, 0x80 | 126, n)
+    else:
+        hdr = struct.pack('!BBQ', 0x80 | opcode, 0x80 | 127, n)
+    return hdr + mask + bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+
+
+async def ws_read(reader):
+    b0, b1 = await reader.readexactly(2)
+    n = b1 & 0x7f
+    if n == 126:
+        n = struct.unpack('!H', await reader.readexactly(2))[0]
+    elif n == 127:
+        n = struct.unpack('!Q', await reader.readexactly(8))[0]
+    if b1 & 0x80:
+        await reader.readexactly(4)  # servers do not mask, but tolerate it
+    return b0 & 0x0f, await reader.readexactly(n)
+
+
+async def ws_worker(args, stats, deadline, idx):
+    sub = json.dumps({'type': 'sub', 'topics': args.ws_topics.split(','), 'binary': args.ws_binary}).encode()
+    while time.monotonic() < deadline:
+        writer = None
+        try:
+            t0 = time.monotonic()
+            reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+            key = base64.b64encode(os.urandom(16)).decode()
+            writer.write(('GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                          'Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n' % (args.host, key)).encode())
+            await writer.drain()
+            status, _ = await asyncio.wait_for(read_headers(reader), args.timeout)
+            if status != 101:
+                stats.error('WS /ws handshake', 'HTTP %d' % status)
+                await asyncio.sleep(1)
+                continue
+            stats.add('WS /ws handshake', time.monotonic() - t0)
+            last_frame = None
+            sub_sent = None
+            next_sub = time.monotonic()
+            while time.monotonic() < deadline:
+                if sub_sent is None and time.monotonic() >= next_sub:
+                    sub_sent = time.monotonic()
+                    writer.write(ws_frame(0x1, sub))
+                    await writer.drain()
+                try:
+                    op, payload = await asyncio.wait_for(ws_read(reader), min(1.0, max(0.05, deadline - time.monotonic())))
+                except asyncio.TimeoutError:
+                    continue
+                now = time.monotonic()
+                if op == 0x8:
+                    raise ConnectionError('ws close')
+                if op == 0x9:
+                    writer.write(ws_frame(0xA, payload))
+                    continue
+                if op == 0x1 and sub_sent is not None and payload.startswith(b'{"type":"sub_ack"'):
+                    stats.add('WS /ws sub rtt', now - sub_sent)
+                    sub_sent = None
+                    next_sub = now + args.ws_sub_interval
+                    continue
+                if last_frame is not None:
+                    stats.add('WS /ws event gap', now - last_frame)
+                stats.code('WS /ws event gap', 'binary' if op == 0x2 else 'text')
+                last_frame = now
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError, ValueError) as e:
+            stats.error('WS /ws', type(e).__name__)
+            await asyncio.sleep(0.5)
+        finally:
+            if writer is not None:
+                writer.close()
+
+
+async def mjpeg_worker(args, stats, deadline, idx):
+    port = args.stream_port or args.port
+    layer = ('main', 'sub')[idx % 2]
+    name = 'MJPEG /stream?layer=%s' % layer
+    while time.monotonic() < deadline:
+        writer = None
+        try:
+            t0 = time.monotonic()
+            reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, port), args.timeout)
+            writer.write(('GET /stream?layer=%s HTTP/1.1\r\nHost: %s\r\n\r\n' % (layer, args.host)).encode())
+            await writer.drain()
+            status, headers = await asyncio.wait_for(read_headers(reader), args.timeout)
+            if status != 200:
+                stats.error(name, 'HTTP %d' % status)
+                await asyncio.sleep(1)
+                continue
+            chunked = headers.get('transfer-encoding', '').lower() == 'chunked'
+            buf = bytearray()
+            last = None
+            while time.monotonic() < deadline:
+                if chunked:
+                    size = int((await asyncio.wait_for(reader.readline(), args.timeout)).split(b';')[0], 16)
+                    if size == 0:
+                        raise ConnectionError('stream ended')
+                    buf += await reader.readexactly(size)
+                    await reader.readexactly(2)
+                else:
+                    data = await asyncio.wait_for(reader.read(65536), args.timeout)
+                    if not data:
+                        raise ConnectionError('stream ended')
+                    buf += data
+                # One frame per JPEG end-of-image marker
+                while True:
+                    eoi = buf.find(b'\xff\xd9')
+                    if eoi < 0:
+                        break
+                    del buf[:eoi + 2]
+                    now = time.monotonic()
+                    if last is None:
+                        stats.add(name + ' first frame', now - t0)
+                    else:
+                        stats.add(name + ' frame gap', now - last)
+                    stats.frame(idx, layer, now)
+                    last = now
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError, ValueError) as e:
+            stats.error(name, type(e).__name__)
+            await asyncio.sleep(0.5)
+        finally:
+            if writer is not None:
+                writer.close()
+
+
+def print_report(rep):
+    print('%-36s %7s %8s %9s %9s %9s %9s  %s' % ('endpoint', 'count', 'rate/s', 'p50 ms', 'p90 ms', 'p99 ms', 'max ms', 'status'))
+    for name, r in rep['endpoints'].items():
+        st = ' '.join('%s:%d' % kv for kv in sorted(r['status'].items(), key=lambda kv: str(kv[0])))
+        print('%-36s %7d %8.1f %9.2f %9.2f %9.2f %9.2f  %s' % (name, r['count'], r['rate_per_s'], r['p50_ms'],
+                                                                r['p90_ms'], r['p99_ms'], r['max_ms'], st))
+    if rep['viewers']:
+        print('viewers:')
+        for v in rep['viewers']:
+            print('  #%-3d layer=%-5s %7d frames %8.1f fps' % (v['viewer'], v['layer'], v['frames'], v['fps']))
+    if rep['errors']:
+        print('errors:')
+        for k, v in sorted(rep['errors'].items()):
+            print('  %-50s %d' % (k, v))
+
+
+async def run(args):
+    stats = Stats()
+    paths = DEFAULT_PATHS
+    if args.path:
+        paths = [(1, 'GET', p) for p in args.path]
+    deadline = time.monotonic() + args.duration
+    tasks = [rest_worker(args, stats, deadline, paths) for _ in range(args.rest)]
+    tasks += [ws_worker(args, stats, deadline, i) for i in range(args.ws)]
+    tasks += [mjpeg_worker(args, stats, deadline, i) for i in range(args.mjpeg)]
+    await asyncio.gather(*tasks)
+    return stats.report(args.duration)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--host', default='192.168.4.1', help='device address (provisioning AP default)')
+    ap.add_argument('--port', type=int, default=80)
+    ap.add_argument('--stream-port', type=int, default=81, help='CONFIG_OPDI_HTTPD_STREAM_PORT, 0 = same as --port')
+    ap.add_argument('--duration', type=float, default=30.0, help='seconds')
+    ap.add_argument('--rest', type=int, default=4, help='concurrent keep-alive REST clients')
+    ap.add_argument('--ws', type=int, default=2, help='concurrent /ws clients')
+    ap.add_argument('--mjpeg', type=int, default=2, help='concurrent /stream viewers, alternating layer=main and layer=sub')
+    ap.add_argument('--path', action='append', help='REST path to request (repeatable, replaces the default mix)')
+    ap.add_argument('--think-ms', type=float, default=0.0, help='mean random pause between REST requests')
+    ap.add_argument('--ws-topics', default='*', help='comma-separated /ws subscription')
+    ap.add_argument('--ws-binary', action='store_true', help='subscribe with "binary":true')
+    ap.add_argument('--ws-sub-interval', type=float, default=1.0, help='seconds between sub round-trip probes')
+    ap.add_argument('--timeout', type=float, default=5.0)
+    ap.add_argument('--json', help='also write the report to this file')
+    args = ap.parse_args()
+
+    rep = asyncio.run(run(args))
+    rep['config'] = {k: v for k, v in vars(args).items() if k != 'json'}
+    print_report(rep)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump(rep, f, indent=2)
+    return 1 if not rep['endpoints'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -22,13 +22,15 @@ async function handleAddProfile(ev){ ev.preventDefault(); const fd=new FormData(
 async function handleAP(ev){ ev.preventDefault(); const fd=new FormData(ev.target); const body={ssid:fd.get('ssid')||'', channel: parseInt(fd.get('channel')||'1',10)}; try{ await raw('/api/v1/net/ap/config',{method:'POST', body:JSON.stringify(body)}); toast('AP config saved'); loadApConfig(); }catch(e){ toast('AP save failed',true);} }
 async function loadApConfig(){ try { const d = await jget('/api/v1/net/ap/config'); S.ap=d; const f=document.getElementById('ap-config-form'); f.querySelector('[name=ssid]').value=d.ssid||''; f.querySelector('[name=channel]').value=d.channel||1; } catch(e){} }
 async function loadLogs(){ try { const d= await jget('/api/v1/net/logs'); S.logs=d; document.getElementById('logs-view').textContent=JSON.stringify(d,null,2); } catch(e){ toast('Logs error',true);} }
-async function scan(){ const btn=document.getElementById('btn-scan'); btn.disabled=true; try { const res = await jget('/api/v1/net/scan'); S.scan=res; renderScan(); toast('Scan complete'); } catch(e){ toast('Scan failed',true);} setTimeout(()=>btn.disabled=false, 30000); }
+async function scan(){ const btn=document.getElementById('btn-scan'); btn.disabled=true; try { const r=await fetch('/api/v1/net/scan'); if(!r.ok) throw new Error('HTTP '+r.status); S.scan=await r.json(); renderScan(); toast(r.status===202?'Scanning…':'Scan complete'); } catch(e){ toast('Scan failed',true);} setTimeout(()=>btn.disabled=false, 5000); }
 function renderScan(){ const div=els.scanResults(); if(!S.scan.length){ div.textContent='No results'; return;} const rows=S.scan.map(r=>`<tr><td>${r.ssid||'(hidden)'}</td><td>${r.rssi}</td><td>${r.auth}</td><td>${r.ch}</td><td><button data-connect="${r.ssid}">Connect</button></td></tr>`).join(''); div.innerHTML=`<table class="scan"><thead><tr><th>SSID</th><th>RSSI</th><th>Auth</th><th>Ch</th><th></th></tr></thead><tbody>${rows}</tbody></table>`; }
 function navHandler(e){ if(e.target.matches('[data-view]')){ e.preventDefault(); document.querySelectorAll('nav a').forEach(a=>a.classList.remove('active')); e.target.classList.add('active'); const v=e.target.getAttribute('data-view'); document.querySelectorAll('.view').forEach(sec=>sec.classList.remove('active')); document.getElementById('view-'+v).classList.add('active'); if(v==='about') loadSysinfo(); if(v==='wifi') loadProfiles(); if(v==='status') refreshStatus(); if(v==='ap') loadApConfig(); if(v==='logs') loadLogs(); } }
 function tableClick(e){ const del=e.target.getAttribute('data-del'); if(del){ raw('/api/v1/net/sta/profiles/'+del,{method:'DELETE'}).then(()=>{toast('Deleted'); loadProfiles();}).catch(()=>toast('Delete failed',true)); }
  const conn=e.target.getAttribute('data-connect'); if(conn){ raw('/api/v1/net/sta/connect',{method:'POST', body:JSON.stringify({ssid:conn})}).then(()=>toast('Connect sent')).catch(()=>toast('Connect failed',true)); } }
-function wsStart(){ let retry=0; function connect(){ const ws = new WebSocket(((location.protocol==='https:')?'wss://':'ws://')+location.host+'/ws'); ws.onopen=()=>{ retry=0; }; ws.onmessage=(ev)=>{ try { const msg=JSON.parse(ev.data); if(msg.type==='net'){ if(msg.sub==='sta_connected'){ S.state='STA_CONNECTED'; S.ip=msg.ip; S.rssi=msg.rssi; badge(); refreshStatus(); } else if(msg.sub==='sta_disconnected'){ S.state='STA_CONNECT'; badge(); } else if(msg.sub==='ap_active'){ S.state='AP_ACTIVE'; badge(); } } } catch(_e){} }; ws.onclose=()=>{ retry++; const delay=Math.min(15000, (2**retry)*1000); setTimeout(connect, delay); }; }
+function wsStart(){ let retry=0; function connect(){ const ws = new WebSocket(((location.protocol==='https:')?'wss://':'ws://')+location.host+'/ws'); ws.onopen=()=>{ retry=0; ws.send(JSON.stringify({type:'sub',topics:['net']})); }; ws.onmessage=(ev)=>{ try { const data=JSON.parse(ev.data); (Array.isArray(data)?data:[data]).forEach(onWsEvent); } catch(_e){} }; ws.onclose=()=>{ retry++; const delay=Math.min(15000, (2**retry)*1000); setTimeout(connect, delay); }; }
  connect(); }
+// The device batches bursts of events into one frame as a JSON array
+function onWsEvent(msg){ if(msg.type==='net'){ if(msg.sub==='sta_connected'){ S.state='STA_CONNECTED'; S.ip=msg.ip; S.rssi=msg.rssi; badge(); refreshStatus(); } else if(msg.sub==='sta_disconnected'){ S.state='STA_CONNECT'; badge(); } else if(msg.sub==='ap_active'){ S.state='AP_ACTIVE'; badge(); } else if(msg.sub==='scan'){ S.scan=msg.aps||[]; renderScan(); } } }
 function init(){ document.getElementById('add-profile-form').addEventListener('submit', handleAddProfile); document.getElementById('ap-config-form').addEventListener('submit', handleAP); document.getElementById('btn-scan').addEventListener('click', scan); document.getElementById('btn-logs-refresh').addEventListener('click', loadLogs); document.querySelector('nav').addEventListener('click', navHandler); document.body.addEventListener('click', tableClick); refreshStatus(); loadApConfig(); wsStart(); }
 window.addEventListener('DOMContentLoaded', init);
 })();